@@ -27,6 +27,8 @@
 
 
 namespace dxvk {
+  std::atomic<uint64_t> D3D9CommonBuffer::s_writeSequence = 1;
+
   D3D9CommonBuffer::D3D9CommonBuffer(
           D3D9DeviceEx*      pDevice,
     const D3D9_BUFFER_DESC*  pDesc) 
@@ -39,6 +41,8 @@ namespace dxvk {
 
     if (m_desc.Pool != D3DPOOL_DEFAULT)
       m_dirtyRange = D3D9Range(0, m_desc.Size);
+
+    MarkWritten();
   }
 
 
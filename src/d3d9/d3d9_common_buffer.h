@@ -170,6 +170,17 @@ namespace dxvk {
     }
     inline uint32_t GetLockCount() const { return m_lockCount; }
 
+    /**
+     * \brief Globally unique stamp of the last write (CPU lock or GPU ProcessVertices) to this buffer.
+     *        Two equal stamps on the same buffer guarantee the contents have not changed in between.
+     */
+    inline uint64_t GetWriteSequence() const { return m_writeSequence; }
+
+    /**
+     * \brief Signal that the buffer contents may have changed
+     */
+    inline void MarkWritten() { m_writeSequence = s_writeSequence++; }
+
     /**
      * \brief Whether or not the staging buffer needs to be copied to the actual buffer
      */
@@ -218,6 +229,10 @@ namespace dxvk {
     D3D9Range                   m_gpuReadingRange;
 
     uint32_t                    m_lockCount = 0;
+
+    uint64_t                    m_writeSequence = 0;
+
+    static std::atomic<uint64_t> s_writeSequence;
   };
 
 }
\ No newline at end of file
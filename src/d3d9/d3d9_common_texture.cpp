@@ -9,6 +9,7 @@
 #include <iostream>
 #include <sstream>
 #include "../dxvk/imgui/dxvk_imgui.h"
+#include "../dxvk/rtx_render/rtx_hash_collision_detection.h"
 
 namespace dxvk {
   D3D9CommonTexture::D3D9CommonTexture(
@@ -563,6 +564,8 @@ namespace dxvk {
     } else {
       imageHash = XXH3_64bits(buffer->mapPtr(0), buffer->info().size);
     }
+    HashCollisionDetection::registerHashedSourceData(imageHash, buffer->mapPtr(0), buffer->info().size, HashSourceDataCategory::Texture);
+
     // save hash to dxvkImage
     m_image->setHash(imageHash);
 
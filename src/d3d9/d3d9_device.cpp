@@ -92,6 +92,11 @@ namespace dxvk {
     if (canSWVP)
       Logger::info("D3D9DeviceEx: Using extended constant set for software vertex processing.");
 
+    // NV-DXVK start: shader module cache
+    // Start reading the cache right away so it is ready by the first draw
+    m_shaderModuleCache = new D3D9ShaderModuleCache(m_d3d9Options.shaderModuleCache);
+    // NV-DXVK end
+
     m_initializer      = new D3D9Initializer(m_dxvkDevice);
     m_converter        = new D3D9FormatHelper(m_dxvkDevice);
 
@@ -2828,6 +2833,7 @@ namespace dxvk {
     }
 
     dst->SetWrittenByGPU(true);
+    dst->MarkWritten();
 
     return D3D_OK;
   }
@@ -4853,6 +4859,9 @@ namespace dxvk {
     if ((desc.Pool == D3DPOOL_DEFAULT || !(Flags & D3DLOCK_NO_DIRTY_UPDATE)) && !(Flags & D3DLOCK_READONLY))
       pResource->DirtyRange().Conjoin(lockRange);
 
+    if (!(Flags & D3DLOCK_READONLY))
+      pResource->MarkWritten();
+
     Rc<DxvkBuffer> mappingBuffer = pResource->GetBuffer<D3D9_COMMON_BUFFER_TYPE_MAPPING>();
 
     DxvkBufferSliceHandle physSlice;
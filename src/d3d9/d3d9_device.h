@@ -23,6 +23,9 @@
 #include "d3d9_sampler.h"
 #include "d3d9_fixed_function.h"
 #include "d3d9_swvp_emu.h"
+// NV-DXVK start: shader module cache
+#include "d3d9_shader_module_cache.h"
+// NV-DXVK end
 
 #include "d3d9_shader_permutations.h"
 
@@ -885,6 +888,12 @@ namespace dxvk {
       return &m_d3d9Options;
     }
 
+    // NV-DXVK start: shader module cache
+    D3D9ShaderModuleCache* GetShaderModuleCache() const {
+      return m_shaderModuleCache.ptr();
+    }
+    // NV-DXVK end
+
     Direct3DState9* GetRawState() {
       return &m_state;
     }
@@ -1150,6 +1159,10 @@ namespace dxvk {
     D3D9Initializer*                m_initializer = nullptr;
     D3D9FormatHelper*               m_converter   = nullptr;
 
+    // NV-DXVK start: shader module cache
+    Rc<D3D9ShaderModuleCache>       m_shaderModuleCache;
+    // NV-DXVK end
+
     D3D9FFShaderModuleSet           m_ffModules;
     D3D9SWVPEmulator                m_swvpEmulator;
 
@@ -2542,6 +2542,30 @@ namespace dxvk {
   }
 
 
+  // NV-DXVK start: shader module cache
+  DxvkShaderKey D3D9FFShader::GetCacheKey(
+    const DxvkShaderKey&            ShaderKey,
+    const D3D9FixedFunctionOptions& Options) {
+    // Everything besides the key that the generated code depends on
+    const uint32_t inputs[] = {
+      uint32_t(Options.invariantPosition),
+      uint32_t(TerrainBaker::Material::replacementSupportInPS_fixedFunction()),
+    };
+
+    const Sha1Hash& keyHash = ShaderKey.sha1();
+
+    const Sha1Data chunks[] = {
+      { &keyHash, sizeof(keyHash) },
+      { inputs,   sizeof(inputs)  },
+    };
+
+    return DxvkShaderKey(
+      VkShaderStageFlagBits(ShaderKey.type()),
+      Sha1Hash::compute(std::size(chunks), chunks));
+  }
+  // NV-DXVK end
+
+
   D3D9FFShader::D3D9FFShader(
           D3D9DeviceEx*         pDevice,
     const D3D9FFShaderKeyVS&    Key) {
@@ -2550,13 +2574,24 @@ namespace dxvk {
 
     std::string name = str::format("FF_", shaderKey.toString());
 
-    D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name,
-      pDevice->GetOptions());
+    // NV-DXVK start: shader module cache
+    const D3D9FixedFunctionOptions options(pDevice->GetOptions());
+    const DxvkShaderKey cacheKey = GetCacheKey(shaderKey, options);
 
-    m_shader = compiler.compile();
-    m_isgn   = compiler.isgn();
+    m_shader = pDevice->GetShaderModuleCache()->Lookup(cacheKey);
+
+    if (m_shader == nullptr) {
+      D3D9FFShaderCompiler compiler(
+        pDevice->GetDXVKDevice(),
+        Key, name,
+        options);
+
+      m_shader = compiler.compile();
+      m_isgn   = compiler.isgn();
+
+      pDevice->GetShaderModuleCache()->Store(cacheKey, m_shader);
+    }
+    // NV-DXVK end
 
     Dump(Key, name);
 
@@ -2573,13 +2608,24 @@ namespace dxvk {
 
     std::string name = str::format("FF_", shaderKey.toString());
 
-    D3D9FFShaderCompiler compiler(
-      pDevice->GetDXVKDevice(),
-      Key, name,
-      pDevice->GetOptions());
+    // NV-DXVK start: shader module cache
+    const D3D9FixedFunctionOptions options(pDevice->GetOptions());
+    const DxvkShaderKey cacheKey = GetCacheKey(shaderKey, options);
 
-    m_shader = compiler.compile();
-    m_isgn   = compiler.isgn();
+    m_shader = pDevice->GetShaderModuleCache()->Lookup(cacheKey);
+
+    if (m_shader == nullptr) {
+      D3D9FFShaderCompiler compiler(
+        pDevice->GetDXVKDevice(),
+        Key, name,
+        options);
+
+      m_shader = compiler.compile();
+      m_isgn   = compiler.isgn();
+
+      pDevice->GetShaderModuleCache()->Store(cacheKey, m_shader);
+    }
+    // NV-DXVK end
 
     Dump(Key, name);
 
@@ -215,6 +215,12 @@ namespace dxvk {
 
   private:
 
+    // NV-DXVK start: shader module cache
+    static DxvkShaderKey GetCacheKey(
+      const DxvkShaderKey&            ShaderKey,
+      const D3D9FixedFunctionOptions& Options);
+    // NV-DXVK end
+
     Rc<DxvkShader> m_shader;
 
     DxsoIsgn       m_isgn;
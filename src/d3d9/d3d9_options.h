@@ -186,6 +186,11 @@ namespace dxvk {
     /// Use device local memory for constant buffers.
     bool deviceLocalConstantBuffers;
 
+    // NV-DXVK start: shader module cache
+    /// Cache generated fixed function and SWVP shaders on disk
+    bool shaderModuleCache;
+    // NV-DXVK end
+
     // NV-DXVK start: adapter override conf
     /// Override the adapter/GPU used for D3D9 (-1 = use application defined)
     int adapterOverride;
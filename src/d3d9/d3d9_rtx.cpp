@@ -26,7 +26,8 @@ namespace dxvk {
   D3D9Rtx::D3D9Rtx(D3D9DeviceEx* d3d9Device)
     : m_rtStagingData(d3d9Device->GetDXVKDevice(), (VkMemoryPropertyFlagBits) (VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
     , m_parent(d3d9Device)
-    , m_gpeWorkers(popcnt_uint8(D3D9Rtx::kAllThreads), "geometry-processing") {
+    , m_gpeWorkers(popcnt_uint8(D3D9Rtx::kAllThreads), "geometry-processing")
+    , m_largeHashWorkers(WorkerThreadPool<kMaxConcurrentDraws>::getDefaultThreadCount(popcnt_uint8(D3D9Rtx::kAllThreads) + 1, kMaxWorkerThreads) - popcnt_uint8(D3D9Rtx::kAllThreads), "geometry-hashing") {
 
     // Add space for 256 objects skinned with 256 bones each.
     m_stagedBones.resize(256 * 256);
@@ -202,9 +203,13 @@ namespace dxvk {
     });
   }
 
-  void D3D9Rtx::processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData) {
+  void D3D9Rtx::processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData, XXH64_hash_t& sourceKeyOut) {
     DxvkBufferSlice streamCopies[caps::MaxStreams] {};
 
+    // Identifies where the vertex data came from, only valid when all streams come from D3D9 buffers that aren't mapped
+    XXH64_hash_t sourceKey = kEmptyHash;
+    bool sourceTrackable = true;
+
     // Process vertex buffers from CPU
     for (const auto& element : d3d9State().vertexDecl->GetElements()) {
       // Get vertex context
@@ -289,8 +294,26 @@ namespace dxvk {
 
         *targetBuffer = RasterBuffer(streamCopies[element.Stream], element.Offset, ctx.stride, DecodeDecltype(D3DDECLTYPE(element.Type)));
         assert(targetBuffer->offset() % 4 == 0);
+
+        if (ctx.pVBO != nullptr && ctx.pVBO->GetLockCount() == 0) {
+          const struct {
+            const D3D9CommonBuffer* pVBO;
+            uint64_t writeSequence;
+            int32_t vertexOffset;
+            uint32_t numVertexBytes;
+            uint32_t stride;
+            uint32_t elementOffset;
+            uint32_t elementType;
+            uint32_t elementUsage;
+          } streamKey = { ctx.pVBO, ctx.pVBO->GetWriteSequence(), vertexOffset, numVertexBytes, ctx.stride, element.Offset, element.Type, element.Usage };
+          sourceKey = XXH3_64bits_withSeed(&streamKey, sizeof(streamKey), sourceKey);
+        } else {
+          sourceTrackable = false;
+        }
       }
     }
+
+    sourceKeyOut = sourceTrackable ? sourceKey : kEmptyHash;
   }
 
   bool D3D9Rtx::processRenderState() {
@@ -586,8 +609,27 @@ namespace dxvk {
     }
 
     // Copy all the vertices into a staging buffer.  Assign fields of the geoData structure.
-    processVertices(vertexContext, vertexIndexOffset, geoData);
-    geoData.futureGeometryHashes = computeHash(geoData, (maxIndex - minIndex));
+    XXH64_hash_t geometrySourceKey = kEmptyHash;
+    processVertices(vertexContext, vertexIndexOffset, geoData, geometrySourceKey);
+
+    // Index data is part of the source identity too
+    if (geometrySourceKey != kEmptyHash && indexContext.indexType != VK_INDEX_TYPE_NONE_KHR) {
+      if (indexContext.pIBO != nullptr && indexContext.pIBO->GetLockCount() == 0) {
+        const struct {
+          const D3D9CommonBuffer* pIBO;
+          uint64_t writeSequence;
+          uint32_t startIndex;
+          uint32_t indexCount;
+          uint32_t indexType;
+          uint32_t padding;
+        } indexKey = { indexContext.pIBO, indexContext.pIBO->GetWriteSequence(), drawContext.StartIndex, geoData.indexCount, (uint32_t) indexContext.indexType, 0 };
+        geometrySourceKey = XXH3_64bits_withSeed(&indexKey, sizeof(indexKey), geometrySourceKey);
+      } else {
+        geometrySourceKey = kEmptyHash;
+      }
+    }
+
+    geoData.futureGeometryHashes = computeHash(geoData, (maxIndex - minIndex), geometrySourceKey);
     geoData.futureBoundingBox = computeAxisAlignedBoundingBox(geoData);
     
     // Process skinning data
@@ -948,6 +990,7 @@ namespace dxvk {
 
       indices.indexBuffer = ibo->GetMappedSlice();
       indices.indexType = DecodeIndexType(ibo->Desc()->Format);
+      indices.pIBO = ibo;
     }
 
     // Copy over the vertex buffers that are actually required
@@ -1033,6 +1076,21 @@ namespace dxvk {
     m_drawCallID = 0;
 
     m_stagedBonesCount = 0;
+
+    // Publish worker scratch memory usage, and have the workers recycle their arenas for the next frame
+    const auto arenaStats = m_gpeWorkers.getWorkerArenaStats();
+    const auto largeHashArenaStats = m_largeHashWorkers.getWorkerArenaStats();
+    m_parent->GetDXVKDevice()->statCounters().setCtr(DxvkStatCounter::RtxWorkerArenaAllocations, arenaStats.allocationCount + largeHashArenaStats.allocationCount);
+    m_parent->GetDXVKDevice()->statCounters().setCtr(DxvkStatCounter::RtxWorkerArenaHeapAllocations, arenaStats.heapAllocationCount + largeHashArenaStats.heapAllocationCount);
+    m_gpeWorkers.resetWorkerArenas();
+    m_largeHashWorkers.resetWorkerArenas();
+
+    m_parent->GetDXVKDevice()->statCounters().setCtr(DxvkStatCounter::RtxGeometryHashCacheHits, m_geometryHashCacheHits);
+    m_parent->GetDXVKDevice()->statCounters().setCtr(DxvkStatCounter::RtxGeometryHashCacheMisses, m_geometryHashCacheMisses);
+    m_geometryHashCacheHits = 0;
+    m_geometryHashCacheMisses = 0;
+
+    garbageCollectGeometryHashCache();
   }
 
   void D3D9Rtx::OnPresent(const Rc<DxvkImage>& targetImage) {
@@ -25,6 +25,7 @@ namespace dxvk {
     RTX_OPTION("rtx", bool, orthographicIsUI, true, "When enabled, draw calls that are orthographic will be considered as UI.");
     RTX_OPTION("rtx", bool, useVertexCapture, true, "When enabled, injects code into the original vertex shader to capture final shaded vertex positions.  Is useful for games using simple vertex shaders, that still also set the fixed function transform matrices.");
     RTX_OPTION("rtx", bool, useVertexCapturedNormals, true, "When enabled, vertex normals are read from the input assembler and used in raytracing.  This doesn't always work as normals can be in any coordinate space, but can help sometimes.");
+    RTX_OPTION("rtx", bool, enableGeometryHashCache, true, "When enabled, geometry hashes are reused for draw calls whose source D3D9 vertex and index buffers have not been written to since they were last hashed, skipping the CPU hashing of static meshes.");
     RTX_OPTION("rtx", bool, useWorldMatricesForShaders, true, "When enabled, Remix will utilize the world matrices being passed from the game via D3D9 fixed function API, even when running with shaders.  Sometimes games pass these matrices and they are useful, however for some games they are very unreliable, and should be filtered out.  If you're seeing precision related issues with shader vertex capture, try disabling this setting.");
 
     // Copy of the parameters issued to D3D9 on DrawXXX
@@ -174,8 +175,27 @@ namespace dxvk {
       kAllThreads = (kHashingThreads | kSkinningThread)
     };
 
+    // Machines with spare hardware threads get up to this many workers in total, the ones past
+    //  the low latency pool wait on a condition variable and only take large hashing jobs.
+    static constexpr uint32_t kMaxWorkerThreads = 8;
+    // Hashing jobs reading at least this much source data go to the waiting pool, where the wakeup is cheap in comparison
+    static constexpr size_t kMinLargeHashJobSize = 256 * 1024;
+
+    // Geometry hashes of previous draws, keyed on the identity and write sequence of their D3D9 source buffers.
+    //  Written from the hashing workers, read from the D3D9 thread.  Declared before the workers so it outlives them.
+    struct CachedGeometryHashes {
+      GeometryHashes hashes;
+      uint32_t lastUsedFrame;
+    };
+    fast_unordered_cache<CachedGeometryHashes> m_geometryHashCache;
+    sync::Spinlock m_geometryHashCacheMutex;
+    std::atomic<uint32_t> m_geometryHashCacheFrame = 0;
+    uint32_t m_geometryHashCacheHits = 0;
+    uint32_t m_geometryHashCacheMisses = 0;
+
     inline static const uint32_t kMaxConcurrentDraws = 4 * 1024;
     WorkerThreadPool<kMaxConcurrentDraws> m_gpeWorkers;
+    WorkerThreadPool<kMaxConcurrentDraws, true, false> m_largeHashWorkers;
     AtomicQueue<DrawCallState, kMaxConcurrentDraws> m_drawCallStateQueue;
 
     DrawCallState m_activeDrawCallState;
@@ -210,6 +230,7 @@ namespace dxvk {
     struct IndexContext {
       VkIndexType indexType = VK_INDEX_TYPE_NONE_KHR;
       DxvkBufferSliceHandle indexBuffer;
+      D3D9CommonBuffer* pIBO = nullptr;
     };
 
     struct VertexContext {
@@ -236,7 +257,7 @@ namespace dxvk {
     DxvkBufferSlice allocVertexCaptureBuffer(const VkDeviceSize size);
     void prepareVertexCapture(const int vertexIndexOffset);
 
-    void processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData);
+    void processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData, XXH64_hash_t& sourceKeyOut);
 
     bool processRenderState();
 
@@ -259,6 +280,8 @@ namespace dxvk {
 
     Future<AxisAlignedBoundingBox> computeAxisAlignedBoundingBox(const RasterGeometry& geoData);
 
-    Future<GeometryHashes> computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue);
+    Future<GeometryHashes> computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue, const XXH64_hash_t sourceKey);
+
+    void garbageCollectGeometryHashCache();
   };
 }
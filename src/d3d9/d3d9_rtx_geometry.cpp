@@ -1,16 +1,23 @@
-#include <vector>
 #include "d3d9_device.h"
 #include "d3d9_rtx.h"
 #include "d3d9_rtx_utils.h"
 #include "d3d9_state.h"
 #include "../dxvk/dxvk_buffer.h"
 #include "../dxvk/rtx_render/rtx_hashing.h"
+#include "../dxvk/rtx_render/rtx_hash_collision_detection.h"
 #include "../util/util_fastops.h"
+#include "../util/util_linear_allocator.h"
+#include "../util/log/metrics.h"
+
+#include <optional>
 
 namespace dxvk {
   // Geometry indices should never be signed.  Using this to handle the non-indexed case for templates.
   typedef int NoIndices;
 
+  static MetricCounter s_drawCallsHashedMetric("geometry.draw_calls_hashed");
+  static MetricCounter s_hashCacheHitsMetric("geometry.hash_cache_hits");
+
   enum VertexRegions : uint32_t {
     Position = 0,
     Texcoord,
@@ -39,32 +46,14 @@ namespace dxvk {
     return true;
   }
 
-  // Sorts and deduplicates a set of integers, storing the result in a vector
+  // Sorts and deduplicates a set of integers, storing the result in memory taken from the allocator
   template<typename T>
-  void deduplicateSortIndices(const void* pIndexData, const size_t indexCount, const uint32_t maxIndexValue, std::vector<T>& uniqueIndicesOut) {
-    // TODO (REMIX-657): Implement optimized variant of this function
-    // We know there will be at most, this many unique indices
-    const uint32_t indexRange = maxIndexValue + 1;
-
-    // Initialize all to 0
-    uniqueIndicesOut.resize(indexRange, (T)0);
-
-    // Use memory as a bin table for index data
-    for (uint32_t i = 0; i < indexCount; i++) {
-      const T& index = ((T*) pIndexData)[i];
-      assert(index <= maxIndexValue);
-      uniqueIndicesOut[index] = 1;
-    }
-
-    // Repopulate the bins with contiguous index values
-    uint32_t uniqueIndexCount = 0;
-    for (uint32_t i = 0; i < indexRange; i++) {
-      if (uniqueIndicesOut[i])
-        uniqueIndicesOut[uniqueIndexCount++] = i;
-    }
+  uint32_t deduplicateSortIndices(const void* pIndexData, const size_t indexCount, const uint32_t maxIndexValue, LinearAllocator& allocator, const T*& pUniqueIndicesOut) {
+    // We know there will be at most, this many unique indices (plus some room for the vectorized tail writes)
+    T* pUniqueIndices = allocator.alloc<T>(maxIndexValue + 1 + fast::kDeduplicatePadding);
+    pUniqueIndicesOut = pUniqueIndices;
 
-    // Remove any unused entries
-    uniqueIndicesOut.resize(uniqueIndexCount);
+    return fast::deduplicateSortIndices<T>((uint32_t) indexCount, (const T*) pIndexData, maxIndexValue, pUniqueIndices);
   }
 
   template<typename T>
@@ -74,14 +63,24 @@ namespace dxvk {
 
     const HashRule& globalHashRule = RtxOptions::Get()->GeometryHashGenerationRule;
 
-    // TODO (REMIX-658): Improve this by reducing allocation overhead of vector
-    std::vector<T> uniqueIndices(0);
+    // Scratch memory comes from the worker's arena, and is handed back once hashing completes.
+    // Threads without an arena (e.g. when hashing inline) get a temporary one.
+    std::optional<LinearAllocator> fallbackArena;
+    LinearAllocator* pArena = threadLinearAllocator();
+    if (pArena == nullptr) {
+      pArena = &fallbackArena.emplace();
+    }
+    LinearAllocator::Scope arenaScope(*pArena);
+
+    const T* pUniqueIndices = nullptr;
+    uint32_t uniqueIndexCount = 0;
     if constexpr (!std::is_same<T, NoIndices>::value) {
       assert((indexCount > 0 && indexBufferRef));
-      deduplicateSortIndices(pIndexData, indexCount, maxIndexValue, uniqueIndices);
+      uniqueIndexCount = deduplicateSortIndices(pIndexData, indexCount, maxIndexValue, *pArena, pUniqueIndices);
 
       if (globalHashRule.test(HashComponents::Indices)) {
         hashesOut[HashComponents::Indices] = hashContiguousMemory(pIndexData, indexCount * sizeof(T));
+        HashCollisionDetection::registerHashedSourceData(hashesOut[HashComponents::Indices], pIndexData, indexCount * sizeof(T), HashSourceDataCategory::GeometryIndices);
       }
 
       // TODO (REMIX-656): Remove this once we can transition content to new hash
@@ -100,10 +99,25 @@ namespace dxvk {
 
       if (globalHashRule.test(component) && componentToRegionMap.count(component) > 0) {
         const VertexRegions region = componentToRegionMap.at(component);
-        hashesOut[component] = hashVertexRegionIndexed(vertexRegions[(uint32_t)region], uniqueIndices);
+        hashesOut[component] = hashVertexRegionIndexed(vertexRegions[(uint32_t)region], pUniqueIndices, uniqueIndexCount);
       }
     }
 
+    if (globalHashRule.test(HashComponents::VertexPosition)) {
+      // Mirrors the bytes hashVertexRegionIndexed consumes: the position of each unique index, or of every vertex without indices
+      const HashQuery& positions = vertexRegions[Position];
+      const bool indexed = !std::is_same<T, NoIndices>::value && uniqueIndexCount > 0;
+      const size_t elementCount = indexed ? uniqueIndexCount : (positions.size + positions.stride - 1) / positions.stride;
+
+      HashCollisionDetection::registerHashedSourceData(hashesOut[HashComponents::VertexPosition], elementCount * positions.elementSize, HashSourceDataCategory::GeometryPositions,
+        [&](HashCollisionDetection::SourceDataWriter& writer) {
+          for (size_t i = 0; i < elementCount; i++) {
+            const size_t offset = indexed ? pUniqueIndices[i] * positions.stride : i * positions.stride;
+            writer.write(positions.pBase + offset, positions.elementSize);
+          }
+        });
+    }
+
     // TODO (REMIX-656): Remove this once we can transition content to new hash
     if (globalHashRule.test(HashComponents::LegacyPositions0) || globalHashRule.test(HashComponents::LegacyPositions1)) {
       hashRegionLegacy(vertexRegions[Position], hashesOut[HashComponents::LegacyPositions0], hashesOut[HashComponents::LegacyPositions1]);
@@ -122,37 +136,15 @@ namespace dxvk {
     }
   }
 
-  Future<GeometryHashes> D3D9Rtx::computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue) {
+  Future<GeometryHashes> D3D9Rtx::computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue, const XXH64_hash_t sourceKey) {
     ScopedCpuProfileZone();
 
     const uint32_t indexCount = geoData.indexCount;
     const uint32_t vertexCount = geoData.vertexCount;
 
-    HashQuery vertexRegions[Count];
-    memset(&vertexRegions[0], 0, sizeof(vertexRegions));
-
-    if (!getVertexRegion(geoData.positionBuffer, vertexCount, vertexRegions[Position]))
+    if (!geoData.positionBuffer.defined())
       return Future<GeometryHashes>(); //invalid
 
-    // Acquire prevents the staging allocator from re-using this memory
-    vertexRegions[Position].ref->acquire(DxvkAccess::Read);
-    vertexRegions[Position].ref->incRef();
-
-    if (getVertexRegion(geoData.texcoordBuffer, vertexCount, vertexRegions[Texcoord])) {
-      vertexRegions[Texcoord].ref->acquire(DxvkAccess::Read);
-      vertexRegions[Texcoord].ref->incRef();
-    }
-
-    // Make sure we hold a ref to the index buffer while hashing.
-    const Rc<DxvkBuffer> indexBufferRef = geoData.indexBuffer.buffer();
-    if (indexBufferRef.ptr()) {
-      indexBufferRef->acquire(DxvkAccess::Read);
-      indexBufferRef->incRef();
-    }
-    const void* pIndexData = geoData.indexBuffer.defined() ? geoData.indexBuffer.mapPtr(0) : nullptr;
-    const size_t indexStride = geoData.indexBuffer.stride();
-    const size_t indexDataSize = indexCount * indexStride;
-
     // Assume the GPU changed the data via shaders, include the constant buffer data in hash
     XXH64_hash_t vertexShaderHash = kEmptyHash;
     if (m_parent->UseProgrammableVS() && useVertexCapture()) {
@@ -181,10 +173,78 @@ namespace dxvk {
       vertexLayoutHash = hashVertexLayout(geoData);
     }
 
-    return m_gpeWorkers.Schedule([vertexRegions, indexBufferRef = indexBufferRef.ptr(),
-                                 pIndexData, indexStride, indexDataSize, indexCount,
-                                 maxIndexValue, vertexShaderHash, geometryDescriptorHash,
-                                 vertexLayoutHash]() -> GeometryHashes {
+    // If the source buffers haven't been written to since we last hashed this draw, reuse those hashes
+    XXH64_hash_t cacheKey = kEmptyHash;
+    if (enableGeometryHashCache() && sourceKey != kEmptyHash) {
+      const struct {
+        uint32_t maxIndexValue;
+        uint32_t indexCount;
+        uint32_t vertexCount;
+        uint32_t topology;
+        uint32_t hashRule;
+      } drawKey = { maxIndexValue, indexCount, vertexCount, (uint32_t) geoData.topology, (uint32_t) RtxOptions::Get()->GeometryHashGenerationRule.raw() };
+      cacheKey = XXH3_64bits_withSeed(&drawKey, sizeof(drawKey), sourceKey);
+
+      GeometryHashes cachedHashes;
+      bool found = false;
+      {
+        std::lock_guard<sync::Spinlock> lock(m_geometryHashCacheMutex);
+        auto it = m_geometryHashCache.find(cacheKey);
+        if (it != m_geometryHashCache.end()) {
+          it->second.lastUsedFrame = m_geometryHashCacheFrame;
+          cachedHashes = it->second.hashes;
+          found = true;
+        }
+      }
+
+      if (found) {
+        ++m_geometryHashCacheHits;
+        s_hashCacheHitsMetric.add();
+
+        return m_gpeWorkers.Schedule([cachedHashes, vertexShaderHash, geometryDescriptorHash, vertexLayoutHash]() -> GeometryHashes {
+          GeometryHashes hashes = cachedHashes;
+          hashes[HashComponents::GeometryDescriptor] = geometryDescriptorHash;
+          hashes[HashComponents::VertexLayout] = vertexLayoutHash;
+          hashes[HashComponents::VertexShader] = vertexShaderHash;
+          hashes.precombine();
+          return hashes;
+        });
+      }
+
+      ++m_geometryHashCacheMisses;
+    }
+
+    HashQuery vertexRegions[Count];
+    memset(&vertexRegions[0], 0, sizeof(vertexRegions));
+
+    if (!getVertexRegion(geoData.positionBuffer, vertexCount, vertexRegions[Position]))
+      return Future<GeometryHashes>(); //invalid
+
+    // Acquire prevents the staging allocator from re-using this memory
+    vertexRegions[Position].ref->acquire(DxvkAccess::Read);
+    vertexRegions[Position].ref->incRef();
+
+    if (getVertexRegion(geoData.texcoordBuffer, vertexCount, vertexRegions[Texcoord])) {
+      vertexRegions[Texcoord].ref->acquire(DxvkAccess::Read);
+      vertexRegions[Texcoord].ref->incRef();
+    }
+
+    // Make sure we hold a ref to the index buffer while hashing.
+    const Rc<DxvkBuffer> indexBufferRef = geoData.indexBuffer.buffer();
+    if (indexBufferRef.ptr()) {
+      indexBufferRef->acquire(DxvkAccess::Read);
+      indexBufferRef->incRef();
+    }
+    const void* pIndexData = geoData.indexBuffer.defined() ? geoData.indexBuffer.mapPtr(0) : nullptr;
+    const size_t indexStride = geoData.indexBuffer.stride();
+    const size_t indexDataSize = indexCount * indexStride;
+
+    s_drawCallsHashedMetric.add();
+
+    auto hashJob = [this, vertexRegions, indexBufferRef = indexBufferRef.ptr(),
+                    pIndexData, indexStride, indexDataSize, indexCount,
+                    maxIndexValue, vertexShaderHash, geometryDescriptorHash,
+                    vertexLayoutHash]() -> GeometryHashes {
       ScopedCpuProfileZone();
 
       GeometryHashes hashes;
@@ -212,6 +272,50 @@ namespace dxvk {
       hashes.precombine();
 
       return hashes;
+    };
+
+    // Large meshes go to the waiting pool, keeping the low latency workers free for the many small draws
+    const size_t hashJobSize = indexDataSize + vertexRegions[Position].size + vertexRegions[Texcoord].size;
+    Future<GeometryHashes> future;
+    if (hashJobSize >= kMinLargeHashJobSize) {
+      future = m_largeHashWorkers.Schedule(std::move(hashJob));
+    } else {
+      future = m_gpeWorkers.Schedule(std::move(hashJob));
+    }
+
+    if (cacheKey == kEmptyHash) {
+      return future;
+    }
+
+    // Publish to the cache on the hashing worker, before the result is handed back
+    return future.then([this, cacheKey](GeometryHashes&& hashes) -> GeometryHashes {
+      std::lock_guard<sync::Spinlock> lock(m_geometryHashCacheMutex);
+      m_geometryHashCache[cacheKey] = { hashes, m_geometryHashCacheFrame };
+      return hashes;
+    });
+  }
+
+  void D3D9Rtx::garbageCollectGeometryHashCache() {
+    ScopedCpuProfileZone();
+
+    // Entries for geometry that hasn't been drawn in a while are most likely stale (buffer released or rewritten)
+    constexpr uint32_t kMaxUnusedFrames = 60;
+    constexpr uint32_t kCollectionPeriod = 64;
+
+    const uint32_t currentFrame = ++m_geometryHashCacheFrame;
+
+    if (currentFrame % kCollectionPeriod != 0)
+      return;
+
+    std::lock_guard<sync::Spinlock> lock(m_geometryHashCacheMutex);
+
+    if (!enableGeometryHashCache()) {
+      m_geometryHashCache.clear();
+      return;
+    }
+
+    m_geometryHashCache.erase_if([currentFrame](const auto& it) {
+      return currentFrame - it->second.lastUsedFrame > kMaxUnusedFrames;
     });
   }
 
@@ -0,0 +1,269 @@
+#include "d3d9_shader_module_cache.h"
+
+#include <iterator>
+#include <type_traits>
+
+#include <version.h>
+
+namespace dxvk {
+
+  // Upper bounds for sanity checks, so that a corrupted
+  // entry cannot make us allocate absurd amounts of memory
+  constexpr uint32_t MaxCachedSlotCount = 1024;
+  constexpr uint32_t MaxCachedCodeSize  = 1u << 22;
+
+  static_assert(std::is_trivially_copyable_v<DxvkShaderKey>);
+  static_assert(std::is_trivially_copyable_v<DxvkResourceSlot>);
+  static_assert(std::is_trivially_copyable_v<D3D9ShaderModuleCacheHeader>);
+  static_assert(std::is_trivially_copyable_v<D3D9ShaderModuleCacheEntryHeader>);
+
+
+  Sha1Hash D3D9ShaderModuleCacheHeader::GetBuildHash() {
+    // Fold in the layout of everything that is stored as raw bytes
+    const uint32_t sizes[] = {
+      uint32_t(sizeof(D3D9ShaderModuleCacheEntryHeader)),
+      uint32_t(sizeof(DxvkResourceSlot)),
+    };
+
+    const std::string version = DXVK_VERSION;
+
+    const Sha1Data chunks[] = {
+      { version.data(), version.size() },
+      { sizes,          sizeof(sizes)  },
+    };
+
+    return Sha1Hash::compute(std::size(chunks), chunks);
+  }
+
+
+  D3D9ShaderModuleCache::D3D9ShaderModuleCache(bool enable) {
+    if (!enable) {
+      m_loaded.store(true, std::memory_order_release);
+      return;
+    }
+
+    m_thread = dxvk::thread([this] () { RunThread(); });
+  }
+
+
+  D3D9ShaderModuleCache::~D3D9ShaderModuleCache() {
+    { std::lock_guard<dxvk::mutex> lock(m_mutex);
+      m_stopThread = true;
+      m_writerCond.notify_one();
+    }
+
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+
+  Rc<DxvkShader> D3D9ShaderModuleCache::Lookup(const DxvkShaderKey& key) {
+    if (unlikely(!m_loaded.load(std::memory_order_acquire))) {
+      std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+      m_loadCond.wait(lock, [this] () {
+        return m_loaded.load(std::memory_order_acquire);
+      });
+    }
+
+    auto entry = m_entries.find(key);
+
+    if (entry == m_entries.end())
+      return nullptr;
+
+    return entry->second;
+  }
+
+
+  void D3D9ShaderModuleCache::Store(const DxvkShaderKey& key, const Rc<DxvkShader>& shader) {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    if (!m_thread.joinable())
+      return;
+
+    m_writerQueue.push({ key, shader });
+    m_writerCond.notify_one();
+  }
+
+
+  void D3D9ShaderModuleCache::RunThread() {
+    env::setThreadName("d3d9-shader-cache");
+
+    const bool valid = ReadCacheFile();
+
+    if (!valid)
+      Logger::info("D3D9: Creating new shader module cache file");
+
+    // Rewrite the file from the entries we could read if it was
+    // missing, outdated or corrupted, otherwise keep appending.
+    std::ofstream file = OpenCacheFile(valid);
+
+    if (file && !valid) {
+      D3D9ShaderModuleCacheHeader header;
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      for (const auto& entry : m_entries)
+        WriteCacheEntry(file, entry.first, entry.second);
+
+      file.flush();
+    }
+
+    { std::lock_guard<dxvk::mutex> lock(m_mutex);
+      m_loaded.store(true, std::memory_order_release);
+      m_loadCond.notify_all();
+    }
+
+    while (true) {
+      WriterItem item;
+
+      { std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+        m_writerCond.wait(lock, [this] () {
+          return !m_writerQueue.empty() || m_stopThread;
+        });
+
+        if (m_writerQueue.empty())
+          break;
+
+        item = std::move(m_writerQueue.front());
+        m_writerQueue.pop();
+      }
+
+      if (file) {
+        WriteCacheEntry(file, item.key, item.shader);
+        file.flush();
+      }
+    }
+  }
+
+
+  bool D3D9ShaderModuleCache::ReadCacheFile() {
+    std::ifstream ifile(GetCacheFileName().c_str(), std::ios_base::binary);
+
+    if (!ifile)
+      return false;
+
+    D3D9ShaderModuleCacheHeader expected;
+    D3D9ShaderModuleCacheHeader header;
+
+    if (!ifile.read(reinterpret_cast<char*>(&header), sizeof(header))
+     || std::memcmp(header.magic, expected.magic, sizeof(header.magic))
+     || header.version != expected.version
+     || header.build != expected.build) {
+      Logger::warn("D3D9: Shader module cache was written by a different build, discarding");
+      return false;
+    }
+
+    while (ifile.peek() != std::char_traits<char>::eof()) {
+      DxvkShaderKey  key;
+      Rc<DxvkShader> shader;
+
+      if (!ReadCacheEntry(ifile, key, shader)) {
+        Logger::warn(str::format("D3D9: Shader module cache is corrupted, keeping ", m_entries.size(), " entries"));
+        return false;
+      }
+
+      m_entries.insert({ key, std::move(shader) });
+    }
+
+    Logger::info(str::format("D3D9: Read ", m_entries.size(), " shaders from shader module cache"));
+    return true;
+  }
+
+
+  bool D3D9ShaderModuleCache::ReadCacheEntry(
+          std::istream&             stream,
+          DxvkShaderKey&            key,
+          Rc<DxvkShader>&           shader) const {
+    D3D9ShaderModuleCacheEntryHeader header;
+
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header))
+     || header.slotCount > MaxCachedSlotCount
+     || header.codeSize  > MaxCachedCodeSize)
+      return false;
+
+    std::vector<DxvkResourceSlot> slots(header.slotCount);
+    std::vector<uint32_t>         code(header.codeSize);
+
+    if (!stream.read(reinterpret_cast<char*>(slots.data()), slots.size() * sizeof(slots[0]))
+     || !stream.read(reinterpret_cast<char*>(code.data()),  code.size()  * sizeof(code[0])))
+      return false;
+
+    const Sha1Data chunks[] = {
+      { slots.data(), slots.size() * sizeof(slots[0]) },
+      { code.data(),  code.size()  * sizeof(code[0])  },
+    };
+
+    if (Sha1Hash::compute(std::size(chunks), chunks) != header.hash)
+      return false;
+
+    key    = header.key;
+    shader = new DxvkShader(
+      VkShaderStageFlagBits(key.type()),
+      slots.size(), slots.data(),
+      header.iface,
+      SpirvCodeBuffer(code.size(), code.data()),
+      DxvkShaderOptions(),
+      DxvkShaderConstData());
+    return true;
+  }
+
+
+  void D3D9ShaderModuleCache::WriteCacheEntry(
+          std::ostream&             stream,
+    const DxvkShaderKey&            key,
+    const Rc<DxvkShader>&           shader) const {
+    const std::vector<DxvkResourceSlot>& slots = shader->resourceSlots();
+    const SpirvCodeBuffer code = shader->getRawCode();
+
+    D3D9ShaderModuleCacheEntryHeader header;
+    header.key       = key;
+    header.iface     = shader->interfaceSlots();
+    header.slotCount = uint32_t(slots.size());
+    header.codeSize  = code.dwords();
+
+    const Sha1Data chunks[] = {
+      { slots.data(), slots.size() * sizeof(slots[0]) },
+      { code.data(),  code.size() },
+    };
+
+    header.hash = Sha1Hash::compute(std::size(chunks), chunks);
+
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(reinterpret_cast<const char*>(slots.data()), chunks[0].size);
+    stream.write(reinterpret_cast<const char*>(code.data()),  chunks[1].size);
+  }
+
+
+  std::ofstream D3D9ShaderModuleCache::OpenCacheFile(bool append) const {
+    const auto mode = std::ios_base::binary
+      | (append ? std::ios_base::app : std::ios_base::trunc);
+
+    std::ofstream file(GetCacheFileName().c_str(), mode);
+
+    if (!file && env::createDirectory(GetCacheDir()))
+      file = std::ofstream(GetCacheFileName().c_str(), mode);
+
+    if (!file)
+      Logger::warn("D3D9: Failed to open shader module cache file for writing");
+
+    return file;
+  }
+
+
+  std::wstring D3D9ShaderModuleCache::GetCacheFileName() const {
+    std::string path = GetCacheDir();
+
+    if (!path.empty() && *path.rbegin() != '/')
+      path += '/';
+
+    path += env::getExeBaseName() + ".d3d9-shader-cache";
+    return str::tows(path.c_str());
+  }
+
+
+  std::string D3D9ShaderModuleCache::GetCacheDir() const {
+    return env::getEnvVar("DXVK_STATE_CACHE_PATH");
+  }
+
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <queue>
+#include <unordered_map>
+
+#include "d3d9_include.h"
+
+#include "../dxvk/dxvk_shader.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Shader module cache file header
+   *
+   * Caches are tied to the exact build that wrote them
+   * since the generated code may change between builds.
+   */
+  struct D3D9ShaderModuleCacheHeader {
+    char     magic[4]   = { 'D', '9', 'S', 'M' };
+    uint32_t version    = 1;
+    Sha1Hash build      = GetBuildHash();
+
+    static Sha1Hash GetBuildHash();
+  };
+
+
+  /**
+   * \brief Shader module cache entry header
+   *
+   * Followed by \c slotCount resource slots and \c codeSize
+   * dwords of SPIR-V. The hash covers both of those arrays.
+   */
+  struct D3D9ShaderModuleCacheEntryHeader {
+    DxvkShaderKey      key;
+    DxvkInterfaceSlots iface;
+    uint32_t           slotCount;
+    uint32_t           codeSize;
+    Sha1Hash           hash;
+  };
+
+
+  /**
+   * \brief Persistent cache of internally generated shaders
+   *
+   * Stores the SPIR-V of fixed function and SWVP emulation shaders
+   * on disk, so that subsequent runs do not have to generate it again
+   * the first time a given state combination shows up. The cache file
+   * is read on a background thread as soon as the device is created,
+   * and newly generated shaders are appended to it on that same thread.
+   *
+   * Only shaders without shader options or constant data can be
+   * cached. Cache keys must cover every input the generated code
+   * depends on, not just the API state.
+   */
+  class D3D9ShaderModuleCache : public RcObject {
+
+  public:
+
+    D3D9ShaderModuleCache(bool enable);
+
+    ~D3D9ShaderModuleCache();
+
+    /**
+     * \brief Looks up a cached shader
+     *
+     * Waits for the cache file to be loaded
+     * if that has not finished yet.
+     * \param [in] key Cache key
+     * \returns The shader, or \c nullptr on a miss
+     */
+    Rc<DxvkShader> Lookup(const DxvkShaderKey& key);
+
+    /**
+     * \brief Adds a newly generated shader
+     *
+     * The shader gets written to the cache file in
+     * the background. Must only be called after a
+     * lookup for the same key missed.
+     * \param [in] key Cache key
+     * \param [in] shader The shader
+     */
+    void Store(const DxvkShaderKey& key, const Rc<DxvkShader>& shader);
+
+  private:
+
+    struct WriterItem {
+      DxvkShaderKey  key;
+      Rc<DxvkShader> shader;
+    };
+
+    // Written once by the cache thread before m_loaded is set, read-only afterwards
+    std::unordered_map<
+      DxvkShaderKey, Rc<DxvkShader>,
+      DxvkHash, DxvkEq>               m_entries;
+
+    std::atomic<bool>                 m_loaded = { false };
+    bool                              m_stopThread = false;
+
+    dxvk::mutex                       m_mutex;
+    dxvk::condition_variable          m_loadCond;
+    dxvk::condition_variable          m_writerCond;
+    std::queue<WriterItem>            m_writerQueue;
+    dxvk::thread                      m_thread;
+
+    void RunThread();
+
+    bool ReadCacheFile();
+
+    bool ReadCacheEntry(
+            std::istream&             stream,
+            DxvkShaderKey&            key,
+            Rc<DxvkShader>&           shader) const;
+
+    void WriteCacheEntry(
+            std::ostream&             stream,
+      const DxvkShaderKey&            key,
+      const Rc<DxvkShader>&           shader) const;
+
+    std::ofstream OpenCacheFile(bool append) const;
+
+    std::wstring GetCacheFileName() const;
+
+    std::string GetCacheDir() const;
+
+  };
+
+}
@@ -10,24 +10,6 @@ namespace dxvk {
 
   // Doesn't compare everything, only what we use in SWVP.
 
-  size_t D3D9VertexDeclHash::operator () (const D3D9VertexElements& key) const {
-    DxvkHashState hash;
-
-    std::hash<BYTE> bytehash;
-    std::hash<WORD> wordhash;
-
-    for (auto& element : key) {
-      hash.add(wordhash(element.Stream));
-      hash.add(wordhash(element.Offset));
-      hash.add(bytehash(element.Type));
-      hash.add(bytehash(element.Method));
-      hash.add(bytehash(element.Usage));
-      hash.add(bytehash(element.UsageIndex));
-    }
-
-    return hash;
-  }
-
   bool D3D9VertexDeclEq::operator () (const D3D9VertexElements& a, const D3D9VertexElements& b) const {
     if (a.size() != b.size())
       return false;
@@ -312,12 +294,16 @@ namespace dxvk {
     ScopedCpuProfileZone();
     auto& elements = pDecl->GetElements();
 
-    // Use the shader's unique key for the lookup
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      
-      auto entry = m_modules.find(elements);
-      if (entry != m_modules.end())
-        return entry->second;
+    // NV-DXVK start: concurrent SWVP shader lookup
+    // Use the shader's unique key for the lookup. A different declaration
+    // with the same hash is vanishingly rare, such declarations just don't
+    // get their module cached in memory.
+    const XXH64_hash_t elementsHash = XXH3_64bits(
+      elements.data(), elements.size() * sizeof(elements[0]));
+
+    if (const Module* module = m_modules.find(elementsHash)) {
+      if (D3D9VertexDeclEq()(module->elements, elements))
+        return module->shader;
     }
 
     Sha1Hash hash = Sha1Hash::compute(
@@ -325,12 +311,21 @@ namespace dxvk {
 
     DxvkShaderKey key = { VK_SHADER_STAGE_GEOMETRY_BIT , hash };
     std::string name = str::format("SWVP_", key.toString());
-    
-    // This shader has not been compiled yet, so we have to create a
-    // new module. This takes a while, so we won't lock the structure.
-    D3D9SWVPEmulatorGenerator generator(name);
-    generator.compile(pDecl);
-    Rc<DxvkShader> shader = generator.finalize();
+
+    // The generated code only depends on the vertex elements, so
+    // the shader key doubles as the key for the on-disk cache.
+    Rc<DxvkShader> shader = pDevice->GetShaderModuleCache()->Lookup(key);
+
+    if (shader == nullptr) {
+      // This shader has not been compiled yet, so we have to create a
+      // new module. This takes a while, so we won't lock the structure.
+      D3D9SWVPEmulatorGenerator generator(name);
+      generator.compile(pDecl);
+      shader = generator.finalize();
+
+      pDevice->GetShaderModuleCache()->Store(key, shader);
+    }
+    // NV-DXVK end
 
     shader->setShaderKey(key);
     pDevice->GetDXVKDevice()->registerShader(shader);
@@ -348,14 +343,14 @@ namespace dxvk {
     // Insert the new module into the lookup table. If another thread
     // has compiled the same shader in the meantime, we should return
     // that object instead and discard the newly created module.
-    { std::unique_lock<dxvk::mutex> lock(m_mutex);
-      
-      auto status = m_modules.insert({ elements, shader });
-      if (!status.second)
-        return status.first->second;
-    }
+    // NV-DXVK start: concurrent SWVP shader lookup
+    auto status = m_modules.try_emplace(elementsHash, Module { elements, shader });
+
+    if (!status.second && D3D9VertexDeclEq()(status.first->elements, elements))
+      return status.first->shader;
+    // NV-DXVK end
 
     return shader;
   }
 
-}
\ No newline at end of file
+}
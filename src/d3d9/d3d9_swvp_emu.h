@@ -1,20 +1,18 @@
 #pragma once
 
-#include <unordered_map>
-
 #include "d3d9_include.h"
 
 #include "../dxvk/dxvk_shader.h"
 
+// NV-DXVK start: concurrent SWVP shader lookup
+#include "../util/util_concurrent_cache.h"
+// NV-DXVK end
+
 namespace dxvk {
 
   class D3D9VertexDecl;
   class D3D9DeviceEx;
 
-  struct D3D9VertexDeclHash {
-    size_t operator () (const D3D9VertexElements& key) const;
-  };
-
   struct D3D9VertexDeclEq {
     bool operator () (const D3D9VertexElements& a, const D3D9VertexElements& b) const;
   };
@@ -27,11 +25,15 @@ namespace dxvk {
 
   private:
 
-    dxvk::mutex                               m_mutex;
+    // NV-DXVK start: concurrent SWVP shader lookup
+    struct Module {
+      D3D9VertexElements elements;
+      Rc<DxvkShader>     shader;
+    };
 
-    std::unordered_map<
-      D3D9VertexElements, Rc<DxvkShader>,
-      D3D9VertexDeclHash, D3D9VertexDeclEq>   m_modules;
+    // Keyed by a hash of the vertex elements, lookups never lock
+    concurrent_fast_cache<Module>             m_modules;
+    // NV-DXVK end
 
   };
 
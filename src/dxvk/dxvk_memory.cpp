@@ -222,9 +222,11 @@ DxvkMemory::DxvkMemory() { }
           DxvkMemoryAllocator*  alloc,
           DxvkMemoryType*       type,
           DxvkDeviceMemory      memory)
-  : m_alloc(alloc), m_type(type), m_memory(memory) {
+  : m_alloc(alloc), m_type(type), m_memory(memory),
+    // NV-DXVK start: TLSF suballocator
     // Mark the entire chunk as free
-    m_freeList.push_back(FreeSlice { 0, memory.memSize });
+    m_suballocator(memory.memSize) {
+    // NV-DXVK end
   }
   
   
@@ -249,50 +251,20 @@ DxvkMemory::DxvkMemory() { }
      || m_memory.priority != priority)
       return DxvkMemory();
     
-    // If the chunk is full, return
-    if (m_freeList.size() == 0)
-      return DxvkMemory();
-    
-    // Select the slice to allocate from in a worst-fit
-    // manner. This may help keep fragmentation low.
-    auto bestSlice = m_freeList.begin();
-    
-    for (auto slice = m_freeList.begin(); slice != m_freeList.end(); slice++) {
-      if (slice->length == size) {
-        bestSlice = slice;
-        break;
-      } else if (slice->length > bestSlice->length) {
-        bestSlice = slice;
-      }
-    }
-    
-    // We need to align the allocation to the requested alignment
-    const VkDeviceSize sliceStart = bestSlice->offset;
-    const VkDeviceSize sliceEnd   = bestSlice->offset + bestSlice->length;
+    // NV-DXVK start: TLSF suballocator
+    // Slice lengths are padded to the alignment as well
+    const VkDeviceSize allocSize  = dxvk::align(size, align);
+    const VkDeviceSize allocStart = m_suballocator.alloc(allocSize, align);
     
-    const VkDeviceSize allocStart = dxvk::align(sliceStart,        align);
-    const VkDeviceSize allocEnd   = dxvk::align(allocStart + size, align);
-    
-    if (allocEnd > sliceEnd)
+    if (allocStart == TlsfAllocator::kInvalidOffset)
       return DxvkMemory();
-    
-    // We can use this slice, but we'll have to add
-    // the unused parts of it back to the free list.
-    m_freeList.erase(bestSlice);
-    
-    if (allocStart != sliceStart)
-      m_freeList.push_back({ sliceStart, allocStart - sliceStart });
-    
-    if (allocEnd != sliceEnd)
-      m_freeList.push_back({ allocEnd, sliceEnd - allocEnd });
 
-    // NV-DXVK start:
     // Calculate the pointer to the mapped data, if any
     void* mapPtr = (m_memory.memPointer != nullptr) ? reinterpret_cast<char*>(m_memory.memPointer) + allocStart : nullptr;
 
     // Create the memory object with the aligned slice
     return DxvkMemory(m_alloc, this, m_type,
-      m_memory.memHandle, allocStart, allocEnd - allocStart,
+      m_memory.memHandle, allocStart, allocSize,
       mapPtr, category);
     // NV-DXVK end
   }
@@ -301,39 +273,19 @@ DxvkMemory::DxvkMemory() { }
   void DxvkMemoryChunk::free(
           VkDeviceSize  offset,
           VkDeviceSize  length) {
-    // Remove adjacent entries from the free list and then add
-    // a new slice that covers all those entries. Without doing
-    // so, the slice could not be reused for larger allocations.
-    auto curr = m_freeList.begin();
-    
-    while (curr != m_freeList.end()) {
-      if (curr->offset == offset + length) {
-        length += curr->length;
-        curr = m_freeList.erase(curr);
-      } else if (curr->offset + curr->length == offset) {
-        offset -= curr->length;
-        length += curr->length;
-        curr = m_freeList.erase(curr);
-      } else {
-        curr++;
-      }
-    }
-    
-    m_freeList.push_back({ offset, length });
+    // NV-DXVK start: TLSF suballocator
+    // The suballocator coalesces the slice with
+    // its free neighbors, so it can be reused
+    // for larger allocations.
+    const VkDeviceSize freedLength = m_suballocator.free(offset);
+    assert(freedLength == length);
+    (void) freedLength;
+    // NV-DXVK end
   }
   
   // NV-DXVK start: Free unused memory
   bool DxvkMemoryChunk::isWholeChunkFree() const {
-    if (m_freeList.size() != 1)
-      return false;
-
-    if (m_freeList[0].offset != 0)
-      return false;
-
-    if (m_freeList[0].length != m_memory.memSize)
-      return false;
-
-    return true;
+    return m_suballocator.empty();
   }
   // NV-DXVK end
 
@@ -380,6 +332,13 @@ DxvkMemory::DxvkMemory() { }
         }
       }
     }
+
+    // NV-DXVK start: memory allocation trace
+    const std::string& tracePath = device->instance()->options().memoryTracePath;
+
+    if (!tracePath.empty())
+      openTrace(tracePath);
+    // NV-DXVK end
   }
   
   
@@ -465,6 +424,9 @@ DxvkMemory::DxvkMemory() { }
 
       type.chunks.erase(new_end_iterator, type.chunks.end());
     }
+
+    if (m_traceWriter)
+      traceTrimChunks();
   }
   // NV-DXVK end
 
@@ -538,9 +500,15 @@ DxvkMemory::DxvkMemory() { }
       }
     }
 
-    if (memory)
+    if (memory) {
       type->heap->stats.trackMemoryAssigned(category, memory.m_length);
 
+      // NV-DXVK start: memory allocation trace
+      if (m_traceWriter)
+        traceAlloc(memory, size, align, dedAllocInfo != nullptr);
+      // NV-DXVK end
+    }
+
     return memory;
   }
   
@@ -609,6 +577,11 @@ DxvkMemory::DxvkMemory() { }
     // NV-DXVK end
     memory.m_type->heap->stats.trackMemoryReleased(memory.m_category, memory.m_length);
 
+    // NV-DXVK start: memory allocation trace
+    if (m_traceWriter)
+      traceFree(memory);
+    // NV-DXVK end
+
     if (memory.m_chunk != nullptr) {
       this->freeChunkMemory(
         memory.m_type,
@@ -668,4 +641,86 @@ DxvkMemory::DxvkMemory() { }
     return chunkSize;
   }
   
+
+  // NV-DXVK start: memory allocation trace
+  // Frees only know where the memory was placed, so look up the trace id by placement
+  static XXH64_hash_t getTraceKey(VkDeviceMemory memory, VkDeviceSize offset) {
+    return XXH3_64bits_withSeed(&offset, sizeof(offset), XXH3_64bits(&memory, sizeof(memory)));
+  }
+
+
+  void DxvkMemoryAllocator::openTrace(
+    const std::string&          path) {
+    AllocTraceHeader header;
+    header.memoryTypeCount = std::min(m_memProps.memoryTypeCount, AllocTraceHeader::kMaxMemoryTypes);
+
+    for (uint32_t i = 0; i < header.memoryTypeCount; i++)
+      header.chunkSizes[i] = m_memTypes[i].chunkSize;
+
+    m_traceWriter = std::make_unique<AllocTraceWriter>();
+
+    if (!m_traceWriter->open(path, header)) {
+      Logger::err(str::format("DxvkMemoryAllocator: Failed to open memory trace file ", path));
+      m_traceWriter = nullptr;
+      return;
+    }
+
+    Logger::info(str::format("DxvkMemoryAllocator: Recording memory trace to ", path));
+  }
+
+
+  void DxvkMemoryAllocator::traceAlloc(
+    const DxvkMemory&           memory,
+          VkDeviceSize          size,
+          VkDeviceSize          align,
+          bool                  dedicated) {
+    std::lock_guard<dxvk::mutex> lock(m_traceMutex);
+
+    AllocTraceRecord record;
+    record.op = AllocTraceRecord::Op::Alloc;
+    record.size = size;
+    record.id = m_traceNextId++;
+    record.frameId = m_device->getCurrentFrameId();
+    record.memoryType = uint8_t(memory.m_type->memTypeId);
+    record.category = uint8_t(memory.m_category);
+    record.alignmentLog2 = uint8_t(align ? bit::tzcnt(uint32_t(align)) : 0);
+    record.flags = dedicated ? AllocTraceRecord::kFlagDedicated : 0;
+    m_traceWriter->write(record);
+
+    m_traceIds[getTraceKey(memory.m_memory, memory.m_offset)] = record.id;
+  }
+
+
+  void DxvkMemoryAllocator::traceFree(
+    const DxvkMemory&           memory) {
+    std::lock_guard<dxvk::mutex> lock(m_traceMutex);
+
+    auto entry = m_traceIds.find(getTraceKey(memory.m_memory, memory.m_offset));
+
+    if (entry == m_traceIds.end())
+      return;
+
+    AllocTraceRecord record;
+    record.op = AllocTraceRecord::Op::Free;
+    record.size = memory.m_length;
+    record.id = entry->second;
+    record.frameId = m_device->getCurrentFrameId();
+    record.memoryType = uint8_t(memory.m_type->memTypeId);
+    record.category = uint8_t(memory.m_category);
+    m_traceWriter->write(record);
+
+    m_traceIds.erase(entry);
+  }
+
+
+  void DxvkMemoryAllocator::traceTrimChunks() {
+    std::lock_guard<dxvk::mutex> lock(m_traceMutex);
+
+    AllocTraceRecord record;
+    record.op = AllocTraceRecord::Op::TrimChunks;
+    record.frameId = m_device->getCurrentFrameId();
+    m_traceWriter->write(record);
+  }
+  // NV-DXVK end
+
 }
@@ -23,6 +23,9 @@
 
 #include "dxvk_adapter.h"
 
+#include "../util/util_alloc_trace.h"
+#include "../util/util_tlsf.h"
+
 namespace dxvk {
   
   class DxvkMemoryAllocator;
@@ -297,16 +300,13 @@ namespace dxvk {
 
   private:
     
-    struct FreeSlice {
-      VkDeviceSize offset;
-      VkDeviceSize length;
-    };
-    
     DxvkMemoryAllocator*  m_alloc;
     DxvkMemoryType*       m_type;
     DxvkDeviceMemory      m_memory;
     
-    std::vector<FreeSlice> m_freeList;
+    // NV-DXVK start: TLSF suballocator
+    TlsfAllocator         m_suballocator;
+    // NV-DXVK end
     
   };
   
@@ -451,6 +451,27 @@ namespace dxvk {
     VkDeviceSize pickChunkSize(
             uint32_t              memTypeId) const;
 
+    // NV-DXVK start: memory allocation trace
+    dxvk::mutex                               m_traceMutex;
+    std::unique_ptr<AllocTraceWriter>         m_traceWriter;
+    uint32_t                                  m_traceNextId = 0;
+    std::unordered_map<XXH64_hash_t, uint32_t, XXH64_hash_passthrough> m_traceIds;
+
+    void openTrace(
+      const std::string&          path);
+
+    void traceAlloc(
+      const DxvkMemory&           memory,
+            VkDeviceSize          size,
+            VkDeviceSize          align,
+            bool                  dedicated);
+
+    void traceFree(
+      const DxvkMemory&           memory);
+
+    void traceTrimChunks();
+    // NV-DXVK end
+
   };
   
 }
\ No newline at end of file
@@ -63,6 +63,10 @@ namespace dxvk {
     deviceLocalMemoryChunkSizeMB = config.getOption<uint32_t>("dxvk.deviceLocalMemoryChunkSizeMB", 320);
     otherMemoryChunkSizeMB = config.getOption<uint32_t>("dxvk.otherMemoryChunkSizeMB", 128);
     // NV-DXVK end
+
+    // NV-DXVK start: memory allocation trace
+    memoryTracePath = config.getOption<std::string>("dxvk.memoryTracePath", "", "DXVK_MEMORY_TRACE_PATH");
+    // NV-DXVK end
   }
 
 }
@@ -72,6 +72,12 @@ namespace dxvk {
     uint32_t deviceLocalMemoryChunkSizeMB;
     uint32_t otherMemoryChunkSizeMB;
     // NV-DXVK end
+
+    // NV-DXVK start: memory allocation trace
+    /// Records every device memory allocation
+    /// and free to this file if not empty
+    std::string memoryTracePath;
+    // NV-DXVK end
   };
 
 }
@@ -236,7 +236,25 @@ namespace dxvk {
      * \param [in] outputStream Stream to write to 
      */
     void dump(std::ostream& outputStream) const;
-    
+
+    // NV-DXVK start: shader module cache
+    /**
+     * \brief Resource slots
+     * \returns Resource slots the shader was created with
+     */
+    const std::vector<DxvkResourceSlot>& resourceSlots() const {
+      return m_slots;
+    }
+
+    /**
+     * \brief Retrieves uncompressed SPIR-V code
+     * \returns Code the shader was created with
+     */
+    SpirvCodeBuffer getRawCode() const {
+      return m_code.decompress();
+    }
+    // NV-DXVK end
+
     /**
      * \brief Sets the shader key
      * \param [in] key Unique key
@@ -32,6 +32,13 @@ namespace dxvk {
     RtxSamplers,                       ///< Number of samplers currently present in the scene
     RtxTexturesInFlight,               ///< Number of texture currently being loaded
     RtxLastTextureBatchDuration,       ///< Duration in ms of the last processed texture batch
+    RtxTextureAvgTimeToFullRes,        ///< Average time in ms from queuing to full resolution of the textures last promoted
+    RtxTextureMaxTimeToFullRes,        ///< Longest time in ms from queuing to full resolution of the textures last promoted
+    RtxTexturesPreempted,              ///< Number of texture promotions dropped because the texture went unused while queued
+    RtxWorkerArenaAllocations,         ///< Number of scratch allocations made from geometry worker arenas last frame
+    RtxWorkerArenaHeapAllocations,     ///< Number of times geometry worker arenas had to grow from the heap last frame
+    RtxGeometryHashCacheHits,          ///< Number of draw calls last frame which reused geometry hashes of unchanged buffers
+    RtxGeometryHashCacheMisses,        ///< Number of cacheable draw calls last frame which had to hash their geometry
     NumCounters,                       ///< Number of counters available
   };
   
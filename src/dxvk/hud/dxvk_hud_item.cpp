@@ -732,7 +732,14 @@ namespace dxvk::hud {
                                    "# Lights:",
                                    "# Samplers:",
                                    "# Textures in-flight:",
-                                   "# Last tex. batch (ms):"}; 
+                                   "# Last tex. batch (ms):",
+                                   "# Avg tex. time to full res (ms):",
+                                   "# Max tex. time to full res (ms):",
+                                   "# Tex. promotions preempted:",
+                                   "# Worker arena allocs:",
+                                   "# Worker arena heap allocs:",
+                                   "# Geometry hash cache hits:",
+                                   "# Geometry hash cache misses:"}; 
     const uint64_t values[] = { counters.getCtr(DxvkStatCounter::QueuePresentCount),
                                 counters.getCtr(DxvkStatCounter::RtxBlasCount),
                                 counters.getCtr(DxvkStatCounter::RtxBufferCount),
@@ -744,7 +751,14 @@ namespace dxvk::hud {
                                 counters.getCtr(DxvkStatCounter::RtxLightCount),
                                 counters.getCtr(DxvkStatCounter::RtxSamplers),
                                 counters.getCtr(DxvkStatCounter::RtxTexturesInFlight),
-                                counters.getCtr(DxvkStatCounter::RtxLastTextureBatchDuration)};
+                                counters.getCtr(DxvkStatCounter::RtxLastTextureBatchDuration),
+                                counters.getCtr(DxvkStatCounter::RtxTextureAvgTimeToFullRes),
+                                counters.getCtr(DxvkStatCounter::RtxTextureMaxTimeToFullRes),
+                                counters.getCtr(DxvkStatCounter::RtxTexturesPreempted),
+                                counters.getCtr(DxvkStatCounter::RtxWorkerArenaAllocations),
+                                counters.getCtr(DxvkStatCounter::RtxWorkerArenaHeapAllocations),
+                                counters.getCtr(DxvkStatCounter::RtxGeometryHashCacheHits),
+                                counters.getCtr(DxvkStatCounter::RtxGeometryHashCacheMisses)};
 
     const uint32_t kNumLabels = sizeof(labels) / sizeof(labels[0]);
     static_assert(kNumLabels == sizeof(values) / sizeof(values[0]));
@@ -1456,6 +1456,14 @@ namespace dxvk {
         ImGui::Unindent();
       }
       ImGui::Checkbox("Hash Collision Detection", &HashCollisionDetectionOptions::enableObject());
+      if (HashCollisionDetectionOptions::enable()) {
+        ImGui::Indent();
+        const HashCollisionDetection::Stats stats = HashCollisionDetection::getStats();
+        ImGui::Text("Collisions: %llu", stats.collisions);
+        ImGui::Text("Validated: %llu / %llu submitted (%llu dropped)", stats.validated, stats.submitted, stats.dropped);
+        ImGui::Text("Cached: %.1f MB (%llu evicted)", stats.cachedBytes / (1024.f * 1024.f), stats.evicted);
+        ImGui::Unindent();
+      }
       ImGui::Checkbox("Validate CPU index data", &RtxOptions::Get()->validateCPUIndexDataObject());
     }
 
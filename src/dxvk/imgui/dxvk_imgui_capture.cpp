@@ -196,6 +196,17 @@ namespace dxvk {
 
   void ImGuiCapture::Progress::update(const Rc<DxvkContext>& ctx) {
     const auto& state = ctx->getCommonObjects()->capturer()->getState();
+    if (state == m_prevState && state.has<GameCapturer::State::Exporting>()) {
+      // Assets are exported incrementally, so keep the last line up to date
+      const auto& progress = ctx->getCommonObjects()->capturer()->getExportProgress();
+      const size_t numAssets = progress.numAssets.load();
+      const size_t numAssetsExported = std::min(progress.numAssetsExported.load(), numAssets);
+      if (numAssets > 0) {
+        m_percent = 0.60f + 0.40f * static_cast<float>(numAssetsExported) / static_cast<float>(numAssets);
+        m_output.back() = str::format("Exporting to USD... (", numAssetsExported, "/", numAssets, " assets)");
+      }
+      return;
+    }
     if (state != m_prevState) {
       m_prevState = state;
       m_output.clear();
@@ -39,9 +39,12 @@
 #include "rtx/concept/billboard.h"
 
 #include "rtx/pass/common_binding_indices.h"
+#include "../util/log/metrics.h"
 
 namespace dxvk {
 
+  static MetricCounter s_blasBuiltMetric("accel.blas_built");
+
   // Make this static and not a member of AccelManager to make it safe updating the count from ~PooledBlas()
   static int g_blasCount = 0;
 
@@ -953,6 +956,7 @@ namespace dxvk {
     if (!blasToBuild.empty()) {
       assert(blasToBuild.size() == blasRangesToBuild.size());
       ctx->vkCmdBuildAccelerationStructuresKHR(blasToBuild.size(), blasToBuild.data(), blasRangesToBuild.data());
+      s_blasBuiltMetric.add(blasToBuild.size());
     }
   }
 
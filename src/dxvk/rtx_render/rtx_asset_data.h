@@ -122,6 +122,15 @@ namespace dxvk {
      */
     virtual void releaseSource() = 0;
 
+    /**
+     * \brief Prefetch asset data
+     *
+     * A hint that the data of all subresources will be requested
+     * soon. Implementations may start bringing the data into memory
+     * in the background, the call never blocks on IO.
+     */
+    virtual void prefetch() { }
+
   protected:
     AssetData() = default;
 
@@ -153,6 +162,10 @@ namespace dxvk {
       m_sourceAsset->releaseSource();
     }
 
+    void prefetch() override {
+      m_sourceAsset->prefetch();
+    }
+
     void evictCache(int layer, int level) override {
       return m_sourceAsset->evictCache(layer, level + m_minLevel);
     }
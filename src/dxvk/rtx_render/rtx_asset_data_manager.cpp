@@ -26,9 +26,60 @@
 #include "rtx_game_capturer_paths.h"
 #include "rtx_io.h"
 #include "dxvk_scoped_annotation.h"
+#include "dxvk_format.h"
+#include "../../util/util_gdeflate.h"
 #include <gli/gli.hpp>
+#include <list>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace dxvk {
+  class DdsFileParser;
+
+  // Tracks the DDS files with an open handle in most recently used order. Texture
+  // loads may keep many sources open at once, so rather than failing once the CRT
+  // runs out of file handles (EMFILE) we close the least recently used ones, which
+  // are reopened on demand.
+  class DdsHandleLru {
+  public:
+    static constexpr size_t kMaxOpenHandles = 256;
+
+    static DdsHandleLru& get() {
+      // Intentionally leaked, asset data may still be released during static destruction
+      static DdsHandleLru* s_instance = new DdsHandleLru;
+      return *s_instance;
+    }
+
+    // Marks the parser's handle as most recently used, closing older handles when over budget
+    void touch(DdsFileParser* parser);
+
+    void remove(DdsFileParser* parser) {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      auto it = m_entries.find(parser);
+      if (it != m_entries.end()) {
+        m_lru.erase(it->second);
+        m_entries.erase(it);
+      }
+    }
+
+    // Closes the least recently used handle not currently in use, returns false if none could be closed
+    bool closeLeastRecentlyUsed(DdsFileParser* exclude) {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      return closeLeastRecentlyUsedLocked(exclude);
+    }
+
+  private:
+    bool closeLeastRecentlyUsedLocked(DdsFileParser* exclude);
+
+    dxvk::mutex m_mutex;
+    std::list<DdsFileParser*> m_lru;
+    std::unordered_map<DdsFileParser*, std::list<DdsFileParser*>::iterator> m_entries;
+  };
   
   class GliTextureData : public AssetData {
     AssetType type() const {
@@ -108,7 +159,15 @@ namespace dxvk {
   };
 
   class DdsFileParser {
+    friend class DdsHandleLru;
   public:
+    // A read-only view of part of the file, pointing straight into the page cache
+    struct MappedRange {
+      void* view = nullptr;
+      size_t viewSize = 0;
+      const uint8_t* data = nullptr;
+    };
+
     virtual ~DdsFileParser() {
       closeHandle();
     }
@@ -116,6 +175,8 @@ namespace dxvk {
     bool parse(const std::string& filename) {
       using namespace gli::detail;
 
+      std::lock_guard<dxvk::mutex> lock(m_handleMutex);
+
       m_filename = filename;
 
       if (openHandle() == nullptr)
@@ -182,36 +243,118 @@ namespace dxvk {
       if (m_sizeOfAllLevels * (m_layers * m_faces) + m_dataOffset > m_fileSize)
         return false;
 
-      closeHandle();
+      closeHandleLocked();
 
       return true;
     }
 
+    void closeHandle() {
+      std::lock_guard<dxvk::mutex> lock(m_handleMutex);
+      closeHandleLocked();
+    }
+
+  protected:
+    // Guards m_file, must be held around openHandle() and any use of the handle
+    dxvk::mutex m_handleMutex;
+
     FILE* openHandle() {
       assert(!m_filename.empty() && "DDS filename cannot be empty");
       if (m_file == nullptr) {
-        errno = 0;
-        m_file = std::fopen(m_filename.c_str(), "rb");
+        while (true) {
+          errno = 0;
+          m_file = std::fopen(m_filename.c_str(), "rb");
+
+          if (m_file != nullptr || errno != EMFILE) {
+            break;
+          }
 
-        if (m_file == nullptr) {
-          if (errno == EMFILE) {
+          // Out of file handles, make room by closing sources that haven't been used in a while
+          if (!DdsHandleLru::get().closeLeastRecentlyUsed(this)) {
             throw DxvkError("Unable to open a DDS file: too many open files. "
                             "Please consider using AssetData::releaseSource() "
                             "method to keep the number of open files low.");
           }
         }
       }
+
+      if (m_file != nullptr) {
+        DdsHandleLru::get().touch(this);
+      }
+
       return m_file;
     }
 
-    void closeHandle() {
+    void closeHandleLocked() {
       if (m_file) {
+        DdsHandleLru::get().remove(this);
         std::fclose(m_file);
         m_file = nullptr;
       }
     }
 
-  protected:
+    // Maps [offset, offset + size) of the file, the handle must be open. The view stays valid
+    // after the handle is closed, until unmapRange() is called.
+    bool mapRange(const long offset, const size_t size, MappedRange& range) const {
+      assert(m_file != nullptr);
+
+#ifdef _WIN32
+      static const size_t s_granularity = [] {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        return static_cast<size_t>(systemInfo.dwAllocationGranularity);
+      }();
+#else
+      static const size_t s_granularity = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+      // Views must start at a multiple of the allocation granularity
+      const size_t viewOffset = static_cast<size_t>(offset) & ~(s_granularity - 1);
+      const size_t viewSize = static_cast<size_t>(offset) - viewOffset + size;
+
+#ifdef _WIN32
+      const HANDLE fileHandle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(m_file)));
+      const HANDLE mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping == nullptr) {
+        return false;
+      }
+
+      // The view keeps the section alive, the mapping handle is not needed past this point
+      void* view = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(viewOffset >> 32),
+                                 static_cast<DWORD>(viewOffset & 0xFFFFFFFF), viewSize);
+      CloseHandle(mapping);
+
+      if (view == nullptr) {
+        return false;
+      }
+#else
+      void* view = mmap(nullptr, viewSize, PROT_READ, MAP_PRIVATE, fileno(m_file), static_cast<off_t>(viewOffset));
+      if (view == MAP_FAILED) {
+        return false;
+      }
+#endif
+
+      range.view = view;
+      range.viewSize = viewSize;
+      range.data = static_cast<const uint8_t*>(view) + (static_cast<size_t>(offset) - viewOffset);
+      return true;
+    }
+
+    // Drops the view and with it the pages it kept resident, akin to madvise(MADV_DONTNEED)
+    static void unmapRange(MappedRange& range) {
+      if (range.view == nullptr) {
+        return;
+      }
+
+#ifdef _WIN32
+      UnmapViewOfFile(range.view);
+#else
+      madvise(range.view, range.viewSize, MADV_DONTNEED);
+      munmap(range.view, range.viewSize);
+#endif
+
+      range = MappedRange {};
+    }
+
     std::string m_filename;
 
     long m_fileSize = 0;
@@ -241,8 +384,48 @@ namespace dxvk {
     FILE* m_file = nullptr;
   };
 
+  void DdsHandleLru::touch(DdsFileParser* parser) {
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(parser);
+    if (it != m_entries.end()) {
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      return;
+    }
+
+    m_lru.push_front(parser);
+    m_entries.emplace(parser, m_lru.begin());
+
+    if (m_lru.size() > kMaxOpenHandles) {
+      closeLeastRecentlyUsedLocked(parser);
+    }
+  }
+
+  bool DdsHandleLru::closeLeastRecentlyUsedLocked(DdsFileParser* exclude) {
+    for (auto it = m_lru.rbegin(); it != m_lru.rend(); ++it) {
+      DdsFileParser* parser = *it;
+
+      // Skip sources that are being read from right now
+      if (parser == exclude || !parser->m_handleMutex.try_lock()) {
+        continue;
+      }
+
+      m_entries.erase(parser);
+      m_lru.erase(std::next(it).base());
+
+      std::fclose(parser->m_file);
+      parser->m_file = nullptr;
+      parser->m_handleMutex.unlock();
+      return true;
+    }
+
+    return false;
+  }
+
   class DdsTextureData : public DdsFileParser, public AssetData {
     std::unordered_map<int, std::vector<uint8_t>> m_data;
+    std::unordered_map<int, MappedRange> m_mappedData;
+    bool m_useMapping = false;
 
     AssetType type() const {
       if (m_width > 1 && m_height == 1 && m_depth == 1) {
@@ -260,10 +443,21 @@ namespace dxvk {
 
   public:
 
-    ~DdsTextureData() override { }
+    ~DdsTextureData() override {
+      for (auto& [key, range] : m_mappedData) {
+        unmapRange(range);
+      }
+    }
 
     const void* data(int layer, int level) override {
       int key = getKey(layer, level);
+
+      if (m_useMapping) {
+        const auto& it = m_mappedData.find(key);
+        if (it != m_mappedData.end() && it->second.data != nullptr)
+          return it->second.data;
+      }
+
       const auto& it = m_data.find(key);
       if (it != m_data.end() && !it->second.empty())
         return it->second.data();
@@ -277,9 +471,22 @@ namespace dxvk {
         return nullptr;
       }
 
+      std::lock_guard<dxvk::mutex> lock(m_handleMutex);
+
       auto file = openHandle();
       assert(file);
-      
+
+      if (m_useMapping) {
+        // Zero-copy: hand out a pointer into the file mapping, falling back to a read if mapping fails
+        MappedRange range;
+        if (mapRange(dataOffset, dataSize, range)) {
+          m_mappedData[key] = range;
+          return range.data;
+        }
+
+        ONCE(Logger::warn(str::format("Unable to memory map DDS file, falling back to buffered reads: ", m_filename)));
+      }
+
       std::vector<uint8_t> data;
       std::fseek(file, dataOffset, SEEK_SET);
       data.resize(dataSize);
@@ -292,10 +499,21 @@ namespace dxvk {
 
     void evictCache(int layer, int level) override {
       int key = getKey(layer, level);
-      releaseVectorMemory(m_data[key]);
+
+      auto it = m_mappedData.find(key);
+      if (it != m_mappedData.end()) {
+        unmapRange(it->second);
+        m_mappedData.erase(it);
+      }
+
+      auto dataIt = m_data.find(key);
+      if (dataIt != m_data.end()) {
+        releaseVectorMemory(dataIt->second);
+      }
     }
 
     void releaseSource() override {
+      // Mapped views stay valid without the handle
       closeHandle();
     }
 
@@ -312,6 +530,8 @@ namespace dxvk {
 
     bool load(const std::string& filename) {
       if (parse(filename)) {
+        m_useMapping = RtxOptions::Get()->useMemoryMappedDdsLoader();
+
         m_info.type = type();
         m_info.compression = AssetCompression::None;
         m_info.format = m_format;
@@ -396,26 +616,81 @@ namespace dxvk {
     const void* data(int layer, int level) override {
       uint32_t blobIdx = getBlobIndex(layer, 0, level);
 
+      // Tail mips share a blob, locate the level within it
+      const size_t levelOffset = getOffsetInBlob(level);
+
       const auto& it = m_data.find(blobIdx);
       if (it != m_data.end() && !it->second.empty())
-        return it->second.data();
+        return it->second.data() + levelOffset;
 
       if (auto blobDesc = m_package->getDataBlobDesc(blobIdx)) {
-        if (blobDesc->compression != 0) {
+        const bool isCompressed = blobDesc->compression != 0;
+
+        if (isCompressed && !GDeflateDecoder::isSupported()) {
           throw DxvkError("Compressed data blobs are not supported for CPU readback.");
         }
 
-        std::vector<uint8_t> data(blobDesc->size);
-        m_package->readDataBlob(blobIdx, data.data(), data.size());
+        // Blocks if the blob was not verified yet, data must not be handed out before that
+        if (m_package->verifyBlobChecksum(blobIdx) == AssetPackage::BlobStatus::Corrupted) {
+          throw DxvkError(str::format("Data blob ", blobIdx, " of package ", m_package->getFilename(), " is corrupted."));
+        }
+
+        const uint8_t* mappedData = m_package->mapDataBlob(blobIdx);
 
-        const void* rawData = data.data();
+        if (mappedData && !isCompressed) {
+          return mappedData + levelOffset;
+        }
+
+        std::vector<uint8_t> data;
+        if (!mappedData) {
+          data.resize(blobDesc->size);
+          m_package->readDataBlob(blobIdx, data.data(), data.size());
+        }
+
+        if (isCompressed) {
+          const uint8_t* compressedData = mappedData ? mappedData : data.data();
+          std::vector<uint8_t> decompressedData(GDeflateDecoder::getUncompressedSize(compressedData, blobDesc->size));
+
+          if (decompressedData.empty() ||
+              !GDeflateDecoder::get().decompress(decompressedData.data(), decompressedData.size(), compressedData, blobDesc->size)) {
+            throw DxvkError(str::format("Unable to decompress data blob ", blobIdx, " of package ", m_package->getFilename(), "."));
+          }
+
+          data = std::move(decompressedData);
+        }
+
+        const uint8_t* rawData = data.data();
         m_data[blobIdx] = std::move(data);
-        return rawData;
+        return rawData + levelOffset;
       }
 
       return nullptr;
     }
 
+    void prefetch() override {
+      if (RtxIo::enabled()) {
+        return;
+      }
+
+      const int numLooseMips = m_assetDesc->numMips - m_assetDesc->numTailMips;
+      const int numFaces = m_assetDesc->type == AssetPackage::AssetDesc::Type::IMAGE_CUBE ? 6 : 1;
+
+      std::vector<uint32_t> blobs;
+      for (int layer = 0; layer < m_assetDesc->arraySize; layer++) {
+        for (int face = 0; face < numFaces; face++) {
+          for (int level = 0; level < m_assetDesc->numMips; level++) {
+            blobs.push_back(getBlobIndex(layer, face, level));
+
+            if (level >= numLooseMips) {
+              break;
+            }
+          }
+        }
+      }
+
+      m_package->prefetchBlobs(blobs.data(), static_cast<uint32_t>(blobs.size()));
+    }
+
     void evictCache(int layer, int level) override {
       uint32_t blobIdx = getBlobIndex(layer, 0, level);
       releaseVectorMemory(m_data[blobIdx]);
@@ -463,6 +738,23 @@ namespace dxvk {
       return baseBlobIdx + layer * numLooseMips;
     }
 
+    size_t getOffsetInBlob(int level) const {
+      const int numLooseMips = m_assetDesc->numMips - m_assetDesc->numTailMips;
+      if (level <= numLooseMips || type() == AssetType::Buffer) {
+        return 0;
+      }
+
+      const DxvkFormatInfo* formatInfo = imageFormatInfo(m_info.format);
+
+      size_t offset = 0;
+      for (int tailLevel = numLooseMips; tailLevel < level; tailLevel++) {
+        const VkExtent3D blockCount = util::computeBlockCount(extent(tailLevel), formatInfo->blockSize);
+        offset += blockCount.width * blockCount.height * blockCount.depth * formatInfo->elementSize;
+      }
+
+      return offset;
+    }
+
     Rc<AssetPackage> m_package;
     const AssetPackage::AssetDesc* m_assetDesc = nullptr;
     uint32_t m_assetIdx;
@@ -502,13 +794,15 @@ namespace dxvk {
     m_searchPaths[priority] = searchPath;
 
     // Find the packages
-    if (RtxIo::enabled()) {
+    if (RtxIo::enabled() || RtxOptions::Get()->useMemoryMappedPackageLoader()) {
       PackageSet packageSet;
       for (const auto& entry : std::filesystem::directory_iterator(path)) {
         if (entry.path().extension() == ".pkg" || entry.path().extension() == ".rtxio") {
           const auto packagePath = entry.path().string();
           // Try to initialize the replacements packages
-          Rc<AssetPackage> package = new AssetPackage(packagePath);
+          Rc<AssetPackage> package = new AssetPackage(packagePath,
+            RtxOptions::Get()->useMemoryMappedPackageLoader(),
+            RtxOptions::Get()->verifyPackageChecksums());
           if (package->initialize()) {
             packageSet.emplace(packagePath, std::move(package));
             Logger::info(str::format("Mounted a package at: ", entry.path()));
@@ -546,7 +840,7 @@ namespace dxvk {
       }
     }
 
-    if (RtxIo::enabled() && !m_packageSets.empty()) {
+    if (!m_packageSets.empty()) {
       // Iterate package sets in search priority order
       for (auto itBase = m_packageSets.rbegin(); itBase != m_packageSets.rend(); ++itBase) {
         const auto& basePath = std::get<0>(itBase->second);
@@ -561,7 +855,12 @@ namespace dxvk {
           for (auto it = packages.rbegin(); it != packages.rend(); ++it) {
             uint32_t assetIdx = it->second->findAsset(relativePath);
             if (AssetPackage::kNoAssetIdx != assetIdx) {
-              return new PackagedAssetData(it->second, assetIdx);
+              Rc<PackagedAssetData> asset = new PackagedAssetData(it->second, assetIdx);
+
+              // Without RTX IO compressed assets need the CPU decoder
+              if (RtxIo::enabled() || asset->info().compression == AssetCompression::None || GDeflateDecoder::isSupported()) {
+                return asset;
+              }
             }
           }
         }
@@ -0,0 +1,550 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "rtx_asset_package.h"
+
+#include "../../util/log/log.h"
+#include "../../util/util_string.h"
+#include "../../util/util_singleton.h"
+#include "../../util/util_threadpool.h"
+#include "../../util/sync/sync_spinlock.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#define fseek64 fseeko64
+#define ftell64 ftello64
+#define fopen_s(pFile,filename,mode) (((*(pFile))=fopen((filename),(mode)))==NULL)
+#endif
+
+namespace dxvk {
+
+  namespace {
+    // Slicing-by-8 CRC-32 (IEEE 802.3, reflected), matching zlib's crc32()
+    struct Crc32Tables {
+      uint32_t table[8][256];
+
+      Crc32Tables() {
+        for (uint32_t i = 0; i < 256; i++) {
+          uint32_t crc = i;
+          for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+          }
+          table[0][i] = crc;
+        }
+
+        for (uint32_t i = 0; i < 256; i++) {
+          for (uint32_t slice = 1; slice < 8; slice++) {
+            const uint32_t prev = table[slice - 1][i];
+            table[slice][i] = (prev >> 8) ^ table[0][prev & 0xFF];
+          }
+        }
+      }
+    };
+
+    uint32_t computeCrc32(const uint8_t* data, size_t size) {
+      static const Crc32Tables s_tables;
+      const auto& t = s_tables.table;
+
+      uint32_t crc = ~0u;
+
+      while (size >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, data, sizeof(lo));
+        memcpy(&hi, data + 4, sizeof(hi));
+        lo ^= crc;
+
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+
+        data += 8;
+        size -= 8;
+      }
+
+      while (size--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+      }
+
+      return ~crc;
+    }
+
+    size_t getPageSize() {
+#ifdef _WIN32
+      static const size_t s_pageSize = [] {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        return static_cast<size_t>(systemInfo.dwPageSize);
+      }();
+#else
+      static const size_t s_pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+      return s_pageSize;
+    }
+  }
+
+  // Background threads faulting package blobs into memory and verifying their checksums
+  class AssetPackagePrefetcher : public Singleton<AssetPackagePrefetcher> {
+    typedef WorkerThreadPool<256, true, false> ThreadPoolType;
+
+    // Note: WorkerThreadPool is not thread-safe
+    sync::Spinlock m_mutex;
+    ThreadPoolType* m_threadPool = nullptr;
+  public:
+    ~AssetPackagePrefetcher() {
+      release();
+    }
+
+    void release() {
+      std::lock_guard<sync::Spinlock> lock(m_mutex);
+      if (m_threadPool) {
+        delete m_threadPool;
+        m_threadPool = nullptr;
+      }
+    }
+
+    template<typename F>
+    bool schedule(F&& f) {
+      std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+      if (m_threadPool == nullptr) {
+        // Prefetching is IO bound, a couple of threads keep enough requests in flight
+        m_threadPool = new ThreadPoolType(ThreadPoolType::getDefaultThreadCount(1, 2), "rtx-package-prefetch");
+      }
+
+      // A full queue only means the readahead is too far ahead already, drop the request
+      return m_threadPool->Schedule(std::forward<F>(f)).valid();
+    }
+  };
+
+  AssetPackage::~AssetPackage() {
+    unmapFile();
+    closeFileHandle();
+  }
+
+  bool AssetPackage::initialize(const char* filename) {
+    if (m_filename.empty() && nullptr == filename)
+      return false;
+
+    unmapFile();
+    closeFileHandle();
+
+    if (m_filename.empty() && nullptr != filename)
+      m_filename = filename;
+
+    if (!openFileHandle())
+      return false;
+
+    fseek64(m_handle, 0, SEEK_END);
+    m_fileSize = ftell64(m_handle);
+    fseek64(m_handle, 0, SEEK_SET);
+
+    if (m_useFileMapping && mapFile()) {
+      // The mapping keeps the file alive, no need to hold on to the handle
+      closeFileHandle();
+    }
+
+    Header header { 0 };
+    if (!readAt(0, &header, sizeof(header))) {
+      Logger::err(str::format("Malformed asset package ", m_filename));
+      return false;
+    }
+
+    if (header.magic != kMagic) {
+      Logger::err(str::format("File ", m_filename, " is not an asset package."));
+      return false;
+    }
+
+    if (header.version < kMinVersion || header.version > kVersion) {
+      Logger::err(str::format("Asset package ", m_filename, " version mismatch. "
+                              "Got: ", header.version, ", expected: ", kMinVersion, "..", kVersion));
+      return false;
+    }
+
+    m_version = header.version;
+
+    uint16_t counts[2] = { 0, 0 };
+    if (!readAt(header.dictOffset, counts, sizeof(counts))) {
+      Logger::err(str::format("Malformed asset package ", m_filename));
+      return false;
+    }
+
+    m_assetCount = counts[0];
+    m_blobCount = counts[1];
+
+    const size_t dictOffset = header.dictOffset + sizeof(counts);
+    const size_t dictSize =
+      m_assetCount * sizeof(AssetDesc) + m_blobCount * sizeof(BlobDesc);
+
+    m_metadata.reset(new uint8_t[dictSize]);
+
+    if (!readAt(dictOffset, m_metadata.get(), dictSize)) {
+      Logger::err(str::format("Malformed asset package ", m_filename));
+      return false;
+    }
+
+    const size_t nameTableOffset = dictOffset + dictSize;
+    if (nameTableOffset > m_fileSize) {
+      Logger::err(str::format("Malformed asset package ", m_filename));
+      return false;
+    }
+
+    const size_t nameTableSize = m_fileSize - nameTableOffset;
+
+    // Keep a terminator past the end so a truncated table cannot run off the buffer
+    std::unique_ptr<char[]> names(new char[nameTableSize + 1]);
+    names[nameTableSize] = '\0';
+
+    if (!readAt(nameTableOffset, names.get(), nameTableSize)) {
+      Logger::err(str::format("Malformed asset package ", m_filename));
+      return false;
+    }
+
+    closeFileHandle();
+
+    auto namesPtr = names.get();
+    const auto namesEnd = namesPtr + nameTableSize;
+    for (uint32_t n = 0; n < m_assetCount && namesPtr < namesEnd; n++) {
+      m_nameHash.emplace(namesPtr, n);
+      namesPtr += strlen(namesPtr) + 1;
+    }
+
+    // Blob checksums are verified lazily, on first access. Packages
+    // predating checksums, and blobs without one, are trusted as is.
+    m_blobStatus.reset();
+    if (m_version >= kChecksumVersion && m_verifyChecksums) {
+      m_blobStatus.reset(new std::atomic<BlobStatus>[m_blobCount]);
+      for (uint32_t n = 0; n < m_blobCount; n++) {
+        m_blobStatus[n].store(getDataBlobDesc(n)->crc32 != 0 ?
+          BlobStatus::Unverified : BlobStatus::Valid, std::memory_order_relaxed);
+      }
+    }
+
+    return true;
+  }
+
+  bool AssetPackage::openFileHandle() {
+    if (nullptr == m_handle) {
+      if (0 != fopen_s(&m_handle, m_filename.c_str(), "rb")) {
+        Logger::info(str::format("Unable to open package file ", m_filename));
+      }
+    }
+
+    return nullptr != m_handle;
+  }
+
+  void AssetPackage::closeFileHandle() {
+    if (m_handle) {
+      fclose(m_handle);
+      m_handle = nullptr;
+    }
+  }
+
+  bool AssetPackage::readAt(uint64_t offset, void* out, size_t size) {
+    if (offset > m_fileSize || size > m_fileSize - offset)
+      return false;
+
+    if (m_mapping) {
+      memcpy(out, static_cast<const uint8_t*>(m_mapping) + offset, size);
+      return true;
+    }
+
+    std::lock_guard<dxvk::mutex> lock(m_handleMutex);
+
+    if (!openFileHandle())
+      return false;
+
+    if (0 != fseek64(m_handle, offset, SEEK_SET))
+      return false;
+
+    return size == fread(out, 1, size, m_handle);
+  }
+
+  bool AssetPackage::mapFile() {
+    assert(m_handle != nullptr && m_mapping == nullptr);
+
+    if (m_fileSize == 0)
+      return false;
+
+#ifdef _WIN32
+    const HANDLE fileHandle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(m_handle)));
+    const HANDLE mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+      Logger::warn(str::format("Unable to map package file ", m_filename, ", falling back to regular reads."));
+      return false;
+    }
+
+    // The view keeps the section alive, the mapping handle is not needed past this point
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (view == nullptr) {
+      Logger::warn(str::format("Unable to map package file ", m_filename, ", falling back to regular reads."));
+      return false;
+    }
+#else
+    void* view = mmap(nullptr, m_fileSize, PROT_READ, MAP_PRIVATE, fileno(m_handle), 0);
+    if (view == MAP_FAILED) {
+      Logger::warn(str::format("Unable to map package file ", m_filename, ", falling back to regular reads."));
+      return false;
+    }
+#endif
+
+    m_mapping = view;
+    return true;
+  }
+
+  void AssetPackage::unmapFile() {
+    if (m_mapping == nullptr)
+      return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_mapping);
+#else
+    munmap(m_mapping, m_fileSize);
+#endif
+
+    m_mapping = nullptr;
+  }
+
+  size_t AssetPackage::readDataBlob(uint32_t idx, void* out, size_t outSize) {
+    if (auto blobDesc = getDataBlobDesc(idx)) {
+      if (outSize < blobDesc->size)
+        return 0;
+
+      if (readAt(blobDesc->offset, out, blobDesc->size))
+        return blobDesc->size;
+    }
+
+    return 0;
+  }
+
+  const uint8_t* AssetPackage::mapDataBlob(uint32_t idx) const {
+    auto blobDesc = getDataBlobDesc(idx);
+
+    if (m_mapping == nullptr || blobDesc == nullptr)
+      return nullptr;
+
+    if (blobDesc->offset > m_fileSize || blobDesc->size > m_fileSize - blobDesc->offset)
+      return nullptr;
+
+    return static_cast<const uint8_t*>(m_mapping) + blobDesc->offset;
+  }
+
+  void AssetPackage::prefetchBlobs(const uint32_t* blobIndices, uint32_t count) {
+    if (m_mapping == nullptr || count == 0)
+      return;
+
+    std::vector<uint32_t> blobs;
+    blobs.reserve(count);
+    for (uint32_t n = 0; n < count; n++) {
+      if (mapDataBlob(blobIndices[n]) != nullptr) {
+        blobs.push_back(blobIndices[n]);
+      }
+    }
+
+    // Walk the blobs in file order so every batch turns into sequential reads
+    std::sort(blobs.begin(), blobs.end(), [this](uint32_t a, uint32_t b) {
+      return getDataBlobDesc(a)->offset < getDataBlobDesc(b)->offset;
+    });
+    blobs.erase(std::unique(blobs.begin(), blobs.end()), blobs.end());
+
+    size_t batchBegin = 0;
+    size_t batchSize = 0;
+
+    for (size_t n = 0; n < blobs.size(); n++) {
+      batchSize += getDataBlobDesc(blobs[n])->size;
+
+      if (batchSize < kPrefetchBatchSize && n + 1 < blobs.size())
+        continue;
+
+      std::vector<uint32_t> batch(blobs.begin() + batchBegin, blobs.begin() + n + 1);
+      batchBegin = n + 1;
+      batchSize = 0;
+
+      AssetPackagePrefetcher::get().schedule([package = Rc<AssetPackage>(this), batch = std::move(batch)]() {
+        const size_t pageSize = getPageSize();
+
+        for (const uint32_t idx : batch) {
+          const uint8_t* data = package->mapDataBlob(idx);
+          const size_t size = package->getDataBlobDesc(idx)->size;
+
+#ifndef _WIN32
+          const uintptr_t begin = reinterpret_cast<uintptr_t>(data) & ~(pageSize - 1);
+          madvise(reinterpret_cast<void*>(begin), reinterpret_cast<uintptr_t>(data) + size - begin, MADV_WILLNEED);
+#endif
+
+          // Verifying the checksum reads the whole blob, which faults it in as well
+          if (package->m_blobStatus) {
+            BlobStatus expected = BlobStatus::Unverified;
+            if (package->m_blobStatus[idx].compare_exchange_strong(expected, BlobStatus::Pending)) {
+              package->verifyBlob(idx);
+              continue;
+            }
+          }
+
+          volatile uint8_t sink = 0;
+          for (size_t offset = 0; offset < size; offset += pageSize) {
+            sink ^= data[offset];
+          }
+        }
+      });
+    }
+  }
+
+  AssetPackage::BlobStatus AssetPackage::verifyBlobChecksum(uint32_t idx) {
+    if (idx >= m_blobCount)
+      return BlobStatus::Corrupted;
+
+    if (!m_blobStatus)
+      return BlobStatus::Valid;
+
+    const BlobStatus status = m_blobStatus[idx].load(std::memory_order_acquire);
+    if (status == BlobStatus::Valid || status == BlobStatus::Corrupted)
+      return status;
+
+    // Unverified, or a prefetch thread is verifying it right now. The prefetch
+    // may also still sit in a queue that gets dropped, so rather than waiting
+    // on it compute the checksum here, both sides store the same result.
+    return verifyBlob(idx);
+  }
+
+  AssetPackage::BlobStatus AssetPackage::verifyBlob(uint32_t idx) {
+    const BlobDesc* blobDesc = getDataBlobDesc(idx);
+
+    uint32_t crc = 0;
+    bool readable = false;
+
+    if (const uint8_t* mappedData = mapDataBlob(idx)) {
+      crc = computeCrc32(mappedData, blobDesc->size);
+      readable = true;
+    } else {
+      std::vector<uint8_t> data(blobDesc->size);
+      readable = readDataBlob(idx, data.data(), data.size()) == data.size();
+      crc = computeCrc32(data.data(), data.size());
+    }
+
+    const bool valid = readable && crc == blobDesc->crc32;
+
+    if (!valid) {
+      Logger::err(str::format("Checksum mismatch in data blob ", idx, " of asset package ", m_filename,
+                              ". Expected: ", blobDesc->crc32, ", got: ", crc));
+    }
+
+    const BlobStatus status = valid ? BlobStatus::Valid : BlobStatus::Corrupted;
+    m_blobStatus[idx].store(status, std::memory_order_release);
+
+    return status;
+  }
+
+  size_t AssetPackage::getDataSize() {
+    Header header { 0 };
+    if (!readAt(0, &header, sizeof(header)))
+      return 0;
+
+    return header.dictOffset;
+  }
+
+  void AssetPackage::releasePrefetcher() {
+    AssetPackagePrefetcher::get().release();
+  }
+
+  uint32_t AssetPackageWriter::addBlob(const void* data, uint32_t size, uint8_t compression) {
+    AssetPackage::BlobDesc blobDesc {};
+    blobDesc.offset = sizeof(AssetPackage::Header) + m_data.size();
+    blobDesc.compression = compression;
+    blobDesc.flags = 0;
+    blobDesc.size = size;
+    blobDesc.crc32 = computeCrc32(static_cast<const uint8_t*>(data), size);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    m_data.insert(m_data.end(), bytes, bytes + size);
+    m_blobs.push_back(blobDesc);
+
+    return static_cast<uint32_t>(m_blobs.size() - 1);
+  }
+
+  uint32_t AssetPackageWriter::addAsset(const std::string& name, const AssetPackage::AssetDesc& desc) {
+    AssetPackage::AssetDesc assetDesc = desc;
+    assetDesc.nameIdx = static_cast<uint16_t>(m_names.size());
+
+    m_assets.push_back(assetDesc);
+    m_names.push_back(name);
+
+    return static_cast<uint32_t>(m_assets.size() - 1);
+  }
+
+  bool AssetPackageWriter::write(const std::string& filename, uint32_t version) const {
+    // The dictionary counts are 16 bit wide
+    if (m_assets.size() > UINT16_MAX || m_blobs.size() > UINT16_MAX) {
+      Logger::err(str::format("Too many assets for package ", filename));
+      return false;
+    }
+
+    FILE* file = nullptr;
+    if (0 != fopen_s(&file, filename.c_str(), "wb")) {
+      Logger::err(str::format("Unable to create package file ", filename));
+      return false;
+    }
+
+    AssetPackage::Header header;
+    header.magic = AssetPackage::kMagic;
+    header.version = version;
+    header.dictOffset = sizeof(header) + m_data.size();
+
+    const uint16_t counts[2] = {
+      static_cast<uint16_t>(m_assets.size()),
+      static_cast<uint16_t>(m_blobs.size())
+    };
+
+    std::vector<AssetPackage::BlobDesc> blobs = m_blobs;
+    if (version < AssetPackage::kChecksumVersion) {
+      for (auto& blobDesc : blobs) {
+        blobDesc.crc32 = 0;
+      }
+    }
+
+    bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+    success &= m_data.empty() || fwrite(m_data.data(), m_data.size(), 1, file) == 1;
+    success &= fwrite(counts, sizeof(counts), 1, file) == 1;
+    success &= m_assets.empty() || fwrite(m_assets.data(), m_assets.size() * sizeof(AssetPackage::AssetDesc), 1, file) == 1;
+    success &= blobs.empty() || fwrite(blobs.data(), blobs.size() * sizeof(AssetPackage::BlobDesc), 1, file) == 1;
+
+    for (const auto& name : m_names) {
+      success &= fwrite(name.c_str(), name.size() + 1, 1, file) == 1;
+    }
+
+    success &= fclose(file) == 0;
+
+    if (!success) {
+      Logger::err(str::format("Unable to write package file ", filename));
+    }
+
+    return success;
+  }
+
+} // namespace dxvk
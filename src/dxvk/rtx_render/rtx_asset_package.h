@@ -24,21 +24,15 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "../../util/rc/util_rc.h"
-#include "../../util/log/log.h"
-#include "../../util/util_string.h"
-
-#ifdef WIN32
-#define fseek64 _fseeki64
-#define ftell64 _ftelli64
-#else
-#define fseek64 fseeko64
-#define ftell64 ftello64
-#define fopen_s(pFile,filename,mode) (((*(pFile))=fopen((filename),(mode)))==NULL)
-#endif
+#include "../../util/rc/util_rc_ptr.h"
+#include "../../util/thread.h"
 
 namespace dxvk {
 
@@ -46,8 +40,13 @@ namespace dxvk {
   class AssetPackage : public RcObject {
   public:
     static constexpr uint32_t kMagic = 0xbaadd00d;
-    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kVersion = 2;
+    // Version 1 packages share the layout but do not carry valid blob checksums
+    static constexpr uint32_t kMinVersion = 1;
+    static constexpr uint32_t kChecksumVersion = 2;
     static constexpr uint32_t kNoAssetIdx = ~0;
+    // Blobs are prefetched in batches of about this many bytes, same as RTX IO small batches
+    static constexpr uint32_t kPrefetchBatchSize = ((64 * 65536) * 5) / 3;
 
     struct Header {
       uint32_t magic;
@@ -95,113 +94,33 @@ namespace dxvk {
       uint64_t flags : 8;
 
       uint32_t size;
+      // CRC-32 (IEEE) of the stored blob bytes, 0 when the packer did not compute one
       uint32_t crc32;
     };
 
     static_assert(sizeof(BlobDesc) == 16, "Blob description structure size overrun!");
 
-    AssetPackage() = default;
-    explicit AssetPackage(const std::string& filename)
-      : m_filename { filename } { }
-
-    ~AssetPackage() {
-      closeFileHandle();
-    }
-
-    bool initialize(const char* filename = nullptr) {
-      if (m_filename.empty() && nullptr == filename)
-        return false;
-
-      closeFileHandle();
-
-      if (m_filename.empty() && nullptr != filename)
-        m_filename = filename;
-
-      if (openFileHandle()) {
-        Header header { 0 };
-        if (sizeof(header) != fread(&header, 1, sizeof(header), m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (header.magic != kMagic) {
-          Logger::err(str::format("File ", m_filename, " is not an asset package."));
-          return false;
-        }
-
-        if (header.version != kVersion) {
-          Logger::err(str::format("Asset package ", m_filename, " version mismatch. "
-                                  "Got: ", header.version, ", expected: ", kVersion));
-          return false;
-        }
-
-        if (0 != fseek64(m_handle, header.dictOffset, SEEK_SET)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (1 != fread(&m_assetCount, 2, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (1 != fread(&m_blobCount, 2, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        const size_t dictSize =
-          m_assetCount * sizeof(AssetDesc) + m_blobCount * sizeof(BlobDesc);
-
-        m_metadata.reset(new uint8_t[dictSize]);
-
-        if (dictSize != fread(m_metadata.get(), 1, dictSize, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        size_t nameTableOffset = ftell64(m_handle);
-        fseek64(m_handle, 0, SEEK_END);
-        size_t nameTableSize = ftell64(m_handle) - nameTableOffset;
-        fseek64(m_handle, nameTableOffset, SEEK_SET);
-
-        std::unique_ptr<char[]> names(new char[nameTableSize]);
-
-        if (1 != fread(names.get(), nameTableSize, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        closeFileHandle();
-
-        auto namesPtr = names.get();
-        for (uint32_t n = 0; n < m_assetCount; n++) {
-          m_nameHash.emplace(namesPtr, n);
-          namesPtr += strlen(namesPtr) + 1;
-        }
-
-        return true;
-      }
+    enum class BlobStatus : uint8_t {
+      Unverified,
+      Pending,
+      Valid,
+      Corrupted,
+    };
 
-      return false;
-    }
+    AssetPackage() = default;
+    explicit AssetPackage(const std::string& filename,
+                          bool useFileMapping = true,
+                          bool verifyChecksums = true)
+      : m_filename { filename }
+      , m_useFileMapping { useFileMapping }
+      , m_verifyChecksums { verifyChecksums } { }
 
-    bool openFileHandle() {
-      if (nullptr == m_handle) {
-        if (0 != fopen_s(&m_handle, m_filename.c_str(), "rb")) {
-          Logger::info(str::format("Unable to open package file ", m_filename));
-        }
-      }
+    ~AssetPackage();
 
-      return nullptr != m_handle;
-    }
+    bool initialize(const char* filename = nullptr);
 
-    void closeFileHandle() {
-      if (m_handle) {
-        fclose(m_handle);
-        m_handle = nullptr;
-      }
-    }
+    bool openFileHandle();
+    void closeFileHandle();
 
     uint32_t getAssetCount() const {
       return m_assetCount;
@@ -226,35 +145,53 @@ namespace dxvk {
       return reinterpret_cast<const BlobDesc*>(m_metadata.get() + offs);
     }
 
-    size_t readDataBlob(uint32_t idx, void* out, size_t outSize) {
-      if (auto blobDesc = getDataBlobDesc(idx)) {
-        if (outSize < blobDesc->size)
-          return 0;
-
-        if (!openFileHandle())
-          return 0;
-
-        if (0 == fseek64(m_handle, blobDesc->offset, SEEK_SET))
-          return fread(out, 1, blobDesc->size, m_handle);
-      }
-
-      return 0;
-    }
-
-    size_t getDataSize() {
-      if (!openFileHandle())
-        return 0;
-
-      if (m_handle && 0 == fseek64(m_handle, 0, SEEK_SET)) {
-        Header header { 0 };
-        if (0 == fread(&header, 1, sizeof(header), m_handle))
-          return 0;
-
-        return header.dictOffset;
-      }
-
-      return 0;
-    }
+    size_t readDataBlob(uint32_t idx, void* out, size_t outSize);
+
+    /**
+     * \brief Get a pointer to the blob data in the file mapping
+     *
+     * The pointer stays valid for the lifetime of the package.
+     * Returns nullptr if the package could not be mapped, callers
+     * must fall back to readDataBlob() in that case.
+     * \param [in] idx Data blob index
+     * \returns Pointer to the stored blob bytes
+     */
+    const uint8_t* mapDataBlob(uint32_t idx) const;
+
+    /**
+     * \brief Prefetch data blobs
+     *
+     * Faults the given blobs into the page cache on background
+     * threads, in readahead batches of about kPrefetchBatchSize
+     * bytes, and verifies the checksums of the blobs that were not
+     * verified yet. Non-blocking, does nothing if the package is
+     * not mapped.
+     * \param [in] blobIndices Indices of blobs to prefetch
+     * \param [in] count Number of indices
+     */
+    void prefetchBlobs(const uint32_t* blobIndices, uint32_t count);
+
+    /**
+     * \brief Verify blob checksum
+     *
+     * Returns the status of a blob that was verified already, by
+     * a prefetch or an earlier call, and verifies the checksum on
+     * the calling thread otherwise, so the result is never Pending.
+     * Packages and blobs without checksums report Valid.
+     * \param [in] idx Data blob index
+     * \returns Verification status of the blob
+     */
+    BlobStatus verifyBlobChecksum(uint32_t idx);
+
+    size_t getDataSize();
+
+    /**
+     * \brief Stop the package prefetch threads
+     *
+     * Pending prefetch and verification requests are dropped,
+     * the threads are restarted by the next request.
+     */
+    static void releasePrefetcher();
 
     uint32_t findAsset(const std::string& filename) const {
       auto it = m_nameHash.find(filename);
@@ -271,19 +208,68 @@ namespace dxvk {
     }
 
   private:
+    bool readAt(uint64_t offset, void* out, size_t size);
+    bool mapFile();
+    void unmapFile();
+    BlobStatus verifyBlob(uint32_t idx);
+
     std::string m_filename;
+    bool m_useFileMapping = true;
+    bool m_verifyChecksums = true;
     FILE* m_handle = nullptr;
+    dxvk::mutex m_handleMutex;
+
+    void* m_mapping = nullptr;
+    uint64_t m_fileSize = 0;
 
+    uint32_t m_version = 0;
     uint32_t m_assetCount = 0;
     uint32_t m_blobCount = 0;
 
     std::unique_ptr<uint8_t[]> m_metadata;
+    std::unique_ptr<std::atomic<BlobStatus>[]> m_blobStatus;
     std::unordered_map<std::string, uint32_t> m_nameHash;
   };
 
-} // namespace dxvk
+  // Writes asset packages of the current version, with blob checksums
+  class AssetPackageWriter {
+  public:
+    /**
+     * \brief Add a data blob
+     *
+     * \param [in] data Blob bytes as stored in the package
+     * \param [in] size Blob size in bytes
+     * \param [in] compression Compression method, 0 for none
+     * \returns Index of the new blob
+     */
+    uint32_t addBlob(const void* data, uint32_t size, uint8_t compression = 0);
+
+    /**
+     * \brief Add an asset
+     *
+     * The name index of the description is overwritten, blob
+     * indices must refer to blobs added to this writer.
+     * \param [in] name Asset file name used for lookups
+     * \param [in] desc Asset description
+     * \returns Index of the new asset
+     */
+    uint32_t addAsset(const std::string& name, const AssetPackage::AssetDesc& desc);
+
+    /**
+     * \brief Write the package file
+     *
+     * \param [in] filename Output file name
+     * \param [in] version Package version, versions before
+     *    AssetPackage::kChecksumVersion get no checksums
+     * \returns \c true on success
+     */
+    bool write(const std::string& filename, uint32_t version = AssetPackage::kVersion) const;
+
+  private:
+    std::vector<uint8_t> m_data;
+    std::vector<AssetPackage::AssetDesc> m_assets;
+    std::vector<AssetPackage::BlobDesc> m_blobs;
+    std::vector<std::string> m_names;
+  };
 
-#undef fseek64
-#ifndef WIN32
-#undef fopen_s
-#endif
+} // namespace dxvk
@@ -26,6 +26,7 @@
 #include "rtx_mod_manager.h"
 #include "rtx_utils.h"
 #include "rtx_lights_data.h"
+#include "../../util/util_concurrent_cache.h"
 
 namespace dxvk {
   class DxvkContext;
@@ -82,48 +83,38 @@ namespace dxvk {
 
   // Asset replacements storage class.
   // Contains and owns the replacements, material and geometry objects.
+  // Lookups are wait-free, so the renderer never stalls on a mod
+  // being loaded into the same storage on another thread.
   class AssetReplacements {
   public:
     // Returns a pointer to replacements of type T for a given hash value,
     // or a nullptr if no replacements found.
     template<AssetReplacement::Type T>
     std::vector<AssetReplacement>* get(XXH64_hash_t hash) {
-      std::lock_guard<sync::Spinlock> lock(m_spinlock);
       auto& map = T == AssetReplacement::eMesh ? m_meshReplacers : m_lightReplacers;
-      auto it = map.find(hash);
-      if (it != map.end()) {
-        return &it->second;
-      }
-      return nullptr;
+      return map.find(hash);
     }
 
     // Stores replacements of type T for a hash value.
     template<AssetReplacement::Type T>
     void set(XXH64_hash_t hash, std::vector<AssetReplacement>&& v) {
-      std::lock_guard<sync::Spinlock> lock(m_spinlock);
       auto& map = T == AssetReplacement::eMesh ? m_meshReplacers : m_lightReplacers;
-      map.emplace(hash, std::move(v));
+      map.try_emplace(hash, std::move(v));
     }
 
     // Returns a pointer to the stored object of type T for a given hash value.
     // Return false if no object was found.
     template<typename T>
     bool getObject(XXH64_hash_t hash, T*& obj) {
-      std::lock_guard<sync::Spinlock> lock(m_spinlock);
+      T* found = nullptr;
       if constexpr (std::is_same_v<T, MaterialData>) {
-        auto it = m_materials.find(hash);
-        if (it != m_materials.end()) {
-          obj = &it->second;
-          return true;
-        }
-        return false;
+        found = m_materials.find(hash);
       } else if constexpr (std::is_same_v<T, MeshReplacement>) {
-        auto it = m_geometries.find(hash);
-        if (it != m_geometries.end()) {
-          obj = &it->second;
-          return true;
-        }
-        return false;
+        found = m_geometries.find(hash);
+      }
+      if (found != nullptr) {
+        obj = found;
+        return true;
       }
       return false;
     }
@@ -131,12 +122,12 @@ namespace dxvk {
     // Stores the object of type T for a hash value.
     template<typename T>
     T& storeObject(XXH64_hash_t hash, T&& obj) {
-      std::lock_guard<sync::Spinlock> lock(m_spinlock);
       if constexpr (std::is_same_v<T, MaterialData>) {
-        return m_materials.try_emplace(hash, std::move(obj)).first->second;
+        return *m_materials.try_emplace(hash, std::move(obj)).first;
       } else if constexpr (std::is_same_v<T, MeshReplacement>) {
-        return m_geometries.try_emplace(hash, std::move(obj)).first->second;
+        return *m_geometries.try_emplace(hash, std::move(obj)).first;
       } else {
+        std::lock_guard<sync::Spinlock> lock(m_secretSpinlock);
         return m_secretReplacements[hash].emplace_back(obj);
       }
     }
@@ -144,23 +135,24 @@ namespace dxvk {
     // Removes the object of type T for a hash value.
     template<typename T>
     void removeObject(XXH64_hash_t hash) {
-      std::lock_guard<sync::Spinlock> lock(m_spinlock);
       if constexpr (std::is_same_v<T, MaterialData>) {
         m_materials.erase(hash);
       } else if constexpr (std::is_same_v<T, MeshReplacement>) {
         m_geometries.erase(hash);
       } else {
+        std::lock_guard<sync::Spinlock> lock(m_secretSpinlock);
         m_secretReplacements.erase(hash);
       }
     }
 
     // Destroys all replacements and stored objects.
+    // Must not be called while other threads access the storage.
     void clear() {
-      std::lock_guard<sync::Spinlock> lock(m_spinlock);
       m_meshReplacers.clear();
       m_lightReplacers.clear();
       m_materials.clear();
       m_geometries.clear();
+      std::lock_guard<sync::Spinlock> lock(m_secretSpinlock);
       m_secretReplacements.clear();
     }
 
@@ -169,19 +161,18 @@ namespace dxvk {
     }
 
   private:
-    mutable sync::Spinlock m_spinlock;
-
     // Replacements ready to be fed to the renderer
-    fast_unordered_cache<std::vector<AssetReplacement>> m_meshReplacers;
-    fast_unordered_cache<std::vector<AssetReplacement>> m_lightReplacers;
+    concurrent_fast_cache<std::vector<AssetReplacement>> m_meshReplacers;
+    concurrent_fast_cache<std::vector<AssetReplacement>> m_lightReplacers;
 
     // Replacement geometry storage
-    fast_unordered_cache<MeshReplacement> m_geometries;
+    concurrent_fast_cache<MeshReplacement> m_geometries;
 
     // Replacement material storage
-    fast_unordered_cache<MaterialData> m_materials;
+    concurrent_fast_cache<MaterialData> m_materials;
 
     // Secret replacements if any
+    mutable sync::Spinlock m_secretSpinlock;
     SecretReplacements m_secretReplacements;
   };
 
@@ -29,9 +29,12 @@
 
 #include "../shaders/rtx/pass/common_binding_indices.h"
 #include "../dxvk_descriptor.h"
+#include "../../util/log/metrics.h"
 
 namespace dxvk {
 
+  static MetricCounter s_descriptorWritesMetric("bindless.descriptor_writes");
+
   BindlessResourceManager::BindlessResourceManager(DxvkDevice* device)
   : CommonDeviceObject(device) { 
     for (int i = 0; i < kMaxFramesInFlight; i++) {
@@ -64,52 +67,49 @@ namespace dxvk {
     // Increment
     m_globalBindlessDescSetIdx = nextIdx();
 
+    uint32_t numDescriptorsWritten = 0;
+
     // Textures
     {
-      std::vector<VkDescriptorImageInfo> imageInfo(rtTextures.size());
+      m_imageInfos.resize(rtTextures.size());
+      m_resources.resize(rtTextures.size());
 
       uint32_t idx = 0;
       for (auto&& texRef : rtTextures) {
         DxvkImageView* imageView = texRef.getImageView();
 
         if (imageView != nullptr) {
-          imageInfo[idx].sampler = nullptr;
-          imageInfo[idx].imageView = imageView->handle();
-          imageInfo[idx].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+          m_imageInfos[idx].sampler = nullptr;
+          m_imageInfos[idx].imageView = imageView->handle();
+          m_imageInfos[idx].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
           ctx->getCommandList()->trackResource<DxvkAccess::Read>(imageView);
         } else {
-          imageInfo[idx] = m_device->getCommon()->dummyResources().imageViewDescriptor(VK_IMAGE_VIEW_TYPE_2D, true);
+          m_imageInfos[idx] = m_device->getCommon()->dummyResources().imageViewDescriptor(VK_IMAGE_VIEW_TYPE_2D, true);
         }
+        m_resources[idx] = imageView;
 
         ++idx;
       }
 
       assert(idx <= kMaxBindlessResources);
 
-      VkWriteDescriptorSet descWrites;
-      descWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descWrites.pNext = nullptr;
-      descWrites.dstSet = 0;//  This will be filled in by the BindlessTable 
-      descWrites.dstBinding = 0;
-      descWrites.dstArrayElement = 0;
-      descWrites.descriptorCount = idx;
-      descWrites.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-      descWrites.pImageInfo = &imageInfo[0];
-      descWrites.pBufferInfo = nullptr;
-      descWrites.pTexelBufferView = nullptr;
-      m_tables[Table::Textures][currentIdx()]->updateDescriptors(descWrites);
+      numDescriptorsWritten += m_tables[Table::Textures][currentIdx()]->updateDescriptors(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_imageInfos.data(), nullptr, m_resources.data(), idx);
     }
 
     // Buffers
     {
+      m_bufferInfos.resize(rtBuffers.size());
+      m_resources.resize(rtBuffers.size());
+
       uint32_t idx = 0;
-      std::vector<VkDescriptorBufferInfo> bufferInfo(rtBuffers.size());
       for (auto&& bufRef : rtBuffers) {
         if (bufRef.defined()) {
-          bufferInfo[idx] = bufRef.getDescriptor().buffer;
+          m_bufferInfos[idx] = bufRef.getDescriptor().buffer;
+          m_resources[idx] = bufRef.buffer().ptr();
           ctx->getCommandList()->trackResource<DxvkAccess::Read>(bufRef.buffer());
         } else {
-          bufferInfo[idx] = m_device->getCommon()->dummyResources().bufferDescriptor();
+          m_bufferInfos[idx] = m_device->getCommon()->dummyResources().bufferDescriptor();
+          m_resources[idx] = nullptr;
         }
 
         ++idx;
@@ -117,53 +117,36 @@ namespace dxvk {
 
       assert(idx <= kMaxBindlessResources);
 
-      VkWriteDescriptorSet descWrites;
-      descWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descWrites.pNext = nullptr;
-      descWrites.dstSet = 0;//  This will be filled in by the BindlessTable 
-      descWrites.dstBinding = 0;
-      descWrites.dstArrayElement = 0;
-      descWrites.descriptorCount = idx;
-      descWrites.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-      descWrites.pImageInfo = nullptr;
-      descWrites.pBufferInfo = &bufferInfo[0];
-      descWrites.pTexelBufferView = nullptr;
-      m_tables[Table::Buffers][currentIdx()]->updateDescriptors(descWrites);
+      numDescriptorsWritten += m_tables[Table::Buffers][currentIdx()]->updateDescriptors(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nullptr, m_bufferInfos.data(), m_resources.data(), idx);
     }
 
     // Samplers
     {
-      std::vector<VkDescriptorImageInfo> imageInfo(samplers.size());
+      m_imageInfos.resize(samplers.size());
+      m_resources.resize(samplers.size());
 
       uint32_t idx = 0;
       for (auto&& sampler : samplers) {
         if (sampler != nullptr) {
-          imageInfo[idx].sampler = sampler->handle();
-          imageInfo[idx].imageView = nullptr;
+          m_imageInfos[idx].sampler = sampler->handle();
+          m_imageInfos[idx].imageView = nullptr;
+          m_imageInfos[idx].imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
           ctx->getCommandList()->trackResource<DxvkAccess::Read>(sampler);
         } else {
-          imageInfo[idx] = m_device->getCommon()->dummyResources().samplerDescriptor();
+          m_imageInfos[idx] = m_device->getCommon()->dummyResources().samplerDescriptor();
         }
+        m_resources[idx] = sampler.ptr();
 
         ++idx;
       }
 
       assert(idx <= kMaxBindlessSamplers);
 
-      VkWriteDescriptorSet descWrites;
-      descWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descWrites.pNext = nullptr;
-      descWrites.dstSet = 0;//  This will be filled in by the BindlessTable 
-      descWrites.dstBinding = 0;
-      descWrites.dstArrayElement = 0;
-      descWrites.descriptorCount = idx;
-      descWrites.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-      descWrites.pImageInfo = &imageInfo[0];
-      descWrites.pBufferInfo = nullptr;
-      descWrites.pTexelBufferView = nullptr;
-      m_tables[Table::Samplers][currentIdx()]->updateDescriptors(descWrites);
+      numDescriptorsWritten += m_tables[Table::Samplers][currentIdx()]->updateDescriptors(VK_DESCRIPTOR_TYPE_SAMPLER, m_imageInfos.data(), nullptr, m_resources.data(), idx);
     }
 
+    s_descriptorWritesMetric.add(numDescriptorsWritten);
+
     m_frameLastUpdated = m_device->getCurrentFrameId();
   }
 
@@ -206,22 +189,80 @@ namespace dxvk {
       throw DxvkError("BindlessTable: Failed to create descriptor set layout");
   }
 
-  void BindlessResourceManager::BindlessTable::updateDescriptors(VkWriteDescriptorSet& set) {
+  uint32_t BindlessResourceManager::BindlessTable::updateDescriptors(const VkDescriptorType type, const VkDescriptorImageInfo* pImageInfo, const VkDescriptorBufferInfo* pBufferInfo,
+                                                                    DxvkResource* const* ppResources, const uint32_t count) {
     if (bindlessDescSet == nullptr) {
       // Allocate the descriptor set
       bindlessDescSet = m_pManager->m_globalBindlessPool[m_pManager->currentIdx()]->alloc(layout, "bindless descriptor set");
       if (bindlessDescSet == nullptr) {
-        Logger::err(str::format("BindlessTable: failed to allocate a descriptor set for ", set.descriptorCount, " ",
-                                (set.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) ? "buffers" : "textures"));
-        return;
+        Logger::err(str::format("BindlessTable: failed to allocate a descriptor set for ", count, " ",
+                                (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) ? "buffers" : "textures"));
+        return 0;
+      }
+    }
+
+    // Shaders don't index past the end of the table, so slots dropped off the end are left as they are
+    // in the set, but their resources are let go of and they count as changed should the table regrow
+    const uint32_t numWritten = std::min(count, static_cast<uint32_t>(m_writtenResources.size()));
+    m_writtenResources.resize(count);
+    if (pImageInfo != nullptr)
+      m_writtenImageInfos.resize(count);
+    else
+      m_writtenBufferInfos.resize(count);
+
+    // Rewriting a few unchanged slots is cheaper than starting another write
+    constexpr uint32_t kMaxUnchangedRun = 16;
+
+    m_writes.clear();
+    uint32_t numDescriptors = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+      bool changed = i >= numWritten || m_writtenResources[i].ptr() != ppResources[i];
+
+      if (pImageInfo != nullptr) {
+        const VkDescriptorImageInfo& written = m_writtenImageInfos[i];
+        changed |= written.sampler != pImageInfo[i].sampler || written.imageView != pImageInfo[i].imageView || written.imageLayout != pImageInfo[i].imageLayout;
+      } else {
+        const VkDescriptorBufferInfo& written = m_writtenBufferInfos[i];
+        changed |= written.buffer != pBufferInfo[i].buffer || written.offset != pBufferInfo[i].offset || written.range != pBufferInfo[i].range;
+      }
+
+      if (!changed)
+        continue;
+
+      m_writtenResources[i] = ppResources[i];
+      if (pImageInfo != nullptr)
+        m_writtenImageInfos[i] = pImageInfo[i];
+      else
+        m_writtenBufferInfos[i] = pBufferInfo[i];
+
+      if (!m_writes.empty() && i - (m_writes.back().dstArrayElement + m_writes.back().descriptorCount) <= kMaxUnchangedRun) {
+        // Extend the previous write up to this slot
+        numDescriptors += i + 1 - (m_writes.back().dstArrayElement + m_writes.back().descriptorCount);
+        m_writes.back().descriptorCount = i + 1 - m_writes.back().dstArrayElement;
+        continue;
       }
+
+      // Writes read from the copy of what was written, which holds the unchanged slots a write spans as well
+      VkWriteDescriptorSet& descWrite = m_writes.emplace_back();
+      descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      descWrite.pNext = nullptr;
+      descWrite.dstSet = bindlessDescSet;
+      descWrite.dstBinding = 0;
+      descWrite.dstArrayElement = i;
+      descWrite.descriptorCount = 1;
+      descWrite.descriptorType = type;
+      descWrite.pImageInfo = pImageInfo != nullptr ? &m_writtenImageInfos[i] : nullptr;
+      descWrite.pBufferInfo = pImageInfo == nullptr ? &m_writtenBufferInfos[i] : nullptr;
+      descWrite.pTexelBufferView = nullptr;
+      ++numDescriptors;
     }
 
-    // Update the write descriptor with our set
-    set.dstSet = bindlessDescSet;
+    // Do the writes
+    if (!m_writes.empty())
+      vkd()->vkUpdateDescriptorSets(vkd()->device(), m_writes.size(), m_writes.data(), 0, nullptr);
 
-    // Do the write
-    vkd()->vkUpdateDescriptorSets(vkd()->device(), 1, &set, 0, nullptr);
+    return numDescriptors;
   }
 
   void BindlessResourceManager::createGlobalBindlessDescPool() {
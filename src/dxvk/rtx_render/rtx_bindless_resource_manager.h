@@ -66,12 +66,23 @@ namespace dxvk {
       VkDescriptorSet bindlessDescSet = VK_NULL_HANDLE;
 
       void createLayout(const VkDescriptorType type);
-      void updateDescriptors(VkWriteDescriptorSet& set);
+
+      // Writes the slots whose descriptor differs from what was last written to this set, either pImageInfo
+      // or pBufferInfo is expected to hold count descriptors.  Returns the number of descriptors written.
+      uint32_t updateDescriptors(const VkDescriptorType type, const VkDescriptorImageInfo* pImageInfo, const VkDescriptorBufferInfo* pBufferInfo,
+                                 DxvkResource* const* ppResources, const uint32_t count);
 
     private:
       const Rc<vk::DeviceFn> vkd() const;
 
       BindlessResourceManager* m_pManager = nullptr;
+
+      // What each slot of the set was last written with.  The resources are referenced to keep their handles
+      // from being destroyed and reused by another object while the set still points at them.
+      std::vector<VkDescriptorImageInfo> m_writtenImageInfos;
+      std::vector<VkDescriptorBufferInfo> m_writtenBufferInfos;
+      std::vector<Rc<DxvkResource>> m_writtenResources;
+      std::vector<VkWriteDescriptorSet> m_writes;
     };
 
     // Persistent desc pool, our sets can be updated after bind (should be no need to reset this pool)
@@ -82,6 +93,11 @@ namespace dxvk {
     uint32_t m_globalBindlessDescSetIdx = 0;
     uint32_t m_frameLastUpdated = UINT_MAX;
 
+    // Scratch memory for gathering the descriptors of a table, reused across frames
+    std::vector<VkDescriptorImageInfo> m_imageInfos;
+    std::vector<VkDescriptorBufferInfo> m_bufferInfos;
+    std::vector<DxvkResource*> m_resources;
+
 
     uint32_t currentIdx() const {
       return m_globalBindlessDescSetIdx;
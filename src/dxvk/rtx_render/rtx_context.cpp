@@ -67,6 +67,11 @@ namespace dxvk {
 
   Metrics Metrics::s_instance;
 
+  static MetricGauge s_frameTimeMetric("frame.time_ms");
+  static MetricGauge s_gpuIdleTimeMetric("frame.gpu_idle_ms");
+  static MetricGauge s_vidMemoryUsageMetric("memory.vid_usage_mb");
+  static MetricGauge s_sysMemoryUsageMetric("memory.sys_usage_mb");
+
   void RtxContext::takeScreenshot(std::string imageName, Rc<DxvkImage> image) {
     // NOTE: Improve this, I'd like all textures from the same frame to have the same time code...  Currently sampling the time on each "dump op" results in different timecodes.
     auto t = std::time(nullptr);
@@ -624,6 +629,13 @@ namespace dxvk {
     }
     Metrics::log(Metric::vid_memory_usage, static_cast<float>(vidUsageMib)); // In MB
     Metrics::log(Metric::sys_memory_usage, static_cast<float>(sysUsageMib)); // In MB
+
+    s_frameTimeMetric.set(frameTimeSecs * 1000);
+    s_gpuIdleTimeMetric.set(gpuIdleTimeSecs * 1000);
+    s_vidMemoryUsageMetric.set(static_cast<double>(vidUsageMib));
+    s_sysMemoryUsageMetric.set(static_cast<double>(sysUsageMib));
+
+    Metrics::endFrame(m_device->getCurrentFrameId());
   }
 
   void RtxContext::setConstantBuffers(const uint32_t vsFixedFunctionConstants, Rc<DxvkBuffer> vertexCaptureCB) {
@@ -50,7 +50,7 @@ DrawCallCache::CacheState DrawCallCache::get(const DrawCallState& drawCall, Blas
   // First, find the right bucket:
   const XXH64_hash_t hash = drawCall.getGeometryData().getHashForRule<rules::TopologicalHash>();
   auto range = m_entries.equal_range(hash);
-  if (range.first == m_entries.end()) {
+  if (range.first == range.second) {
     // New bucket
     *out = allocateEntry(hash, drawCall);
     return CacheState::kNew;
@@ -127,7 +127,7 @@ DrawCallCache::CacheState DrawCallCache::get(const DrawCallState& drawCall, Blas
 }
 
 BlasEntry* DrawCallCache::allocateEntry(XXH64_hash_t hash, const DrawCallState& drawCall) {
-  auto& iter = m_entries.emplace(hash, drawCall);
+  auto iter = m_entries.emplace(hash, drawCall);
   BlasEntry* result = &iter->second;
   result->frameCreated = m_device->getCurrentFrameId();
   return result;
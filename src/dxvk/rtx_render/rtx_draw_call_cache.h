@@ -23,8 +23,8 @@
 
 #include <vector>
 #include <limits>
-#include <unordered_map>
 
+#include "../util/util_fast_cache.h"
 #include "../util/util_vector.h"
 #include "dxvk_scoped_annotation.h"
 
@@ -37,10 +37,10 @@ namespace dxvk
 class DxvkDevice;
 
 // A cache of the BlasEntries across frames.  This maintains stable BlasEntry pointers until that BlasEntry
-// is erased by sceneManager's garbage collection.
+// is erased by sceneManager's garbage collection (the flat cache keeps its values in a separate node slab).
 class DrawCallCache : public CommonDeviceObject {
 public:
-  using MultimapType = std::unordered_multimap<XXH64_hash_t, BlasEntry, XXH64_hash_passthrough>;
+  using MultimapType = fast_unordered_multicache<BlasEntry>;
 
   enum class CacheState
   {
@@ -49,7 +49,9 @@
 #include "rtx_matrix_helpers.h"
 #include "rtx_lights.h"
 
+#include <algorithm>
 #include <filesystem>
+#include <iterator>
 
 #define BASE_DIR (std::string(GameCapturer::s_baseDir))
 
@@ -416,6 +418,7 @@ namespace dxvk {
         m_cap.meshes[meshHash] = std::make_shared<Mesh>();
         m_cap.meshes[meshHash]->instanceCount = 0;
         m_cap.meshes[meshHash]->matHash = matHash;
+        m_cap.meshes[meshHash]->meshSync.pCompletion = m_cap.pMeshCompletion;
       }
       instanceNum = m_cap.meshes[meshHash]->instanceCount++;
     }
@@ -835,7 +838,7 @@ namespace dxvk {
                                                   pxr::VtArray<T>& newBuffer,
                                                   const float currentFrameNum,
                                                   CompareTReturnBool compareT) {
-    std::lock_guard lock(pMesh->meshSync.mutex);
+    std::unique_lock lock(pMesh->meshSync.mutex);
     // Discover whether the new buffer is worth cacheing
     bool bSufficientlyDifferent = false;
     if (bufferCache.size() > 0) {
@@ -857,8 +860,11 @@ namespace dxvk {
     if (bSufficientlyDifferent) {
       bufferCache[currentFrameNum] = std::move(newBuffer);
     }
-    pMesh->meshSync.numOutstanding--;
-    pMesh->meshSync.cond.notify_all();
+    const bool bComplete = --pMesh->meshSync.numOutstanding == 0;
+    lock.unlock();
+    if (bComplete) {
+      pMesh->meshSync.pCompletion->signal();
+    }
   }
 
   void GameCapturer::exportUsd(const Rc<DxvkContext> ctx) {
@@ -868,19 +874,25 @@ namespace dxvk {
     static auto exportThreadTask = [this](const Rc<DxvkContext> ctx,
                                           Capture cap,
                                           State* pState,
+                                          lss::ExportProgress* pProgress,
                                           CompletedCapture* complete,
                                           const float framesPerSecond,
                                           const bool bUseLssUsdPlugins) {
-      m_exporter.waitForAllExportsToComplete();
       assert(pState->has<State::PreppingExport>());
       const auto exportPrep = prepExport(cap, framesPerSecond, bUseLssUsdPlugins);
+      pProgress->numAssets = exportPrep.materials.size() + cap.meshes.size();
       pState->set<State::PreppingExport, false>();
       pState->set<State::Exporting, true>();
 
+      // Meshes are handed to the exporter as their buffers come back from the GPU,
+      // so their layers get written while the remaining readbacks are still in flight
       Logger::info("[GameCapturer][" + cap.idStr + "] Begin USD export");
-      lss::GameExporter::exportUsd(exportPrep);
+      lss::GameExporter::exportUsd(exportPrep, prepExportMeshSource(cap, pProgress), cap.meshes.size(), pProgress);
       Logger::info("[GameCapturer][" + cap.idStr + "] End USD export");
 
+      // Layers only refer to the texture files, so those just need to be done by the time the capture is
+      m_exporter.waitForAllExportsToComplete();
+
       // Necessary step for being able to properly diff and check for regressions
       const auto flattenCaptureEnvStr = env::getEnvVar("DXVK_CAPTURE_FLATTEN");
       if (!flattenCaptureEnvStr.empty()) {
@@ -895,10 +907,13 @@ namespace dxvk {
 
     m_state.set<State::PreppingExport, true>();
     m_state.set<State::BeginExport, false>();
+    m_exportProgress.numAssets = 0;
+    m_exportProgress.numAssetsExported = 0;
     std::thread(exportThreadTask,
                 ctx,
                 std::move(m_cap),
                 &m_state,
+                &m_exportProgress,
                 &m_completeCapture,
                 static_cast<float>(m_options.fps),
                 m_bUseLssUsdPlugins).detach();
@@ -911,7 +926,6 @@ namespace dxvk {
     lss::Export exportPrep;
     prepExportMetaData(cap, framesPerSecond, bUseLssUsdPlugins, exportPrep);
     prepExportMaterials(cap, exportPrep);
-    prepExportMeshes(cap, exportPrep);
     if (exportPrep.bExportInstanceStage) {
       prepExportInstances(cap, exportPrep);
       prepExportLights(cap, exportPrep);
@@ -959,21 +973,55 @@ namespace dxvk {
     }
   }
 
-  void GameCapturer::prepExportMeshes(const Capture& cap,
-                                      lss::Export& exportPrep) {
-    for (auto& [hash, pMesh] : cap.meshes) {
-      std::unique_lock lock(pMesh->meshSync.mutex);
-      pMesh->meshSync.cond.wait(lock,
-        [pNumOutstanding = &pMesh->meshSync.numOutstanding] { return *pNumOutstanding == 0; });
-      auto& exportMesh = exportPrep.meshes[hash];
-      if (pMesh->lssData.numIndices == 0 && pMesh->lssData.numVertices == 0) {
-        continue;
-      }
-      if (cap.materials.count(pMesh->matHash) > 0) {
-        pMesh->lssData.matId = pMesh->matHash;
+  std::function<bool(lss::Id&, const lss::Mesh*&)> GameCapturer::prepExportMeshSource(const Capture& cap,
+                                                                                      lss::ExportProgress* pProgress) {
+    std::vector<std::pair<XXH64_hash_t, std::shared_ptr<Mesh>>> pendingMeshes(cap.meshes.cbegin(), cap.meshes.cend());
+    std::vector<std::pair<XXH64_hash_t, std::shared_ptr<Mesh>>> readyMeshes;
+    const auto* pMaterials = &cap.materials;
+    return [pendingMeshes = std::move(pendingMeshes), readyMeshes = std::move(readyMeshes), pMaterials,
+            pCompletion = cap.pMeshCompletion, pProgress]
+           (lss::Id& meshId, const lss::Mesh*& pLssMesh) mutable {
+      while (!readyMeshes.empty() || !pendingMeshes.empty()) {
+        if (readyMeshes.empty()) {
+          // Taken before the sweep, so a mesh completing while it runs still wakes the wait below
+          size_t numCompleted;
+          {
+            std::lock_guard lock(pCompletion->mutex);
+            numCompleted = pCompletion->numCompleted;
+          }
+          // Move every mesh whose buffers have all arrived over in one sweep, so that
+          // meshes are scanned again only once the exporter has run out of ready ones
+          const auto isReady = [](const auto& hashAndMesh) {
+            std::lock_guard lock(hashAndMesh.second->meshSync.mutex);
+            return hashAndMesh.second->meshSync.numOutstanding == 0;
+          };
+          auto firstPending = std::stable_partition(pendingMeshes.begin(), pendingMeshes.end(), isReady);
+          readyMeshes.assign(std::make_move_iterator(pendingMeshes.begin()), std::make_move_iterator(firstPending));
+          pendingMeshes.erase(pendingMeshes.begin(), firstPending);
+          if (readyMeshes.empty()) {
+            // Wait for whichever mesh completes first, then sweep again
+            std::unique_lock lock(pCompletion->mutex);
+            pCompletion->cond.wait(lock, [&] { return pCompletion->numCompleted != numCompleted; });
+            continue;
+          }
+        }
+        auto [hash, pMesh] = std::move(readyMeshes.back());
+        readyMeshes.pop_back();
+        if (pMesh->lssData.numIndices == 0 && pMesh->lssData.numVertices == 0) {
+          // Counted in numAssets, so count it as done for the progress to reach the total
+          ++pProgress->numAssetsExported;
+          continue;
+        }
+        if (pMaterials->count(pMesh->matHash) > 0) {
+          pMesh->lssData.matId = pMesh->matHash;
+        }
+        // The capture owns the mesh until the export thread is done with it
+        meshId = hash;
+        pLssMesh = &pMesh->lssData;
+        return true;
       }
-      exportMesh = pMesh->lssData;
-    }
+      return false;
+    };
   }
 
   void GameCapturer::prepExportInstances(const Capture& cap,
@@ -31,6 +31,7 @@
 #include "../../util/xxHash/xxhash.h"
 #include "../imgui/dxvk_imgui.h"
 
+#include <functional>
 #include <vector>
 #include <unordered_map>
 #include <mutex>
@@ -97,6 +98,9 @@ public:
   const CompletedCapture& queryCompleteCapture() const {
     return m_completeCapture;
   }
+  const lss::ExportProgress& getExportProgress() const {
+    return m_exportProgress;
+  }
 
   static const std::string s_baseDir;
 
@@ -116,12 +120,19 @@ private:
     lss::Material lssData;
   };
 
+  // Counts the meshes of a capture whose buffers have all arrived, so the export can wait for whichever completes first
+  struct MeshCompletion {
+    size_t                   numCompleted = 0;
+    dxvk::mutex              mutex;
+    dxvk::condition_variable cond;
+    void signal() { { std::lock_guard lock(mutex); numCompleted++; } cond.notify_all(); }
+  };
+
   struct MeshSync {
     size_t                  numOutstanding = 0;
     dxvk::mutex              mutex;
-    dxvk::condition_variable cond;
+    std::shared_ptr<MeshCompletion> pCompletion;
     void numOutstandingInc() { std::lock_guard lock(mutex); numOutstanding++; }
-    void numOutstandingDec() { { std::lock_guard lock(mutex); numOutstanding--; } cond.notify_all(); }
   };
 
   struct Mesh {
@@ -203,8 +214,8 @@ private:
                                  lss::Export& exportPrep);
   static void prepExportMaterials(const Capture& cap,
                                   lss::Export& exportPrep);
-  static void prepExportMeshes(const Capture& cap,
-                               lss::Export& exportPrep);
+  static std::function<bool(lss::Id&, const lss::Mesh*&)> prepExportMeshSource(const Capture& cap,
+                                                                                lss::ExportProgress* pProgress);
   static void prepExportInstances(const Capture& cap,
                                   lss::Export& exportPrep);
   static void prepExportLights(const Capture& cap,
@@ -251,6 +262,7 @@ private:
   // State
   bool m_bTriggerCapture = false;
   State m_state;
+  lss::ExportProgress m_exportProgress;
   
   // Constants
   const bool m_bUseLssUsdPlugins;
@@ -277,6 +289,7 @@ private:
     std::unordered_map<XXH64_hash_t, lss::SphereLight> sphereLights;
     std::unordered_map<XXH64_hash_t, lss::DistantLight> distantLights;
     std::unordered_map<XXH64_hash_t, std::shared_ptr<Mesh>> meshes;
+    std::shared_ptr<MeshCompletion> pMeshCompletion = std::make_shared<MeshCompletion>();
     std::unordered_map<XXH64_hash_t, Material> materials;
     std::unordered_map<XXH64_hash_t, Instance> instances;
     std::unordered_map<XXH64_hash_t, uint8_t> instanceFlags;
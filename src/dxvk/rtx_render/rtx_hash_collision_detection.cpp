@@ -26,74 +26,63 @@
 
 namespace dxvk {
 
-  static constexpr char* HashSourceDataCategoryName[HashSourceDataCategory::Count] = {
-    "OpacityMicromap",
-  };
+  namespace {
+    dxvk::mutex s_validatorMutex;
+    std::atomic<HashSourceDataValidator*> s_validator = nullptr;
 
-
-  HashSourceDataCache::~HashSourceDataCache() {
-    release();
-  }
-
-  void HashSourceDataCache::release(HashSourceDataCategory category) {
-    for (auto& cacheItem : m_hashSourceDataCaches[static_cast<uint8_t>(category)]) {
-      free(cacheItem.second);
+    size_t getMemoryBudget() {
+      return static_cast<size_t>(HashCollisionDetectionOptions::memoryBudgetMB()) << 20;
     }
   }
 
-  void HashSourceDataCache::release() {
-    for (uint8_t i = 0; i < static_cast<uint8_t>(HashSourceDataCategory::Count); i++) {
-      release(static_cast<HashSourceDataCategory>(i));
+  HashSourceDataValidator* HashCollisionDetection::getValidator() {
+    HashSourceDataValidator* validator = s_validator.load(std::memory_order_acquire);
+
+    if (validator == nullptr) {
+      std::lock_guard lock(s_validatorMutex);
+
+      validator = s_validator.load(std::memory_order_relaxed);
+      if (validator == nullptr) {
+        validator = new HashSourceDataValidator(getMemoryBudget());
+        validator->start();
+        s_validator.store(validator, std::memory_order_release);
+      }
     }
+
+    validator->setMemoryBudget(getMemoryBudget());
+    return validator;
   }
 
-  fast_unordered_cache<void*>& HashSourceDataCache::getCache(HashSourceDataCategory category) {
-    return m_hashSourceDataCaches[static_cast<uint8_t>(category)];
+  void HashCollisionDetection::shutdown() {
+    std::lock_guard lock(s_validatorMutex);
+    delete s_validator.exchange(nullptr);
   }
 
   uint32_t HashCollisionDetection::getHashSourceDataSize(HashSourceDataCategory category) {
     switch (category) {
     case HashSourceDataCategory::OpacityMicromap: return sizeof(OpacityMicromapHashSourceData);
     default:
-      assert(!"Invalid category specified.");
+      assert(!"Category has no fixed source data size.");
       return 0;
     }
   }
 
-  void HashCollisionDetection::registerHashedSourceData(XXH64_hash_t hash, void* hashSourceData, HashSourceDataCategory category) {
-    if (!HashCollisionDetectionOptions::enable()) {
-      return;
-    }
-
-    auto bitExactMatch = [](const void* data0, const void* data1, uint32_t dataSize) {
-      return memcmp(data0, data1, dataSize) == 0;
-    };
-
-    std::lock_guard lock(s_cacheAccessMutex);
-    
-    fast_unordered_cache<void*>& cache = s_caches.getCache(category);
-    auto cacheItemIter = cache.find(hash);
-
-    const uint32_t hashSourceDataSize = getHashSourceDataSize(category);
-
-    // Hash is in the cache
-    if (cacheItemIter != cache.end()) {
-      const void* cachedHashSourceData = cacheItemIter->second;
+  void HashCollisionDetection::registerHashedSourceData(XXH64_hash_t hash, const void* hashSourceData, HashSourceDataCategory category) {
+    registerHashedSourceData(hash, hashSourceData, getHashSourceDataSize(category), category);
+  }
 
-      // Validate the source data matches
-      if (!bitExactMatch(hashSourceData, cachedHashSourceData, hashSourceDataSize)) {
-        std::stringstream ssHash;
-        ssHash << "0x" << std::uppercase << std::setfill('0') << std::hex << hash;
+  void HashCollisionDetection::registerHashedSourceData(XXH64_hash_t hash, const void* hashSourceData, size_t size, HashSourceDataCategory category) {
+    registerHashedSourceData(hash, size, category, [hashSourceData, size](SourceDataWriter& writer) {
+      writer.write(hashSourceData, size);
+    });
+  }
 
-        Logger::err(str::format("[RTX Hash Collision Detection] Found a hash collision for hash ", ssHash.str(), " in category ", HashSourceDataCategoryName[static_cast<uint8_t>(category)]));
-      }
-    } 
-    else { // Hash is not in the cache
-      // Insert it
-      void* hashSourceDataCopy = malloc(hashSourceDataSize);
-      memcpy(hashSourceDataCopy, hashSourceData, hashSourceDataSize);
-      cache.insert({ hash, hashSourceDataCopy });
+  HashCollisionDetection::Stats HashCollisionDetection::getStats() {
+    HashSourceDataValidator* validator = s_validator.load(std::memory_order_acquire);
+    if (!HashCollisionDetectionOptions::enable() || validator == nullptr) {
+      return Stats();
     }
+    return validator->getStats();
   }
 
 }  // namespace dxvk
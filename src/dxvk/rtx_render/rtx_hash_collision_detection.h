@@ -23,47 +23,56 @@
 
 #include "rtx_utils.h"
 #include "rtx_option.h"
+#include "rtx_hash_source_validator.h"
 #include "../util/xxHash/xxhash.h"
 
 namespace dxvk {
 
-  enum class HashSourceDataCategory : uint8_t {
-    OpacityMicromap = 0,
-
-    Count
-  };
-
   struct HashCollisionDetectionOptions {
     friend class ImGUI;
 
     RTX_OPTION_ENV("rtx.hashCollisionDetection", bool, enable, false, "RTX_HASH_COLLISION_DETECTION", "Enables hash collision detection.");
-  };
-
-  class HashSourceDataCache {
-  public:
-    ~HashSourceDataCache();
-
-    void release();
-    void release(HashSourceDataCategory category);
-    fast_unordered_cache<void* /*hashSourceData*/>& getCache(HashSourceDataCategory category);
-
-  private:
-    fast_unordered_cache<void* /*hashSourceData*/> m_hashSourceDataCaches[static_cast<uint8_t>(HashSourceDataCategory::Count)];
+    RTX_OPTION("rtx.hashCollisionDetection", uint32_t, memoryBudgetMB, 256,
+               "The memory budget of hash collision detection, in megabytes.\n"
+               "Shared by the source data waiting to be validated and the source data cached for validation. The cache keeps to three quarters of the budget and evicts the least recently seen hashes once full, submissions which do not fit are dropped.");
   };
 
   // Caches hash source data and validates that any future hash source data instances have a matching hash source data for a given hash and a category
   // Expects hash source data to be fully padded and initialized
+  //
+  // Registration only queues the source data, or a 128-bit fingerprint of it for larger sources, the comparison
+  // runs on a background thread, see HashSourceDataValidator.  A collision with a hash that was evicted from the
+  // caches goes unnoticed.
   class HashCollisionDetection {
   public:
-    ~HashCollisionDetection();
+    using Stats = HashSourceDataValidator::Stats;
+    using SourceDataWriter = HashSourceDataValidator::SourceDataWriter;
+
+    // Fixed size source data, sized by category
+    static void registerHashedSourceData(XXH64_hash_t hash, const void* hashSourceData, HashSourceDataCategory category);
+
+    static void registerHashedSourceData(XXH64_hash_t hash, const void* hashSourceData, size_t size, HashSourceDataCategory category);
+
+    // For source data which is not contiguous in memory, writeSourceData(SourceDataWriter&) must write exactly size bytes
+    template<typename F>
+    static void registerHashedSourceData(XXH64_hash_t hash, size_t size, HashSourceDataCategory category, F&& writeSourceData) {
+      if (!HashCollisionDetectionOptions::enable()) {
+        return;
+      }
+
+      getValidator()->submit(hash, size, category, std::forward<F>(writeSourceData));
+    }
+
+    static Stats getStats();
+
+    // Stops the validation thread and frees the caches, must not race with registrations
+    static void shutdown();
 
-    static void registerHashedSourceData(XXH64_hash_t hash, void* hashSourceData, HashSourceDataCategory category);
-  
   private:
     static uint32_t getHashSourceDataSize(HashSourceDataCategory category);
 
-    inline static HashSourceDataCache s_caches;
-    inline static dxvk::mutex s_cacheAccessMutex;
-   };
+    // Started on first use, so nothing runs unless detection gets enabled
+    static HashSourceDataValidator* getValidator();
+  };
 }  // namespace dxvk
 
@@ -0,0 +1,271 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "rtx_hash_source_validator.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "../../util/log/log.h"
+#include "../../util/util_env.h"
+#include "../../util/util_string.h"
+#include "../../util/sync/sync_futex.h"
+
+namespace dxvk {
+
+  namespace {
+    constexpr const char* HashSourceDataCategoryName[static_cast<uint8_t>(HashSourceDataCategory::Count)] = {
+      "OpacityMicromap",
+      "GeometryIndices",
+      "GeometryPositions",
+      "Texture",
+    };
+
+    // The caches keep to this share of the budget, the rest is left for pending submissions
+    size_t getCacheBudget(size_t memoryBudget) {
+      return memoryBudget / 4 * 3;
+    }
+
+    // Fingerprints are computed incrementally, a source written by the caller does not need to be contiguous
+    XXH3_state_t* getFingerprintState() {
+      struct FingerprintState {
+        XXH3_state_t* state = XXH3_createState();
+
+        ~FingerprintState() {
+          XXH3_freeState(state);
+        }
+      };
+
+      static thread_local FingerprintState s_state;
+      return s_state.state;
+    }
+  }
+
+  HashSourceDataValidator::HashSourceDataValidator(size_t memoryBudget)
+    : m_memoryBudget(memoryBudget) {
+  }
+
+  HashSourceDataValidator::~HashSourceDataValidator() {
+    stop();
+  }
+
+  void HashSourceDataValidator::start() {
+    if (m_thread.joinable()) {
+      return;
+    }
+
+    m_stop = false;
+    m_thread = dxvk::thread([this] { run(); });
+  }
+
+  void HashSourceDataValidator::stop() {
+    if (m_thread.joinable()) {
+      m_stop = true;
+      wake();
+      m_thread.join();
+      m_thread = dxvk::thread();
+    }
+
+    Submission* submission = m_submissions.exchange(nullptr, std::memory_order_acquire);
+    while (submission) {
+      Submission* next = submission->next;
+      m_pendingBytes.fetch_sub(getSubmissionCost(*submission), std::memory_order_relaxed);
+      free(submission);
+      submission = next;
+    }
+  }
+
+  HashSourceDataValidator::Submission* HashSourceDataValidator::allocate(XXH64_hash_t hash, size_t size, HashSourceDataCategory category) {
+    m_submitted.fetch_add(1, std::memory_order_relaxed);
+
+    const size_t storedSize = size <= kMaxStoredSourceDataSize ? size : sizeof(XXH128_hash_t);
+    const size_t cost = sizeof(Submission) + storedSize;
+
+    // Drop the submission rather than queue up unbounded memory when validation falls behind
+    const size_t budget = m_memoryBudget.load(std::memory_order_relaxed);
+    const size_t pendingBytes = m_pendingBytes.fetch_add(cost, std::memory_order_relaxed) + cost;
+    if (pendingBytes + m_cachedBytes.load(std::memory_order_relaxed) > budget) {
+      m_pendingBytes.fetch_sub(cost, std::memory_order_relaxed);
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    Submission* submission = static_cast<Submission*>(malloc(cost));
+    submission->next = nullptr;
+    submission->hash = hash;
+    submission->size = size;
+    submission->storedSize = storedSize;
+    submission->category = category;
+    return submission;
+  }
+
+  HashSourceDataValidator::SourceDataWriter HashSourceDataValidator::beginWrite(Submission& submission) {
+    SourceDataWriter writer;
+    writer.m_size = submission.size;
+
+    if (submission.storedSize != submission.size) {
+      writer.m_fingerprintState = getFingerprintState();
+      XXH3_128bits_reset(writer.m_fingerprintState);
+    } else {
+      writer.m_dst = submission.data();
+    }
+
+    return writer;
+  }
+
+  void HashSourceDataValidator::endWrite(Submission& submission, SourceDataWriter& writer) {
+    assert(writer.m_offset == submission.size);
+
+    if (writer.m_fingerprintState != nullptr) {
+      const XXH128_hash_t fingerprint = XXH3_128bits_digest(writer.m_fingerprintState);
+      memcpy(submission.data(), &fingerprint, sizeof(fingerprint));
+    }
+
+    Submission* head = m_submissions.load(std::memory_order_relaxed);
+    do {
+      submission.next = head;
+    } while (!m_submissions.compare_exchange_weak(head, &submission, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+    if (m_sleeping.load()) {
+      wake();
+    }
+  }
+
+  void HashSourceDataValidator::wake() {
+    m_signal.fetch_add(1);
+    sync::futexWakeAll(m_signal);
+  }
+
+  void HashSourceDataValidator::run() {
+    env::setThreadName("rtx-hash-collision-validator");
+
+    while (!m_stop) {
+      Submission* batch = m_submissions.exchange(nullptr, std::memory_order_acquire);
+
+      if (batch == nullptr) {
+        // Producers only wake us while we're flagged as sleeping, so check for work once more after raising the flag
+        const uint32_t signal = m_signal.load();
+        m_sleeping.store(true);
+        if (m_submissions.load() == nullptr && !m_stop) {
+          sync::futexWait(m_signal, signal);
+        }
+        m_sleeping.store(false);
+        continue;
+      }
+
+      processBatch(batch);
+    }
+  }
+
+  void HashSourceDataValidator::processSubmissions() {
+    assert(!m_thread.joinable());
+    processBatch(m_submissions.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  void HashSourceDataValidator::processBatch(Submission* batch) {
+    // The list is last in first out, restore submission order
+    Submission* ordered = nullptr;
+    while (batch) {
+      Submission* next = batch->next;
+      batch->next = ordered;
+      ordered = batch;
+      batch = next;
+    }
+
+    while (ordered) {
+      Submission* next = ordered->next;
+      validate(*ordered);
+      m_pendingBytes.fetch_sub(getSubmissionCost(*ordered), std::memory_order_relaxed);
+      free(ordered);
+      ordered = next;
+    }
+  }
+
+  void HashSourceDataValidator::validate(Submission& submission) {
+    // Top bits pick the shard, the caches index by the low bits
+    Shard& shard = m_shards[submission.hash >> 60];
+    static_assert(kNumShards == 16);
+
+    std::lock_guard lock(shard.mutex);
+
+    auto& entries = shard.entries[static_cast<uint8_t>(submission.category)];
+    auto cacheItemIter = entries.find(submission.hash);
+
+    m_validated.fetch_add(1, std::memory_order_relaxed);
+
+    // Hash is in the cache
+    if (cacheItemIter != entries.end()) {
+      EntryList::iterator entry = cacheItemIter->second;
+      shard.lru.splice(shard.lru.begin(), shard.lru, entry);
+
+      // Validate the source data matches
+      if (entry->size != submission.size || entry->data.size() != submission.storedSize ||
+          memcmp(entry->data.data(), submission.data(), submission.storedSize) != 0) {
+        m_collisions.fetch_add(1, std::memory_order_relaxed);
+
+        // Report each colliding hash once, a colliding asset tends to be seen every frame
+        if (!entry->reported) {
+          entry->reported = true;
+
+          std::stringstream ssHash;
+          ssHash << "0x" << std::uppercase << std::setfill('0') << std::hex << submission.hash;
+
+          Logger::err(str::format("[RTX Hash Collision Detection] Found a hash collision for hash ", ssHash.str(), " in category ", HashSourceDataCategoryName[static_cast<uint8_t>(submission.category)],
+                                  " (source data sizes ", entry->size, " and ", submission.size, ")"));
+        }
+      }
+      return;
+    }
+
+    // Hash is not in the cache, insert it
+    const size_t entryCost = submission.storedSize + kEntryOverhead;
+    shard.lru.push_front(Entry { submission.hash, submission.category, false, submission.size,
+                                 std::vector<uint8_t>(submission.data(), submission.data() + submission.storedSize) });
+    entries.emplace(submission.hash, shard.lru.begin());
+    shard.memoryUsage += entryCost;
+    m_cachedBytes.fetch_add(entryCost, std::memory_order_relaxed);
+
+    // Evict the least recently seen hashes past the shard's share of the cache budget
+    const size_t shardBudget = getCacheBudget(m_memoryBudget.load(std::memory_order_relaxed)) / kNumShards;
+    while (shard.memoryUsage > shardBudget && shard.lru.size() > 1) {
+      const Entry& victim = shard.lru.back();
+      const size_t victimCost = victim.data.size() + kEntryOverhead;
+      shard.memoryUsage -= victimCost;
+      m_cachedBytes.fetch_sub(victimCost, std::memory_order_relaxed);
+      shard.entries[static_cast<uint8_t>(victim.category)].erase(victim.hash);
+      shard.lru.pop_back();
+      m_evicted.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  HashSourceDataValidator::Stats HashSourceDataValidator::getStats() {
+    Stats stats;
+    stats.submitted = m_submitted.load(std::memory_order_relaxed);
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    stats.validated = m_validated.load(std::memory_order_relaxed);
+    stats.collisions = m_collisions.load(std::memory_order_relaxed);
+    stats.evicted = m_evicted.load(std::memory_order_relaxed);
+    stats.pendingBytes = m_pendingBytes.load(std::memory_order_relaxed);
+    stats.cachedBytes = m_cachedBytes.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+}  // namespace dxvk
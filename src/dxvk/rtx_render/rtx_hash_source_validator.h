@@ -0,0 +1,204 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "../../util/thread.h"
+#include "../../util/util_fast_cache.h"
+#include "../../util/xxHash/xxhash.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <list>
+#include <vector>
+
+namespace dxvk {
+
+  enum class HashSourceDataCategory : uint8_t {
+    OpacityMicromap = 0,
+    GeometryIndices,
+    GeometryPositions,
+    Texture,
+
+    Count
+  };
+
+  /**
+   * \brief Hash source data validator
+   *
+   * Checks that all source data submitted for a hash and category matches the first
+   * one seen.  Submissions go into a lock-free list and are compared on a background
+   * thread against caches sharded by hash, which evict the least recently seen hashes.
+   * Small sources are stored as is, larger ones are reduced to a 128-bit fingerprint
+   * by the submitting thread so only the fingerprint is queued.
+   *
+   * Pending and cached source data share one memory budget.  The caches keep to a
+   * share of it so there is always room left to queue submissions, submissions which
+   * do not fit are dropped.
+   */
+  class HashSourceDataValidator {
+    struct Submission;
+
+  public:
+    // Sources up to this size are compared byte for byte, larger ones by fingerprint
+    static constexpr size_t kMaxStoredSourceDataSize = 4 * 1024;
+    static constexpr uint32_t kNumShards = 16;
+    // Rough bookkeeping cost of a cache entry on top of its data
+    static constexpr size_t kEntryOverhead = 96;
+
+    struct Stats {
+      uint64_t submitted = 0;
+      uint64_t dropped = 0;
+      uint64_t validated = 0;
+      uint64_t collisions = 0;
+      uint64_t evicted = 0;
+      size_t pendingBytes = 0;
+      size_t cachedBytes = 0;
+    };
+
+    // Receives the source data of a submission in order, copying it or folding it into the fingerprint
+    class SourceDataWriter {
+    public:
+      void write(const void* data, size_t size) {
+        assert(m_offset + size <= m_size);
+        if (m_fingerprintState != nullptr) {
+          XXH3_128bits_update(m_fingerprintState, data, size);
+        } else {
+          memcpy(m_dst + m_offset, data, size);
+        }
+        m_offset += size;
+      }
+
+    private:
+      friend class HashSourceDataValidator;
+
+      uint8_t* m_dst = nullptr;
+      XXH3_state_t* m_fingerprintState = nullptr;
+      size_t m_size = 0;
+      size_t m_offset = 0;
+    };
+
+    explicit HashSourceDataValidator(size_t memoryBudget);
+    ~HashSourceDataValidator();
+
+    HashSourceDataValidator(const HashSourceDataValidator&) = delete;
+    HashSourceDataValidator& operator=(const HashSourceDataValidator&) = delete;
+
+    // Starts validating submissions on a background thread
+    void start();
+
+    // Joins the background thread, submissions still pending are discarded
+    void stop();
+
+    void setMemoryBudget(size_t memoryBudget) {
+      if (m_memoryBudget.load(std::memory_order_relaxed) != memoryBudget) {
+        m_memoryBudget.store(memoryBudget, std::memory_order_relaxed);
+      }
+    }
+
+    // writeSourceData(SourceDataWriter&) must write exactly size bytes and must not submit
+    // any other source data itself.  Returns false if the submission was dropped.
+    template<typename F>
+    bool submit(XXH64_hash_t hash, size_t size, HashSourceDataCategory category, F&& writeSourceData) {
+      Submission* submission = allocate(hash, size, category);
+      if (submission == nullptr) {
+        return false;
+      }
+
+      SourceDataWriter writer = beginWrite(*submission);
+      writeSourceData(writer);
+      endWrite(*submission, writer);
+      return true;
+    }
+
+    // Validates everything submitted so far on the calling thread, only valid while the
+    // background thread is not running
+    void processSubmissions();
+
+    Stats getStats();
+
+  private:
+    // Source data follows the header in the same allocation
+    struct Submission {
+      Submission* next;
+      XXH64_hash_t hash;
+      size_t size;
+      size_t storedSize;
+      HashSourceDataCategory category;
+
+      uint8_t* data() {
+        return reinterpret_cast<uint8_t*>(this + 1);
+      }
+    };
+
+    struct Entry {
+      XXH64_hash_t hash;
+      HashSourceDataCategory category;
+      bool reported = false;
+      size_t size;
+      // The source data itself, or its fingerprint for large sources
+      std::vector<uint8_t> data;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    struct Shard {
+      dxvk::mutex mutex;
+      // Most recently seen first
+      EntryList lru;
+      fast_unordered_cache<EntryList::iterator> entries[static_cast<uint8_t>(HashSourceDataCategory::Count)];
+      size_t memoryUsage = 0;
+    };
+
+    Submission* allocate(XXH64_hash_t hash, size_t size, HashSourceDataCategory category);
+    SourceDataWriter beginWrite(Submission& submission);
+    void endWrite(Submission& submission, SourceDataWriter& writer);
+
+    void wake();
+    void run();
+    void processBatch(Submission* batch);
+    void validate(Submission& submission);
+
+    static size_t getSubmissionCost(const Submission& submission) {
+      return sizeof(Submission) + submission.storedSize;
+    }
+
+    Shard m_shards[kNumShards];
+
+    std::atomic<Submission*> m_submissions = nullptr;
+    std::atomic<size_t> m_memoryBudget;
+    std::atomic<size_t> m_pendingBytes = 0;
+    std::atomic<size_t> m_cachedBytes = 0;
+
+    std::atomic<uint32_t> m_signal = 0;
+    std::atomic<bool> m_sleeping = false;
+    std::atomic<bool> m_stop = false;
+    dxvk::thread m_thread;
+
+    std::atomic<uint64_t> m_submitted = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    std::atomic<uint64_t> m_validated = 0;
+    std::atomic<uint64_t> m_collisions = 0;
+    std::atomic<uint64_t> m_evicted = 0;
+  };
+
+}  // namespace dxvk
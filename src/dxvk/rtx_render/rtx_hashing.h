@@ -207,10 +207,11 @@ namespace dxvk {
     * \brief Hashes a region of sparse memory
     *
     *   query [in]: structure containing information about the region
-    *   uniqueIndices [in]: indices (byte offsets as multiples of query.stride) to hash
+    *   pUniqueIndices [in]: indices (byte offsets as multiples of query.stride) to hash
+    *   uniqueIndexCount [in]: number of indices, if 0 the whole region is hashed
     */
   template<typename T>
-  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<T>& uniqueIndices);
+  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const T* pUniqueIndices, const size_t uniqueIndexCount);
 
   template<typename T>
   [[deprecated("(REMIX-656): Remove this once we can transition content to new hash)")]]
@@ -28,6 +28,8 @@
 #include "dxvk_device.h"
 #include "rtx_render/rtx_shader_manager.h"
 #include "rtx_io.h"
+#include "rtx_asset_package.h"
+#include "rtx_hash_collision_detection.h"
 #include "dxvk_raytracing.h"
 
 namespace dxvk {
@@ -101,6 +103,8 @@ namespace dxvk {
     }
 
     ShaderManager::destroyInstance();
+    AssetPackage::releasePrefetcher();
+    HashCollisionDetection::shutdown();
 #ifdef WITH_RTXIO
     RtxIo::get().release();
 #endif
@@ -33,6 +33,7 @@
 
 #include "../d3d9/d3d9_state.h"
 #include "rtx_matrix_helpers.h"
+#include "rtx_instance_matching.h"
 #include "dxvk_scoped_annotation.h"
 
 #include "rtx/pass/common_binding_indices.h"
@@ -40,7 +41,6 @@
 #include "rtx/pass/instance_definitions.h"
 
 namespace dxvk {
-  
   static bool isMirrorTransform(const Matrix4& m) {
     // Note: Identify if the winding is inverted by checking if the z axis is ever flipped relative to what it's expected to be for clockwise vertices in a lefthanded space
     // (x cross y) through the series of transformations
@@ -374,6 +374,11 @@ namespace dxvk {
     }
 
     updateInstance(*currentInstance, cameraManager, blas, drawCall, materialData, material, objectToWorld, worldToProjection);
+
+    // Keep the instance findable by further draws this frame at its updated transform
+    if (blas.frameInstanceIndexBuilt == m_device->getCurrentFrameId()) {
+      blas.instanceIndex.insert(currentInstance->getWorldPosition(), kTouchedInstanceIndexKey, currentInstance);
+    }
    
     return currentInstance;
   }
@@ -580,7 +585,7 @@ namespace dxvk {
     // NOTE: In the future we could extend this with heuristics as needed...
   }
 
-  RtInstance* InstanceManager::findSimilarInstance(const BlasEntry& blas, const RtSurfaceMaterial& material, const Matrix4& transform, CameraType::Enum cameraType, const RayPortalManager& rayPortalManager) {
+  RtInstance* InstanceManager::findSimilarInstance(BlasEntry& blas, const RtSurfaceMaterial& material, const Matrix4& transform, CameraType::Enum cameraType, const RayPortalManager& rayPortalManager) {
 
     // Disable temporal correlation between instances so that duplicate instances are not created
     // should a developer option change instance enough for it not to match anymore
@@ -604,46 +609,44 @@ namespace dxvk {
 
     const Vector3 worldPosition = Vector3(transform[3][0], transform[3][1], transform[3][2]);
 
+    const float uniqueObjectDistance = RtxOptions::Get()->getUniqueObjectDistance();
     const float uniqueObjectDistanceSqr = RtxOptions::Get()->getUniqueObjectDistanceSqr();
 
-    RtInstance* pSimilar = nullptr;
-    float nearestDistSqr = FLT_MAX;
-
-    // Search the BLAS for an instance matching ours
-    for (const RtInstance* instance : blas.getLinkedInstances()) {
-      
-      if ((instance->m_frameLastUpdated == currentFrameIdx)) {
-        // If the transform is an exact match and the instance has already been touched this frame,
-        // then this is a second draw call on a single mesh.
-        if (memcmp(&transform, &instance->getTransform(), sizeof(instance->getTransform())) == 0) {
-          return const_cast<RtInstance*>(instance);
-        }
-      } else if (instance->m_materialHash == material.getHash()) {
-        // Instance hasn't been touched yet this frame.
+    // Heavily instanced geometry (foliage, debris, crowds...) would make a linear search quadratic in the number of
+    // instances per frame, so such BLASes keep a spatial index of their instances, rebuilt once per frame on first use.
+    // Instances touched this frame are re-inserted as they are updated (see processSceneObject).
+    const bool useInstanceIndex = blas.getLinkedInstances().size() >= kMinInstancesForSpatialIndex;
 
-        const Vector3 prevInstanceWorldPosition = instance->getWorldPosition();
+    if (useInstanceIndex) {
+      const float cellSize = std::max(2.f * uniqueObjectDistance, kMinInstanceIndexCellSize);
 
-        const float distSqr = lengthSqr(prevInstanceWorldPosition - worldPosition);
-        if (distSqr <= uniqueObjectDistanceSqr && distSqr < nearestDistSqr) {
-          if (distSqr == 0.0f) {
-            // Not going to find anything closer.
-            return const_cast<RtInstance*>(instance);
-          }
-          nearestDistSqr = distSqr;
-          foundResult.setInstance(const_cast<RtInstance*>(instance));
-        }
+      if (blas.frameInstanceIndexBuilt != currentFrameIdx || blas.instanceIndex.cellSize() != cellSize) {
+        ScopedCpuProfileZoneN("Build Instance Index");
+        buildInstanceIndex(blas.instanceIndex, blas.getLinkedInstances(), cellSize, currentFrameIdx);
+        blas.frameInstanceIndexBuilt = currentFrameIdx;
       }
     }
 
+    // Search the BLAS for an instance matching ours
+    const SimilarInstanceMatch<RtInstance> match = matchSimilarInstance<RtInstance>(useInstanceIndex ? &blas.instanceIndex : nullptr, blas.getLinkedInstances(),
+                                                                                    transform, material.getHash(), currentFrameIdx, uniqueObjectDistance);
+    if (match.exactMatch) {
+      return match.exactMatch;
+    }
+
+    float nearestDistSqr = match.nearestDistSqr;
+    foundResult.setInstance(match.nearest);
+
     // For portal gun and other objects that were drawn in the ViewModel, need to check the
     // virtual version of the instance from previous frame.
     if (nearestDistSqr > 0.0f &&
         cameraType == CameraType::ViewModel && 
         RtxOptions::Get()->isRayPortalVirtualInstanceMatchingEnabled() ) {
-      for (const RtInstance* instance : blas.getLinkedInstances()) {
+      // Returns false once an exact virtual match is found
+      auto matchVirtualInstance = [&](const RtInstance* instance, const SingleRayPortalDirectionInfo& rayPortal) {
         if (instance->m_frameLastUpdated != currentFrameIdx - 1 || 
             instance->m_materialHash != material.getHash()) {
-          continue;
+          return true;
         }
         
         // Compare against virtual position of a predicted instance's position in the current frame
@@ -651,27 +654,46 @@ namespace dxvk {
         const Vector3 prevInstanceWorldPosition = instance->getWorldPosition();
         Vector3 predictedInstanceWorldPosition = prevInstanceWorldPosition +
           (prevInstanceWorldPosition - prevPrevInstanceWorldPosition);
-      
-        // Check all portal pairs
-        for (auto& rayPortalPair : rayPortalManager.getRayPortalPairInfos()) {
-          if (rayPortalPair.has_value()) {
-            for (uint32_t i = 0; i < 2; i++) {
-              const auto& rayPortal = rayPortalPair->pairInfos[i];
-
-              const Vector3 virtualPredictedInstanceWorldPosition =
-                rayPortalManager.getVirtualPosition(predictedInstanceWorldPosition, rayPortal.portalToOpposingPortalDirection);
-
-              // Distance of the object from the predicted virtual position of an instance
-              const float virtualDistSqr = lengthSqr(virtualPredictedInstanceWorldPosition - worldPosition);
-
-              // Is the instance is similar, and within range?  We already know the BLAS is shared, due to the for loop
-              if (virtualDistSqr <= uniqueObjectDistanceSqr && virtualDistSqr < nearestDistSqr) {
-                nearestDistSqr = virtualDistSqr;
-                foundResult.setInstance(const_cast<RtInstance*>(instance), &rayPortal.portalToOpposingPortalDirection);
-                if (virtualDistSqr == 0.0f) {
-                  // Not going to find anything closer.
-                  break;
-                }
+
+        const Vector3 virtualPredictedInstanceWorldPosition =
+          rayPortalManager.getVirtualPosition(predictedInstanceWorldPosition, rayPortal.portalToOpposingPortalDirection);
+
+        // Distance of the object from the predicted virtual position of an instance
+        const float virtualDistSqr = lengthSqr(virtualPredictedInstanceWorldPosition - worldPosition);
+
+        // Is the instance is similar, and within range?  We already know the BLAS is shared, due to the for loop
+        if (virtualDistSqr <= uniqueObjectDistanceSqr && virtualDistSqr < nearestDistSqr) {
+          nearestDistSqr = virtualDistSqr;
+          foundResult.setInstance(const_cast<RtInstance*>(instance), &rayPortal.portalToOpposingPortalDirection);
+          if (virtualDistSqr == 0.0f) {
+            // Not going to find anything closer.
+            return false;
+          }
+        }
+        return true;
+      };
+
+      // Check all portal pairs
+      for (auto& rayPortalPair : rayPortalManager.getRayPortalPairInfos()) {
+        if (rayPortalPair.has_value()) {
+          for (uint32_t i = 0; i < 2; i++) {
+            const auto& rayPortal = rayPortalPair->pairInfos[i];
+
+            if (useInstanceIndex) {
+              // Candidates are looked up at the position the portal maps onto ours, with the search
+              // radius scaled by the portal transform in case it is not rigid
+              const Matrix4 opposingPortalToPortal = inverse(rayPortal.portalToOpposingPortalDirection);
+              const Vector3 devirtualizedWorldPosition = rayPortalManager.getVirtualPosition(worldPosition, opposingPortalToPortal);
+              const float radiusScale = std::max({ length(opposingPortalToPortal[0].xyz()),
+                                                   length(opposingPortalToPortal[1].xyz()),
+                                                   length(opposingPortalToPortal[2].xyz()) });
+
+              blas.instanceIndex.forEachNear(devirtualizedWorldPosition, uniqueObjectDistance * radiusScale,
+                material.getHash() ^ kPredictedInstanceIndexKeySalt,
+                [&](const RtInstance* instance) { return matchVirtualInstance(instance, rayPortal); });
+            } else {
+              for (const RtInstance* instance : blas.getLinkedInstances()) {
+                matchVirtualInstance(instance, rayPortal);
               }
             }
           }
@@ -0,0 +1,135 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+#pragma once
+
+#include <cfloat>
+#include <cstring>
+#include "../../util/util_matrix.h"
+#include "../../util/util_spatial_hash.h"
+
+namespace dxvk {
+  // BLASes with at least this many linked instances use a spatial index to match instances across frames
+  constexpr size_t kMinInstancesForSpatialIndex = 32;
+  // Guards against degenerate cells when rtx.uniqueObjectDistance is (close to) zero
+  constexpr float kMinInstanceIndexCellSize = 1e-2f;
+  // Instance index keys, see matchSimilarInstance.  Instances are otherwise keyed by material hash.
+  constexpr XXH64_hash_t kTouchedInstanceIndexKey = 0x9e3779b97f4a7c15ull;
+  constexpr XXH64_hash_t kPredictedInstanceIndexKeySalt = 0xc2b2ae3d27d4eb4full;
+
+  // The candidate matching of InstanceManager::findSimilarInstance, free of any device state.
+  //
+  // InstanceType is RtInstance in the instance manager.  It must provide getFrameLastUpdated(),
+  // getMaterialHash(), getTransform(), getWorldPosition() and getPrevWorldPosition().
+
+  // Builds the spatial index over a BLAS's linked instances for the current frame.  Instances touched
+  // this frame are keyed apart, as they can only be matched exactly.
+  template<typename InstanceType, typename InstanceList>
+  void buildInstanceIndex(SpatialHash<const InstanceType*>& index, const InstanceList& instances, const float cellSize, const uint32_t currentFrameIdx) {
+    index.clear(cellSize);
+    index.reserve(instances.size());
+
+    for (const InstanceType* instance : instances) {
+      if (instance->getFrameLastUpdated() == currentFrameIdx) {
+        index.insert(instance->getWorldPosition(), kTouchedInstanceIndexKey, instance);
+        continue;
+      }
+
+      index.insert(instance->getWorldPosition(), instance->getMaterialHash(), instance);
+
+      // Instances from the previous frame are also indexed at the position they are predicted at this frame,
+      // for the ray portal virtual instance matching
+      if (instance->getFrameLastUpdated() == currentFrameIdx - 1) {
+        const Vector3 prevInstanceWorldPosition = instance->getWorldPosition();
+        const Vector3 predictedInstanceWorldPosition = prevInstanceWorldPosition +
+          (prevInstanceWorldPosition - instance->getPrevWorldPosition());
+
+        index.insert(predictedInstanceWorldPosition, instance->getMaterialHash() ^ kPredictedInstanceIndexKeySalt, instance);
+      }
+    }
+  }
+
+  template<typename InstanceType>
+  struct SimilarInstanceMatch {
+    // Set when nothing else can beat the match: a second draw of an instance touched this frame, or a zero distance
+    InstanceType* exactMatch = nullptr;
+    // Otherwise the nearest instance not touched yet this frame, within the unique object distance
+    InstanceType* nearest = nullptr;
+    float nearestDistSqr = FLT_MAX;
+  };
+
+  // Matches a draw against the instances of its BLAS.  Looks candidates up in pIndex when given, which must have
+  // been built this frame, and scans all of instances otherwise.
+  template<typename InstanceType, typename InstanceList>
+  SimilarInstanceMatch<InstanceType> matchSimilarInstance(const SpatialHash<const InstanceType*>* pIndex, const InstanceList& instances,
+                                                          const Matrix4& transform, const XXH64_hash_t materialHash,
+                                                          const uint32_t currentFrameIdx, const float uniqueObjectDistance) {
+    SimilarInstanceMatch<InstanceType> result;
+
+    const Vector3 worldPosition = Vector3(transform[3][0], transform[3][1], transform[3][2]);
+    const float uniqueObjectDistanceSqr = uniqueObjectDistance * uniqueObjectDistance;
+
+    // Returns false once a match is found that nothing else can beat
+    auto matchInstance = [&](const InstanceType* instance) {
+      if ((instance->getFrameLastUpdated() == currentFrameIdx)) {
+        // If the transform is an exact match and the instance has already been touched this frame,
+        // then this is a second draw call on a single mesh.
+        const Matrix4 instanceTransform = instance->getTransform();
+        if (memcmp(&transform, &instanceTransform, sizeof(instanceTransform)) == 0) {
+          result.exactMatch = const_cast<InstanceType*>(instance);
+          return false;
+        }
+      } else if (instance->getMaterialHash() == materialHash) {
+        // Instance hasn't been touched yet this frame.
+
+        const Vector3 prevInstanceWorldPosition = instance->getWorldPosition();
+
+        const float distSqr = lengthSqr(prevInstanceWorldPosition - worldPosition);
+        if (distSqr <= uniqueObjectDistanceSqr && distSqr < result.nearestDistSqr) {
+          if (distSqr == 0.0f) {
+            // Not going to find anything closer.
+            result.exactMatch = const_cast<InstanceType*>(instance);
+            return false;
+          }
+          result.nearestDistSqr = distSqr;
+          result.nearest = const_cast<InstanceType*>(instance);
+        }
+      }
+      return true;
+    };
+
+    if (pIndex) {
+      // Exact matches of instances touched this frame first
+      if (pIndex->forEachNear(worldPosition, 0.f, kTouchedInstanceIndexKey, matchInstance)) {
+        pIndex->forEachNear(worldPosition, uniqueObjectDistance, materialHash, matchInstance);
+      }
+    } else {
+      for (const InstanceType* instance : instances) {
+        if (!matchInstance(instance)) {
+          break;
+        }
+      }
+    }
+
+    return result;
+  }
+}
@@ -34,6 +34,7 @@
 #include "math.h"
 #include "rtx_lights.h"
 #include "rtx_intersection_test.h"
+#include "../util/log/metrics.h"
 
 /*  Light Manager (blurb)
 * 
@@ -75,6 +76,8 @@ namespace dxvk {
   // to represent something such as a new light index.
   static_assert(LIGHT_INDEX_INVALID == kNewLightIdx, "New light index must match invalid light sentinel value");
 
+  static MetricCounter s_lightsMatchedMetric("lights.matched");
+
   LightManager::LightManager(DxvkDevice* device)
     : CommonDeviceObject(device) {
     // Legacy light translation Options
@@ -96,8 +99,15 @@ namespace dxvk {
   LightManager::~LightManager() {
   }
 
+  // Lights closer than this are merged by addLight, to catch minor perturbations in static lights (e.g. due to precision loss)
+  static float getLightMergeDistance() {
+    constexpr float kDistanceThresholdMeters = 0.02f;
+    return kDistanceThresholdMeters * RtxOptions::Get()->getMeterToWorldUnitScale();
+  }
+
   void LightManager::clear() {
     m_lights.clear();
+    m_lightIndex.clear(getLightMergeDistance());
   }
 
   void LightManager::garbageCollectionInternal() {
@@ -165,6 +175,21 @@ namespace dxvk {
 
   void LightManager::dynamicLightMatching() {
     ScopedCpuProfileZone();
+    const float distanceThreshold = RtxOptions::Get()->getUniqueObjectDistance();
+
+    // Index the lights added this frame, those are the candidates for the lights from previous frame to have moved to
+    m_newLightIndex.clear(distanceThreshold);
+
+    for (auto&& [lightHash, light] : m_lights) {
+      if (light.getBufferIdx() == kNewLightIdx && !light.isChildOfMesh()) {
+        m_newLightIndex.insert(lightHash, light);
+      }
+    }
+
+    if (m_newLightIndex.empty()) {
+      return;
+    }
+
     // Try match up any stragglers now we have the full light list this frame.
     for (auto it = m_lights.begin(); it != m_lights.end(); ) {
       RtLight& light = it->second;
@@ -184,23 +209,11 @@ namespace dxvk {
         continue;
       }
 
-      float currentSimilarity = -1.f;
-      std::optional<XXH64_hash_t> similarLight;
-      for (auto&& newPair : m_lights) {
-        RtLight& newLight = newPair.second;
-        // Skip comparing to old lights, this check implicitly avoids comparing the exact same light.
-        if (newLight.getBufferIdx() != kNewLightIdx || newLight.isChildOfMesh())
-          continue;
+      // Note: only new lights are indexed, this implicitly avoids comparing the exact same light.
+      const std::optional<XXH64_hash_t> similarLight = m_newLightIndex.findMostSimilar(m_lights, light, distanceThreshold,
+        [distanceThreshold](const RtLight& newLight, const RtLight& prevLight) { return isSimilar(prevLight, newLight, distanceThreshold); });
 
-        float similarity = isSimilar(light, newLight, RtxOptions::Get()->getUniqueObjectDistance());
-        // Update the cached light if it's similar.
-        if (similarity > currentSimilarity) {
-          similarLight = newPair.first;
-          currentSimilarity = similarity;
-        }
-      }
-
-      if (currentSimilarity >= 0 && similarLight.has_value()) {
+      if (similarLight.has_value()) {
         // This is a dynamic light!
         RtLight& dynamicLight = m_lights[similarLight.value()];
         dynamicLight.isDynamic = true;
@@ -482,6 +495,9 @@ namespace dxvk {
   }
 
   void LightManager::updateLight(const RtLight& in, RtLight& out) {
+    // Only called for a light matched to one seen before
+    s_lightsMatchedMetric.add();
+
     // This is somewhat of a blank slate currently to allow for future improvement.
     out.isStaticCount = 0; // This light is not static anymore.
     out.setBufferIdx(in.getBufferIdx());  // We remapped this light.
@@ -541,6 +557,9 @@ namespace dxvk {
     if (foundLightIt != m_lights.end()) {
       // Ignore changes in the same frame
       if (foundLightIt->second.getFrameLastTouched() != m_device->getCurrentFrameId()) {
+        const Vector3 prevPosition = foundLightIt->second.getPosition();
+        const RtLightType prevType = foundLightIt->second.getType();
+
         if (rtLight.isChildOfMesh()) {
           // If light transform changed, update it.
           if (foundLightIt->second.getTransformedHash() != rtLight.getTransformedHash()) {
@@ -569,31 +588,36 @@ namespace dxvk {
 
         // We saw this light so bump its frame counter.
         foundLightIt->second.setFrameLastTouched(m_device->getCurrentFrameId());
+
+        // Keep the light findable at its new position
+        if (foundLightIt->second.getType() != prevType || foundLightIt->second.getPosition() != prevPosition) {
+          m_lightIndex.update(foundLightIt->first, foundLightIt->second, m_lights, getLightMergeDistance());
+        }
       }
 
     } else {
       //  Try find a similar light
       std::optional<RtLight> similarLight;
-      for (auto&& pair : m_lights) {
-        const RtLight& light = pair.second;
 
-        // Update the cached light if it's similar.  This should catch minor perturbations in static lights (e.g. due to precision loss)
-        const float kDistanceThresholdMeters = 0.02f;
-        const float kDistanceThresholdWorldUnits = kDistanceThresholdMeters * RtxOptions::Get()->getMeterToWorldUnitScale();
-        if (isSimilar(light, rtLight, kDistanceThresholdWorldUnits) >= 0.f) {
-          // Copy off light state.
-          similarLight = light;
+      // Update the cached light if it's similar.  This should catch minor perturbations in static lights (e.g. due to precision loss)
+      const float distanceThreshold = getLightMergeDistance();
+      if (!m_lightIndex.isBuiltFor(distanceThreshold)) {
+        m_lightIndex.rebuild(m_lights, distanceThreshold);
+      }
 
-          // Remove it, since we want to re-add it with a (potentially) new hash
-          m_lights.erase(pair.first);
+      const std::optional<XXH64_hash_t> similarLightHash = m_lightIndex.findSimilar(m_lights, rtLight, distanceThreshold,
+        [distanceThreshold](const RtLight& candidate, const RtLight& newLight) { return isSimilar(candidate, newLight, distanceThreshold); });
 
-          break;
-        } 
+      if (similarLightHash.has_value()) {
+        // Copy off light state, then remove it, since we want to re-add it with a (potentially) new hash
+        similarLight = m_lights.at(similarLightHash.value());
+        m_lights.erase(similarLightHash.value());
       }
 
       // Add as a new light (with/out updated data depending on if a similar light was found)
       RtLight& localLight = m_lights[rtLight.getInstanceHash()];
       localLight = rtLight;
+      m_lightIndex.update(rtLight.getInstanceHash(), localLight, m_lights, getLightMergeDistance());
 
       // Copy/interpolate any state we like from the similar light.
       if (similarLight.has_value())
@@ -29,6 +29,7 @@
 #include "rtx/utility/shader_types.h"
 #include "rtx/concept/light/light_types.h"
 #include "rtx_lights.h"
+#include "rtx_light_matching.h"
 #include "rtx_camera_manager.h"
 #include "rtx_common_object.h"
 
@@ -106,6 +107,11 @@ private:
   std::vector<RtLight*> m_linearizedLights{};
   std::vector<unsigned char> m_lightsGPUData{};
   std::vector<uint16_t> m_lightMappingData{};
+  // Spatial indices of m_lights, so that similar lights can be found without comparing against every light.
+  // m_lightIndex covers all lights for addLight, m_newLightIndex only the lights added this frame and is
+  // rebuilt by every dynamicLightMatching call.
+  LightIndex m_lightIndex;
+  LightIndex m_newLightIndex;
 
   void garbageCollectionInternal();
 
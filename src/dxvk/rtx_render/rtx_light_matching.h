@@ -0,0 +1,144 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include "../../util/util_spatial_hash.h"
+
+namespace dxvk {
+  // Spatial index of a light table, so that similar lights can be found without comparing against every
+  // light.  Lights are referred to by their hash in the table and bucketed by type, as lights are only ever
+  // similar to lights of the same type.  Free of any device state, LightManager keeps one of these over all
+  // of its lights and another over the lights added each frame.
+  //
+  // LightType must provide getPosition() and getType(), LightTable maps light hashes to LightType.
+  // Like SpatialHash the index is append only, entries of moved or removed lights go stale and are
+  // skipped when matching.
+  // Note: distant lights have no position and so all end up in the same cell, which is fine as there are only a handful of them.
+  class LightIndex {
+  public:
+    // Cell size of an index searched within the given distance
+    static float getCellSize(const float distanceThreshold) {
+      // Guards against degenerate cells for tiny (or zero) thresholds
+      constexpr float kMinCellSize = 1e-3f;
+      return std::max(2.f * distanceThreshold, kMinCellSize);
+    }
+
+    void clear(const float distanceThreshold) {
+      m_index.clear(getCellSize(distanceThreshold));
+    }
+
+    bool isBuiltFor(const float distanceThreshold) const {
+      return m_index.cellSize() == getCellSize(distanceThreshold);
+    }
+
+    size_t size() const {
+      return m_index.size();
+    }
+
+    bool empty() const {
+      return m_index.empty();
+    }
+
+    template<typename LightType>
+    void insert(const XXH64_hash_t lightHash, const LightType& light) {
+      m_index.insert(light.getPosition(), getKey(light), lightHash);
+    }
+
+    template<typename LightTable>
+    void rebuild(const LightTable& lights, const float distanceThreshold) {
+      clear(distanceThreshold);
+      m_index.reserve(lights.size());
+
+      for (auto&& [lightHash, light] : lights) {
+        insert(lightHash, light);
+      }
+    }
+
+    // Indexes a light which was added to the table or moved, the table must already hold it
+    template<typename LightTable, typename LightType>
+    void update(const XXH64_hash_t lightHash, const LightType& light, const LightTable& lights, const float distanceThreshold) {
+      // Entries of removed or moved lights are only dropped on a rebuild, so rebuild once they make up half of the index
+      constexpr size_t kMinStaleEntries = 256;
+
+      if (m_index.size() >= 2 * lights.size() + kMinStaleEntries || !isBuiltFor(distanceThreshold)) {
+        rebuild(lights, distanceThreshold);
+      } else {
+        insert(lightHash, light);
+      }
+    }
+
+    // Returns the first indexed light within distanceThreshold of light with similarity(candidate, light) >= 0
+    template<typename LightTable, typename LightType, typename Similarity>
+    std::optional<XXH64_hash_t> findSimilar(const LightTable& lights, const LightType& light, const float distanceThreshold, Similarity&& similarity) const {
+      std::optional<XXH64_hash_t> similarLight;
+
+      m_index.forEachNear(light.getPosition(), distanceThreshold, getKey(light), [&](const XXH64_hash_t lightHash) {
+        // The index may still refer to lights which have since been removed
+        const auto lightIt = lights.find(lightHash);
+        if (lightIt == lights.end() || similarity(lightIt->second, light) < 0.f) {
+          return true;
+        }
+
+        similarLight = lightHash;
+        return false;
+      });
+
+      return similarLight;
+    }
+
+    // Returns the indexed light within distanceThreshold of light with the highest similarity(candidate, light) >= 0
+    template<typename LightTable, typename LightType, typename Similarity>
+    std::optional<XXH64_hash_t> findMostSimilar(const LightTable& lights, const LightType& light, const float distanceThreshold, Similarity&& similarity) const {
+      float currentSimilarity = -1.f;
+      std::optional<XXH64_hash_t> similarLight;
+
+      m_index.forEachNear(light.getPosition(), distanceThreshold, getKey(light), [&](const XXH64_hash_t lightHash) {
+        const auto lightIt = lights.find(lightHash);
+        if (lightIt == lights.end()) {
+          return true;
+        }
+
+        const float candidateSimilarity = similarity(lightIt->second, light);
+        if (candidateSimilarity > currentSimilarity) {
+          similarLight = lightHash;
+          currentSimilarity = candidateSimilarity;
+        }
+        return true;
+      });
+
+      if (currentSimilarity < 0.f) {
+        return std::nullopt;
+      }
+      return similarLight;
+    }
+
+  private:
+    template<typename LightType>
+    static XXH64_hash_t getKey(const LightType& light) {
+      return static_cast<XXH64_hash_t>(light.getType());
+    }
+
+    SpatialHash<XXH64_hash_t> m_index;
+  };
+}
@@ -195,6 +195,14 @@ namespace dxvk {
     return std::optional<LightData>(std::in_place, LightData(lightPrim, localToRoot, absoluteTransform));
   }
 
+  LightData LightData::fromBytes(const void* data) {
+    static_assert(std::is_trivially_copyable_v<LightData>, "Light data must stay trivially copyable to be cached as raw bytes.");
+
+    LightData output;
+    memcpy(&output, data, sizeof(LightData));
+    return output;
+  }
+
   LightData LightData::createFromDirectional(const D3DLIGHT9& light) {
     LightData output;
 
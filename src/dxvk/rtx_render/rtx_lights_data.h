@@ -58,6 +58,9 @@ namespace dxvk {
 
     bool relativeTransform() const { return m_transformType == Relative; }
 
+    // Light data holds no references to USD or device objects, so the compiled mod cache stores it as raw bytes.
+    static LightData fromBytes(const void* data);
+
   private:
     // Supported light data types
     enum LightType {
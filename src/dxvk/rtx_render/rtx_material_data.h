@@ -161,6 +161,23 @@
         target.m_##name = TextureRef(getTexture(shader, get##name##Token())); \
       }
 
+#define WRITE_TEXTURE_RESOLVER(name, usd_attr, type, minVal, maxVal, defaultVal) \
+      if(m_dirty.test(DirtyFlags::k_##name)) { \
+        m_##name = TextureRef(getTexture(get##name##Token())); \
+      }
+
+#define WRITE_CONSTANT_CACHE_SERIALIZER(name, usd_attr, type, minVal, maxVal, defaultVal) \
+      writeConstant(&m_##name, sizeof(m_##name));
+
+#define WRITE_TEXTURE_CACHE_SERIALIZER(name, usd_attr, type, minVal, maxVal, defaultVal) \
+      writeTexture(get##name##Token());
+
+#define WRITE_CONSTANT_CACHE_DESERIALIZER(name, usd_attr, type, minVal, maxVal, defaultVal) \
+      readConstant(&target.m_##name, sizeof(target.m_##name));
+
+#define WRITE_TEXTURE_CACHE_DESERIALIZER(name, usd_attr, type, minVal, maxVal, defaultVal) \
+      target.m_##name = readTexture(get##name##Token());
+
 #define WRITE_PARAMETER_MERGE(name, usd_attr, type, minVal, maxVal, defaultVal) \
       if(!m_dirty.test(DirtyFlags::k_##name)) { \
         m_##name = input.m_##name; \
@@ -217,6 +234,33 @@ struct name##Data {
     return target;                                                                                   \
   }                                                                                                  \
                                                                                                      \
+  /* Note: Binds the textures of a material deserialized with deferred texture loading */            \
+  template<typename F>                                                                               \
+  void resolveTextures(const F& getTexture) {                                                        \
+    X_TEXTURES(WRITE_TEXTURE_RESOLVER)                                                               \
+    updateCachedHash();                                                                              \
+  }                                                                                                  \
+                                                                                                     \
+  /* Note: Used by the compiled mod cache, constants are written as raw bytes while textures are */  \
+  /*       handed to the writer by token so it can record the path they were resolved from.     */   \
+  template<typename W, typename T>                                                                   \
+  void serializeCached(const W& writeConstant, const T& writeTexture) const {                        \
+    writeConstant(&m_dirty, sizeof(m_dirty));                                                        \
+    X_CONSTANTS(WRITE_CONSTANT_CACHE_SERIALIZER)                                                     \
+    X_TEXTURES(WRITE_TEXTURE_CACHE_SERIALIZER)                                                       \
+  }                                                                                                  \
+                                                                                                     \
+  template<typename R, typename T>                                                                   \
+  static name##Data deserializeCached(const R& readConstant, const T& readTexture) {                 \
+    name##Data target;                                                                               \
+    readConstant(&target.m_dirty, sizeof(target.m_dirty));                                           \
+    X_CONSTANTS(WRITE_CONSTANT_CACHE_DESERIALIZER)                                                   \
+    X_TEXTURES(WRITE_TEXTURE_CACHE_DESERIALIZER)                                                     \
+    target.sanitizeData();                                                                           \
+    target.updateCachedHash();                                                                       \
+    return target;                                                                                   \
+  }                                                                                                  \
+                                                                                                     \
   void merge(const name##Data& input)  {                                                             \
     X_PARAMS(WRITE_PARAMETER_MERGE)                                                                  \
     updateCachedHash();                                                                              \
@@ -277,6 +321,11 @@ namespace dxvk {
 #undef WRITE_MEMBER_FUNC
 #undef WRITE_CONSTANT_DESERIALIZER
 #undef WRITE_TEXTURE_DESERIALIZER
+#undef WRITE_TEXTURE_RESOLVER
+#undef WRITE_CONSTANT_CACHE_SERIALIZER
+#undef WRITE_TEXTURE_CACHE_SERIALIZER
+#undef WRITE_CONSTANT_CACHE_DESERIALIZER
+#undef WRITE_TEXTURE_CACHE_DESERIALIZER
 #undef WRITE_PARAMETER_MERGE
 #undef WRITE_CONSTANT_RANGES
 #undef WRITE_CONSTANT_SANITIZATION
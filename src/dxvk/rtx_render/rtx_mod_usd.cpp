@@ -22,6 +22,7 @@
 #pragma once
 
 #include "rtx_mod_usd.h"
+#include "rtx_mod_usd_cache.h"
 #include "rtx_asset_replacer.h"
 
 #include "dxvk_device.h"
@@ -62,8 +63,11 @@
 #include "../../lssusd/usd_common.h"
 
 #include "rtx_lights_data.h"
+#include "../../util/util_time.h"
 #include <filesystem>
 #include <algorithm>
+#include <unordered_set>
+#include <variant>
 
 namespace fs = std::filesystem;
 
@@ -93,15 +97,58 @@ private:
     std::vector<AssetReplacement>& meshes;
   };
 
+  // Output of the import stage for a mesh, everything that can be built without touching the device
+  struct MeshImport {
+    std::unique_ptr<lss::UsdMeshImporter> mesh;
+    std::string error;
+    std::vector<XXH64_hash_t> submeshHashes;
+    bool optimized = false;
+    lss::UsdMeshImporter::OptimizationStats optimization;
+  };
+
+  // Output of the import stage for a material, its textures are resolved but not loaded yet
+  struct MaterialImport {
+    XXH64_hash_t hash = 0;
+    bool ignored = false;
+    std::variant<OpaqueMaterialData, TranslucentMaterialData, RayPortalMaterialData> data;
+    CompiledModCacheWriter::TexturePaths texturePaths;
+  };
+
+  struct ImportStats {
+    size_t meshCount = 0;
+    size_t materialCount = 0;
+    uint32_t threadCount = 1;
+    double discoveryMs = 0.0;
+    double importMs = 0.0;
+    // Mesh optimization totals, ACMR is weighted by triangle count
+    size_t optimizedMeshCount = 0;
+    uint64_t trianglesBefore = 0;
+    uint64_t trianglesAfter = 0;
+    uint64_t unusedVertices = 0;
+    double acmrBefore = 0.0;
+    double acmrAfter = 0.0;
+  };
+
   bool haveFilesChanged();
 
   void processUSD(const Rc<DxvkContext>& context);
+  bool loadCompiledCache(const Rc<DxvkContext>& context, const fs::path& cachePath);
+
+  // Discovers the meshes and materials of a stage and imports them on a worker pool,
+  // the results are published in order by the regular processing functions.
+  ImportStats importStage(const pxr::UsdStageRefPtr& stage);
+  XXH64_hash_t getOriginHash(const pxr::UsdPrim& prim) const;
+  pxr::UsdPrim getBoundMaterial(const pxr::UsdPrim& prim) const;
 
   void TEMP_parseSecretReplacementVariants(const fast_unordered_cache<uint32_t>& variants);
-  Rc<ManagedTexture> getTexture(const Args& args, const pxr::UsdPrim& shader, const pxr::TfToken& textureToken, bool forcePreload = false) const;
+  std::string resolveTexture(const pxr::UsdPrim& shader, const pxr::TfToken& textureToken) const;
+  Rc<ManagedTexture> loadTexture(const Rc<DxvkContext>& context, const std::string& resolvedTexturePath, bool forcePreload = false) const;
+  MaterialImport importMaterial(const pxr::UsdPrim& matPrim) const;
+  MaterialData* publishMaterial(Args& args, MaterialImport& import);
   MaterialData* processMaterial(Args& args, const pxr::UsdPrim& matPrim);
   MaterialData* processMaterialUser(Args& args, const pxr::UsdPrim& prim);
-  bool processMesh(const pxr::UsdPrim& prim, Args& args);
+  static MeshImport importMesh(const pxr::UsdPrim& prim);
+  bool processMesh(const pxr::UsdPrim& prim, XXH64_hash_t usdOriginHash, Args& args);
   void processPrim(Args& args, pxr::UsdPrim& prim);
 
   void processLight(Args& args, const pxr::UsdPrim& lightPrim);
@@ -119,6 +166,24 @@ private:
   std::filesystem::file_time_type m_fileModificationTime;
   std::string m_openedFilePath;
 
+  // Collects the processed replacements while the USD is parsed, null when not writing a compiled mod cache
+  std::unique_ptr<CompiledModCacheWriter> m_cacheWriter;
+
+  // Import stage results, only populated while a stage is being processed
+  struct Imports {
+    std::unordered_map<pxr::SdfPath, XXH64_hash_t, pxr::SdfPath::Hash> originHashes;
+    std::unordered_map<pxr::SdfPath, pxr::UsdPrim, pxr::SdfPath::Hash> boundMaterials;
+    fast_unordered_cache<MeshImport> meshes;
+    std::unordered_map<pxr::SdfPath, MaterialImport, pxr::SdfPath::Hash> materials;
+
+    void clear() {
+      originHashes.clear();
+      boundMaterials.clear();
+      meshes.clear();
+      materials.clear();
+    }
+  } m_imports;
+
   Watchdog<1000> m_usdChangeWatchdog;
 };
 
@@ -254,49 +319,51 @@ static std::string resolveTexturePath(
   return textureAssetPath;
 }
 
-Rc<ManagedTexture> UsdMod::Impl::getTexture(const Args& args, const pxr::UsdPrim& shader, const pxr::TfToken& textureToken, bool forcePreload) const {
-  static const pxr::TfToken kSRGBColorSpace("sRGB");
-  static pxr::SdfAssetPath path;
+std::string UsdMod::Impl::resolveTexture(const pxr::UsdPrim& shader, const pxr::TfToken& textureToken) const {
+  pxr::SdfAssetPath path;
   auto attr = shader.GetAttribute(textureToken);
   if (attr.Get(&path)) {
-    const ColorSpace colorSpace = ColorSpace::AUTO; // Always do this, whether or not force SRGB is required or not is unclear at this time.
-
-    std::string resolvedTexturePath;
     if (!path.GetResolvedPath().empty()) {
       // We have a resolved path - texture file exists on disk
-      resolvedTexturePath = path.GetResolvedPath();
+      return path.GetResolvedPath();
     } else if (!path.GetAssetPath().empty()) {
       // We do NOT have a resolved path - this could be a packaged texture
       // Resolve full path from the asset path and source USD path
-      resolvedTexturePath = resolveTexturePath(shader, textureToken, path.GetAssetPath());
-    } else {
-      // No texture set
-      return nullptr;
+      return resolveTexturePath(shader, textureToken, path.GetAssetPath());
     }
+  }
 
-    auto assetData = AssetDataManager::get().findAsset(resolvedTexturePath);
-    if (assetData != nullptr) {
-      auto device = args.context->getDevice();
-      auto& textureManager = device->getCommon()->getTextureManager();
-      return textureManager.preloadTextureAsset(assetData, colorSpace, args.context, forcePreload);
-    } else if (RtxOptions::Automation::suppressAssetLoadingErrors()) {
-      Logger::warn(str::format("Texture ", resolvedTexturePath, " asset data cannot be found or corrupted."));
-    } else {
-      Logger::err(str::format("Texture ", resolvedTexturePath, " asset data cannot be found or corrupted."));
-    }
+  // No texture set
+  return std::string();
+}
+
+Rc<ManagedTexture> UsdMod::Impl::loadTexture(const Rc<DxvkContext>& context, const std::string& resolvedTexturePath, bool forcePreload) const {
+  const ColorSpace colorSpace = ColorSpace::AUTO; // Always do this, whether or not force SRGB is required or not is unclear at this time.
+
+  auto assetData = AssetDataManager::get().findAsset(resolvedTexturePath);
+  if (assetData != nullptr) {
+    auto device = context->getDevice();
+    auto& textureManager = device->getCommon()->getTextureManager();
+    return textureManager.preloadTextureAsset(assetData, colorSpace, context, forcePreload);
+  } else if (RtxOptions::Automation::suppressAssetLoadingErrors()) {
+    Logger::warn(str::format("Texture ", resolvedTexturePath, " asset data cannot be found or corrupted."));
+  } else {
+    Logger::err(str::format("Texture ", resolvedTexturePath, " asset data cannot be found or corrupted."));
   }
 
   // Note: "Empty" texture returned on failure
   return nullptr;
 }
 
-MaterialData* UsdMod::Impl::processMaterial(Args& args, const pxr::UsdPrim& matPrim) {
+UsdMod::Impl::MaterialImport UsdMod::Impl::importMaterial(const pxr::UsdPrim& matPrim) const {
   ScopedCpuProfileZone();
 
   static const pxr::TfToken kShaderToken("Shader");
   static const pxr::TfToken kIgnore("inputs:ignore_material");  // Any draw call or replacement using a material with this flag will be skipped by the SceneManager
   static const pxr::TfToken kLegacyRayPortalIndexToken("rayPortalIndex");
 
+  MaterialImport import;
+
   pxr::UsdPrim shader = matPrim.GetChild(kShaderToken);
   if (!shader.IsValid() || !shader.IsA<pxr::UsdShadeShader>()) {
     auto children = matPrim.GetFilteredChildren(pxr::UsdPrimIsActive);
@@ -308,23 +375,16 @@ MaterialData* UsdMod::Impl::processMaterial(Args& args, const pxr::UsdPrim& matP
   }
 
   if (!shader.IsValid()) {
-    return nullptr;
+    return import;
   }
 
-  XXH64_hash_t materialHash = getMaterialHash(matPrim, shader);
-  if (materialHash == 0) {
-    return nullptr;
+  import.hash = getMaterialHash(matPrim, shader);
+  if (import.hash == 0) {
+    return import;
   }
 
-  // Check if the material has already been processed
-  MaterialData* materialData;
-  if (m_owner.m_replacements->getObject(materialHash, materialData)) {
-    return materialData;
-  }
-
-  bool shouldIgnore = false;
   if (shader.HasAttribute(kIgnore)) {
-    shader.GetAttribute(kIgnore).Get(&shouldIgnore);
+    shader.GetAttribute(kIgnore).Get(&import.ignored);
   }
 
   // Todo: Only Opaque materials are currently handled, in the future a Translucent path should also exist
@@ -332,7 +392,7 @@ MaterialData* UsdMod::Impl::processMaterial(Args& args, const pxr::UsdPrim& matP
   static const pxr::TfToken sourceAsset("info:mdl:sourceAsset");
   pxr::UsdAttribute sourceAssetAttr = shader.GetAttribute(sourceAsset);
   if (sourceAssetAttr.HasValue()) {
-    static pxr::SdfAssetPath assetPath;
+    pxr::SdfAssetPath assetPath;
     sourceAssetAttr.Get(&assetPath);
     std::string assetPathStr = assetPath.GetAssetPath();
     if (assetPathStr.find("AperturePBR_Portal.mdl") != std::string::npos) {
@@ -347,41 +407,287 @@ MaterialData* UsdMod::Impl::processMaterial(Args& args, const pxr::UsdPrim& matP
     }
   }
 
+  // Note: Textures are only resolved here, loading them touches the texture manager and is left to publishMaterial()
   auto getTextureFunctor = [&](const pxr::UsdPrim& shader, const pxr::TfToken& name) {
-                             return getTexture(args, shader, name);
+                             const std::string resolvedTexturePath = resolveTexture(shader, name);
+                             if (!resolvedTexturePath.empty()) {
+                               import.texturePaths[name.GetString()] = resolvedTexturePath;
+                             }
+                             return Rc<ManagedTexture>(nullptr);
                            };
 
   switch (materialType) {
   case RtSurfaceMaterialType::Opaque:
-    return &m_owner.m_replacements->storeObject(materialHash, MaterialData(OpaqueMaterialData::deserialize(getTextureFunctor, shader), shouldIgnore));
+    import.data = OpaqueMaterialData::deserialize(getTextureFunctor, shader);
+    break;
   case RtSurfaceMaterialType::Translucent:
-    return &m_owner.m_replacements->storeObject(materialHash, MaterialData(TranslucentMaterialData::deserialize(getTextureFunctor, shader), shouldIgnore));
+    import.data = TranslucentMaterialData::deserialize(getTextureFunctor, shader);
+    break;
   case RtSurfaceMaterialType::RayPortal:
-    return &m_owner.m_replacements->storeObject(materialHash, MaterialData(RayPortalMaterialData::deserialize(getTextureFunctor, shader)));
+    import.data = RayPortalMaterialData::deserialize(getTextureFunctor, shader);
+    break;
+  default:
+    import.hash = 0;
+    break;
   }
 
-  return nullptr;
+  return import;
+}
+
+MaterialData* UsdMod::Impl::publishMaterial(Args& args, MaterialImport& import) {
+  if (import.hash == 0) {
+    return nullptr;
+  }
+
+  // Check if the material has already been processed
+  MaterialData* materialData;
+  if (m_owner.m_replacements->getObject(import.hash, materialData)) {
+    return materialData;
+  }
+
+  auto getTextureFunctor = [&](const pxr::TfToken& name) {
+                             auto path = import.texturePaths.find(name.GetString());
+                             return path != import.texturePaths.end() ? loadTexture(args.context, path->second) : nullptr;
+                           };
+
+  std::visit([&](auto& data) {
+    data.resolveTextures(getTextureFunctor);
+    if constexpr (std::is_same_v<std::decay_t<decltype(data)>, RayPortalMaterialData>) {
+      materialData = &m_owner.m_replacements->storeObject(import.hash, MaterialData(data));
+    } else {
+      materialData = &m_owner.m_replacements->storeObject(import.hash, MaterialData(data, import.ignored));
+    }
+  }, import.data);
+
+  if (m_cacheWriter) {
+    m_cacheWriter->addMaterial(import.hash, *materialData, import.texturePaths);
+  }
+
+  return materialData;
+}
+
+MaterialData* UsdMod::Impl::processMaterial(Args& args, const pxr::UsdPrim& matPrim) {
+  ScopedCpuProfileZone();
+
+  auto imported = m_imports.materials.find(matPrim.GetPath());
+  if (imported != m_imports.materials.end()) {
+    return publishMaterial(args, imported->second);
+  }
+
+  // Not seen by the import stage, e.g. part of a secret replacement stage
+  MaterialImport import = importMaterial(matPrim);
+  return publishMaterial(args, import);
 }
 
 MaterialData* UsdMod::Impl::processMaterialUser(Args& args, const pxr::UsdPrim& prim) {
-  auto bindAPI = pxr::UsdShadeMaterialBindingAPI(prim);
-  auto boundMaterial = bindAPI.ComputeBoundMaterial();
-  if (boundMaterial) {
-    return processMaterial(args, boundMaterial.GetPrim());
+  const pxr::UsdPrim boundMaterial = getBoundMaterial(prim);
+  if (boundMaterial.IsValid()) {
+    return processMaterial(args, boundMaterial);
   }
   return nullptr;
 }
 
+XXH64_hash_t UsdMod::Impl::getOriginHash(const pxr::UsdPrim& prim) const {
+  auto imported = m_imports.originHashes.find(prim.GetPath());
+  if (imported != m_imports.originHashes.end()) {
+    return imported->second;
+  }
+  return getStrongestOpinionatedPathHash(prim);
+}
+
+pxr::UsdPrim UsdMod::Impl::getBoundMaterial(const pxr::UsdPrim& prim) const {
+  auto imported = m_imports.boundMaterials.find(prim.GetPath());
+  if (imported != m_imports.boundMaterials.end()) {
+    return imported->second;
+  }
+  auto bindAPI = pxr::UsdShadeMaterialBindingAPI(prim);
+  return bindAPI.ComputeBoundMaterial().GetPrim();
+}
+
+UsdMod::Impl::ImportStats UsdMod::Impl::importStage(const pxr::UsdStageRefPtr& stage) {
+  ScopedCpuProfileZone();
+
+  using ThreadPoolType = WorkerThreadPool<256, true, false>;
+
+  ImportStats stats;
+  const auto startTime = dxvk::high_resolution_clock::now();
+
+  // Discovery: gather the mesh prims of every replacement and the standalone materials.
+  // Mirrors what processReplacement() visits, anything missed here is simply imported
+  // inline when it is published.
+  std::vector<pxr::UsdPrim> meshPrims;
+  std::vector<pxr::UsdPrim> materialPrims;
+
+  auto discoverReplacement = [&meshPrims](const pxr::UsdPrim& rootPrim) {
+    if (rootPrim.IsA<pxr::UsdGeomMesh>()) {
+      meshPrims.push_back(rootPrim);
+    }
+    for (const pxr::UsdPrim& desc : rootPrim.GetFilteredDescendants(pxr::UsdPrimIsActive)) {
+      if (desc.IsA<pxr::UsdGeomMesh>()) {
+        meshPrims.push_back(desc);
+      }
+    }
+  };
+
+  pxr::UsdPrim meshes = stage->GetPrimAtPath(pxr::SdfPath("/RootNode/meshes"));
+  if (meshes.IsValid()) {
+    for (const pxr::UsdPrim& child : meshes.GetFilteredChildren(pxr::UsdPrimIsActive)) {
+      if (getModelHash(child) != 0) {
+        discoverReplacement(child);
+      }
+    }
+  }
+
+  pxr::UsdPrim lights = stage->GetPrimAtPath(pxr::SdfPath("/RootNode/lights"));
+  if (lights.IsValid()) {
+    for (const pxr::UsdPrim& child : lights.GetFilteredChildren(pxr::UsdPrimIsActive)) {
+      if (getLightHash(child) != 0) {
+        discoverReplacement(child);
+      }
+    }
+  }
+
+  pxr::UsdPrim materialRoot = stage->GetPrimAtPath(pxr::SdfPath("/RootNode/Looks"));
+  if (materialRoot.IsValid()) {
+    for (const pxr::UsdPrim& child : materialRoot.GetFilteredChildren(pxr::UsdPrimIsActive)) {
+      materialPrims.push_back(child);
+    }
+  }
+
+  const uint32_t requestedThreads = RtxOptions::Get()->usdModLoadThreadCount();
+  stats.threadCount = requestedThreads != 0 ? requestedThreads : ThreadPoolType::getDefaultThreadCount() + 1;
+
+  // Note: The calling thread participates in the parallel loops, so the pool only needs the remaining threads
+  std::unique_ptr<ThreadPoolType> threadPool;
+  if (stats.threadCount > 1) {
+    threadPool = std::make_unique<ThreadPoolType>(static_cast<uint8_t>(std::min(stats.threadCount - 1, 255u)), "rtx-usd-mod-load");
+  }
+
+  auto parallelFor = [&threadPool](size_t count, const auto& func) {
+    if (threadPool) {
+      threadPool->parallelFor(0, static_cast<uint32_t>(count), 1, func);
+    } else {
+      for (uint32_t i = 0; i < count; i++) {
+        func(i);
+      }
+    }
+  };
+
+  // Resolve the origin hashes and material bindings of the prims and their subsets, which
+  // determine the unique meshes and materials to import. USD stages are safe to read from
+  // multiple threads as long as nothing edits them.
+  struct PrimInfo {
+    std::vector<std::pair<pxr::SdfPath, XXH64_hash_t>> originHashes;
+    std::vector<std::pair<pxr::SdfPath, pxr::UsdPrim>> boundMaterials;
+  };
+  std::vector<PrimInfo> primInfos(meshPrims.size());
+
+  parallelFor(meshPrims.size(), [&](uint32_t i) {
+    const pxr::UsdPrim& prim = meshPrims[i];
+    PrimInfo& info = primInfos[i];
+
+    auto resolve = [&info](const pxr::UsdPrim& p) {
+      info.originHashes.emplace_back(p.GetPath(), getStrongestOpinionatedPathHash(p));
+      info.boundMaterials.emplace_back(p.GetPath(), pxr::UsdShadeMaterialBindingAPI(p).ComputeBoundMaterial().GetPrim());
+    };
+
+    resolve(prim);
+    for (const pxr::UsdPrim& child : prim.GetFilteredChildren(pxr::UsdPrimIsActive)) {
+      if (child.IsA<pxr::UsdGeomSubset>()) {
+        resolve(child);
+      }
+    }
+  });
+
+  std::vector<std::pair<XXH64_hash_t, pxr::UsdPrim>> meshJobs;
+  std::unordered_set<XXH64_hash_t> uniqueMeshes;
+  for (size_t i = 0; i < meshPrims.size(); i++) {
+    const XXH64_hash_t primOriginHash = primInfos[i].originHashes.front().second;
+    if (uniqueMeshes.insert(primOriginHash).second) {
+      meshJobs.emplace_back(primOriginHash, meshPrims[i]);
+    }
+
+    for (auto& [path, hash] : primInfos[i].originHashes) {
+      m_imports.originHashes.emplace(path, hash);
+    }
+
+    for (auto& [path, material] : primInfos[i].boundMaterials) {
+      if (material.IsValid()) {
+        materialPrims.push_back(material);
+      }
+      m_imports.boundMaterials.emplace(path, material);
+    }
+  }
+
+  std::vector<pxr::UsdPrim> materialJobs;
+  std::unordered_set<pxr::SdfPath, pxr::SdfPath::Hash> uniqueMaterials;
+  for (const pxr::UsdPrim& material : materialPrims) {
+    if (uniqueMaterials.insert(material.GetPath()).second) {
+      materialJobs.push_back(material);
+    }
+  }
+
+  const auto importStartTime = dxvk::high_resolution_clock::now();
+
+  // Import: build the vertex data of every unique mesh and parse every unique material.
+  // Nothing is published from here, so the results do not depend on scheduling.
+  std::vector<MeshImport> meshImports(meshJobs.size());
+  std::vector<MaterialImport> materialImports(materialJobs.size());
+
+  parallelFor(meshJobs.size() + materialJobs.size(), [&](uint32_t i) {
+    if (i < meshJobs.size()) {
+      meshImports[i] = importMesh(meshJobs[i].second);
+    } else {
+      const size_t materialIndex = i - meshJobs.size();
+      materialImports[materialIndex] = importMaterial(materialJobs[materialIndex]);
+    }
+  });
+
+  for (size_t i = 0; i < meshJobs.size(); i++) {
+    const MeshImport& meshImport = meshImports[i];
+    if (meshImport.optimized) {
+      const lss::UsdMeshImporter::OptimizationStats& optimization = meshImport.optimization;
+      stats.optimizedMeshCount++;
+      stats.trianglesBefore += optimization.numTrianglesBefore;
+      stats.trianglesAfter += optimization.numTrianglesAfter;
+      stats.unusedVertices += optimization.numUnusedVertices;
+      stats.acmrBefore += double(optimization.acmrBefore) * optimization.numTrianglesBefore;
+      stats.acmrAfter += double(optimization.acmrAfter) * optimization.numTrianglesAfter;
+    }
+
+    m_imports.meshes.emplace(meshJobs[i].first, std::move(meshImports[i]));
+  }
+
+  if (stats.trianglesBefore > 0) {
+    stats.acmrBefore /= stats.trianglesBefore;
+  }
+  if (stats.trianglesAfter > 0) {
+    stats.acmrAfter /= stats.trianglesAfter;
+  }
+
+  for (size_t i = 0; i < materialJobs.size(); i++) {
+    m_imports.materials.emplace(materialJobs[i].GetPath(), std::move(materialImports[i]));
+  }
+
+  const auto endTime = dxvk::high_resolution_clock::now();
+
+  stats.meshCount = meshJobs.size();
+  stats.materialCount = materialJobs.size();
+  stats.discoveryMs = std::chrono::duration<double, std::milli>(importStartTime - startTime).count();
+  stats.importMs = std::chrono::duration<double, std::milli>(endTime - importStartTime).count();
+  return stats;
+}
+
 void UsdMod::Impl::processPrim(Args& args, pxr::UsdPrim& prim) {
   ScopedCpuProfileZone();
 
-  const XXH64_hash_t usdOriginHash = getStrongestOpinionatedPathHash(prim);
+  const XXH64_hash_t usdOriginHash = getOriginHash(prim);
 
 
   MeshReplacement* pTemp;
   if (!m_owner.m_replacements->getObject(usdOriginHash, pTemp)) {
     // First time seeing this mesh, then process it.
-    if (!processMesh(prim, args)) {
+    if (!processMesh(prim, usdOriginHash, args)) {
       return;
     }
   }
@@ -418,7 +724,7 @@ void UsdMod::Impl::processPrim(Args& args, pxr::UsdPrim& prim) {
     }
   } else {
     for (auto subset : geomSubsets) {
-      const XXH64_hash_t usdChildOriginHash = getStrongestOpinionatedPathHash(subset.GetPrim());
+      const XXH64_hash_t usdChildOriginHash = getOriginHash(subset.GetPrim());
       MeshReplacement* childGeometryData;
       if (m_owner.m_replacements->getObject(usdChildOriginHash, childGeometryData)) {
         AssetReplacement newReplacementMesh(childGeometryData, materialData, categoryFlags, replacementToObject);
@@ -607,10 +913,32 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
 
   m_owner.setState(State::Loading);
 
+  const fs::path cachePath = CompiledModCache::getCachePath(m_owner.m_filePath);
+  m_cacheWriter.reset();
+
+  if (RtxOptions::Get()->useCompiledModCache()) {
+    if (loadCompiledCache(context, cachePath)) {
+      m_openedFilePath = replacementsUsdPath;
+      m_fileModificationTime = fs::last_write_time(fs::path(m_openedFilePath));
+
+      context->emitMemoryBarrier(0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
+
+      m_owner.setState(State::Loaded);
+      return;
+    }
+
+    m_cacheWriter = std::make_unique<CompiledModCacheWriter>();
+  }
+
   pxr::UsdStageRefPtr stage = pxr::UsdStage::Open(replacementsUsdPath, pxr::UsdStage::LoadAll);
 
   if (!stage) {
     Logger::err(str::format("USD mod file failed parsing: ", std::filesystem::weakly_canonical(replacementsUsdPath).string()));
+    m_cacheWriter.reset();
     m_openedFilePath.clear();
     m_fileModificationTime = fs::file_time_type();
     m_owner.setState(State::Unloaded);
@@ -628,11 +956,19 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
     auto layerBasePath = std::filesystem::path(identifier).remove_filename();
     auto fullLayerBasePath = modBaseDirectory / layerBasePath;
     AssetDataManager::get().addSearchPath(i, fullLayerBasePath);
+
+    if (m_cacheWriter) {
+      m_cacheWriter->addSearchPath(i, fullLayerBasePath);
+    }
   }
 
   // Add stage's base path last.
   AssetDataManager::get().addSearchPath(sublayers.size(), modBaseDirectory);
 
+  if (m_cacheWriter) {
+    m_cacheWriter->addSearchPath(sublayers.size(), modBaseDirectory);
+  }
+
   m_fileModificationTime = fs::last_write_time(fs::path(m_openedFilePath));
   pxr::UsdGeomXformCache xformCache;
 
@@ -648,6 +984,14 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
     }
   }
 
+  if (m_cacheWriter) {
+    m_cacheWriter->setStatus(m_owner.m_status);
+  }
+
+  m_imports.clear();
+  const ImportStats importStats = importStage(stage);
+  const auto publishStartTime = dxvk::high_resolution_clock::now();
+
   fast_unordered_cache<uint32_t> variantCounts;
   pxr::UsdPrim meshes = stage->GetPrimAtPath(pxr::SdfPath("/RootNode/meshes"));
   if (meshes.IsValid()) {
@@ -663,16 +1007,32 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
 
         variantCounts[hash]++;
 
+        if (m_cacheWriter) {
+          m_cacheWriter->addReplacements(AssetReplacement::eMesh, hash, replacementVec);
+        }
+
         m_owner.m_replacements->set<AssetReplacement::eMesh>(hash, std::move(replacementVec));
       }
     }
   }
 
+  if (m_cacheWriter) {
+    for (const auto& [hash, count] : variantCounts) {
+      m_cacheWriter->addVariantCount(hash, count);
+    }
+  }
+
   // TODO: enter "secrets" section of USD as exported by Kit app
   TEMP_parseSecretReplacementVariants(variantCounts);
   for (auto& [hash, secretReplacements] : m_owner.m_replacements->secretReplacements()) {
     for (auto& secretReplacement : secretReplacements) {
       const std::string variantStage(modBaseDirectory.string() + secretReplacement.replacementPath);
+
+      // Note: Recorded even when missing, so the cache goes stale once the stage shows up
+      if (m_cacheWriter) {
+        m_cacheWriter->addDependency(variantStage);
+      }
+
       double dummy;
       if (!pxr::ArchGetModificationTime(variantStage.c_str(),&dummy)) {
         Logger::warn(
@@ -693,6 +1053,15 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
 
       processReplacement(args);
 
+      if (m_cacheWriter) {
+        for (const pxr::SdfLayerHandle& layer : pStage->GetUsedLayers()) {
+          if (!layer->GetRealPath().empty()) {
+            m_cacheWriter->addDependency(layer->GetRealPath());
+          }
+        }
+        m_cacheWriter->addReplacements(AssetReplacement::eMesh, variantHash, replacementVec);
+      }
+
       m_owner.m_replacements->set<AssetReplacement::eMesh>(variantHash, std::move(replacementVec));
     }
   }
@@ -708,6 +1077,10 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
 
         processReplacement(args);
 
+        if (m_cacheWriter) {
+          m_cacheWriter->addReplacements(AssetReplacement::eLight, hash, replacementVec);
+        }
+
         m_owner.m_replacements->set<AssetReplacement::eLight>(hash, std::move(replacementVec));
       }
     }
@@ -732,9 +1105,63 @@ void UsdMod::Impl::processUSD(const Rc<DxvkContext>& context) {
     VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
     VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR);
 
+  // Anything left over was imported for prims that ended up not being published
+  m_imports.clear();
+
+  const double publishMs = std::chrono::duration<double, std::milli>(dxvk::high_resolution_clock::now() - publishStartTime).count();
+  Logger::info(str::format("Processed USD mod ", replacementsUsdPath, ": discovery ", importStats.discoveryMs, " ms, import ", importStats.importMs,
+                           " ms (", importStats.meshCount, " meshes, ", importStats.materialCount, " materials, ", importStats.threadCount,
+                           " threads), publication ", publishMs, " ms"));
+
+  if (importStats.optimizedMeshCount > 0) {
+    Logger::info(str::format("Optimized ", importStats.optimizedMeshCount, " meshes: ACMR ", importStats.acmrBefore, " -> ", importStats.acmrAfter,
+                             ", removed ", importStats.trianglesBefore - importStats.trianglesAfter, " degenerate triangles and ",
+                             importStats.unusedVertices, " unused vertices"));
+  }
+
+  if (m_cacheWriter) {
+    for (const pxr::SdfLayerHandle& layer : stage->GetUsedLayers()) {
+      if (!layer->GetRealPath().empty()) {
+        m_cacheWriter->addDependency(layer->GetRealPath());
+      }
+    }
+    m_cacheWriter->write(cachePath);
+    m_cacheWriter.reset();
+  }
+
   m_owner.setState(State::Loaded);
 }
 
+bool UsdMod::Impl::loadCompiledCache(const Rc<DxvkContext>& context, const fs::path& cachePath) {
+  ScopedCpuProfileZone();
+
+  CompiledModCacheReader reader;
+  if (!reader.open(cachePath)) {
+    return false;
+  }
+
+  // Note: Search paths must be in place before the cached materials resolve their textures
+  for (const auto& [priority, searchPath] : reader.getSearchPaths()) {
+    AssetDataManager::get().addSearchPath(priority, searchPath);
+  }
+
+  auto loadTextureFn = [&](const std::string& resolvedTexturePath) {
+    return loadTexture(context, resolvedTexturePath);
+  };
+  auto nextGeomHashFn = [this]() {
+    return getNextGeomHash();
+  };
+
+  if (!reader.load(context, *m_owner.m_replacements, loadTextureFn, nextGeomHashFn)) {
+    AssetDataManager::get().clearSearchPaths();
+    return false;
+  }
+
+  m_owner.m_status = reader.getStatus();
+  TEMP_parseSecretReplacementVariants(reader.getVariantCounts());
+  return true;
+}
+
 void UsdMod::Impl::TEMP_parseSecretReplacementVariants(const fast_unordered_cache<uint32_t>& variantCounts) {
   auto lookupCount = [&variantCounts](XXH64_hash_t hash) -> auto {
     // NOTE: If there's no default replacement make sure secret variants are not default.
@@ -916,20 +1343,53 @@ Categorizer UsdMod::Impl::processCategoryFlags(const pxr::UsdPrim& prim) {
   return categoryFlags;
 }
 
-bool UsdMod::Impl::processMesh(const pxr::UsdPrim& prim, Args& args) {
-  MeshReplacement replacement;
-  RasterGeometry& geometryData = replacement.data;
+UsdMod::Impl::MeshImport UsdMod::Impl::importMesh(const pxr::UsdPrim& prim) {
+  ScopedCpuProfileZone();
 
-  std::unique_ptr<lss::UsdMeshImporter> processedMesh;
+  MeshImport import;
 
   try {
-    processedMesh = std::make_unique<lss::UsdMeshImporter>(prim);
+    import.mesh = std::make_unique<lss::UsdMeshImporter>(prim);
   }
   catch (DxvkError e) {
-    Logger::err(e.message());
+    import.error = e.message();
+    return import;
+  }
+
+  if (RtxOptions::Get()->optimizeReplacementMeshes()) {
+    import.optimization = import.mesh->Optimize();
+    import.optimized = true;
+  }
+
+  import.submeshHashes.reserve(import.mesh->GetSubMeshes().size());
+  for (const lss::UsdMeshImporter::SubMesh& submesh : import.mesh->GetSubMeshes()) {
+    import.submeshHashes.push_back(getStrongestOpinionatedPathHash(submesh.prim));
+  }
+
+  return import;
+}
+
+bool UsdMod::Impl::processMesh(const pxr::UsdPrim& prim, XXH64_hash_t usdOriginHash, Args& args) {
+  MeshReplacement replacement;
+  RasterGeometry& geometryData = replacement.data;
+
+  MeshImport import;
+  auto imported = m_imports.meshes.find(usdOriginHash);
+  if (imported != m_imports.meshes.end()) {
+    import = std::move(imported->second);
+    m_imports.meshes.erase(imported);
+  } else {
+    // Not seen by the import stage, e.g. part of a secret replacement stage
+    import = importMesh(prim);
+  }
+
+  if (import.mesh == nullptr) {
+    Logger::err(import.error);
     return false;
   }
 
+  std::unique_ptr<lss::UsdMeshImporter> processedMesh = std::move(import.mesh);
+
   geometryData.vertexCount = processedMesh->GetNumVertices();
 
   if (processedMesh->GetNumVertices() == 0) {
@@ -951,6 +1411,8 @@ bool UsdMod::Impl::processMesh(const pxr::UsdPrim& prim, Args& args) {
   const DxvkBufferSlice& vertexSlice = DxvkBufferSlice(vertexBuffer);
   memcpy(vertexSlice.mapPtr(0), processedMesh->GetVertexData().data(), vertexDataSize);
 
+  const uint32_t cachedVertexDataIndex = m_cacheWriter ? m_cacheWriter->addVertexData(processedMesh->GetVertexData().data(), vertexDataSize) : 0;
+
   for (const auto& element : processedMesh->GetVertexDecl()) {
     switch (element.attribute) {
     case lss::UsdMeshImporter::VertexPositions:
@@ -989,16 +1451,18 @@ bool UsdMod::Impl::processMesh(const pxr::UsdPrim& prim, Args& args) {
 
   geometryData.frontFace = processedMesh->IsRightHanded() ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
-  for (const lss::UsdMeshImporter::SubMesh& submesh : processedMesh->GetSubMeshes()) {
+  const auto& submeshes = processedMesh->GetSubMeshes();
+  for (size_t i = 0; i < submeshes.size(); i++) {
+    const lss::UsdMeshImporter::SubMesh& submesh = submeshes[i];
     if (submesh.GetNumIndices() == 0) {
       Logger::err(str::format("Prim: ", submesh.prim.GetPath().GetString(), ", does not have indices, this is currently a requirement."));
       continue;
     }
 
-    XXH64_hash_t usdOriginHash = getStrongestOpinionatedPathHash(submesh.prim);
+    const XXH64_hash_t submeshOriginHash = import.submeshHashes[i];
     MeshReplacement* childGeometryData;
-    if (!m_owner.m_replacements->getObject(usdOriginHash, childGeometryData)) {
-      MeshReplacement& newReplacement = m_owner.m_replacements->storeObject(usdOriginHash, MeshReplacement(replacement));
+    if (!m_owner.m_replacements->getObject(submeshOriginHash, childGeometryData)) {
+      MeshReplacement& newReplacement = m_owner.m_replacements->storeObject(submeshOriginHash, MeshReplacement(replacement));
       RasterGeometry& newGeomData = newReplacement.data;
 
       const size_t indexDataSize = submesh.GetNumIndices() * sizeof(uint32_t);
@@ -1013,6 +1477,10 @@ bool UsdMod::Impl::processMesh(const pxr::UsdPrim& prim, Args& args) {
       // Set these as hashed so that the geometryData acts like it's static.
       newGeomData.hashes[HashComponents::Indices] = newGeomData.hashes[HashComponents::VertexPosition] = getNextGeomHash();
       newGeomData.hashes.precombine();
+
+      if (m_cacheWriter) {
+        m_cacheWriter->addGeometry(submeshOriginHash, newReplacement, cachedVertexDataIndex, submesh.indexBuffer.data());
+      }
     }
   }
 
@@ -0,0 +1,517 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "rtx_mod_usd_cache.h"
+#include "rtx_lights_data.h"
+#include "rtx_options.h"
+
+#include "dxvk_device.h"
+#include "dxvk_context.h"
+
+#include "../../util/log/log.h"
+#include "../../util/util_string.h"
+
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace dxvk {
+  using namespace CompiledModCache;
+
+  namespace {
+    // Vertex attributes in the order they are stored in a cached geometry
+    constexpr RasterBuffer RasterGeometry::* kCachedAttributes[] = {
+      &RasterGeometry::positionBuffer,
+      &RasterGeometry::normalBuffer,
+      &RasterGeometry::texcoordBuffer,
+      &RasterGeometry::color0Buffer,
+      &RasterGeometry::blendWeightBuffer,
+      &RasterGeometry::blendIndicesBuffer,
+    };
+    static_assert(std::size(kCachedAttributes) == kCachedAttributeCount);
+    constexpr uint32_t kTexcoordAttribute = 2;
+
+    struct CachedReplacement {
+      enum Flags : uint32_t {
+        kHasGeometry = 1 << 0,
+        kHasMaterial = 1 << 1,
+        kHasLight = 1 << 2,
+        kIncludeOriginal = 1 << 3,
+      };
+
+      uint32_t type;
+      uint32_t flags;
+      XXH64_hash_t geometryHash;
+      XXH64_hash_t materialHash;
+      Categorizer categories;
+      Matrix4 replacementToObject;
+      // Followed by the raw light data when kHasLight is set
+    };
+
+    static_assert(std::is_trivially_copyable_v<CachedReplacement>);
+
+    // Same buffer setup UsdMod uses for the replacement geometry it processes
+    Rc<DxvkBuffer> createReplacementBuffer(const Rc<DxvkContext>& context, size_t size) {
+      DxvkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+      info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+      info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+      info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+      info.size = dxvk::align(size, CACHE_LINE_SIZE);
+
+      return context->getDevice()->createBuffer(info, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, DxvkMemoryStats::Category::RTXBuffer);
+    }
+  }
+
+  namespace CompiledModCache {
+    fs::path getCachePath(const fs::path& modFilePath) {
+      fs::path cachePath = modFilePath;
+      cachePath += ".rtxmodcache";
+      return cachePath;
+    }
+
+    XXH64_hash_t getLayoutHash() {
+      const uint64_t layout[] = {
+        sizeof(CachedGeometry),
+        sizeof(CachedReplacement),
+        sizeof(LightData),
+        sizeof(OpaqueMaterialData),
+        sizeof(TranslucentMaterialData),
+        sizeof(RayPortalMaterialData),
+        // Baked into the replacement transforms
+        RtxOptions::Get()->isLHS(),
+        // Baked into the vertex and index data
+        RtxOptions::Get()->optimizeReplacementMeshes(),
+      };
+      return XXH3_64bits(layout, sizeof(layout));
+    }
+  }
+
+  void CompiledModCacheWriter::addDependency(const fs::path& path) {
+    Dependency dependency;
+    if (!captureDependency(path, dependency)) {
+      invalidate("unable to read a layer");
+      return;
+    }
+
+    m_manifest.dependencies.push_back(std::move(dependency));
+  }
+
+  void CompiledModCacheWriter::addSearchPath(uint32_t priority, const fs::path& path) {
+    m_manifest.searchPaths.emplace_back(priority, path.string());
+  }
+
+  void CompiledModCacheWriter::addVariantCount(XXH64_hash_t hash, uint32_t count) {
+    m_manifest.variantCounts.emplace_back(hash, count);
+  }
+
+  uint32_t CompiledModCacheWriter::addVertexData(const void* data, size_t size) {
+    writeValue(m_vertexData, static_cast<uint64_t>(size));
+    writeBytes(m_vertexData, data, size);
+    return m_vertexDataCount++;
+  }
+
+  void CompiledModCacheWriter::addGeometry(XXH64_hash_t hash, const MeshReplacement& geometry, uint32_t vertexDataIndex, const uint32_t* indices) {
+    const RasterGeometry& data = geometry.data;
+
+    CachedGeometry cached {};
+    cached.hash = hash;
+    cached.vertexDataIndex = vertexDataIndex;
+    cached.vertexCount = data.vertexCount;
+    cached.indexCount = data.indexCount;
+    cached.numBonesPerVertex = data.numBonesPerVertex;
+    cached.topology = data.topology;
+    cached.cullMode = data.cullMode;
+    cached.frontFace = data.frontFace;
+    cached.forceCullBit = data.forceCullBit;
+
+    for (uint32_t i = 0; i < kCachedAttributeCount; i++) {
+      const RasterBuffer& buffer = data.*kCachedAttributes[i];
+      if (buffer.defined()) {
+        cached.attributes[i].offset = buffer.offsetFromSlice();
+        cached.attributes[i].stride = buffer.stride();
+        cached.attributes[i].format = buffer.vertexFormat();
+      }
+    }
+
+    writeValue(m_geometries, cached);
+    writeBytes(m_geometries, indices, data.indexCount * sizeof(uint32_t));
+
+    m_geometryHashes[&geometry] = hash;
+    m_geometryCount++;
+  }
+
+  void CompiledModCacheWriter::addMaterial(XXH64_hash_t hash, const MaterialData& material, const TexturePaths& texturePaths) {
+    writeValue(m_materials, hash);
+    writeValue(m_materials, material.getType());
+    writeValue(m_materials, static_cast<uint8_t>(material.getIgnored()));
+
+    auto writeConstant = [this](const void* data, size_t size) {
+      writeBytes(m_materials, data, size);
+    };
+    auto writeTexture = [this, &texturePaths](const pxr::TfToken& token) {
+      auto it = texturePaths.find(token.GetString());
+      writeString(m_materials, it != texturePaths.end() ? it->second : std::string());
+    };
+
+    switch (material.getType()) {
+    case MaterialDataType::Opaque:
+      material.getOpaqueMaterialData().serializeCached(writeConstant, writeTexture);
+      break;
+    case MaterialDataType::Translucent:
+      material.getTranslucentMaterialData().serializeCached(writeConstant, writeTexture);
+      break;
+    case MaterialDataType::RayPortal:
+      material.getRayPortalMaterialData().serializeCached(writeConstant, writeTexture);
+      break;
+    default:
+      invalidate("unsupported material type");
+      return;
+    }
+
+    m_materialHashes[&material] = hash;
+    m_materialCount++;
+  }
+
+  void CompiledModCacheWriter::addReplacements(AssetReplacement::Type type, XXH64_hash_t hash, const std::vector<AssetReplacement>& replacements) {
+    writeValue(m_replacements, static_cast<uint32_t>(type));
+    writeValue(m_replacements, hash);
+    writeValue(m_replacements, static_cast<uint32_t>(replacements.size()));
+
+    for (const AssetReplacement& replacement : replacements) {
+      CachedReplacement cached {};
+      cached.type = replacement.type;
+      cached.categories = replacement.categories;
+      cached.replacementToObject = replacement.replacementToObject;
+
+      if (replacement.includeOriginal) {
+        cached.flags |= CachedReplacement::kIncludeOriginal;
+      }
+
+      if (replacement.type == AssetReplacement::eMesh) {
+        auto geometry = m_geometryHashes.find(replacement.geometry);
+        if (geometry == m_geometryHashes.end()) {
+          invalidate("replacement references an unrecorded geometry");
+          return;
+        }
+        cached.flags |= CachedReplacement::kHasGeometry;
+        cached.geometryHash = geometry->second;
+
+        if (replacement.materialData != nullptr) {
+          auto material = m_materialHashes.find(replacement.materialData);
+          if (material == m_materialHashes.end()) {
+            invalidate("replacement references an unrecorded material");
+            return;
+          }
+          cached.flags |= CachedReplacement::kHasMaterial;
+          cached.materialHash = material->second;
+        }
+      }
+
+      if (replacement.lightData.has_value()) {
+        cached.flags |= CachedReplacement::kHasLight;
+      }
+
+      writeValue(m_replacements, cached);
+
+      if (replacement.lightData.has_value()) {
+        writeValue(m_replacements, replacement.lightData.value());
+      }
+    }
+
+    m_replacementCount++;
+  }
+
+  void CompiledModCacheWriter::invalidate(const char* reason) {
+    if (m_invalidReason == nullptr) {
+      m_invalidReason = reason;
+    }
+  }
+
+  bool CompiledModCacheWriter::write(const fs::path& path) const {
+    if (m_invalidReason != nullptr) {
+      Logger::info(str::format("Not writing compiled mod cache ", path.string(), ": ", m_invalidReason));
+      return false;
+    }
+
+    const std::vector<Section> sections = {
+      { m_vertexDataCount, &m_vertexData },
+      { m_geometryCount, &m_geometries },
+      { m_materialCount, &m_materials },
+      { m_replacementCount, &m_replacements },
+    };
+
+    if (!writeFile(path, kVersion, getLayoutHash(), m_manifest, sections)) {
+      return false;
+    }
+
+    Logger::info(str::format("Wrote compiled mod cache ", path.string(), " (", m_geometryCount, " geometries, ",
+                             m_materialCount, " materials, ", m_replacementCount, " replacement sets)"));
+    return true;
+  }
+
+  bool CompiledModCacheReader::open(const fs::path& path) {
+    m_variantCounts.clear();
+
+    if (!m_file.open(path, kVersion, getLayoutHash())) {
+      return false;
+    }
+
+    for (const auto& [hash, count] : m_file.getManifest().variantCounts) {
+      m_variantCounts[hash] = count;
+    }
+
+    return true;
+  }
+
+  bool CompiledModCacheReader::load(const Rc<DxvkContext>& context, AssetReplacements& replacements,
+                                    const LoadTextureFn& loadTexture, const NextHashFn& nextGeomHash) {
+    ScopedCpuProfileZone();
+
+    if (!m_file.isOpen()) {
+      return false;
+    }
+
+    const std::string& path = m_file.getPath();
+    BlobReader reader = m_file.getPayload();
+
+    struct VertexData {
+      const void* data;
+      uint64_t size;
+    };
+
+    struct Geometry {
+      CachedGeometry desc;
+      const uint32_t* indices;
+    };
+
+    struct Replacements {
+      AssetReplacement::Type type;
+      XXH64_hash_t hash;
+      std::vector<std::pair<CachedReplacement, const void*>> entries;
+    };
+
+    // Parse and validate everything up front, the replacement storage
+    // must not end up partially populated from a broken cache.
+    std::vector<VertexData> vertexData;
+    const uint32_t vertexDataCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < vertexDataCount && !reader.failed(); i++) {
+      VertexData& entry = vertexData.emplace_back();
+      entry.size = reader.read<uint64_t>();
+      entry.data = reader.readBytes(entry.size);
+    }
+
+    std::vector<Geometry> geometries;
+    std::unordered_set<XXH64_hash_t> geometryHashes;
+    const uint32_t geometryCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < geometryCount && !reader.failed(); i++) {
+      Geometry& geometry = geometries.emplace_back();
+      geometry.desc = reader.read<CachedGeometry>();
+      geometry.indices = reinterpret_cast<const uint32_t*>(reader.readBytes(geometry.desc.indexCount * sizeof(uint32_t)));
+
+      const CachedGeometry& desc = geometry.desc;
+      if (reader.failed() || desc.vertexDataIndex >= vertexData.size() ||
+          !isValidGeometry(desc, geometry.indices, vertexData[desc.vertexDataIndex].size)) {
+        Logger::warn(str::format("Compiled mod cache ", path, " has malformed geometry, ignoring it."));
+        return false;
+      }
+
+      geometryHashes.insert(desc.hash);
+    }
+
+    auto readMaterials = [&path](BlobReader& source, const auto& readTexture, std::vector<std::pair<XXH64_hash_t, MaterialData>>& materials) {
+      auto readConstant = [&source](void* data, size_t size) {
+        source.readBytes(data, size);
+      };
+
+      const uint32_t materialCount = source.read<uint32_t>();
+      for (uint32_t i = 0; i < materialCount && !source.failed(); i++) {
+        const XXH64_hash_t hash = source.read<XXH64_hash_t>();
+        const MaterialDataType type = source.read<MaterialDataType>();
+        const bool ignored = source.read<uint8_t>() != 0;
+
+        switch (type) {
+        case MaterialDataType::Opaque:
+          materials.emplace_back(hash, MaterialData(OpaqueMaterialData::deserializeCached(readConstant, readTexture), ignored));
+          break;
+        case MaterialDataType::Translucent:
+          materials.emplace_back(hash, MaterialData(TranslucentMaterialData::deserializeCached(readConstant, readTexture), ignored));
+          break;
+        case MaterialDataType::RayPortal:
+          materials.emplace_back(hash, MaterialData(RayPortalMaterialData::deserializeCached(readConstant, readTexture)));
+          break;
+        default:
+          Logger::warn(str::format("Compiled mod cache ", path, " has a malformed material, ignoring it."));
+          return false;
+        }
+      }
+
+      return true;
+    };
+
+    // Textures are only loaded once the whole cache checked out, so the
+    // first pass over the materials skips their paths. The second pass
+    // below starts over from this copy of the reader.
+    const BlobReader materialReader = reader;
+
+    std::vector<std::pair<XXH64_hash_t, MaterialData>> materials;
+    auto skipTexture = [&reader](const pxr::TfToken&) {
+      reader.readString();
+      return TextureRef();
+    };
+
+    if (!readMaterials(reader, skipTexture, materials)) {
+      return false;
+    }
+
+    std::unordered_set<XXH64_hash_t> materialHashes;
+    for (const auto& [hash, material] : materials) {
+      materialHashes.insert(hash);
+    }
+
+    std::vector<Replacements> replacementSets;
+    const uint32_t replacementSetCount = reader.read<uint32_t>();
+    for (uint32_t i = 0; i < replacementSetCount && !reader.failed(); i++) {
+      Replacements& replacementSet = replacementSets.emplace_back();
+      replacementSet.type = static_cast<AssetReplacement::Type>(reader.read<uint32_t>());
+      replacementSet.hash = reader.read<XXH64_hash_t>();
+
+      const uint32_t entryCount = reader.read<uint32_t>();
+      for (uint32_t e = 0; e < entryCount && !reader.failed(); e++) {
+        const CachedReplacement cached = reader.read<CachedReplacement>();
+        const void* light = (cached.flags & CachedReplacement::kHasLight) ? reader.readBytes(sizeof(LightData)) : nullptr;
+
+        const bool valid =
+          (cached.type == AssetReplacement::eMesh || cached.type == AssetReplacement::eLight) &&
+          (!(cached.flags & CachedReplacement::kHasGeometry) || geometryHashes.count(cached.geometryHash)) &&
+          (!(cached.flags & CachedReplacement::kHasMaterial) || materialHashes.count(cached.materialHash)) &&
+          (cached.type != AssetReplacement::eMesh || (cached.flags & CachedReplacement::kHasGeometry)) &&
+          (cached.type != AssetReplacement::eLight || (cached.flags & CachedReplacement::kHasLight));
+
+        if (!valid && !reader.failed()) {
+          Logger::warn(str::format("Compiled mod cache ", path, " has a malformed replacement, ignoring it."));
+          return false;
+        }
+
+        replacementSet.entries.emplace_back(cached, light);
+      }
+    }
+
+    if (reader.failed() || reader.read<uint32_t>() != kEndMagic) {
+      Logger::warn(str::format("Compiled mod cache ", path, " is truncated, ignoring it."));
+      return false;
+    }
+
+    BlobReader textureReader = materialReader;
+    auto readTexture = [&textureReader, &loadTexture](const pxr::TfToken&) {
+      const std::string texturePath = textureReader.readString();
+      return TextureRef(texturePath.empty() ? nullptr : loadTexture(texturePath));
+    };
+
+    materials.clear();
+    readMaterials(textureReader, readTexture, materials);
+
+    // Everything checks out, create the replacements.
+    // Vertex data is copied straight out of the mapping into the buffers the geometries share.
+    std::vector<DxvkBufferSlice> vertexSlices;
+    std::vector<XXH64_hash_t> texcoordHashes(vertexData.size(), 0);
+    vertexSlices.reserve(vertexData.size());
+    for (const VertexData& entry : vertexData) {
+      const DxvkBufferSlice& slice = vertexSlices.emplace_back(createReplacementBuffer(context, entry.size));
+      memcpy(slice.mapPtr(0), entry.data, entry.size);
+    }
+
+    for (const Geometry& geometry : geometries) {
+      const CachedGeometry& desc = geometry.desc;
+      const DxvkBufferSlice& vertexSlice = vertexSlices[desc.vertexDataIndex];
+
+      MeshReplacement replacement;
+      RasterGeometry& data = replacement.data;
+      data.vertexCount = desc.vertexCount;
+      data.numBonesPerVertex = desc.numBonesPerVertex;
+      data.topology = VkPrimitiveTopology(desc.topology);
+      data.cullMode = VkCullModeFlags(desc.cullMode);
+      data.frontFace = VkFrontFace(desc.frontFace);
+      data.forceCullBit = desc.forceCullBit != 0;
+
+      for (uint32_t a = 0; a < kCachedAttributeCount; a++) {
+        const CachedAttribute& attribute = desc.attributes[a];
+        if (attribute.stride != 0) {
+          data.*kCachedAttributes[a] = RasterBuffer(vertexSlice, attribute.offset, attribute.stride, VkFormat(attribute.format));
+        }
+      }
+
+      // Note: Texcoord hashes are shared by all geometries sourcing the same vertex data, same as when processing the USD
+      if (desc.attributes[kTexcoordAttribute].stride != 0) {
+        XXH64_hash_t& texcoordHash = texcoordHashes[desc.vertexDataIndex];
+        if (texcoordHash == 0) {
+          texcoordHash = nextGeomHash();
+        }
+        data.hashes[HashComponents::VertexTexcoord] = texcoordHash;
+      }
+
+      const size_t indexDataSize = desc.indexCount * sizeof(uint32_t);
+      const DxvkBufferSlice indexSlice(createReplacementBuffer(context, indexDataSize));
+      memcpy(indexSlice.mapPtr(0), geometry.indices, indexDataSize);
+      data.indexBuffer = RasterBuffer(indexSlice, 0, sizeof(uint32_t), VK_INDEX_TYPE_UINT32);
+      data.indexCount = desc.indexCount;
+      data.hashes[HashComponents::Indices] = data.hashes[HashComponents::VertexPosition] = nextGeomHash();
+      data.hashes.precombine();
+
+      replacements.storeObject(desc.hash, std::move(replacement));
+    }
+
+    for (auto& [hash, material] : materials) {
+      replacements.storeObject(hash, std::move(material));
+    }
+
+    for (const Replacements& replacementSet : replacementSets) {
+      std::vector<AssetReplacement> replacementVec;
+      replacementVec.reserve(replacementSet.entries.size());
+
+      for (const auto& [cached, light] : replacementSet.entries) {
+        if (cached.type == AssetReplacement::eMesh) {
+          MeshReplacement* geometry = nullptr;
+          MaterialData* material = nullptr;
+          replacements.getObject(cached.geometryHash, geometry);
+          if (cached.flags & CachedReplacement::kHasMaterial) {
+            replacements.getObject(cached.materialHash, material);
+          }
+          replacementVec.emplace_back(geometry, material, cached.categories, cached.replacementToObject);
+        } else {
+          replacementVec.emplace_back(LightData::fromBytes(light));
+          replacementVec.back().categories = cached.categories;
+        }
+        replacementVec.back().includeOriginal = (cached.flags & CachedReplacement::kIncludeOriginal) != 0;
+      }
+
+      if (replacementSet.type == AssetReplacement::eMesh) {
+        replacements.set<AssetReplacement::eMesh>(replacementSet.hash, std::move(replacementVec));
+      } else {
+        replacements.set<AssetReplacement::eLight>(replacementSet.hash, std::move(replacementVec));
+      }
+    }
+
+    Logger::info(str::format("Loaded compiled mod cache ", path, " (", geometries.size(), " geometries, ",
+                             materials.size(), " materials, ", replacementSets.size(), " replacement sets)"));
+    return true;
+  }
+
+} // namespace dxvk
@@ -0,0 +1,158 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "rtx_types.h"
+#include "rtx_asset_replacer.h"
+#include "rtx_mod_usd_cache_file.h"
+
+#include "../../util/xxHash/xxhash.h"
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dxvk {
+  class DxvkContext;
+
+  /**
+   * \brief Compiled mod cache
+   *
+   * Binary snapshot of the replacements a USD mod produced when it was
+   * last processed: interleaved vertex data, indices, material parameters,
+   * lights and the hash to replacement tables, along with every layer the
+   * stage was composed from. Later loads of an unchanged mod map the cache
+   * and rebuild the replacements straight out of it, skipping USD entirely.
+   *
+   * The cache is only a shortcut, anything unexpected in it (version or
+   * layout mismatch, truncation, a changed layer) makes the mod fall back
+   * to regular USD processing, which then rewrites the cache.
+   */
+  namespace CompiledModCache {
+    // Bump whenever the format or the data the USD importer produces changes
+    constexpr uint32_t kVersion = 2;
+
+    // Returns the cache location for a mod file
+    std::filesystem::path getCachePath(const std::filesystem::path& modFilePath);
+
+    // Hash of everything besides the layers that shapes the cached data,
+    // i.e. sizes of the structures stored as raw bytes and the options
+    // applied while processing the USD.
+    XXH64_hash_t getLayoutHash();
+  }
+
+  /**
+   * \brief Compiled mod cache writer
+   *
+   * Collects the replacements as the USD mod processes them and writes
+   * the cache once the whole stage was processed successfully.
+   */
+  class CompiledModCacheWriter {
+  public:
+    // Maps a material texture token to the path the texture was resolved from
+    using TexturePaths = std::unordered_map<std::string, std::string>;
+
+    // Records a layer, or a file that was expected but missing, the cache depends on
+    void addDependency(const std::filesystem::path& path);
+
+    void addSearchPath(uint32_t priority, const std::filesystem::path& path);
+
+    void setStatus(const std::string& status) {
+      m_manifest.status = status;
+    }
+
+    void addVariantCount(XXH64_hash_t hash, uint32_t count);
+
+    // Records interleaved vertex data shared by the geometries of a mesh, returns its index
+    uint32_t addVertexData(const void* data, size_t size);
+
+    // Records a geometry referencing previously added vertex data
+    void addGeometry(XXH64_hash_t hash, const MeshReplacement& geometry, uint32_t vertexDataIndex, const uint32_t* indices);
+
+    void addMaterial(XXH64_hash_t hash, const MaterialData& material, const TexturePaths& texturePaths);
+
+    // Records replacements referencing previously added geometries and materials
+    void addReplacements(AssetReplacement::Type type, XXH64_hash_t hash, const std::vector<AssetReplacement>& replacements);
+
+    // Discards everything collected, e.g. when some data cannot be represented in the cache
+    void invalidate(const char* reason);
+
+    bool write(const std::filesystem::path& path) const;
+
+  private:
+    CompiledModCache::Manifest m_manifest;
+
+    std::vector<uint8_t> m_vertexData;
+    std::vector<uint8_t> m_geometries;
+    std::vector<uint8_t> m_materials;
+    std::vector<uint8_t> m_replacements;
+    uint32_t m_vertexDataCount = 0;
+    uint32_t m_geometryCount = 0;
+    uint32_t m_materialCount = 0;
+    uint32_t m_replacementCount = 0;
+
+    std::unordered_map<const MeshReplacement*, XXH64_hash_t> m_geometryHashes;
+    std::unordered_map<const MaterialData*, XXH64_hash_t> m_materialHashes;
+
+    const char* m_invalidReason = nullptr;
+  };
+
+  /**
+   * \brief Compiled mod cache reader
+   *
+   * Maps a cache file and validates it against the layers it was compiled
+   * from. Nothing is created until \c load is called, and \c load only
+   * loads textures and touches the replacement storage once the whole
+   * file has been parsed.
+   */
+  class CompiledModCacheReader {
+  public:
+    using LoadTextureFn = std::function<Rc<ManagedTexture>(const std::string&)>;
+    using NextHashFn = std::function<XXH64_hash_t()>;
+
+    // Maps the cache, returns false if it is missing, malformed or out of date
+    bool open(const std::filesystem::path& path);
+
+    const std::string& getStatus() const {
+      return m_file.getManifest().status;
+    }
+
+    const std::vector<std::pair<uint32_t, std::string>>& getSearchPaths() const {
+      return m_file.getManifest().searchPaths;
+    }
+
+    const fast_unordered_cache<uint32_t>& getVariantCounts() const {
+      return m_variantCounts;
+    }
+
+    // Creates the cached geometries, materials and replacements
+    bool load(const Rc<DxvkContext>& context, AssetReplacements& replacements,
+              const LoadTextureFn& loadTexture, const NextHashFn& nextGeomHash);
+
+  private:
+    CompiledModCache::MappedFile m_file;
+    fast_unordered_cache<uint32_t> m_variantCounts;
+  };
+
+} // namespace dxvk
@@ -0,0 +1,311 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "rtx_mod_usd_cache_file.h"
+
+#include "../../util/log/log.h"
+#include "../../util/util_string.h"
+
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace dxvk {
+  namespace {
+    bool hashFileContents(const fs::path& path, XXH64_hash_t& hash) {
+      std::ifstream file(path, std::ios::binary);
+      if (!file) {
+        return false;
+      }
+
+      XXH3_state_t* state = XXH3_createState();
+      XXH3_64bits_reset(state);
+
+      std::vector<char> chunk(1 << 20);
+      while (file) {
+        file.read(chunk.data(), chunk.size());
+        XXH3_64bits_update(state, chunk.data(), static_cast<size_t>(file.gcount()));
+      }
+
+      hash = XXH3_64bits_digest(state);
+      XXH3_freeState(state);
+      return true;
+    }
+  }
+
+  namespace CompiledModCache {
+    bool captureDependency(const fs::path& path, Dependency& dependency) {
+      dependency = Dependency {};
+      dependency.path = path.string();
+
+      std::error_code ec;
+      dependency.exists = fs::exists(path, ec);
+      if (dependency.exists) {
+        dependency.size = fs::file_size(path, ec);
+        dependency.modificationTime = fs::last_write_time(path, ec).time_since_epoch().count();
+        if (ec || !hashFileContents(path, dependency.contentHash)) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    bool isUpToDate(const Dependency& dependency) {
+      std::error_code ec;
+      bool upToDate = fs::exists(dependency.path, ec) == dependency.exists;
+      if (upToDate && dependency.exists) {
+        upToDate = fs::file_size(dependency.path, ec) == dependency.size;
+        if (upToDate && fs::last_write_time(dependency.path, ec).time_since_epoch().count() != dependency.modificationTime) {
+          XXH64_hash_t currentHash;
+          upToDate = hashFileContents(dependency.path, currentHash) && currentHash == dependency.contentHash;
+        }
+      }
+
+      return upToDate && !ec;
+    }
+
+    bool writeFile(const fs::path& path, uint32_t version, XXH64_hash_t layoutHash,
+                   const Manifest& manifest, const std::vector<Section>& sections) {
+      std::vector<uint8_t> header;
+
+      FileHeader fileHeader {};
+      memcpy(fileHeader.magic, kFileMagic, sizeof(kFileMagic));
+      fileHeader.version = version;
+      fileHeader.layoutHash = layoutHash;
+      writeValue(header, fileHeader);
+
+      writeValue(header, static_cast<uint32_t>(manifest.dependencies.size()));
+      for (const Dependency& dependency : manifest.dependencies) {
+        writeString(header, dependency.path);
+        writeValue(header, static_cast<uint8_t>(dependency.exists));
+        writeValue(header, dependency.modificationTime);
+        writeValue(header, dependency.size);
+        writeValue(header, dependency.contentHash);
+      }
+
+      writeString(header, manifest.status);
+
+      writeValue(header, static_cast<uint32_t>(manifest.searchPaths.size()));
+      for (const auto& [priority, searchPath] : manifest.searchPaths) {
+        writeValue(header, priority);
+        writeString(header, searchPath);
+      }
+
+      writeValue(header, static_cast<uint32_t>(manifest.variantCounts.size()));
+      for (const auto& [hash, count] : manifest.variantCounts) {
+        writeValue(header, hash);
+        writeValue(header, count);
+      }
+
+      fs::path tempPath = path;
+      tempPath += ".tmp";
+
+      {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+          Logger::warn(str::format("Unable to create compiled mod cache ", path.string()));
+          return false;
+        }
+
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+        for (const Section& section : sections) {
+          file.write(reinterpret_cast<const char*>(&section.count), sizeof(section.count));
+          file.write(reinterpret_cast<const char*>(section.data->data()), section.data->size());
+        }
+        file.write(reinterpret_cast<const char*>(&kEndMagic), sizeof(kEndMagic));
+
+        if (!file) {
+          file.close();
+          std::error_code ec;
+          fs::remove(tempPath, ec);
+          Logger::warn(str::format("Unable to write compiled mod cache ", path.string()));
+          return false;
+        }
+      }
+
+      std::error_code ec;
+      fs::rename(tempPath, path, ec);
+      if (ec) {
+        fs::remove(tempPath, ec);
+        Logger::warn(str::format("Unable to write compiled mod cache ", path.string()));
+        return false;
+      }
+
+      return true;
+    }
+
+    bool isValidGeometry(const CachedGeometry& geometry, const uint32_t* indices, uint64_t vertexDataSize) {
+      if (geometry.attributes[0].stride == 0) {
+        return false;
+      }
+
+      for (const CachedAttribute& attribute : geometry.attributes) {
+        if (attribute.stride != 0 &&
+            (attribute.offset >= attribute.stride || uint64_t(attribute.stride) * geometry.vertexCount > vertexDataSize)) {
+          return false;
+        }
+      }
+
+      for (uint32_t idx = 0; idx < geometry.indexCount; idx++) {
+        uint32_t index;
+        memcpy(&index, indices + idx, sizeof(index));
+        if (index >= geometry.vertexCount) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    MappedFile::~MappedFile() {
+      close();
+    }
+
+    bool MappedFile::open(const fs::path& path, uint32_t version, XXH64_hash_t layoutHash) {
+      close();
+      m_path = path.string();
+
+      std::error_code ec;
+      if (!fs::exists(path, ec)) {
+        return false;
+      }
+
+      m_mappingSize = fs::file_size(path, ec);
+      if (ec || m_mappingSize < sizeof(FileHeader)) {
+        return false;
+      }
+
+      FILE* handle = fopen(m_path.c_str(), "rb");
+      if (handle == nullptr) {
+        return false;
+      }
+
+#ifdef _WIN32
+      const HANDLE fileHandle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(handle)));
+      const HANDLE mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping != nullptr) {
+        // The view keeps the section alive, the mapping handle is not needed past this point
+        m_mapping = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+      }
+#else
+      void* view = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, fileno(handle), 0);
+      m_mapping = view != MAP_FAILED ? view : nullptr;
+#endif
+      fclose(handle);
+
+      if (m_mapping == nullptr) {
+        Logger::warn(str::format("Unable to map compiled mod cache ", m_path));
+        return false;
+      }
+
+      BlobReader reader(m_mapping, m_mappingSize);
+
+      const FileHeader fileHeader = reader.read<FileHeader>();
+      if (memcmp(fileHeader.magic, kFileMagic, sizeof(kFileMagic)) != 0 ||
+          fileHeader.version != version ||
+          fileHeader.layoutHash != layoutHash) {
+        Logger::info(str::format("Compiled mod cache ", m_path, " was built by a different runtime version, ignoring it."));
+        close();
+        return false;
+      }
+
+      m_manifest = Manifest {};
+
+      const uint32_t dependencyCount = reader.read<uint32_t>();
+      for (uint32_t i = 0; i < dependencyCount && !reader.failed(); i++) {
+        Dependency dependency;
+        dependency.path = reader.readString();
+        dependency.exists = reader.read<uint8_t>() != 0;
+        dependency.modificationTime = reader.read<int64_t>();
+        dependency.size = reader.read<uint64_t>();
+        dependency.contentHash = reader.read<XXH64_hash_t>();
+
+        if (reader.failed()) {
+          break;
+        }
+
+        if (!isUpToDate(dependency)) {
+          Logger::info(str::format("Compiled mod cache ", m_path, " is out of date, ", dependency.path, " has changed."));
+          close();
+          return false;
+        }
+
+        m_manifest.dependencies.push_back(std::move(dependency));
+      }
+
+      m_manifest.status = reader.readString();
+
+      const uint32_t searchPathCount = reader.read<uint32_t>();
+      for (uint32_t i = 0; i < searchPathCount && !reader.failed(); i++) {
+        const uint32_t priority = reader.read<uint32_t>();
+        m_manifest.searchPaths.emplace_back(priority, reader.readString());
+      }
+
+      const uint32_t variantCount = reader.read<uint32_t>();
+      for (uint32_t i = 0; i < variantCount && !reader.failed(); i++) {
+        const XXH64_hash_t hash = reader.read<XXH64_hash_t>();
+        m_manifest.variantCounts.emplace_back(hash, reader.read<uint32_t>());
+      }
+
+      if (reader.failed()) {
+        Logger::warn(str::format("Compiled mod cache ", m_path, " is truncated, ignoring it."));
+        close();
+        return false;
+      }
+
+      m_payloadOffset = reader.offset();
+      return true;
+    }
+
+    void MappedFile::close() {
+      if (m_mapping == nullptr) {
+        return;
+      }
+
+#ifdef _WIN32
+      UnmapViewOfFile(m_mapping);
+#else
+      munmap(m_mapping, m_mappingSize);
+#endif
+
+      m_mapping = nullptr;
+      m_payloadOffset = 0;
+    }
+
+    BlobReader MappedFile::getPayload() const {
+      BlobReader reader(m_mapping, m_mapping != nullptr ? m_mappingSize : 0);
+      reader.readBytes(m_payloadOffset);
+      return reader;
+    }
+  }
+
+} // namespace dxvk
@@ -0,0 +1,227 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "../../util/xxHash/xxhash.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+  /**
+   * \brief Compiled mod cache file
+   *
+   * Container the compiled mod cache is stored in, independent of the
+   * replacement types: a header, the manifest of layers the cache was
+   * compiled from, a number of counted sections and an end marker.
+   * Nothing in here trusts the file contents, every read is bounds
+   * checked and every recorded layer is checked against the disk.
+   */
+  namespace CompiledModCache {
+    constexpr char kFileMagic[4] = { 'R', 'M', 'D', 'C' };
+    constexpr uint32_t kEndMagic = 0x444e4521; // "!END"
+
+    struct FileHeader {
+      char magic[4];
+      uint32_t version;
+      XXH64_hash_t layoutHash;
+    };
+
+    // A layer, or a file that was expected but missing, the cache depends on
+    struct Dependency {
+      std::string path;
+      bool exists;
+      int64_t modificationTime;
+      uint64_t size;
+      XXH64_hash_t contentHash;
+    };
+
+    // Records the current state of a file, returns false if it exists but cannot be read
+    bool captureDependency(const std::filesystem::path& path, Dependency& dependency);
+
+    // Note: Touched but otherwise unchanged layers still match by content
+    bool isUpToDate(const Dependency& dependency);
+
+    struct Manifest {
+      std::vector<Dependency> dependencies;
+      std::string status;
+      std::vector<std::pair<uint32_t, std::string>> searchPaths;
+      std::vector<std::pair<XXH64_hash_t, uint32_t>> variantCounts;
+    };
+
+    struct Section {
+      uint32_t count;
+      const std::vector<uint8_t>* data;
+    };
+
+    // Writes next to the destination and moves the file in place once complete,
+    // so a crash mid-write never leaves a truncated cache behind.
+    bool writeFile(const std::filesystem::path& path, uint32_t version, XXH64_hash_t layoutHash,
+                   const Manifest& manifest, const std::vector<Section>& sections);
+
+    template<typename T>
+    void writeValue(std::vector<uint8_t>& out, const T& value) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+      out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    inline void writeBytes(std::vector<uint8_t>& out, const void* data, size_t size) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+      out.insert(out.end(), bytes, bytes + size);
+    }
+
+    inline void writeString(std::vector<uint8_t>& out, const std::string& str) {
+      writeValue(out, static_cast<uint32_t>(str.size()));
+      writeBytes(out, str.data(), str.size());
+    }
+
+    // Bounds checked cursor over the mapped cache. Any out of bounds access
+    // latches the failure state and yields zeroed values from there on, so
+    // parsers only need to check the state once they are done. Copying a
+    // reader remembers its position.
+    class BlobReader {
+    public:
+      BlobReader(const void* data, size_t size)
+        : m_data(reinterpret_cast<const uint8_t*>(data)), m_size(size) { }
+
+      const void* readBytes(size_t size) {
+        if (m_failed || size > m_size - m_offset) {
+          m_failed = true;
+          return nullptr;
+        }
+
+        const void* ptr = m_data + m_offset;
+        m_offset += size;
+        return ptr;
+      }
+
+      void readBytes(void* out, size_t size) {
+        if (const void* ptr = readBytes(size)) {
+          memcpy(out, ptr, size);
+        } else {
+          memset(out, 0, size);
+        }
+      }
+
+      template<typename T>
+      T read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        readBytes(&value, sizeof(T));
+        return value;
+      }
+
+      std::string readString() {
+        const uint32_t size = read<uint32_t>();
+        const char* str = reinterpret_cast<const char*>(readBytes(size));
+        return str ? std::string(str, size) : std::string();
+      }
+
+      bool failed() const { return m_failed; }
+      size_t offset() const { return m_offset; }
+
+    private:
+      const uint8_t* m_data;
+      size_t m_size;
+      size_t m_offset = 0;
+      bool m_failed = false;
+    };
+
+    // Position, normal, texcoord, color, blend weights and blend indices
+    constexpr uint32_t kCachedAttributeCount = 6;
+
+    struct CachedAttribute {
+      uint32_t offset;
+      uint32_t stride; // Zero when the attribute is not present
+      uint32_t format;
+    };
+
+    struct CachedGeometry {
+      XXH64_hash_t hash;
+      uint32_t vertexDataIndex;
+      uint32_t vertexCount;
+      uint32_t indexCount;
+      uint32_t numBonesPerVertex;
+      uint32_t topology;
+      uint32_t cullMode;
+      uint32_t frontFace;
+      uint32_t forceCullBit;
+      CachedAttribute attributes[kCachedAttributeCount];
+    };
+
+    static_assert(std::is_trivially_copyable_v<CachedGeometry>);
+
+    // Checks a geometry has positions and only references vertices within the
+    // vertex data it is stored with. Indices may be unaligned in the mapping.
+    bool isValidGeometry(const CachedGeometry& geometry, const uint32_t* indices, uint64_t vertexDataSize);
+
+    /**
+     * \brief Mapped cache file
+     *
+     * Maps a cache file and reads its manifest, the sections are
+     * left to the caller.
+     */
+    class MappedFile {
+    public:
+      MappedFile() = default;
+      ~MappedFile();
+
+      MappedFile(const MappedFile&) = delete;
+      MappedFile& operator=(const MappedFile&) = delete;
+
+      // Returns false if the file is missing, malformed, built with a
+      // different version or layout, or any of its layers changed
+      bool open(const std::filesystem::path& path, uint32_t version, XXH64_hash_t layoutHash);
+
+      void close();
+
+      bool isOpen() const {
+        return m_mapping != nullptr;
+      }
+
+      const std::string& getPath() const {
+        return m_path;
+      }
+
+      const Manifest& getManifest() const {
+        return m_manifest;
+      }
+
+      // Reader positioned at the first section
+      BlobReader getPayload() const;
+
+    private:
+      std::string m_path;
+      void* m_mapping = nullptr;
+      size_t m_mappingSize = 0;
+      size_t m_payloadOffset = 0;
+      Manifest m_manifest;
+    };
+  }
+
+} // namespace dxvk
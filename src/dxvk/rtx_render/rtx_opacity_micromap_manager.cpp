@@ -31,6 +31,7 @@
 #include "rtx_imgui.h"
 
 #include "rtx/pass/common_binding_indices.h"
+#include "../util/log/metrics.h"
 
 // #define VALIDATION_MODE
 
@@ -44,6 +45,8 @@ const VkDeviceSize kBufferAlignment = 16;
 const VkDeviceSize kBufferInBlasUsageAlignment = 256;
 
 namespace dxvk {
+  static MetricGauge s_ommUsedBytesMetric("omm.used_bytes");
+
   DxvkOpacityMicromap::DxvkOpacityMicromap(DxvkDevice& device) : m_vkd(device.vkd()) { }
 
   DxvkOpacityMicromap::~DxvkOpacityMicromap() {
@@ -1736,6 +1739,8 @@ namespace dxvk {
       // were not used in this frame and thus should go to a pending release queue of the last frame
       m_memoryManager.onFrameStart();
 
+      s_ommUsedBytesMetric.set(static_cast<double>(m_memoryManager.getUsed()));
+
       m_numMicroTrianglesBaked = 0;
       m_numMicroTrianglesBuilt = 0;
     }
@@ -792,6 +792,18 @@ namespace dxvk {
     RTX_OPTION("rtx", bool, enableReplacementMaterials, true,
                "Enables or disables enhanced material replacements.\n"
                "Requires replacement assets in general to be enabled to have any effect.");
+    RTX_OPTION("rtx", bool, useCompiledModCache, true,
+               "A flag controlling if USD mods should be loaded from a compiled mod cache when possible.\n"
+               "When enabled, the replacements a mod produces are written to a binary cache next to the mod file once it has been processed, and later loads of the unchanged mod rebuild its replacements from that cache rather than parsing the USD again.\n"
+               "The cache is validated against every layer the mod was composed from and is rebuilt automatically whenever any of them changes.");
+    RTX_OPTION("rtx", uint, usdModLoadThreadCount, 0,
+               "The number of threads used to import the meshes and materials of USD mods, including the loading thread itself.\n"
+               "0 picks a thread count based on the number of hardware threads, 1 imports everything on the loading thread.\n"
+               "Replacements are always published in the same order, so the result of a load does not depend on this setting.");
+    RTX_OPTION("rtx", bool, optimizeReplacementMeshes, false,
+               "A flag controlling if replacement meshes are optimized when a USD mod is loaded.\n"
+               "When enabled, degenerate triangles are removed, triangles are reordered for vertex cache reuse and vertices are reordered by first use, which helps both rasterization and acceleration structure builds.\n"
+               "The optimized meshes are stored in the compiled mod cache, so the cost is only paid when the cache is rebuilt.");
     RTX_OPTION("rtx", bool, forceHighResolutionReplacementTextures, false,
                "A flag to enable or disable forcing high resolution replacement textures.\n"
                "When enabled this mode overrides all other methods of mip calculation (adaptive resolution and the minimum mipmap level) and forces it to be 0 to always load in the highest quality of textures.\n"
@@ -818,6 +830,18 @@ namespace dxvk {
                "A flag controlling if the partial DDS loader should be used, true to enable, false to disable and use GLI instead.\n"
                "Generally this should be always enabled as it allows for simple parsing of DDS header information without loading the entire texture into memory like GLI does to retrieve similar information.\n"
                "Should only be set to false for debugging purposes if the partial DDS loader's logic is suspected to be incorrect to compare against GLI's implementation.");
+    RTX_OPTION("rtx", bool, useMemoryMappedDdsLoader, true,
+               "A flag controlling if the partial DDS loader should memory map texture files rather than reading them into intermediate buffers.\n"
+               "When enabled, texture data is read straight out of the file mapping during upload, avoiding an extra copy of each mip level in host memory, and evicted levels are unmapped.\n"
+               "Only relevant when the partial DDS loader is enabled. Falls back to regular reads if a file cannot be mapped.");
+    RTX_OPTION("rtx", bool, useMemoryMappedPackageLoader, true,
+               "A flag controlling if asset packages should be memory mapped and read without RTX IO.\n"
+               "When enabled, packages are mounted even if RTX IO is disabled and their uncompressed assets are read straight out of the file mapping, with the blobs of queued textures prefetched on background threads.\n"
+               "Compressed package assets are decoded on the CPU in that case, which requires a build with the GDeflate library.");
+    RTX_OPTION("rtx", bool, verifyPackageChecksums, true,
+               "A flag controlling if the checksums of asset package data blobs should be verified.\n"
+               "Blobs are verified on background threads when they are prefetched, or on the loading thread if they are read before that, and assets with corrupted blobs fail to load.\n"
+               "Only packages of version 2 or later carry checksums.");
 
     RTX_OPTION("rtx", TonemappingMode, tonemappingMode, TonemappingMode::Local,
                "The tonemapping type to use, 0 for Global, 1 for Local (Default).\n"
@@ -784,8 +784,38 @@ namespace dxvk {
     }
   }
 
+  // Rough fraction of the screen covered by a draw, derived from the bounding sphere of its geometry.
+  // Only used to prioritize texture streaming, so draws without a bounding box or a valid camera
+  // are treated as covering the whole screen.
+  static float estimateScreenCoverage(const RtCamera& camera, uint32_t frameId, const DrawCallState& drawCallState) {
+    const AxisAlignedBoundingBox& boundingBox = drawCallState.getGeometryData().boundingBox;
+    if (!boundingBox.isValid() || !camera.isValid(frameId)) {
+      return 1.f;
+    }
+
+    const Matrix4& objectToWorld = drawCallState.getTransformData().objectToWorld;
+    const Matrix4 objectToView = camera.getWorldToView(false) * objectToWorld;
+
+    const float scale = std::max({ length(objectToWorld[0].xyz()), length(objectToWorld[1].xyz()), length(objectToWorld[2].xyz()) });
+    const float radius = 0.5f * length(boundingBox.maxPos - boundingBox.minPos) * scale;
+
+    const Vector3 center = 0.5f * (boundingBox.minPos + boundingBox.maxPos);
+    const float distance = length((objectToView * Vector4(center.x, center.y, center.z, 1.f)).xyz());
+
+    if (distance <= radius) {
+      return 1.f;
+    }
+
+    // Projected sphere radius relative to half the screen height, and the area of its disc on screen
+    const float tanHalfFov = std::tan(camera.getFov() * 0.5f);
+    const float projectedRadius = radius / (std::sqrt(distance * distance - radius * radius) * tanHalfFov);
+    const float aspectRatio = std::max(camera.getAspectRatio(), 1e-3f);
+
+    return std::min(kPi * projectedRadius * projectedRadius / (4.f * aspectRatio), 1.f);
+  }
+
   // Helper to populate the texture cache with this resource (and patch sampler if required for texture)
-  void SceneManager::trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool allowAsync) {
+  void SceneManager::trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool allowAsync, float screenCoverage) {
     // If no texcoords, no need to bind the texture
     if (!hasTexcoords) {
       ONCE(Logger::info(str::format("[RTX-Compatibility-Info] Trying to bind a texture to a mesh without UVs.  Was this intended?")));
@@ -793,7 +823,7 @@ namespace dxvk {
     }
 
     auto& textureManager = m_device->getCommon()->getTextureManager();
-    textureManager.addTexture(ctx, inputTexture, allowAsync, textureIndex);
+    textureManager.addTexture(ctx, inputTexture, allowAsync, textureIndex, screenCoverage);
   }
 
   uint64_t SceneManager::processDrawCallState(Rc<DxvkContext> ctx, const DrawCallState& drawCallState, const MaterialData* overrideMaterialData) {
@@ -828,6 +858,7 @@ namespace dxvk {
     std::optional<RtSurfaceMaterial> surfaceMaterial{};
 
     const bool hasTexcoords = drawCallState.hasTextureCoordinates();
+    const float screenCoverage = estimateScreenCoverage(getCamera(), m_device->getCurrentFrameId(), drawCallState);
 
     // We're going to use this to create a modified sampler for replacement textures.
     // Legacy and replacement materials should follow same filtering but due to lack of override capability per texture
@@ -889,7 +920,7 @@ namespace dxvk {
         } else {
           if (defaults.useAlbedoTextureIfPresent()) {
             // NOTE: Do not patch original sampler to preserve filtering behavior of the legacy material
-            trackTexture(ctx, legacyMaterialData.getColorTexture(), albedoOpacityTextureIndex, hasTexcoords);
+            trackTexture(ctx, legacyMaterialData.getColorTexture(), albedoOpacityTextureIndex, hasTexcoords, true, screenCoverage);
           }
         }
 
@@ -913,9 +944,9 @@ namespace dxvk {
           metallicConstant = 0.f;
           roughnessConstant = 1.f;
         } else {
-          trackTexture(ctx, opaqueMaterialData.getAlbedoOpacityTexture(), albedoOpacityTextureIndex, hasTexcoords);
-          trackTexture(ctx, opaqueMaterialData.getRoughnessTexture(), roughnessTextureIndex, hasTexcoords);
-          trackTexture(ctx, opaqueMaterialData.getMetallicTexture(), metallicTextureIndex, hasTexcoords);
+          trackTexture(ctx, opaqueMaterialData.getAlbedoOpacityTexture(), albedoOpacityTextureIndex, hasTexcoords, true, screenCoverage);
+          trackTexture(ctx, opaqueMaterialData.getRoughnessTexture(), roughnessTextureIndex, hasTexcoords, true, screenCoverage);
+          trackTexture(ctx, opaqueMaterialData.getMetallicTexture(), metallicTextureIndex, hasTexcoords, true, screenCoverage);
 
           albedoOpacityConstant.xyz() = opaqueMaterialData.getAlbedoConstant();
           albedoOpacityConstant.w = opaqueMaterialData.getOpacityConstant();
@@ -923,10 +954,10 @@ namespace dxvk {
           roughnessConstant = opaqueMaterialData.getRoughnessConstant();
         }
 
-        trackTexture(ctx, opaqueMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords);
-        trackTexture(ctx, opaqueMaterialData.getTangentTexture(), tangentTextureIndex, hasTexcoords);
-        trackTexture(ctx, opaqueMaterialData.getHeightTexture(), heightTextureIndex, hasTexcoords);
-        trackTexture(ctx, opaqueMaterialData.getEmissiveColorTexture(), emissiveColorTextureIndex, hasTexcoords);
+        trackTexture(ctx, opaqueMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords, true, screenCoverage);
+        trackTexture(ctx, opaqueMaterialData.getTangentTexture(), tangentTextureIndex, hasTexcoords, true, screenCoverage);
+        trackTexture(ctx, opaqueMaterialData.getHeightTexture(), heightTextureIndex, hasTexcoords, true, screenCoverage);
+        trackTexture(ctx, opaqueMaterialData.getEmissiveColorTexture(), emissiveColorTextureIndex, hasTexcoords, true, screenCoverage);
 
         emissiveIntensity = opaqueMaterialData.getEmissiveIntensity();
         emissiveColorConstant = opaqueMaterialData.getEmissiveColorConstant();
@@ -975,9 +1006,9 @@ namespace dxvk {
       uint32_t transmittanceTextureIndex = kSurfaceMaterialInvalidTextureIndex;
       uint32_t emissiveColorTextureIndex = kSurfaceMaterialInvalidTextureIndex;
 
-      trackTexture(ctx, translucentMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords);
-      trackTexture(ctx, translucentMaterialData.getTransmittanceTexture(), transmittanceTextureIndex, hasTexcoords);
-      trackTexture(ctx, translucentMaterialData.getEmissiveColorTexture(), emissiveColorTextureIndex, hasTexcoords);
+      trackTexture(ctx, translucentMaterialData.getNormalTexture(), normalTextureIndex, hasTexcoords, true, screenCoverage);
+      trackTexture(ctx, translucentMaterialData.getTransmittanceTexture(), transmittanceTextureIndex, hasTexcoords, true, screenCoverage);
+      trackTexture(ctx, translucentMaterialData.getEmissiveColorTexture(), emissiveColorTextureIndex, hasTexcoords, true, screenCoverage);
 
       float refractiveIndex = translucentMaterialData.getRefractiveIndex();
       Vector3 transmittanceColor = translucentMaterialData.getTransmittanceColor();
@@ -198,7 +198,7 @@ public:
   void triggerUsdCapture() const;
   bool isGameCapturerIdle() const;
 
-  void trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool allowAsync = true);
+  void trackTexture(Rc<DxvkContext> ctx, TextureRef inputTexture, uint32_t& textureIndex, bool hasTexcoords, bool allowAsync = true, float screenCoverage = 1.f);
   void trackSampler(Rc<DxvkSampler> sampler, bool patchSampler, uint32_t& samplerIndex);
 
   std::future<XXH64_hash_t> findLegacyTextureHashBySurfaceMaterialIndex(uint32_t surfaceMaterialIndex);
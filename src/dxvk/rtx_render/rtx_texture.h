@@ -25,6 +25,7 @@
 #include "dxvk_context_state.h"
 #include "rtx_asset_data.h"
 #include "rtx_constants.h"
+#include "../../util/util_time.h"
 
 namespace gli {
   class texture;
@@ -91,6 +92,15 @@ namespace dxvk {
     size_t uniqueKey = kInvalidTextureKey;
     bool canDemote = true;
     uint32_t frameQueuedForUpload = 0;
+    // Set when an upload is queued, cleared by the texture manager worker when it drops the upload
+    // and by the rendering thread when it times the promotion, so it's atomic
+    std::atomic<dxvk::high_resolution_clock::time_point> timeQueuedForUpload = dxvk::high_resolution_clock::time_point();
+
+    // Streaming priority inputs, refreshed by RtxTextureManager::addTexture on every use of the texture.
+    // Written by the rendering thread and read by the texture manager worker, so tearing between them is benign.
+    std::atomic<uint32_t> frameLastUsed = 0;
+    std::atomic<uint32_t> instanceCount = 0;             // number of draws referencing the texture in frameLastUsed
+    std::atomic<float> screenCoverage = 0.f;             // largest fraction of the screen covered by those draws
 
     bool good() const {
       return state != State::kUnknown && state != State::kFailed;
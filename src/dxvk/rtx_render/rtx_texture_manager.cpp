@@ -26,23 +26,69 @@
 #include "dxvk_device.h"
 #include "dxvk_scoped_annotation.h"
 #include <chrono>
+#include <cmath>
 
 #include "rtx_texture.h"
 #include "rtx_io.h"
+#include "../util/log/metrics.h"
 
 namespace dxvk {
+  static MetricCounter s_texturesPromotedMetric("textures.promoted");
+  static MetricHistogram s_timeToFullResMetric("textures.time_to_full_res_ms");
+
   constexpr VkDeviceSize MiBPerGiB = 1024;
   // Remix needs at least two frames to completely evict the demoted textures.
   // After a global texture demotion event, texture manager will delay future texture promotions
   // by this number of frames to make sure the previously used memory is released and there
   // will be no overcommit.
   constexpr uint32_t kPromotionDelayFrames = 2;
+  // Lower bound of the screen coverage used in promotion priorities, so that textures
+  // on tiny or distant draws are still ordered by their usage rather than all tying at zero.
+  constexpr float kMinPriorityScreenCoverage = 1.f / 4096.f;
+
+  // Whether the worker may load a texture right away, see RtxTextureManager::work
+  static bool isReadyForUpload(const ManagedTexture& texture, uint32_t currentFrame) {
+    return RtxIo::enabled() || RtxOptions::Get()->alwaysWaitForAsyncTextures() || texture.frameQueuedForUpload < currentFrame;
+  }
+
+  uint32_t TexturePromotionPolicy::currentFrame() const {
+    return m_device->getCurrentFrameId();
+  }
+
+  bool TexturePromotionPolicy::prioritize() const {
+    return RtxTextureManager::prioritizePromotions();
+  }
+
+  bool TexturePromotionPolicy::isReady(const Rc<ManagedTexture>& texture, uint32_t currentFrame) const {
+    return isReadyForUpload(*texture, currentFrame);
+  }
+
+  float TexturePromotionPolicy::calcPriority(const ManagedTexture& texture, uint32_t currentFrame) {
+    const uint32_t frameLastUsed = texture.frameLastUsed.load(std::memory_order_relaxed);
+    const uint32_t framesUnused = currentFrame > frameLastUsed ? currentFrame - frameLastUsed : 0;
+
+    const float screenCoverage = std::max(texture.screenCoverage.load(std::memory_order_relaxed), kMinPriorityScreenCoverage);
+    const float instanceWeight = 1.f + std::log2(1.f + static_cast<float>(texture.instanceCount.load(std::memory_order_relaxed)));
+
+    return screenCoverage * instanceWeight / static_cast<float>(1 + framesUnused);
+  }
 
   void RtxTextureManager::work(Rc<ManagedTexture>& texture, Rc<DxvkContext>& ctx) {
     if (m_dropRequests) {
       flushRtxIo(false);
     }
 
+    // Drop requests for textures which went out of use while waiting in the queue. The texture
+    // goes back to its initialized state so the promotion is requested anew once it's used again.
+    const uint32_t staleFrames = stalePromotionFrames();
+    if (!m_dropRequests && staleFrames > 0 &&
+        texture->frameLastUsed + staleFrames < m_pDevice->getCurrentFrameId()) {
+      texture->timeQueuedForUpload.store(dxvk::high_resolution_clock::time_point(), std::memory_order_relaxed);
+      texture->state = ManagedTexture::State::kInitialized;
+      ++m_numPreemptedTextures;
+      return;
+    }
+
     const bool alwaysWait = RtxOptions::Get()->alwaysWaitForAsyncTextures();
 
     // Wait until the next frame since the texture's been queued for upload, to relieve some pressure from frames
@@ -63,7 +109,7 @@ namespace dxvk {
   }
 
   RtxTextureManager::RtxTextureManager(DxvkDevice* device)
-    : RenderProcessor(device, "rtx-texture-manager")
+    : RenderProcessor(device, "rtx-texture-manager", device)
     , m_pDevice(device) {
   }
 
@@ -109,6 +155,7 @@ namespace dxvk {
       // We have texture in vidmem - attempt to finalize the promotion so that it can be used for rendering
       if (texture.finalizePendingPromotion()) {
         // Texture reached its final destination
+        recordTimeToFullRes(texture.getManagedTexture());
         return;
       }
     } else if (managedState == ManagedTexture::State::kQueuedForUpload) {
@@ -145,10 +192,14 @@ namespace dxvk {
 
     managedTexture->state = ManagedTexture::State::kQueuedForUpload;
     managedTexture->frameQueuedForUpload = m_pDevice->getCurrentFrameId();
+    managedTexture->timeQueuedForUpload.store(dxvk::high_resolution_clock::now(), std::memory_order_relaxed);
 
     if (!allowAsync) {
       loadTexture(managedTexture, immediateContext);
     } else {
+      // The upload worker cools down for a frame, let the data stream in meanwhile
+      managedTexture->assetData->prefetch();
+
       RenderProcessor::add(std::move(managedTexture));
     }
   }
@@ -177,6 +228,44 @@ namespace dxvk {
     }
 
     m_pDevice->statCounters().setCtr(DxvkStatCounter::RtxTexturesInFlight, m_itemsPending.load());
+    m_pDevice->statCounters().setCtr(DxvkStatCounter::RtxTexturesPreempted, m_numPreemptedTextures.load());
+
+    // Keep reporting the last frame that promoted anything, so the numbers stay readable in the HUD
+    if (m_numPromotedTextures > 0) {
+      m_pDevice->statCounters().setCtr(DxvkStatCounter::RtxTextureAvgTimeToFullRes,
+        std::chrono::duration_cast<std::chrono::milliseconds>(m_totalTimeToFullRes / m_numPromotedTextures).count());
+      m_pDevice->statCounters().setCtr(DxvkStatCounter::RtxTextureMaxTimeToFullRes,
+        std::chrono::duration_cast<std::chrono::milliseconds>(m_maxTimeToFullRes).count());
+
+      m_numPromotedTextures = 0;
+      m_totalTimeToFullRes = dxvk::high_resolution_clock::duration(0);
+      m_maxTimeToFullRes = dxvk::high_resolution_clock::duration(0);
+    }
+  }
+
+  void RtxTextureManager::recordTimeToFullRes(const Rc<ManagedTexture>& texture) {
+    constexpr auto zeroTimePoint = dxvk::high_resolution_clock::time_point(dxvk::high_resolution_clock::duration(0));
+
+    // Every upload queued by scheduleTextureLoad is timed, async or not, and each of them once.
+    // Uploads dropped as stale by the worker have their time cleared and are not counted.
+    const auto timeQueued = texture->timeQueuedForUpload.exchange(zeroTimePoint, std::memory_order_relaxed);
+    if (timeQueued == zeroTimePoint) {
+      return;
+    }
+
+    const auto timeToFullRes = dxvk::high_resolution_clock::now() - timeQueued;
+
+    ++m_numPromotedTextures;
+    m_totalTimeToFullRes += timeToFullRes;
+    m_maxTimeToFullRes = std::max(m_maxTimeToFullRes, timeToFullRes);
+
+    s_texturesPromotedMetric.add();
+    s_timeToFullResMetric.record(std::chrono::duration<double, std::milli>(timeToFullRes).count());
+
+#ifdef _DEBUG
+    Logger::debug(str::format("Texture ", texture->assetData->info().filename, " reached full resolution in ",
+      std::chrono::duration_cast<std::chrono::milliseconds>(timeToFullRes).count(), "ms"));
+#endif
   }
 
   void RtxTextureManager::finalizeAllPendingTexturePromotions() {
@@ -185,7 +274,9 @@ namespace dxvk {
       if (texture.isPromotable()) {
         if (processManagedTextureState(texture) == ManagedTexture::State::kVidMem) {
           // We have texture in vidmem - attempt to finalize the promotion
-          if (!texture.finalizePendingPromotion()) {
+          if (texture.finalizePendingPromotion()) {
+            recordTimeToFullRes(texture.getManagedTexture());
+          } else {
 #ifdef _DEBUG
             Logger::debug(str::format("Unable to finalize pending promotion for ",
                                       texture.getManagedTexture()->assetData->info().filename));
@@ -196,7 +287,7 @@ namespace dxvk {
     }
   }
 
-  void RtxTextureManager::addTexture(Rc<DxvkContext>& immediateContext, TextureRef inputTexture, bool allowAsync, uint32_t& textureIndexOut) {
+  void RtxTextureManager::addTexture(Rc<DxvkContext>& immediateContext, TextureRef inputTexture, bool allowAsync, uint32_t& textureIndexOut, float screenCoverage) {
     // If theres valid texture backing this ref, then skip
     if (!inputTexture.isValid())
       return;
@@ -207,12 +298,29 @@ namespace dxvk {
     // Fetch the texture object from cache
     TextureRef& cachedTexture = m_textureCache.at(textureIndexOut);
 
+    const uint32_t currentFrame = m_pDevice->getCurrentFrameId();
+
     // If there is a pending promotion, schedule it
     if (cachedTexture.isPromotable()) {
+      // Accumulate this frame's usage so the promotion gets prioritized by it
+      ManagedTexture& managedTexture = *cachedTexture.getManagedTexture();
+
+      if (managedTexture.frameLastUsed.load(std::memory_order_relaxed) != currentFrame) {
+        managedTexture.instanceCount.store(1, std::memory_order_relaxed);
+        managedTexture.screenCoverage.store(screenCoverage, std::memory_order_relaxed);
+        managedTexture.frameLastUsed.store(currentFrame, std::memory_order_relaxed);
+      } else {
+        managedTexture.instanceCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (screenCoverage > managedTexture.screenCoverage.load(std::memory_order_relaxed)) {
+          managedTexture.screenCoverage.store(screenCoverage, std::memory_order_relaxed);
+        }
+      }
+
       scheduleTextureLoad(cachedTexture, immediateContext, allowAsync);
     }
 
-    cachedTexture.frameLastUsed = m_pDevice->getCurrentFrameId();
+    cachedTexture.frameLastUsed = currentFrame;
   }
 
 
@@ -22,11 +22,13 @@
 #pragma once
 #include <mutex>
 #include <queue>
+#include <vector>
 
 #include "../../util/util_renderprocessor.h"
 #include "../../util/thread.h"
 #include "../../util/rc/util_rc_ptr.h"
 #include "../../util/sync/sync_signal.h"
+#include "../../util/util_priority_queue.h"
 #include "rtx_texture.h"
 #include "rtx_sparse_unique_cache.h"
 
@@ -34,7 +36,45 @@ namespace dxvk {
   class DxvkContext;
   struct ManagedTexture;
 
-  class RtxTextureManager : public RenderProcessor<Rc<ManagedTexture>> {
+  /**
+    * \brief Orders pending texture promotions by how much each texture
+    *        contributes to what is currently on screen.
+    *
+    * Priorities are re-evaluated once per frame, so usage recorded after a
+    * texture was queued is taken into account. Textures which are still
+    * cooling down from the frame they were queued in are only picked when
+    * nothing else is ready. See FramePriorityQueue.
+    */
+  struct TexturePromotionPolicy {
+    explicit TexturePromotionPolicy(const DxvkDevice* device)
+      : m_device(device) { }
+
+    uint32_t currentFrame() const;
+
+    bool prioritize() const;
+
+    bool isReady(const Rc<ManagedTexture>& texture, uint32_t currentFrame) const;
+
+    float priority(const Rc<ManagedTexture>& texture, uint32_t currentFrame) const {
+      return calcPriority(*texture, currentFrame);
+    }
+
+    /**
+      * \brief Calculates the streaming priority of a texture.
+      * \param [in] texture The texture to calculate the priority for.
+      * \param [in] currentFrame Id of the frame currently being recorded.
+      * \return Priority of the texture, higher is more important.
+      */
+    static float calcPriority(const ManagedTexture& texture, uint32_t currentFrame);
+
+  private:
+    const DxvkDevice* m_device;
+  };
+
+  using TexturePromotionQueue = FramePriorityQueue<Rc<ManagedTexture>, TexturePromotionPolicy>;
+
+  class RtxTextureManager : public RenderProcessor<Rc<ManagedTexture>, TexturePromotionQueue> {
+    friend struct TexturePromotionPolicy;
   public:
     RtxTextureManager(DxvkDevice* device);
     ~RtxTextureManager();
@@ -69,8 +109,10 @@ namespace dxvk {
       * \param [in] inputTexture The texture to be added.
       * \param [in] allowAsync Whether asynchronous texture upload is allowed for this texture.
       * \param [out] textureIndexOut Index of the added texture in resource table.
+      * \param [in] screenCoverage Estimated fraction of the screen covered by the draw using the texture,
+      *             used to prioritize the texture's promotion.
     */
-    void addTexture(Rc<DxvkContext>& immediateContext, TextureRef inputTexture, bool allowAsync, uint32_t& textureIndexOut);
+    void addTexture(Rc<DxvkContext>& immediateContext, TextureRef inputTexture, bool allowAsync, uint32_t& textureIndexOut, float screenCoverage = 1.f);
 
     /**
       * \brief Synchronizes the resource manager.
@@ -164,12 +206,21 @@ namespace dxvk {
 
     fast_unordered_cache<Rc<ManagedTexture>> m_assetHashToTextures;
 
+    // Time-to-full-res of the textures promoted since the last kickoff
+    uint32_t m_numPromotedTextures = 0;
+    dxvk::high_resolution_clock::duration m_totalTimeToFullRes { dxvk::high_resolution_clock::duration(0) };
+    dxvk::high_resolution_clock::duration m_maxTimeToFullRes { dxvk::high_resolution_clock::duration(0) };
+    std::atomic<uint32_t> m_numPreemptedTextures = 0;
+
     RTX_OPTION("rtx.texturemanager", uint32_t, budgetPercentageOfAvailableVram, 50, "The percentage of available VRAM we should use for material textures.  If material textures are required beyond this budget, then those textures will be loaded at lower quality.  Important note, it's impossible to perfectly match the budget while maintaining reasonable quality levels, so use this as more of a guideline.  If the replacements assets are simply too large for the target GPUs available vid mem, we may end up going overbudget regularly.  Defaults to 50% of the available VRAM.");
     RTX_OPTION("rtx.texturemanager", bool, showProgress, false, "Show texture loading progress in the HUD.");
+    RTX_OPTION("rtx.texturemanager", bool, prioritizePromotions, true, "Promote textures in order of their on-screen footprint (screen coverage, number of draws using them and how recently they were used) rather than in the order they were requested.");
+    RTX_OPTION("rtx.texturemanager", uint32_t, stalePromotionFrames, 30, "Number of frames a texture may go unused while its promotion is pending before the request is dropped. The promotion is requested again once the texture is used. 0 disables dropping stale requests.");
 
     bool isTextureSuboptimal(const Rc<ManagedTexture>& texture) const;
     void scheduleTextureLoad(TextureRef& texture, Rc<DxvkContext>& immediateContext, bool allowAsync);
     void loadTexture(const Rc<ManagedTexture>& texture, Rc<DxvkContext>& ctx);
+    void recordTimeToFullRes(const Rc<ManagedTexture>& texture);
 
     VkDeviceSize overBudgetMib(VkDeviceSize percentageOfBudget = 100) const;
   };
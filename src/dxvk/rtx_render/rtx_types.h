@@ -28,6 +28,7 @@
 #include "rtx_camera.h"
 #include "vulkan/vulkan_core.h"
 #include "../../util/util_threadpool.h"
+#include "../../util/util_spatial_hash.h"
 
 #include <inttypes.h>
 #include <vector>
@@ -573,6 +574,9 @@ struct BlasEntry {
   }
 
   void unlinkInstance(const RtInstance* instance) {
+    // The index may still refer to the instance, rebuild it on next use
+    frameInstanceIndexBuilt = kInvalidFrameIndex;
+
     auto& it = std::find(m_linkedInstances.begin(), m_linkedInstances.end(), instance);
     if (it != m_linkedInstances.end()) {
       // Swap & pop - faster than "erase", but doesn't preserve order, which is fine here.
@@ -585,6 +589,11 @@ struct BlasEntry {
 
   const std::vector<const RtInstance*>& getLinkedInstances() const { return m_linkedInstances; }
 
+  // Spatial index over the linked instances, used to match heavily instanced geometry against
+  // the previous frame's instances.  Maintained by InstanceManager::findSimilarInstance.
+  SpatialHash<const RtInstance*> instanceIndex;
+  uint32_t frameInstanceIndexBuilt = kInvalidFrameIndex;
+
 private:
   std::vector<const RtInstance*> m_linkedInstances;
   std::unordered_map<XXH64_hash_t, LegacyMaterialData> m_materials;
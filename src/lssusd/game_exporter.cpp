@@ -63,6 +63,7 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
@@ -192,11 +193,24 @@ bool GameExporter::loadUsdPlugins(const std::string& path) {
 }
 
 void GameExporter::exportUsd(const Export& exportData) {
+  auto meshIt = exportData.meshes.cbegin();
+  exportUsd(exportData, [&](Id& meshId, const Mesh*& pMesh) {
+    if (meshIt == exportData.meshes.cend()) {
+      return false;
+    }
+    meshId = meshIt->first;
+    pMesh = &meshIt->second;
+    ++meshIt;
+    return true;
+  }, exportData.meshes.size());
+}
+
+void GameExporter::exportUsd(const Export& exportData, const MeshSource& meshSource, const size_t numMeshes, ExportProgress* pProgress) {
   if(s_bMultiThreadSafety) {
     std::scoped_lock lock(s_mutex);
-    exportUsdInternal(exportData);
+    exportUsdInternal(exportData, meshSource, numMeshes, pProgress);
   } else {
-    exportUsdInternal(exportData);
+    exportUsdInternal(exportData, meshSource, numMeshes, pProgress);
   }
 }
 
@@ -204,15 +218,26 @@ std::string getExtension(std::filesystem::path path) {
   return path.extension().generic_string();
 }
 
-void GameExporter::exportUsdInternal(const Export& exportData) {
+void GameExporter::exportUsdInternal(const Export& exportData, const MeshSource& meshSource, const size_t numMeshes, ExportProgress* pProgress) {
   dxvk::Logger::info("[GameExporter][" + exportData.debugId + "] Export start");
   ExportContext ctx;
+  ctx.pProgress = pProgress;
+  // Material, mesh and skeleton layers only touch their own stage, so they are written on
+  // these threads while the calling thread keeps pulling meshes and authors the instance stage.
+  // Each layer is one task, small captures don't need a worker per core.
+  constexpr size_t kLayersPerThread = 8;
+  const size_t numLayers = exportData.materials.size() + numMeshes;
+  const size_t maxThreads = std::min<size_t>((numLayers + kLayersPerThread - 1) / kLayersPerThread, 255);
+  const uint8_t numThreads = ThreadPool::getDefaultThreadCount(1, static_cast<uint32_t>(maxThreads));
+  if (numThreads > 1) {
+    ctx.threadPool = std::make_unique<ThreadPool>(numThreads, "rtx-usd-capture-export");
+  }
   lss::GameExporter::createApertureMdls(exportData.baseExportPath);
   ctx.instanceStage = (exportData.bExportInstanceStage) ? createInstanceStage(exportData) : pxr::UsdStageRefPtr();
   ctx.extension = (exportData.bExportInstanceStage) ? getExtension(exportData.instanceStagePath) : lss::ext::usd;
+  // Mesh layers reference material layers, so those have to be on disk first
   exportMaterials(exportData, ctx);
-  exportMeshes(exportData, ctx);
-  exportSkeletons(exportData, ctx);
+  exportMeshes(exportData, meshSource, ctx);
   if(ctx.instanceStage) {
     exportCamera(exportData, ctx);
     exportSphereLights(exportData, ctx);
@@ -297,404 +322,491 @@ void GameExporter::createApertureMdls(const std::string& baseExportPath) {
 void GameExporter::exportMaterials(const Export& exportData, ExportContext& ctx) {
   dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMaterials] Begin");
   const std::string matDirPath = exportData.baseExportPath + "/" + commonDirName::matDir;
-  const std::string fullMaterialBasePath = computeLocalPath(matDirPath);
-
   dxvk::env::createDirectory(matDirPath);
+
+  // Write material layers in parallel, the instance stage may only be touched by this thread
+  std::vector<std::pair<Id, const Material*>> materials;
+  materials.reserve(exportData.materials.size());
   for(const auto& [matId, matData] : exportData.materials) {
-    // Build material stage
-    const std::string matName = prefix::mat + matData.matName;
-    const std::string matStageName = matName + ctx.extension;
-    const std::string matStagePath = matDirPath + matStageName;
-    pxr::UsdStageRefPtr matStage = findOpenOrCreateStage(matStagePath, true);
-    assert(matStage);
-    setCommonStageMetaData(matStage, exportData);
-
-    // Add Looks + RootPrim prims
-    const auto looksSdfPath = gStageRootPath.AppendChild(gTokLooks);
-    const auto looksScopePrim = matStage->DefinePrim(looksSdfPath, gTokScope);
-    assert(looksScopePrim);
-    matStage->SetDefaultPrim(looksScopePrim);
-
-    // Create material prim
-    const auto matSdfPath = looksSdfPath.AppendElementString(matName);
-    const auto matSchema = pxr::UsdShadeMaterial::Define(matStage, matSdfPath);
-    assert(matSchema);
-    const auto matPrim = matSchema.GetPrim();
-    assert(matPrim);
-
-    // Create shader prim under material prim
-    static const pxr::TfToken kTokShader("Shader");
-    const auto shaderPath = matPrim.GetPath().AppendChild(kTokShader);
-    const auto shader = pxr::UsdShadeShader::Define(matStage, shaderPath);
-    const auto shaderPrim = shader.GetPrim();
-    assert(shaderPrim);
-
-    // Create shader prim outputs attr
-    static const pxr::TfToken kTokOutputsOutput("outputs:out");
-    const auto outputsOutAttr =
-      shaderPrim.CreateAttribute(kTokOutputsOutput, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
-
-    // Create and connect material outputs to shader outputs
-    static const pxr::TfToken kTokOutputsMdlSurface("outputs:mdl:surface");
-    const auto outputsMdlSurfaceAttr =
-      matPrim.CreateAttribute(kTokOutputsMdlSurface, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
-    outputsMdlSurfaceAttr.AddConnection(outputsOutAttr.GetPath(), pxr::UsdListPositionFrontOfAppendList);
-
-    // Set shader "Kind"
-    static const pxr::TfToken kTokMaterial("Material");
-    pxr::UsdModelAPI(shader).SetKind(kTokMaterial);
-
-    // Create and set textures asset paths on material
-    static const auto setTextureAttr =
-      [](const pxr::UsdPrim& shaderPrim, const pxr::TfToken attrName, const std::string& relTexPath, const std::string& fullMaterialBasePath)
-    {
-      const auto attr = shaderPrim.CreateAttribute(pxr::TfToken(attrName), pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityVarying);
-      assert(attr);
-      const auto fullTexturePath = computeLocalPath(relTexPath);
-      const auto relToMaterialsTexPath = std::filesystem::relative(fullTexturePath,fullMaterialBasePath).string();
-      const bool bSetSuccessful = attr.Set(pxr::SdfAssetPath(relToMaterialsTexPath));
-      assert(bSetSuccessful);
-      static const pxr::TfToken kTokColorSpaceAuto("auto");
-      attr.SetColorSpace(kTokColorSpaceAuto);
-      return true;
-    };
-    static const pxr::TfToken kTokenInputsDiffuseTex("inputs:diffuse_texture");
-
-    // Try to use an updated texture, if that doesn't work, try to use an old one
-    setTextureAttr(shaderPrim, kTokenInputsDiffuseTex, matData.albedoTexPath, fullMaterialBasePath);
-
-    // Create and set OmniPBR MDL boilerplate attributes on shader
-    static const pxr::TfToken kTokInfoImplSource("info:implementationSource");
-    static const pxr::TfToken kTokSourceAsset("sourceAsset");
-    const auto infoImplSourceAttr =
-      shaderPrim.CreateAttribute(kTokInfoImplSource, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
-    assert(infoImplSourceAttr);
-    const bool bSetInfoImplSourceAttr = infoImplSourceAttr.Set(kTokSourceAsset);
-    assert(bSetInfoImplSourceAttr);
-
-    static const pxr::TfToken kTokInfoMdlSourceAsset("info:mdl:sourceAsset");
-
-    static const pxr::SdfAssetPath kSdfAssetPathOmniPBR("./AperturePBR_Opacity.mdl");
-    const auto infoMdlSourceAsset =
-      shaderPrim.CreateAttribute(kTokInfoMdlSourceAsset, pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityUniform);
-    assert(infoMdlSourceAsset);
-    const bool bSetInfoMdlSourceAsset = infoMdlSourceAsset.Set(kSdfAssetPathOmniPBR);
-    assert(bSetInfoMdlSourceAsset);
-
-    static const pxr::TfToken kTokInfoMdlSourceAssetSubId("info:mdl:sourceAsset:subIdentifier");
-    static const pxr::TfToken kTokOmniPBR("AperturePBR_Opacity");
-    const auto infoImplSourceSubIdAttr =
-      shaderPrim.CreateAttribute(kTokInfoMdlSourceAssetSubId, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
-    assert(infoImplSourceSubIdAttr);
-    const bool bSetInfoMdlSourceAssetSubId = infoImplSourceSubIdAttr.Set(kTokOmniPBR);
-    assert(bSetInfoMdlSourceAssetSubId);
-
-    // Mark whether to enable varying opacity
-    static const pxr::TfToken kTokEnableOpacity("enable_opacity");
-    const auto enableOpacityAttr =
-      shaderPrim.CreateAttribute(kTokEnableOpacity, pxr::SdfValueTypeNames->Bool, false, pxr::SdfVariabilityUniform);
-    assert(enableOpacityAttr);
-    const bool bSetEnableOpacityAttr = enableOpacityAttr.Set(matData.enableOpacity);
-    assert(bSetEnableOpacityAttr);
-
-    matStage->Save();
-    
-    // Cache material reference
-    Reference matLssReference;
-    matLssReference.stagePath = matStagePath;
-    matLssReference.ogSdfPath = matSdfPath;
+    materials.emplace_back(matId, &matData);
+  }
+  std::vector<Reference> matLssReferences(materials.size());
+  const auto exportLayer = [&](uint32_t i) {
+    matLssReferences[i] = exportMaterialLayer(exportData, ctx, *materials[i].second);
+    if (ctx.pProgress) {
+      ++ctx.pProgress->numAssetsExported;
+    }
+  };
+  if (ctx.threadPool) {
+    ctx.threadPool->parallelFor(0, static_cast<uint32_t>(materials.size()), 1, exportLayer);
+  } else {
+    for (uint32_t i = 0; i < materials.size(); ++i) {
+      exportLayer(i);
+    }
+  }
+
+  for(size_t i = 0; i < materials.size(); ++i) {
+    const auto& [matId, pMatData] = materials[i];
+    Reference& matLssReference = matLssReferences[i];
 
     // Build matSchema prim on instance stage
     if(ctx.instanceStage != nullptr) {
+      const std::string matName = prefix::mat + pMatData->matName;
       const auto matInstanceSdfPath = gRootMaterialsPath.AppendElementString(matName);
       auto matInstanceSchema = pxr::UsdShadeMaterial::Define(ctx.instanceStage, matInstanceSdfPath);
       assert(matInstanceSchema);
       
       const std::string relMeshStagePath = commonDirName::matDir + matName + ctx.extension;
       auto matInstanceUsdReferences = matInstanceSchema.GetPrim().GetReferences();
-      matInstanceUsdReferences.AddReference(relMeshStagePath, matSdfPath);
+      matInstanceUsdReferences.AddReference(relMeshStagePath, matLssReference.ogSdfPath);
       
       matLssReference.instanceSdfPath = matInstanceSdfPath;
     }
 
-    ctx.matReferences[matId] = matLssReference;
+    ctx.matReferences[matId] = std::move(matLssReference);
   }
   dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMaterials] End");
 }
 
-void GameExporter::exportSkeletons(const Export& exportData, ExportContext& ctx) {
-  dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportSkeletons] Begin");
-  static const pxr::GfMatrix4d identity(1);
-  const std::string relDirPath = commonDirName::skeletonDir + "/";
-  const std::string dirPath = exportData.baseExportPath + "/" + relDirPath;
-  const std::string fullStagePath = computeLocalPath(dirPath);
-  dxvk::env::createDirectory(dirPath);
-  for (const auto& [meshId, mesh] : exportData.meshes) {
-    if (mesh.numBones == 0) {
-      continue;
-    }
+GameExporter::Reference GameExporter::exportMaterialLayer(const Export& exportData, const ExportContext& ctx, const Material& matData) {
+  const std::string matDirPath = exportData.baseExportPath + "/" + commonDirName::matDir;
+  const std::string fullMaterialBasePath = computeLocalPath(matDirPath);
 
-    // Build skeleton stage
-    const std::string name = prefix::skeleton + mesh.meshName;
-    const std::string stagePath = dirPath + name + ctx.extension;
-    pxr::UsdStageRefPtr stage = findOpenOrCreateStage(stagePath, true);
-    assert(stage);
-    setCommonStageMetaData(stage, exportData);
+  // Build material stage
+  const std::string matName = prefix::mat + matData.matName;
+  const std::string matStageName = matName + ctx.extension;
+  const std::string matStagePath = matDirPath + matStageName;
+  pxr::UsdStageRefPtr matStage = findOpenOrCreateStage(matStagePath, true);
+  assert(matStage);
+  setCommonStageMetaData(matStage, exportData);
+
+  // Add Looks + RootPrim prims
+  const auto looksSdfPath = gStageRootPath.AppendChild(gTokLooks);
+  const auto looksScopePrim = matStage->DefinePrim(looksSdfPath, gTokScope);
+  assert(looksScopePrim);
+  matStage->SetDefaultPrim(looksScopePrim);
+
+  // Create material prim
+  const auto matSdfPath = looksSdfPath.AppendElementString(matName);
+  const auto matSchema = pxr::UsdShadeMaterial::Define(matStage, matSdfPath);
+  assert(matSchema);
+  const auto matPrim = matSchema.GetPrim();
+  assert(matPrim);
+
+  // Create shader prim under material prim
+  static const pxr::TfToken kTokShader("Shader");
+  const auto shaderPath = matPrim.GetPath().AppendChild(kTokShader);
+  const auto shader = pxr::UsdShadeShader::Define(matStage, shaderPath);
+  const auto shaderPrim = shader.GetPrim();
+  assert(shaderPrim);
+
+  // Create shader prim outputs attr
+  static const pxr::TfToken kTokOutputsOutput("outputs:out");
+  const auto outputsOutAttr =
+    shaderPrim.CreateAttribute(kTokOutputsOutput, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
+
+  // Create and connect material outputs to shader outputs
+  static const pxr::TfToken kTokOutputsMdlSurface("outputs:mdl:surface");
+  const auto outputsMdlSurfaceAttr =
+    matPrim.CreateAttribute(kTokOutputsMdlSurface, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityVarying);
+  outputsMdlSurfaceAttr.AddConnection(outputsOutAttr.GetPath(), pxr::UsdListPositionFrontOfAppendList);
+
+  // Set shader "Kind"
+  static const pxr::TfToken kTokMaterial("Material");
+  pxr::UsdModelAPI(shader).SetKind(kTokMaterial);
+
+  // Create and set textures asset paths on material
+  static const auto setTextureAttr =
+    [](const pxr::UsdPrim& shaderPrim, const pxr::TfToken attrName, const std::string& relTexPath, const std::string& fullMaterialBasePath)
+  {
+    const auto attr = shaderPrim.CreateAttribute(pxr::TfToken(attrName), pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityVarying);
+    assert(attr);
+    const auto fullTexturePath = computeLocalPath(relTexPath);
+    const auto relToMaterialsTexPath = std::filesystem::relative(fullTexturePath,fullMaterialBasePath).string();
+    const bool bSetSuccessful = attr.Set(pxr::SdfAssetPath(relToMaterialsTexPath));
+    assert(bSetSuccessful);
+    static const pxr::TfToken kTokColorSpaceAuto("auto");
+    attr.SetColorSpace(kTokColorSpaceAuto);
+    return true;
+  };
+  static const pxr::TfToken kTokenInputsDiffuseTex("inputs:diffuse_texture");
+
+  // Try to use an updated texture, if that doesn't work, try to use an old one
+  setTextureAttr(shaderPrim, kTokenInputsDiffuseTex, matData.albedoTexPath, fullMaterialBasePath);
+
+  // Create and set OmniPBR MDL boilerplate attributes on shader
+  static const pxr::TfToken kTokInfoImplSource("info:implementationSource");
+  static const pxr::TfToken kTokSourceAsset("sourceAsset");
+  const auto infoImplSourceAttr =
+    shaderPrim.CreateAttribute(kTokInfoImplSource, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
+  assert(infoImplSourceAttr);
+  const bool bSetInfoImplSourceAttr = infoImplSourceAttr.Set(kTokSourceAsset);
+  assert(bSetInfoImplSourceAttr);
+
+  static const pxr::TfToken kTokInfoMdlSourceAsset("info:mdl:sourceAsset");
+
+  static const pxr::SdfAssetPath kSdfAssetPathOmniPBR("./AperturePBR_Opacity.mdl");
+  const auto infoMdlSourceAsset =
+    shaderPrim.CreateAttribute(kTokInfoMdlSourceAsset, pxr::SdfValueTypeNames->Asset, false, pxr::SdfVariabilityUniform);
+  assert(infoMdlSourceAsset);
+  const bool bSetInfoMdlSourceAsset = infoMdlSourceAsset.Set(kSdfAssetPathOmniPBR);
+  assert(bSetInfoMdlSourceAsset);
+
+  static const pxr::TfToken kTokInfoMdlSourceAssetSubId("info:mdl:sourceAsset:subIdentifier");
+  static const pxr::TfToken kTokOmniPBR("AperturePBR_Opacity");
+  const auto infoImplSourceSubIdAttr =
+    shaderPrim.CreateAttribute(kTokInfoMdlSourceAssetSubId, pxr::SdfValueTypeNames->Token, false, pxr::SdfVariabilityUniform);
+  assert(infoImplSourceSubIdAttr);
+  const bool bSetInfoMdlSourceAssetSubId = infoImplSourceSubIdAttr.Set(kTokOmniPBR);
+  assert(bSetInfoMdlSourceAssetSubId);
+
+  // Mark whether to enable varying opacity
+  static const pxr::TfToken kTokEnableOpacity("enable_opacity");
+  const auto enableOpacityAttr =
+    shaderPrim.CreateAttribute(kTokEnableOpacity, pxr::SdfValueTypeNames->Bool, false, pxr::SdfVariabilityUniform);
+  assert(enableOpacityAttr);
+  const bool bSetEnableOpacityAttr = enableOpacityAttr.Set(matData.enableOpacity);
+  assert(bSetEnableOpacityAttr);
+
+  matStage->Save();
+
+  // Cache material reference
+  Reference matLssReference;
+  matLssReference.stagePath = matStagePath;
+  matLssReference.ogSdfPath = matSdfPath;
+  return matLssReference;
+}
 
-    pxr::VtDictionary customLayerData = stage->GetRootLayer()->GetCustomLayerData();
-    for (auto& component : mesh.componentHashes) {
-      customLayerData.SetValueAtPath(component.first, pxr::VtValue(component.second));
+void GameExporter::exportMeshes(const Export& exportData, const MeshSource& meshSource, ExportContext& ctx) {
+  dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMeshes] Begin");
+  dxvk::env::createDirectory(exportData.baseExportPath + "/" + commonDirName::meshDir + "/");
+  dxvk::env::createDirectory(exportData.baseExportPath + "/" + commonDirName::skeletonDir + "/");
+
+  // Bound the number of layers in flight, so that finished ones get consumed long before
+  // their task slots in the pool are recycled
+  const size_t maxLayersInFlight = ctx.threadPool ? 4 * ctx.threadPool->getThreadCount() : 0;
+  std::deque<std::unique_ptr<MeshLayer>> layersInFlight;
+  size_t numMeshes = 0;
+
+  // Instance stage prims are authored here in submission order, as soon as the layer is on disk
+  const auto completeLayers = [&](const bool bWaitAll) {
+    while (!layersInFlight.empty()) {
+      MeshLayer& layer = *layersInFlight.front();
+      const bool bMustWait = bWaitAll || layersInFlight.size() > maxLayersInFlight;
+      if (!bMustWait && !layer.bWritten.load(std::memory_order_acquire)) {
+        break;
+      }
+      if (layer.future.valid()) {
+        layer.future.get();
+      }
+      exportMeshInstancePrims(exportData, ctx, layer);
+      layersInFlight.pop_front();
     }
-    stage->GetRootLayer()->SetCustomLayerData(customLayerData);
-
-    // Build skel root prim on stage
-    const auto defaultPrimPath = gStageRootPath.AppendElementString(name);
-    pxr::UsdSkelRoot skelRootSchema = pxr::UsdSkelRoot::Define(stage, defaultPrimPath);
-
-    assert(skelRootSchema);
-    stage->SetDefaultPrim(skelRootSchema.GetPrim());
-
-    // Build skeleton prim under above xform
-    const auto skeletonSdfPath = defaultPrimPath.AppendChild(gTokSkel);
-    auto skelSchema = pxr::UsdSkelSkeleton::Define(stage, skeletonSdfPath);
-    assert(skelSchema);
-
-
-    // Set bindTransforms attribute
-    auto bindTransformsAttr = skelSchema.CreateBindTransformsAttr();
-    assert(bindTransformsAttr);
-    ctx.skeletons[meshId] = generateSkeleton(mesh.numBones,
-                                             mesh.bonesPerVertex,
-                                             mesh.buffers.positionBufs.begin()->second,
-                                             mesh.buffers.blendWeightBufs.empty() ? nullptr : &mesh.buffers.blendWeightBufs.begin()->second,
-                                             mesh.buffers.blendIndicesBufs.empty() ? nullptr : &mesh.buffers.blendIndicesBufs.begin()->second);
-    const Skeleton& skel = ctx.skeletons[meshId];
-    // pxr::VtMatrix4dArray identities(mesh.numBones, pxr::GfMatrix4d(1));
-    bindTransformsAttr.Set(skel.bindPose);
-
-    // Set restTransforms attribute
-    auto restTransformsAttr = skelSchema.CreateRestTransformsAttr();
-    assert(restTransformsAttr);
-    restTransformsAttr.Set(skel.restPose);
-
-    // Set joints attribute on both the skeleton and the pose
-    auto jointsAttr = skelSchema.CreateJointsAttr();
-    assert(jointsAttr);
-    jointsAttr.Set(skel.jointNames);
-
-    stage->Save();
-
-    // Build meshSchema prim on instance stage
-    if (ctx.instanceStage != nullptr) {
-      const std::string mesh_name = prefix::mesh + mesh.meshName;
-      const std::string relSkelStagePath = relDirPath + name + ctx.extension;
-      const pxr::SdfPath skelInstancePath = gRootMeshesPath.AppendElementString(mesh_name).AppendElementString(gTokSkel);
+  };
 
-      auto skelSchema = pxr::UsdSkelSkeleton::Define(ctx.instanceStage, skelInstancePath);
-      auto skelInstanceUsdReferences = skelSchema.GetPrim().GetReferences();
-      skelInstanceUsdReferences.AddReference(relSkelStagePath, skeletonSdfPath);
+  Id meshId;
+  const Mesh* pMesh;
+  while (meshSource(meshId, pMesh)) {
+    auto& layer = *layersInFlight.emplace_back(std::make_unique<MeshLayer>());
+    layer.meshId = meshId;
+    layer.pMesh = pMesh;
+    const auto exportLayer = [&exportData, &ctx, pLayer = &layer]() {
+      exportMeshLayer(exportData, ctx, *pLayer);
+      if (pLayer->pMesh->numBones > 0) {
+        exportSkeletonLayer(exportData, ctx, *pLayer);
+      }
+      if (ctx.pProgress) {
+        ++ctx.pProgress->numAssetsExported;
+      }
+      pLayer->bWritten.store(true, std::memory_order_release);
+    };
+    if (ctx.threadPool) {
+      layer.future = ctx.threadPool->Schedule(exportLayer);
     }
+    if (!layer.future.valid()) {
+      // No workers, or their queues are full
+      exportLayer();
+    }
+    ++numMeshes;
+    completeLayers(false);
   }
-  dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportSkeletons] End");
+  completeLayers(true);
+
+  dxvk::Logger::info(dxvk::str::format("[GameExporter][", exportData.debugId, "] Exported ", numMeshes, " meshes"));
+  dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMeshes] End");
 }
 
-void GameExporter::exportMeshes(const Export& exportData, ExportContext& ctx) {
-  dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMeshes] Begin");
+void GameExporter::exportMeshLayer(const Export& exportData, const ExportContext& ctx, MeshLayer& layer) {
   static const pxr::GfMatrix4d identity(1);
   const std::string relMeshDirPath = commonDirName::meshDir + "/";
   const std::string meshDirPath = exportData.baseExportPath + "/" + relMeshDirPath;
   const std::string fullMeshStagePath = computeLocalPath(meshDirPath);
-  dxvk::env::createDirectory(meshDirPath);
-  for(const auto& [meshId,mesh] : exportData.meshes) {
-    assert(mesh.numVertices > 0);
-    assert(mesh.numIndices > 0);
-
-    const bool isSkeleton = mesh.numBones > 0;
-
-    // Build mesh stage
-    const std::string meshName = prefix::mesh + mesh.meshName;
-    const std::string meshStagePath = meshDirPath + meshName + ctx.extension;
-    pxr::UsdStageRefPtr meshStage = findOpenOrCreateStage(meshStagePath, true);
-    assert(meshStage);
-    setCommonStageMetaData(meshStage, exportData);
-
-    pxr::VtDictionary customLayerData = meshStage->GetRootLayer()->GetCustomLayerData();
-    for (auto& component : mesh.componentHashes) {
-      customLayerData.SetValueAtPath(component.first, pxr::VtValue(component.second));
-    }
-    meshStage->GetRootLayer()->SetCustomLayerData(customLayerData);
+  const Mesh& mesh = *layer.pMesh;
 
-    // Build mesh xform prim on mesh stage, make it visible
-    const auto meshXformSdfPath = gStageRootPath.AppendElementString(meshName);
-    pxr::UsdGeomXformable meshXformSchema;
-    if (isSkeleton) {
-      meshXformSchema = pxr::UsdSkelRoot::Define(meshStage, meshXformSdfPath);
-    } else {
-      meshXformSchema = pxr::UsdGeomXform::Define(meshStage, meshXformSdfPath);
-    }
-    assert(meshXformSchema);
-    meshStage->SetDefaultPrim(meshXformSchema.GetPrim());
-    auto meshXformVisibilityAttr = meshXformSchema.CreateVisibilityAttr();
-    assert(meshXformVisibilityAttr);
-    meshXformVisibilityAttr.Set(gVisibilityInherited);
-
-    // Build mesh geometry prim under above xform
-    const auto meshSchemaSdfPath = meshXformSdfPath.AppendChild(gTokMesh);
-    pxr::UsdGeomMesh meshSchema = pxr::UsdGeomMesh::Define(meshStage, meshSchemaSdfPath);
-    pxr::UsdGeomPrimvarsAPI primvarsAPI(meshSchema.GetPrim());
-
-    assert(meshSchema);
-    auto meshVisibilityAttr = meshSchema.CreateVisibilityAttr();
-    assert(meshVisibilityAttr);
-    meshVisibilityAttr.Set(gVisibilityInherited);
-    
-    // Set double-sidedness attribute
-    auto doubleSidedAttr = meshSchema.CreateDoubleSidedAttr();
-    assert(doubleSidedAttr);
-    doubleSidedAttr.Set(mesh.isDoubleSided);
-
-    // Set orientation attribute
-    auto orientationAttr = meshSchema.CreateOrientationAttr();
-    assert(orientationAttr);
-    orientationAttr.Set(pxr::VtValue(pxr::UsdGeomTokens->leftHanded));
-
-    // Create corresponding attribute arrays using above populated VtArrays
-    pxr::VtArray<int> faceVertexCounts;
-    faceVertexCounts.assign(mesh.numIndices / 3, 3);
-    auto faceVertexCountsAttr = meshSchema.CreateFaceVertexCountsAttr();
-    assert(faceVertexCountsAttr);
-    faceVertexCountsAttr.Set(faceVertexCounts);
-
-    for (auto& pair : mesh.categoryFlags) {
-      const auto attribute = meshSchema.GetPrim().CreateAttribute(pxr::TfToken(pair.first), pxr::SdfValueTypeNames->Bool, true, pxr::SdfVariabilityUniform);
-      attribute.Set(pxr::VtValue(pair.second));
-    }
+  assert(mesh.numVertices > 0);
+  assert(mesh.numIndices > 0);
 
-    // Indices
-    const bool reduce = exportData.meta.bReduceMeshBuffers;
-    ReducedIdxBufSet reducedIdxBufSet = reduce ? reduceIdxBufferSet(mesh.buffers.idxBufs) : ReducedIdxBufSet();
-    const std::map<float,IndexBuffer>& idxBufSet =
-      reduce ? reducedIdxBufSet.bufSet : mesh.buffers.idxBufs;
-    auto indexAttr = meshSchema.CreateFaceVertexIndicesAttr();
-    assert(indexAttr);
-    exportBufferSet(idxBufSet, indexAttr);
-    // Vertices
-    auto pointsAttr = meshSchema.CreatePointsAttr();
-    assert(pointsAttr);
-    exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.positionBufs, reducedIdxBufSet) : mesh.buffers.positionBufs, pointsAttr);
-    // Normals
-    auto normalsAttr = meshSchema.CreateNormalsAttr();
-    assert(normalsAttr);
-    exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.normalBufs, reducedIdxBufSet) : mesh.buffers.normalBufs, normalsAttr);
-    // Set subdivision scheme to None (USD defaults to catmull clark)
-    auto subdivAttr = meshSchema.CreateSubdivisionSchemeAttr();
-    assert(subdivAttr);
-    subdivAttr.Set(pxr::UsdGeomTokens->none);
-    // Texture Coordinates
-    static const pxr::TfToken kTokSt("st");
-    auto stAttr = primvarsAPI.CreatePrimvar(kTokSt, pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->vertex);
-    assert(stAttr);
-    exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.texcoordBufs, reducedIdxBufSet) : mesh.buffers.texcoordBufs, stAttr);
-
-    // Vertex Colors
-    if (mesh.buffers.colorBufs.size() > 0) {
-      auto displayColorPrimvar = meshSchema.CreateDisplayColorPrimvar(pxr::UsdGeomTokens->vertex);
-      auto displayOpacityPrimvar = meshSchema.CreateDisplayOpacityPrimvar(pxr::UsdGeomTokens->vertex);
-      assert(displayColorPrimvar);
-      assert(displayOpacityPrimvar);
-      if (mesh.buffers.colorBufs.cbegin()->second.size() == 1) {
-        // Constant Color
-        displayColorPrimvar.SetInterpolation(pxr::UsdGeomTokens->constant);
-        displayOpacityPrimvar.SetInterpolation(pxr::UsdGeomTokens->constant);
-      }
-      exportColorOpacityBufferSet(reduce ? reduceBufferSet(mesh.buffers.colorBufs, reducedIdxBufSet) : mesh.buffers.colorBufs, displayColorPrimvar, displayOpacityPrimvar);
+  const bool isSkeleton = mesh.numBones > 0;
+
+  // Build mesh stage
+  const std::string meshName = prefix::mesh + mesh.meshName;
+  const std::string meshStagePath = meshDirPath + meshName + ctx.extension;
+  pxr::UsdStageRefPtr meshStage = findOpenOrCreateStage(meshStagePath, true);
+  assert(meshStage);
+  setCommonStageMetaData(meshStage, exportData);
+
+  pxr::VtDictionary customLayerData = meshStage->GetRootLayer()->GetCustomLayerData();
+  for (auto& component : mesh.componentHashes) {
+    customLayerData.SetValueAtPath(component.first, pxr::VtValue(component.second));
+  }
+  meshStage->GetRootLayer()->SetCustomLayerData(customLayerData);
+
+  // Build mesh xform prim on mesh stage, make it visible
+  const auto meshXformSdfPath = gStageRootPath.AppendElementString(meshName);
+  pxr::UsdGeomXformable meshXformSchema;
+  if (isSkeleton) {
+    meshXformSchema = pxr::UsdSkelRoot::Define(meshStage, meshXformSdfPath);
+  } else {
+    meshXformSchema = pxr::UsdGeomXform::Define(meshStage, meshXformSdfPath);
+  }
+  assert(meshXformSchema);
+  meshStage->SetDefaultPrim(meshXformSchema.GetPrim());
+  auto meshXformVisibilityAttr = meshXformSchema.CreateVisibilityAttr();
+  assert(meshXformVisibilityAttr);
+  meshXformVisibilityAttr.Set(gVisibilityInherited);
+
+  // Build mesh geometry prim under above xform
+  const auto meshSchemaSdfPath = meshXformSdfPath.AppendChild(gTokMesh);
+  pxr::UsdGeomMesh meshSchema = pxr::UsdGeomMesh::Define(meshStage, meshSchemaSdfPath);
+  pxr::UsdGeomPrimvarsAPI primvarsAPI(meshSchema.GetPrim());
+
+  assert(meshSchema);
+  auto meshVisibilityAttr = meshSchema.CreateVisibilityAttr();
+  assert(meshVisibilityAttr);
+  meshVisibilityAttr.Set(gVisibilityInherited);
+  
+  // Set double-sidedness attribute
+  auto doubleSidedAttr = meshSchema.CreateDoubleSidedAttr();
+  assert(doubleSidedAttr);
+  doubleSidedAttr.Set(mesh.isDoubleSided);
+
+  // Set orientation attribute
+  auto orientationAttr = meshSchema.CreateOrientationAttr();
+  assert(orientationAttr);
+  orientationAttr.Set(pxr::VtValue(pxr::UsdGeomTokens->leftHanded));
+
+  // Create corresponding attribute arrays using above populated VtArrays
+  pxr::VtArray<int> faceVertexCounts;
+  faceVertexCounts.assign(mesh.numIndices / 3, 3);
+  auto faceVertexCountsAttr = meshSchema.CreateFaceVertexCountsAttr();
+  assert(faceVertexCountsAttr);
+  faceVertexCountsAttr.Set(faceVertexCounts);
+
+  for (auto& pair : mesh.categoryFlags) {
+    const auto attribute = meshSchema.GetPrim().CreateAttribute(pxr::TfToken(pair.first), pxr::SdfValueTypeNames->Bool, true, pxr::SdfVariabilityUniform);
+    attribute.Set(pxr::VtValue(pair.second));
+  }
+
+  // Indices
+  const bool reduce = exportData.meta.bReduceMeshBuffers;
+  ReducedIdxBufSet reducedIdxBufSet = reduce ? reduceIdxBufferSet(mesh.buffers.idxBufs) : ReducedIdxBufSet();
+  const std::map<float,IndexBuffer>& idxBufSet =
+    reduce ? reducedIdxBufSet.bufSet : mesh.buffers.idxBufs;
+  auto indexAttr = meshSchema.CreateFaceVertexIndicesAttr();
+  assert(indexAttr);
+  exportBufferSet(idxBufSet, indexAttr);
+  // Vertices
+  auto pointsAttr = meshSchema.CreatePointsAttr();
+  assert(pointsAttr);
+  exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.positionBufs, reducedIdxBufSet) : mesh.buffers.positionBufs, pointsAttr);
+  // Normals
+  auto normalsAttr = meshSchema.CreateNormalsAttr();
+  assert(normalsAttr);
+  exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.normalBufs, reducedIdxBufSet) : mesh.buffers.normalBufs, normalsAttr);
+  // Set subdivision scheme to None (USD defaults to catmull clark)
+  auto subdivAttr = meshSchema.CreateSubdivisionSchemeAttr();
+  assert(subdivAttr);
+  subdivAttr.Set(pxr::UsdGeomTokens->none);
+  // Texture Coordinates
+  static const pxr::TfToken kTokSt("st");
+  auto stAttr = primvarsAPI.CreatePrimvar(kTokSt, pxr::SdfValueTypeNames->TexCoord2fArray, pxr::UsdGeomTokens->vertex);
+  assert(stAttr);
+  exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.texcoordBufs, reducedIdxBufSet) : mesh.buffers.texcoordBufs, stAttr);
+
+  // Vertex Colors
+  if (mesh.buffers.colorBufs.size() > 0) {
+    auto displayColorPrimvar = meshSchema.CreateDisplayColorPrimvar(pxr::UsdGeomTokens->vertex);
+    auto displayOpacityPrimvar = meshSchema.CreateDisplayOpacityPrimvar(pxr::UsdGeomTokens->vertex);
+    assert(displayColorPrimvar);
+    assert(displayOpacityPrimvar);
+    if (mesh.buffers.colorBufs.cbegin()->second.size() == 1) {
+      // Constant Color
+      displayColorPrimvar.SetInterpolation(pxr::UsdGeomTokens->constant);
+      displayOpacityPrimvar.SetInterpolation(pxr::UsdGeomTokens->constant);
     }
-    
-    if (isSkeleton) {
-      pxr::UsdSkelBindingAPI skelBind = pxr::UsdSkelBindingAPI::Apply(meshSchema.GetPrim());
+    exportColorOpacityBufferSet(reduce ? reduceBufferSet(mesh.buffers.colorBufs, reducedIdxBufSet) : mesh.buffers.colorBufs, displayColorPrimvar, displayOpacityPrimvar);
+  }
+  
+  if (isSkeleton) {
+    pxr::UsdSkelBindingAPI skelBind = pxr::UsdSkelBindingAPI::Apply(meshSchema.GetPrim());
 
-      auto jointWeightsAttr = skelBind.CreateJointWeightsPrimvar(0, mesh.bonesPerVertex);
-      assert(jointWeightsAttr);
-      exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.blendWeightBufs, reducedIdxBufSet, mesh.bonesPerVertex) : mesh.buffers.blendWeightBufs, jointWeightsAttr);
+    auto jointWeightsAttr = skelBind.CreateJointWeightsPrimvar(0, mesh.bonesPerVertex);
+    assert(jointWeightsAttr);
+    exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.blendWeightBufs, reducedIdxBufSet, mesh.bonesPerVertex) : mesh.buffers.blendWeightBufs, jointWeightsAttr);
 
-      auto jointIndicesAttr = skelBind.CreateJointIndicesPrimvar(0, mesh.bonesPerVertex);
-      assert(jointIndicesAttr);
-      if (mesh.buffers.blendIndicesBufs.size() > 0) {
-        exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.blendIndicesBufs, reducedIdxBufSet, mesh.bonesPerVertex) : mesh.buffers.blendIndicesBufs, jointIndicesAttr);
-      } else {
-        // D3D9 allows for default bone indices of "0, 1, ... bonesPerVertex" if no joint indices are set.
-        pxr::VtArray<int> defaultIndices(mesh.bonesPerVertex * mesh.numVertices);
-        for (int i = 0; i < mesh.numVertices; ++i) {
-          for (int j = 0; j < mesh.bonesPerVertex; ++j) {
-            defaultIndices[i * mesh.bonesPerVertex + j] = j;
-          }
+    auto jointIndicesAttr = skelBind.CreateJointIndicesPrimvar(0, mesh.bonesPerVertex);
+    assert(jointIndicesAttr);
+    if (mesh.buffers.blendIndicesBufs.size() > 0) {
+      exportBufferSet(reduce ? reduceBufferSet(mesh.buffers.blendIndicesBufs, reducedIdxBufSet, mesh.bonesPerVertex) : mesh.buffers.blendIndicesBufs, jointIndicesAttr);
+    } else {
+      // D3D9 allows for default bone indices of "0, 1, ... bonesPerVertex" if no joint indices are set.
+      pxr::VtArray<int> defaultIndices(mesh.bonesPerVertex * mesh.numVertices);
+      for (int i = 0; i < mesh.numVertices; ++i) {
+        for (int j = 0; j < mesh.bonesPerVertex; ++j) {
+          defaultIndices[i * mesh.bonesPerVertex + j] = j;
         }
-        jointIndicesAttr.Set(defaultIndices);
       }
-
-      auto skelRel = skelBind.CreateSkeletonRel();
-      skelRel.AddTarget(meshXformSdfPath.AppendChild(gTokSkel));
+      jointIndicesAttr.Set(defaultIndices);
     }
 
-    const bool bHasMat = mesh.matId != kInvalidId;
-    const Reference& matLssReference = (bHasMat) ? ctx.matReferences[mesh.matId] : Reference();
-    if(bHasMat) {
-      const auto shaderMatSchema = pxr::UsdShadeMaterial::Define(meshStage, matLssReference.ogSdfPath);
-      assert(shaderMatSchema);
-      auto shaderMatUsdReferences = shaderMatSchema.GetPrim().GetReferences();
-      const std::string fullMatStagePath = computeLocalPath(matLssReference.stagePath);
-      const std::string relMatRefStagePath = std::filesystem::relative(fullMatStagePath,fullMeshStagePath).string();
-      shaderMatUsdReferences.AddReference(relMatRefStagePath, matLssReference.ogSdfPath);
-      pxr::UsdShadeMaterialBindingAPI(meshXformSchema.GetPrim()).Bind(shaderMatSchema);
-    }
+    auto skelRel = skelBind.CreateSkeletonRel();
+    skelRel.AddTarget(meshXformSdfPath.AppendChild(gTokSkel));
+  }
 
-    // Kit metadata
-    if(exportData.meta.bUseLssUsdPlugins) {
-      meshXformSchema.GetPrim().SetMetadata(PXR_NS::SdfFieldKeys->Kind, PXR_NS::KindTokens->assembly);
-      static const pxr::TfToken kTokHideInStageWindow("hide_in_stage_window");
-      meshSchema.GetPrim().SetMetadata(kTokHideInStageWindow, true);
-      static const pxr::TfToken kTokNoDelete("no_delete");
-      meshSchema.GetPrim().SetMetadata(kTokNoDelete, true);
-    }
+  const auto matLssReferenceIt = ctx.matReferences.find(mesh.matId);
+  if(matLssReferenceIt != ctx.matReferences.cend()) {
+    const Reference& matLssReference = matLssReferenceIt->second;
+    const auto shaderMatSchema = pxr::UsdShadeMaterial::Define(meshStage, matLssReference.ogSdfPath);
+    assert(shaderMatSchema);
+    auto shaderMatUsdReferences = shaderMatSchema.GetPrim().GetReferences();
+    const std::string fullMatStagePath = computeLocalPath(matLssReference.stagePath);
+    const std::string relMatRefStagePath = std::filesystem::relative(fullMatStagePath,fullMeshStagePath).string();
+    shaderMatUsdReferences.AddReference(relMatRefStagePath, matLssReference.ogSdfPath);
+    pxr::UsdShadeMaterialBindingAPI(meshXformSchema.GetPrim()).Bind(shaderMatSchema);
+  }
+
+  // Kit metadata
+  if(exportData.meta.bUseLssUsdPlugins) {
+    meshXformSchema.GetPrim().SetMetadata(PXR_NS::SdfFieldKeys->Kind, PXR_NS::KindTokens->assembly);
+    static const pxr::TfToken kTokHideInStageWindow("hide_in_stage_window");
+    meshSchema.GetPrim().SetMetadata(kTokHideInStageWindow, true);
+    static const pxr::TfToken kTokNoDelete("no_delete");
+    meshSchema.GetPrim().SetMetadata(kTokNoDelete, true);
+  }
+
+  meshStage->Save();
+
+  // Cache mesh reference
+  layer.reference.stagePath = meshStagePath;
+  layer.reference.ogSdfPath = meshXformSdfPath;
+}
+
+void GameExporter::exportSkeletonLayer(const Export& exportData, const ExportContext& ctx, MeshLayer& layer) {
+  const std::string relDirPath = commonDirName::skeletonDir + "/";
+  const std::string dirPath = exportData.baseExportPath + "/" + relDirPath;
+  const Mesh& mesh = *layer.pMesh;
+
+  // Build skeleton stage
+  const std::string name = prefix::skeleton + mesh.meshName;
+  const std::string stagePath = dirPath + name + ctx.extension;
+  pxr::UsdStageRefPtr stage = findOpenOrCreateStage(stagePath, true);
+  assert(stage);
+  setCommonStageMetaData(stage, exportData);
 
-    meshStage->Save();
+  pxr::VtDictionary customLayerData = stage->GetRootLayer()->GetCustomLayerData();
+  for (auto& component : mesh.componentHashes) {
+    customLayerData.SetValueAtPath(component.first, pxr::VtValue(component.second));
+  }
+  stage->GetRootLayer()->SetCustomLayerData(customLayerData);
+
+  // Build skel root prim on stage
+  const auto defaultPrimPath = gStageRootPath.AppendElementString(name);
+  pxr::UsdSkelRoot skelRootSchema = pxr::UsdSkelRoot::Define(stage, defaultPrimPath);
+
+  assert(skelRootSchema);
+  stage->SetDefaultPrim(skelRootSchema.GetPrim());
+
+  // Build skeleton prim under above xform
+  const auto skeletonSdfPath = defaultPrimPath.AppendChild(gTokSkel);
+  auto skelSchema = pxr::UsdSkelSkeleton::Define(stage, skeletonSdfPath);
+  assert(skelSchema);
+
+
+  // Set bindTransforms attribute
+  auto bindTransformsAttr = skelSchema.CreateBindTransformsAttr();
+  assert(bindTransformsAttr);
+  layer.skeleton = generateSkeleton(mesh.numBones,
+                                   mesh.bonesPerVertex,
+                                   mesh.buffers.positionBufs.begin()->second,
+                                   mesh.buffers.blendWeightBufs.empty() ? nullptr : &mesh.buffers.blendWeightBufs.begin()->second,
+                                   mesh.buffers.blendIndicesBufs.empty() ? nullptr : &mesh.buffers.blendIndicesBufs.begin()->second);
+  const Skeleton& skel = layer.skeleton;
+  // pxr::VtMatrix4dArray identities(mesh.numBones, pxr::GfMatrix4d(1));
+  bindTransformsAttr.Set(skel.bindPose);
+
+  // Set restTransforms attribute
+  auto restTransformsAttr = skelSchema.CreateRestTransformsAttr();
+  assert(restTransformsAttr);
+  restTransformsAttr.Set(skel.restPose);
+
+  // Set joints attribute on both the skeleton and the pose
+  auto jointsAttr = skelSchema.CreateJointsAttr();
+  assert(jointsAttr);
+  jointsAttr.Set(skel.jointNames);
+
+  stage->Save();
+
+  layer.skelSdfPath = skeletonSdfPath;
+}
+
+void GameExporter::exportMeshInstancePrims(const Export& exportData, ExportContext& ctx, MeshLayer& layer) {
+  const Mesh& mesh = *layer.pMesh;
+  const bool isSkeleton = mesh.numBones > 0;
+  const std::string meshName = prefix::mesh + mesh.meshName;
+
+  // Build meshSchema prim on instance stage
+  if(ctx.instanceStage != nullptr) {
+    const auto meshInstanceXformSdfPath = gRootMeshesPath.AppendElementString(meshName);
+    pxr::UsdGeomXformable meshInstanceXformSchema;
+    if (isSkeleton) {
+      meshInstanceXformSchema = pxr::UsdSkelRoot::Define(ctx.instanceStage, meshInstanceXformSdfPath);
+    } else {
+      meshInstanceXformSchema = pxr::UsdGeomXform::Define(ctx.instanceStage, meshInstanceXformSdfPath);
+    }
+    assert(meshInstanceXformSchema);
     
-    // Cache material reference
-    Reference meshLssReference;
-    meshLssReference.stagePath = meshStagePath;
-    meshLssReference.ogSdfPath = meshXformSdfPath;
+    const std::string relMeshStagePath = commonDirName::meshDir + "/" + meshName + ctx.extension;
+    auto meshInstanceUsdReferences = meshInstanceXformSchema.GetPrim().GetReferences();
+    meshInstanceUsdReferences.AddReference(relMeshStagePath);
+
+    auto meshInstanceXformVisibilityAttr = meshInstanceXformSchema.CreateVisibilityAttr();
+    assert(meshInstanceXformVisibilityAttr);
+    meshInstanceXformVisibilityAttr.Set(gVisibilityInvisible);
     
-    // Build meshSchema prim on instance stage
-    if(ctx.instanceStage != nullptr) {
-      const auto meshInstanceXformSdfPath = gRootMeshesPath.AppendElementString(meshName);
-      pxr::UsdGeomXformable meshInstanceXformSchema;
-      if (isSkeleton) {
-        meshInstanceXformSchema = pxr::UsdSkelRoot::Define(ctx.instanceStage, meshInstanceXformSdfPath);
-      } else {
-        meshInstanceXformSchema = pxr::UsdGeomXform::Define(ctx.instanceStage, meshInstanceXformSdfPath);
-      }
-      assert(meshInstanceXformSchema);
-      
-      const std::string relMeshStagePath = relMeshDirPath + meshName + ctx.extension;
-      auto meshInstanceUsdReferences = meshInstanceXformSchema.GetPrim().GetReferences();
-      meshInstanceUsdReferences.AddReference(relMeshStagePath);
+    const auto matLssReferenceIt = ctx.matReferences.find(mesh.matId);
+    if(matLssReferenceIt != ctx.matReferences.cend()) {
+      const auto shaderMatInstanceSchema = pxr::UsdShadeMaterial::Get(ctx.instanceStage, matLssReferenceIt->second.instanceSdfPath);
+      assert(shaderMatInstanceSchema);
+      pxr::UsdShadeMaterialBindingAPI(meshInstanceXformSchema.GetPrim()).Bind(shaderMatInstanceSchema);
+    }
 
-      auto meshInstanceXformVisibilityAttr = meshInstanceXformSchema.CreateVisibilityAttr();
-      assert(meshInstanceXformVisibilityAttr);
-      meshInstanceXformVisibilityAttr.Set(gVisibilityInvisible);
-      
-      if(bHasMat) {
-        const auto shaderMatInstanceSchema = pxr::UsdShadeMaterial::Get(ctx.instanceStage, matLssReference.instanceSdfPath);
-        assert(shaderMatInstanceSchema);
-        pxr::UsdShadeMaterialBindingAPI(meshInstanceXformSchema.GetPrim()).Bind(shaderMatInstanceSchema);
-      }
+    layer.reference.instanceSdfPath = meshInstanceXformSdfPath;
+
+    // Build skeleton prim on instance stage
+    if (isSkeleton) {
+      const std::string relSkelStagePath = commonDirName::skeletonDir + "/" + prefix::skeleton + mesh.meshName + ctx.extension;
+      const pxr::SdfPath skelInstancePath = meshInstanceXformSdfPath.AppendElementString(gTokSkel);
 
-      meshLssReference.instanceSdfPath = meshInstanceXformSdfPath;
+      auto skelSchema = pxr::UsdSkelSkeleton::Define(ctx.instanceStage, skelInstancePath);
+      auto skelInstanceUsdReferences = skelSchema.GetPrim().GetReferences();
+      skelInstanceUsdReferences.AddReference(relSkelStagePath, layer.skelSdfPath);
     }
-    
-    ctx.meshReferences[meshId] = meshLssReference;
   }
-  dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportMeshes] End");
+
+  ctx.meshReferences[layer.meshId] = std::move(layer.reference);
+  if (isSkeleton) {
+    ctx.skeletons[layer.meshId] = std::move(layer.skeleton);
+  }
 }
 
 GameExporter::ReducedIdxBufSet GameExporter::reduceIdxBufferSet(const std::map<float,IndexBuffer>& idxBufSet) {
@@ -797,6 +909,12 @@ void GameExporter::exportInstances(const Export& exportData, ExportContext& ctx)
   assert(exportData.bExportInstanceStage);
   dxvk::Logger::debug("[GameExporter][" + exportData.debugId + "][exportInstances] Begin");
   for(const auto& [instId,instanceData] : exportData.instances) {
+    // Meshes without any geometry are never handed to the exporter
+    const auto meshLssReferenceIt = ctx.meshReferences.find(instanceData.meshId);
+    if (meshLssReferenceIt == ctx.meshReferences.cend()) {
+      continue;
+    }
+
     // Build base Xform prim for instance to reside in
     auto instanceName = (instanceData.isSky ? "sky_" : "inst_") + std::string(instanceData.instanceName);
     pxr::SdfPath fullInstancePath = gRootInstancesPath.AppendElementString(instanceName);
@@ -812,7 +930,7 @@ void GameExporter::exportInstances(const Export& exportData, ExportContext& ctx)
     assert(instanceXform);
 
     // Attach reference to mesh in question
-    const Reference& meshLssReference = ctx.meshReferences[instanceData.meshId];
+    const Reference& meshLssReference = meshLssReferenceIt->second;
     auto instanceUsdReferences = instanceXform.GetPrim().GetReferences();
     instanceUsdReferences.AddInternalReference(meshLssReference.instanceSdfPath);
     
@@ -31,6 +31,11 @@
 #include "game_exporter_types.h"
 #include "game_exporter_paths.h"
 
+#include "../util/util_threadpool.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
 
 namespace lss {
@@ -38,12 +43,22 @@ namespace lss {
 class GameExporter
 {
 public:
+  // Hands out the next mesh whose data is complete, blocking until there is one.
+  // Returns false once every mesh has been handed out. Meshes must stay alive
+  // and unmodified until the export returns.
+  using MeshSource = std::function<bool(Id& meshId, const Mesh*& pMesh)>;
+
   static void setMultiThreadSafety(const bool enable) {
     s_bMultiThreadSafety = enable;
   }
   static bool loadUsdPlugins(const std::string& path);
   static void exportUsd(const Export& exportData);
+  // Streaming variant, exportData.meshes is ignored in favour of meshSource, which yields numMeshes
+  // meshes. Mesh layers are written on worker threads as soon as the source yields them, and the
+  // instance stage is filled in as they complete.
+  static void exportUsd(const Export& exportData, const MeshSource& meshSource, const size_t numMeshes, ExportProgress* pProgress = nullptr);
 private:
+  using ThreadPool = dxvk::WorkerThreadPool<256, true, false>;
   struct Reference {
     std::string  stagePath;
     pxr::SdfPath ogSdfPath;
@@ -55,15 +70,29 @@ private:
     IdMap<Reference> matReferences;
     IdMap<Reference> meshReferences;
     IdMap<Skeleton> skeletons;
-    
+    std::unique_ptr<ThreadPool> threadPool;
+    ExportProgress* pProgress = nullptr;
+  };
+  // Result of writing a single mesh layer (and its skeleton layer, if skinned) on a worker
+  struct MeshLayer {
+    Id meshId = kInvalidId;
+    const Mesh* pMesh = nullptr;
+    Reference reference;
+    pxr::SdfPath skelSdfPath;
+    Skeleton skeleton;
+    std::atomic<bool> bWritten = false;
+    dxvk::Future<void> future;
   };
-  static void exportUsdInternal(const Export& exportData);
+  static void exportUsdInternal(const Export& exportData, const MeshSource& meshSource, const size_t numMeshes, ExportProgress* pProgress);
   static pxr::UsdStageRefPtr createInstanceStage(const Export& exportData);
   static void setCommonStageMetaData(pxr::UsdStageRefPtr stage, const Export& exportData);
   static void createApertureMdls(const std::string& baseExportPath);
   static void exportMaterials(const Export& exportData, ExportContext& ctx);
-  static void exportMeshes(const Export& exportData, ExportContext& ctx);
-  static void exportSkeletons(const Export& exportData, ExportContext& ctx);
+  static Reference exportMaterialLayer(const Export& exportData, const ExportContext& ctx, const Material& matData);
+  static void exportMeshes(const Export& exportData, const MeshSource& meshSource, ExportContext& ctx);
+  static void exportMeshLayer(const Export& exportData, const ExportContext& ctx, MeshLayer& layer);
+  static void exportSkeletonLayer(const Export& exportData, const ExportContext& ctx, MeshLayer& layer);
+  static void exportMeshInstancePrims(const Export& exportData, ExportContext& ctx, MeshLayer& layer);
   struct ReducedIdxBufSet {
     std::map<float,IndexBuffer> bufSet;
     // Per-timecode idx mapping
@@ -28,6 +28,7 @@
 #include "usd_include_end.h"
 
 #include <stdint.h>
+#include <atomic>
 #include <limits>
 #include <map>
 #include "../dxvk/rtx_render/rtx_hashing.h"
@@ -200,4 +201,10 @@ struct Export {
   IdMap<DistantLight> distantLights;
 };
 
+// Counts assets (materials and meshes) as their layers get written, may be read from any thread
+struct ExportProgress {
+  std::atomic<size_t> numAssets = 0;
+  std::atomic<size_t> numAssetsExported = 0;
+};
+
 }
\ No newline at end of file
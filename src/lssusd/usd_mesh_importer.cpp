@@ -25,6 +25,8 @@
 #include "../util/util_error.h"
 #include "../util/util_string.h"
 #include "../util/util_fast_cache.h"
+#include "../util/util_fastops.h"
+#include "../util/util_mesh_optimizer.h"
 #include "../util/log/log.h"
 #include "../tracy/Tracy.hpp"
 #include "hd/usd_mesh_util.h"
@@ -176,6 +178,68 @@ namespace lss {
   }
 
 
+  UsdMeshImporter::OptimizationStats UsdMeshImporter::Optimize() {
+    ZoneScoped;
+    OptimizationStats stats;
+
+    const uint32_t elementStride = m_vertexStride / sizeof(float);
+    // Note: positions are always the first vertex element
+    assert(m_vertexDecl[0].attribute == Attributes::VertexPositions && m_vertexDecl[0].offset == 0);
+
+    // Skinned vertices sharing a bind pose position can still move apart once posed,
+    // so only triangles repeating a vertex are dropped from those
+    const void* positions = m_numBonesPerVertex > 0 ? nullptr : m_vertexData.data();
+
+    // Sub meshes share the vertex buffer, and so the per vertex scratch of the optimizer
+    meshopt::Scratch scratch;
+    float missesBefore = 0.f, missesAfter = 0.f;
+    std::vector<uint32_t> allIndices;
+    for (SubMesh& submesh : m_meshes) {
+      std::vector<uint32_t>& indices = submesh.indexBuffer;
+      const uint32_t numTrianglesBefore = indices.size() / 3;
+      missesBefore += meshopt::computeAcmr(indices.data(), indices.size(), m_numVertices, scratch) * numTrianglesBefore;
+
+      indices.resize(meshopt::removeDegenerateTriangles(indices.data(), indices.size(), positions, m_vertexStride));
+      meshopt::optimizeVertexCache(indices.data(), indices.size(), m_numVertices, scratch);
+
+      const uint32_t numTrianglesAfter = indices.size() / 3;
+      missesAfter += meshopt::computeAcmr(indices.data(), indices.size(), m_numVertices, scratch) * numTrianglesAfter;
+
+      stats.numTrianglesBefore += numTrianglesBefore;
+      stats.numTrianglesAfter += numTrianglesAfter;
+      allIndices.insert(allIndices.end(), indices.begin(), indices.end());
+    }
+
+    if (stats.numTrianglesBefore > 0) {
+      stats.acmrBefore = missesBefore / stats.numTrianglesBefore;
+    }
+    if (stats.numTrianglesAfter > 0) {
+      stats.acmrAfter = missesAfter / stats.numTrianglesAfter;
+    }
+
+    // Without any triangles every vertex would be dropped, keep the vertex buffer as authored
+    if (allIndices.empty()) {
+      return stats;
+    }
+
+    // Sub meshes share the vertex buffer, so vertices are ordered by first use across all of them
+    std::vector<uint32_t> remap(m_numVertices);
+    const uint32_t numUsedVertices = meshopt::optimizeVertexFetchRemap(remap.data(), allIndices.data(), allIndices.size(), m_numVertices);
+
+    std::vector<float> vertexData(numUsedVertices * elementStride);
+    meshopt::remapVertexBuffer(vertexData.data(), m_vertexData.data(), m_numVertices, m_vertexStride, remap.data());
+    for (SubMesh& submesh : m_meshes) {
+      meshopt::remapIndexBuffer(submesh.indexBuffer.data(), submesh.indexBuffer.size(), remap.data());
+    }
+
+    stats.numUnusedVertices = m_numVertices - numUsedVertices;
+    m_vertexData = std::move(vertexData);
+    m_numVertices = numUsedVertices;
+
+    return stats;
+  }
+
+
   uint32_t UsdMeshImporter::generateVertexDeclaration(std::unique_ptr<GeomPrimvarSampler>* ppMeshSamplers) {
     size_t offset = 0;
     const size_t size = sizeof(float) * 3;
@@ -322,6 +386,59 @@ namespace lss {
     }
   }
 
+  // Resolves which source element every triangle corner reads, returns false if the source can't supply all corners.
+  //  Vertex indexed sources are used in place, everything else is expanded into the scratch vector.
+  //  Note: per corner sampling left a corner holding whatever bytes the vertex slot already had when a sample failed,
+  //  and read uniform primvars by corner rather than by triangle. Neither has a bulk equivalent, so uniform primvars
+  //  are read per triangle as authored, and a source with any index out of range is not expanded at all.
+  static bool getCornerElements(const GeomPrimvarSampler::BulkSource& source, const uint32_t numIndices,
+                                std::vector<uint32_t>& scratch, const uint32_t*& cornerElementsOut) {
+    const uint32_t numTriangles = numIndices / 3;
+
+    switch (source.mapping) {
+    case GeomPrimvarSampler::Mapping::Constant:
+      if (source.numElements == 0)
+        return false;
+      scratch.assign(numIndices, 0);
+      break;
+    case GeomPrimvarSampler::Mapping::PerTriangle: {
+      if (source.indices != nullptr && source.numIndices < numTriangles)
+        return false;
+      scratch.resize(numIndices);
+      for (uint32_t triIdx = 0; triIdx < numTriangles; triIdx++) {
+        const uint32_t faceIdx = source.indices ? (uint32_t) UsdMeshUtil::DecodeFaceIndexFromCoarseFaceParam(source.indices[triIdx]) : triIdx;
+        if (faceIdx >= source.numElements)
+          return false;
+        scratch[triIdx * 3 + 0] = scratch[triIdx * 3 + 1] = scratch[triIdx * 3 + 2] = faceIdx;
+      }
+      break;
+    }
+    case GeomPrimvarSampler::Mapping::PerCorner:
+      if (source.numElements < numIndices)
+        return false;
+      scratch.resize(numIndices);
+      for (uint32_t i = 0; i < numIndices; i++) {
+        scratch[i] = i;
+      }
+      break;
+    case GeomPrimvarSampler::Mapping::Indexed: {
+      if (source.numIndices < numIndices)
+        return false;
+      // Negative indices wrap to large unsigned values and fail the range check
+      const uint32_t* indices = reinterpret_cast<const uint32_t*>(source.indices);
+      uint32_t minIndex, maxIndex;
+      fast::findMinMax<uint32_t>(numIndices, indices, minIndex, maxIndex);
+      if (maxIndex >= source.numElements)
+        return false;
+      cornerElementsOut = indices;
+      return true;
+    }
+    }
+
+    cornerElementsOut = scratch.data();
+    return true;
+  }
+
   void UsdMeshImporter::triangulate(const uint32_t numTriangles, 
                                     const uint32_t elementStride,
                                     const std::unique_ptr<GeomPrimvarSampler>* ppMeshSamplers,
@@ -334,85 +451,114 @@ namespace lss {
     indicesOut.resize(numIndices);
     m_vertexData.resize(numVertexElements);
 
-    fast_unordered_cache<uint32_t> uniqueVertexToIndex;
-
-    // Temp stack storage for blend weights/indices
-    uint32_t blendIndicesStorage[MaxSupportedNumBones];
+    // Expand every attribute stream for all corners in bulk, the vertices are deduplicated afterwards
+    uint8_t* const vertices = reinterpret_cast<uint8_t*>(m_vertexData.data());
+
+    std::vector<uint32_t> scratch;
+    auto resolveCorners = [&](Attributes attribute, std::vector<uint32_t>& cornerScratch, const uint32_t*& cornerElementsOut) -> const GeomPrimvarSampler::BulkSource* {
+      if (!ppMeshSamplers[attribute])
+        return nullptr;
+      const GeomPrimvarSampler::BulkSource& source = ppMeshSamplers[attribute]->GetBulkSource();
+      if (!getCornerElements(source, numIndices, cornerScratch, cornerElementsOut)) {
+        Logger::warn(str::format("Primvar data out of range for vertex attribute, ", attribute, ", on prim, id=", m_meshPrim.GetPath().GetString()));
+        return nullptr;
+      }
+      return &source;
+    };
 
-    IndexRange currentFaceMapRange;
-    uint32_t uniqueVertexIndex = 0;
-    uint32_t prevFaceIdx = 0;
-    uint32_t totalOffset = 0;
-    for (uint32_t triIdx = 0; triIdx < numTriangles; triIdx++) {
-      for (uint32_t vertIdx = 0; vertIdx < 3; vertIdx++) {
-        const uint32_t idx = triIdx * 3 + vertIdx;
-
-        uint32_t vertexOffset = totalOffset;
-
-        // Sample the vertex attributes to get all the data for this vertex.
-        for (const VertexDeclaration& decl : m_vertexDecl) {
-          switch (decl.attribute) {
-          case Attributes::BlendIndices: {
-            ppMeshSamplers[Attributes::BlendIndices]->SampleBuffer(idx, &blendIndicesStorage[0]);
-            // Encode bone indices into compressed byte form
-            for (int j = 0; j < m_numBonesPerVertex; j += 4) {
-              uint32_t vertIndices = 0;
-              for (int k = 0; k < 4 && j + k < m_numBonesPerVertex; ++k) {
-                vertIndices |= blendIndicesStorage[j + k] << 8 * k;
-              }
-              *(uint32_t*) &m_vertexData[vertexOffset + j/4] = vertIndices;
+    for (const VertexDeclaration& decl : m_vertexDecl) {
+      uint8_t* const dst = vertices + decl.offset;
+
+      switch (decl.attribute) {
+      case Attributes::BlendIndices: {
+        const uint32_t* elements;
+        const GeomPrimvarSampler::BulkSource* source = resolveCorners(Attributes::BlendIndices, scratch, elements);
+        if (!source)
+          break;
+        // Encode bone indices into compressed byte form
+        for (uint32_t idx = 0; idx < numIndices; idx++) {
+          const int* blendIndices = reinterpret_cast<const int*>(source->data + elements[idx] * source->elementSize);
+          uint32_t* vertIndices = reinterpret_cast<uint32_t*>(dst + idx * m_vertexStride);
+          for (uint32_t j = 0; j < m_numBonesPerVertex; j += 4) {
+            uint32_t packed = 0;
+            for (uint32_t k = 0; k < 4 && j + k < m_numBonesPerVertex; ++k) {
+              packed |= (uint32_t) blendIndices[j + k] << 8 * k;
             }
-            break;
-          }
-          case Attributes::Colors: {
-            GfVec3f color(1.0f); // default to white
-            ppMeshSamplers[Attributes::Colors]->SampleBuffer(idx, &color);
-            const uint32_t enColor = D3DCOLOR_COLORVALUE(color[0], color[1], color[2], 1.f);
-            uint32_t& vertexColor = *(uint32_t*) &m_vertexData[vertexOffset];
-            vertexColor = (vertexColor & 0xFF000000) | (enColor & 0x00FFFFFF);
-            break;
-          }
-          case Attributes::Opacity: {
-            float opacity = 1.0f; // default to opaque
-            ppMeshSamplers[Attributes::Opacity]->SampleBuffer(idx, &opacity);
-            uint32_t& vertexColor = *(uint32_t*) &m_vertexData[vertexOffset];
-            vertexColor = (vertexColor & 0x00FFFFFF) | (((uint32_t) (opacity * 255.f) & 0xFF) << 24);
-            break;
-          }
-          case Attributes::Texcoords: {
-            ppMeshSamplers[decl.attribute]->SampleBuffer(idx, &m_vertexData[vertexOffset]);
-            // Invert texcoord.y for Remix
-            m_vertexData[vertexOffset + 1] = 1.f - m_vertexData[vertexOffset + 1];
-            break;
-          }
-          default: {
-            ppMeshSamplers[decl.attribute]->SampleBuffer(idx, &m_vertexData[vertexOffset]);
-            break;
+            vertIndices[j / 4] = packed;
           }
+        }
+        break;
+      }
+      case Attributes::Colors: {
+        const uint32_t* colorElements;
+        const GeomPrimvarSampler::BulkSource* colors = resolveCorners(Attributes::Colors, scratch, colorElements);
+        if (colors && colors->elementSize < sizeof(GfVec3f))
+          colors = nullptr;
+
+        // Note: the alpha byte is left at zero, displayOpacity is not applied to the vertex color
+        for (uint32_t idx = 0; idx < numIndices; idx++) {
+          GfVec3f color(1.0f); // default to white
+          if (colors)
+            std::memcpy(&color, colors->data + colorElements[idx] * colors->elementSize, sizeof(color));
+
+          const uint32_t enColor = D3DCOLOR_COLORVALUE(color[0], color[1], color[2], 1.f);
+          *reinterpret_cast<uint32_t*>(dst + idx * m_vertexStride) = enColor & 0x00FFFFFF;
+        }
+        break;
+      }
+      default: {
+        const uint32_t* elements;
+        const GeomPrimvarSampler::BulkSource* source = resolveCorners(decl.attribute, scratch, elements);
+        if (!source)
+          break;
+        fast::gatherStrided(dst, m_vertexStride, source->data, source->elementSize, (uint32_t) source->numElements, decl.size, elements, numIndices);
+
+        if (decl.attribute == Attributes::Texcoords) {
+          // Invert texcoord.y for Remix
+          for (uint32_t idx = 0; idx < numIndices; idx++) {
+            float& v = reinterpret_cast<float*>(dst + idx * m_vertexStride)[1];
+            v = 1.f - v;
           }
-          vertexOffset += decl.size / 4;
         }
+        break;
+      }
+      }
+    }
 
-        // If we've indexed this vertex before, no need to waste memory
-        const XXH64_hash_t vHash = XXH3_64bits(&m_vertexData[totalOffset], m_vertexStride);
+    // If we've indexed a vertex before, no need to waste memory.  Unique vertices are compacted in place,
+    //  the write position never passes the vertex being read.
+    fast_unordered_cache<uint32_t> uniqueVertexToIndex;
+    uniqueVertexToIndex.reserve(numTriangles);
 
-        const auto& existingVertex = uniqueVertexToIndex.find(vHash);
-        if (existingVertex == uniqueVertexToIndex.end()) {
-          std::memcpy(&m_vertexData[uniqueVertexIndex * elementStride], &m_vertexData[totalOffset], m_vertexStride);
-          uniqueVertexToIndex[vHash] = indicesOut[idx] = uniqueVertexIndex++;
-          // if this was unique, then offset the vertex data write pointer, if not, overwrite the last vertex entry
-          totalOffset += elementStride;
-        } else {
-#ifndef NDEBUG
-          // Check for hash collisions
-          assert(memcmp(&m_vertexData[existingVertex->second * elementStride], &m_vertexData[totalOffset], m_vertexStride) == 0);
-#endif
-          indicesOut[idx] = existingVertex->second;
-        }
+    uint32_t uniqueVertexIndex = 0;
+    for (uint32_t idx = 0; idx < numIndices; idx++) {
+      const float* vertex = &m_vertexData[idx * elementStride];
+      const XXH64_hash_t vHash = XXH3_64bits(vertex, m_vertexStride);
+
+      const auto existingVertex = uniqueVertexToIndex.find(vHash);
+      const bool isKnownHash = existingVertex != uniqueVertexToIndex.end();
+      if (isKnownHash && memcmp(&m_vertexData[existingVertex->second * elementStride], vertex, m_vertexStride) == 0) {
+        indicesOut[idx] = existingVertex->second;
+        continue;
       }
 
-      // Build the face to index mapping for geom subsets
-      if (triangleMapOut.size() > 0) {
+      // On a hash collision the vertex is kept as unique, the table keeps pointing at the first one
+      if (uniqueVertexIndex != idx) {
+        std::memcpy(&m_vertexData[uniqueVertexIndex * elementStride], vertex, m_vertexStride);
+      }
+      if (!isKnownHash) {
+        uniqueVertexToIndex.emplace(vHash, uniqueVertexIndex);
+      }
+      indicesOut[idx] = uniqueVertexIndex++;
+    }
+
+    m_vertexData.resize(uniqueVertexIndex * elementStride);
+
+    // Build the face to index mapping for geom subsets
+    if (triangleMapOut.size() > 0) {
+      IndexRange currentFaceMapRange;
+      uint32_t prevFaceIdx = 0;
+      for (uint32_t triIdx = 0; triIdx < numTriangles; triIdx++) {
         const uint32_t faceIdx = UsdMeshUtil::DecodeFaceIndexFromCoarseFaceParam(trianglePrimitiveParams[triIdx]);
         if (faceIdx != prevFaceIdx) {
           currentFaceMapRange.end = triIdx * 3;
@@ -421,14 +567,12 @@ namespace lss {
           prevFaceIdx = faceIdx;
         }
       }
-    }
 
-    if (triangleMapOut.size() > 0 && prevFaceIdx != 0xFFFFFFFF) {
-      // Add the last face to mapping
-      currentFaceMapRange.end = numTriangles * 3;
-      triangleMapOut[prevFaceIdx] = currentFaceMapRange;
+      if (prevFaceIdx != 0xFFFFFFFF) {
+        // Add the last face to mapping
+        currentFaceMapRange.end = numTriangles * 3;
+        triangleMapOut[prevFaceIdx] = currentFaceMapRange;
+      }
     }
-
-    m_vertexData.resize(uniqueVertexIndex * elementStride);
   }
 }
@@ -105,6 +105,19 @@ namespace lss {
       return m_doubleSided;
     }
 
+    struct OptimizationStats {
+      uint32_t numTrianglesBefore = 0;
+      uint32_t numTrianglesAfter = 0;
+      uint32_t numUnusedVertices = 0;
+      // Average cache miss ratio over all sub meshes, weighted by triangle count
+      float acmrBefore = 0.f;
+      float acmrAfter = 0.f;
+    };
+
+    // Drops degenerate triangles, reorders the triangles of every sub mesh for vertex cache reuse
+    // and reorders the vertices by first use, dropping any no triangle references anymore.
+    OptimizationStats Optimize();
+
   private:
     inline static const uint32_t MaxSupportedNumBones = 256;
 
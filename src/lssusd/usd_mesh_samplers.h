@@ -62,6 +62,14 @@ namespace lss {
       return true;
     }
 
+    const uint8_t* GetData() const {
+      return m_buffer.cdata();
+    }
+
+    size_t GetNumElements() const {
+      return m_numElements;
+    }
+
   private:
     pxr::VtArray<uint8_t> const m_buffer;
     int m_numElements;
@@ -70,10 +78,40 @@ namespace lss {
 
   class GeomPrimvarSampler {
   public:
+    // How triangle corners map onto the elements of the source buffer
+    enum class Mapping {
+      Constant,     // every corner reads element 0
+      PerTriangle,  // corner reads the element of its triangle, via the coarse face params when present
+      PerCorner,    // corner i reads element i
+      Indexed,      // corner i reads element indices[i]
+    };
+
+    // Raw view of the sampled data, used to expand whole attribute streams without a virtual call per corner
+    struct BulkSource {
+      Mapping mapping = Mapping::Constant;
+      const uint8_t* data = nullptr;
+      size_t numElements = 0;
+      size_t elementSize = 0;
+      const int* indices = nullptr;
+      size_t numIndices = 0;
+    };
+
     GeomPrimvarSampler() = default;
     virtual ~GeomPrimvarSampler() = default;
 
     virtual bool SampleBuffer(int index, void* value) const = 0;
+
+    const BulkSource& GetBulkSource() const {
+      return m_bulkSource;
+    }
+
+  protected:
+    void setBulkSource(Mapping mapping, const BufferSampler& sampler, size_t elementSize, const int* indices = nullptr, size_t numIndices = 0) {
+      m_bulkSource = BulkSource { mapping, sampler.GetData(), sampler.GetNumElements(), elementSize, indices, numIndices };
+    }
+
+  private:
+    BulkSource m_bulkSource;
   };
 
 
@@ -81,7 +119,9 @@ namespace lss {
   public:
     ConstantSampler(pxr::VtValue const& value, size_t elementSize)
       : m_sampler(value)
-      , m_elementSize(elementSize) { }
+      , m_elementSize(elementSize) {
+      setBulkSource(Mapping::Constant, m_sampler, m_elementSize);
+    }
 
     bool SampleBuffer(int index, void* value) const override {
       return m_sampler.Sample(0, value, m_elementSize);
@@ -97,11 +137,15 @@ namespace lss {
     UniformSampler(pxr::VtValue const& value, pxr::VtIntArray const& primitiveParams, size_t elementSize)
       : m_sampler(value)
       , m_primitiveParams(primitiveParams)
-      , m_elementSize(elementSize) { }
+      , m_elementSize(elementSize) {
+      setBulkSource(Mapping::PerTriangle, m_sampler, m_elementSize, m_primitiveParams.cdata(), m_primitiveParams.size());
+    }
 
     UniformSampler(pxr::VtValue const& value, size_t elementSize)
       : m_sampler(value)
-      , m_elementSize(elementSize) { }
+      , m_elementSize(elementSize) {
+      setBulkSource(Mapping::PerTriangle, m_sampler, m_elementSize);
+    }
 
     bool SampleBuffer(int index, void* value) const {
       if (m_primitiveParams.empty()) {
@@ -125,7 +169,10 @@ namespace lss {
     TriangleVertexSampler(pxr::VtValue const& value, pxr::VtVec3iArray const& indices, size_t elementSize)
       : m_sampler(value)
       , m_indices(indices)
-      , m_elementSize(elementSize) { }
+      , m_elementSize(elementSize) {
+      static_assert(sizeof(pxr::GfVec3i) == sizeof(int) * 3);
+      setBulkSource(Mapping::Indexed, m_sampler, m_elementSize, reinterpret_cast<const int*>(m_indices.cdata()), m_indices.size() * 3);
+    }
 
     bool SampleBuffer(int index, void* value) const {
       return m_sampler.Sample(m_indices[index / 3][index % 3], value, m_elementSize);
@@ -142,7 +189,9 @@ namespace lss {
   public:
     TriangleFaceVaryingSampler(pxr::VtValue const& value, UsdMeshUtil& meshUtil, size_t elementSize)
       : m_sampler(triangulate(value, meshUtil, elementSize))
-      , m_elementSize(elementSize) { }
+      , m_elementSize(elementSize) {
+      setBulkSource(Mapping::PerCorner, m_sampler, m_elementSize);
+    }
 
     bool SampleBuffer(int index, void* value) const {
       return m_sampler.Sample(index, value, m_elementSize);
@@ -21,7 +21,11 @@
 */
 #include "log.h"
 
+#include <string_view>
+
 #include "../util_env.h"
+#include "../sync/sync_futex.h"
+#include "../xxHash/xxhash.h"
 
 // NV-DXVK start: Don't double print every line
 namespace{
@@ -39,17 +43,77 @@ namespace dxvk {
   // NV-DXVK start: Don't double print every line
   , m_doublePrintToStdErr(getDoublePrintToStdErr())
   // NV-DXVK end
+  // NV-DXVK start: Asynchronous logging
+  , m_startTime(high_resolution_clock::now())
+  // NV-DXVK end
   {
     if (m_minLevel != LogLevel::None) {
       auto path = getFileName(file_name);
 
       if (!path.empty())
         m_fileStream = std::ofstream(str::tows(path.c_str()).c_str());
+
+      // NV-DXVK start: Asynchronous logging
+      m_ring = std::make_unique<Entry[]>(kRingSize);
+      for (uint32_t i = 0; i < kRingSize; i++)
+        m_ring[i].sequence.store(i, std::memory_order_relaxed);
+
+      // Without a writer thread every message is written out by the thread logging it
+      try {
+        m_thread = dxvk::thread([this] { runWriter(); });
+      } catch (const std::system_error&) { }
+
+#ifdef _WIN32
+      // Only sees exceptions nothing else handled, right before the process goes down. Exceptions the
+      // application or a debugger handle, first chance ones included, never get here.
+      const LPTOP_LEVEL_EXCEPTION_FILTER crashFilter = [](EXCEPTION_POINTERS* pInfo) -> LONG {
+        flushOnCrash();
+
+        // Keep any filter installed before us, e.g. a crash reporter, working
+        const auto previousFilter = reinterpret_cast<LPTOP_LEVEL_EXCEPTION_FILTER>(s_instance.m_previousCrashFilter);
+        return previousFilter ? previousFilter(pInfo) : EXCEPTION_CONTINUE_SEARCH;
+      };
+      m_crashFilter = reinterpret_cast<void*>(crashFilter);
+      m_previousCrashFilter = reinterpret_cast<void*>(::SetUnhandledExceptionFilter(crashFilter));
+#endif
+      // NV-DXVK end
     }
   }
   
   
-  Logger::~Logger() { }
+  Logger::~Logger() {
+    // NV-DXVK start: Asynchronous logging
+    if (m_ring == nullptr)
+      return;
+
+#ifdef _WIN32
+    if (m_crashFilter) {
+      // Only restore the previous filter if nobody replaced ours in the meantime
+      const LPTOP_LEVEL_EXCEPTION_FILTER currentFilter = ::SetUnhandledExceptionFilter(
+        reinterpret_cast<LPTOP_LEVEL_EXCEPTION_FILTER>(m_previousCrashFilter));
+      if (currentFilter != reinterpret_cast<LPTOP_LEVEL_EXCEPTION_FILTER>(m_crashFilter))
+        ::SetUnhandledExceptionFilter(currentFilter);
+    }
+#endif
+
+    if (m_thread.joinable()) {
+      // On process exit the writer has already been terminated, possibly while holding the lock
+      if (this_thread::isInModuleDetachment()) {
+        m_thread.detach();
+        flushOnCrash();
+        return;
+      }
+
+      m_stopped.store(true);
+      m_signal.fetch_add(1);
+      sync::futexWakeAll(m_signal);
+      m_thread.join();
+    }
+
+    std::lock_guard<dxvk::mutex> lock(m_mutex);
+    writeQueued(m_enqueuePos.load());
+    // NV-DXVK end
+  }
   
   
   void Logger::trace(const std::string& message) {
@@ -80,34 +144,239 @@ namespace dxvk {
   void Logger::log(LogLevel level, const std::string& message) {
     s_instance.emitMsg(level, message);
   }
+
+
+  // NV-DXVK start: Asynchronous logging
+  void Logger::flush() {
+    if (s_instance.m_ring == nullptr)
+      return;
+
+    std::lock_guard<dxvk::mutex> lock(s_instance.m_mutex);
+    s_instance.writeQueued(s_instance.m_enqueuePos.load());
+  }
+  // NV-DXVK end
   
   
   void Logger::emitMsg(LogLevel level, const std::string& message) {
-    if (level >= m_minLevel) {
-      OutputDebugString(str::format(message, "\n\n").c_str());
-
-      std::lock_guard<dxvk::mutex> lock(m_mutex);
-      
-      static std::array<const char*, 5> s_prefixes
-        = {{ "trace: ", "debug: ", "info:  ", "warn:  ", "err:   " }};
-      
-      const char* prefix = s_prefixes.at(static_cast<uint32_t>(level));
-
-      std::stringstream stream(message);
-      std::string       line;
-
-      while (std::getline(stream, line, '\n')) {
-        // NV-DXVK start: Don't double print every line
-        if(m_doublePrintToStdErr) {
-          std::cerr << prefix << line << std::endl;
+    // NV-DXVK start: Asynchronous logging
+    // Writing out happens on another thread, don't let an invalid level reach it
+    if (level >= m_minLevel && level < LogLevel::None) {
+    // NV-DXVK end
+      // NV-DXVK start: Asynchronous logging
+      // Errors are rare and often the last thing logged before a failure, so they are
+      // never suppressed and are written out before returning
+      uint32_t suppressedRepeats = 0;
+
+      if (level < LogLevel::Error && !filterRepeat(level, message, suppressedRepeats))
+        return;
+
+      const uint64_t pos = enqueue(level, std::string(message), suppressedRepeats);
+
+      if (level >= LogLevel::Error || !m_thread.joinable()) {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+        writeQueued(pos + 1);
+      }
+      // NV-DXVK end
+    }
+  }
+
+
+  // NV-DXVK start: Asynchronous logging
+  bool Logger::filterRepeat(LogLevel level, const std::string& message, uint32_t& suppressedRepeats) {
+    const XXH64_hash_t hash = XXH3_64bits_withSeed(message.data(), message.size(), static_cast<uint32_t>(level));
+    const uint64_t tag = hash >> 32;
+    const uint64_t window = std::chrono::duration_cast<std::chrono::seconds>(high_resolution_clock::now() - m_startTime).count() & 0xffff;
+
+    std::atomic<uint64_t>& filter = m_repeatFilter[hash % kRepeatFilterSize];
+    uint64_t current = filter.load(std::memory_order_relaxed);
+
+    while (true) {
+      const uint64_t currentTag = current >> 32;
+      const uint64_t currentWindow = (current >> 16) & 0xffff;
+      const uint64_t currentCount = current & 0xffff;
+
+      uint64_t next;
+      bool emit;
+      suppressedRepeats = 0;
+
+      if (currentTag == tag && currentWindow == window) {
+        emit = currentCount < kMaxRepeatsPerSecond;
+        next = currentCount < 0xffff ? current + 1 : current;
+      } else {
+        // A different message, or the first repeat in a new window.  Messages sharing a
+        // filter entry just restart each other's count.
+        emit = true;
+        next = (tag << 32) | (window << 16) | 1;
+
+        if (currentTag == tag && currentCount > kMaxRepeatsPerSecond)
+          suppressedRepeats = static_cast<uint32_t>(currentCount - kMaxRepeatsPerSecond);
+      }
+
+      if (next == current || filter.compare_exchange_weak(current, next, std::memory_order_relaxed))
+        return emit;
+    }
+  }
+
+
+  uint64_t Logger::enqueue(LogLevel level, std::string&& message, uint32_t suppressedRepeats) {
+    uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Entry* entry;
+
+    while (true) {
+      entry = &m_ring[pos % kRingSize];
+      const uint64_t sequence = entry->sequence.load(std::memory_order_acquire);
+
+      if (sequence == pos) {
+        if (m_enqueuePos.compare_exchange_weak(pos, pos + 1))
+          break;
+      } else if (sequence < pos) {
+        // The ring is full, help write it out rather than wait on the writer.  This also keeps
+        // logging going when the writer can't run yet, e.g. while the loader lock is held.
+        {
+          std::lock_guard<dxvk::mutex> lock(m_mutex);
+          while (writeNext()) { }
         }
-        // NV-DXVK end
+        this_thread::yield();
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+      } else {
+        pos = m_enqueuePos.load(std::memory_order_relaxed);
+      }
+    }
+
+    entry->level = level;
+    entry->suppressedRepeats = suppressedRepeats;
+    entry->message = std::move(message);
+    entry->sequence.store(pos + 1, std::memory_order_release);
+
+    if (m_sleeping.load()) {
+      m_signal.fetch_add(1);
+      sync::futexWakeAll(m_signal);
+    }
 
-        if (m_fileStream)
-          m_fileStream << prefix << line << std::endl;
+    return pos;
+  }
+
+
+  void Logger::writeQueued(uint64_t endPos) {
+    bool written = false;
+
+    while (m_dequeuePos.load(std::memory_order_relaxed) < endPos) {
+      // Another thread may still be filling in an entry it has claimed
+      if (writeNext())
+        written = true;
+      else
+        this_thread::yield();
+    }
+
+    if (written && m_fileStream)
+      m_fileStream.flush();
+  }
+
+
+  bool Logger::writeNext() {
+    const uint64_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    Entry& entry = m_ring[pos % kRingSize];
+
+    if (entry.sequence.load(std::memory_order_acquire) != pos + 1)
+      return false;
+
+    const LogLevel level = entry.level;
+    const uint32_t suppressedRepeats = entry.suppressedRepeats;
+    const std::string message = std::move(entry.message);
+
+    // Hand the entry back before formatting, producers can reuse it right away
+    entry.message = std::string();
+    entry.sequence.store(pos + kRingSize, std::memory_order_release);
+    m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+
+    if (suppressedRepeats != 0)
+      writeMsg(level, str::format("(Suppressed ", suppressedRepeats, " repeats of the next message)"));
+
+    writeMsg(level, message);
+    return true;
+  }
+
+
+  void Logger::writeMsg(LogLevel level, const std::string& message) {
+    OutputDebugString(str::format(message, "\n\n").c_str());
+
+    static std::array<const char*, 5> s_prefixes
+      = {{ "trace: ", "debug: ", "info:  ", "warn:  ", "err:   " }};
+
+    const char* prefix = s_prefixes.at(static_cast<uint32_t>(level));
+
+    size_t begin = 0;
+
+    while (begin < message.size()) {
+      size_t end = message.find('\n', begin);
+      if (end == std::string::npos)
+        end = message.size();
+
+      const std::string_view line(message.data() + begin, end - begin);
+      begin = end + 1;
+
+      // NV-DXVK start: Don't double print every line
+      if(m_doublePrintToStdErr) {
+        std::cerr << prefix << line << std::endl;
       }
+      // NV-DXVK end
+
+      // Flushed once per batch of messages rather than per line
+      if (m_fileStream)
+        m_fileStream << prefix << line << '\n';
+    }
+  }
+
+
+  void Logger::runWriter() {
+    env::setThreadName("dxvk-logger");
+
+    while (!m_stopped.load()) {
+      const uint32_t signal = m_signal.load();
+
+      {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+        bool written = false;
+
+        while (writeNext())
+          written = true;
+
+        if (written && m_fileStream)
+          m_fileStream.flush();
+      }
+
+      // Producers only wake us while we're flagged as sleeping, so check for messages once more after raising the flag
+      m_sleeping.store(true);
+
+      if (m_enqueuePos.load() == m_dequeuePos.load(std::memory_order_relaxed)) {
+        if (!m_stopped.load())
+          sync::futexWait(m_signal, signal);
+      } else {
+        // An entry is claimed but not filled in yet
+        this_thread::yield();
+      }
+
+      m_sleeping.store(false);
     }
   }
+
+
+  void Logger::flushOnCrash() {
+    if (s_instance.m_ring == nullptr)
+      return;
+
+    // The crashing thread may hold the lock, never block here
+    if (!s_instance.m_mutex.try_lock())
+      return;
+
+    while (s_instance.writeNext()) { }
+
+    if (s_instance.m_fileStream)
+      s_instance.m_fileStream.flush();
+
+    s_instance.m_mutex.unlock();
+  }
+  // NV-DXVK end
   
   
   LogLevel Logger::getMinLogLevel() {
@@ -22,12 +22,15 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include "../util_once.h"
 
 #include "../thread.h"
+#include "../util_time.h"
 
 namespace dxvk {
   
@@ -46,6 +49,14 @@ namespace dxvk {
    * Logger for one DLL. Creates a text file and
    * writes all log messages to that file.
    */
+  // NV-DXVK start: Asynchronous logging
+  // Messages are queued in a lock-free ring buffer and written out by a
+  // dedicated thread, so logging threads don't serialize on file I/O.
+  // Errors are written out before the logging call returns, and anything
+  // queued is flushed when the process crashes.  A message repeated more
+  // than a few times a second is suppressed, with a count of the
+  // suppressed repeats logged when it shows up again.
+  // NV-DXVK end
   class Logger {
     
   public:
@@ -63,8 +74,31 @@ namespace dxvk {
     static LogLevel logLevel() {
       return s_instance.m_minLevel;
     }
+
+    // NV-DXVK start: Asynchronous logging
+    /**
+     * \brief Writes out all queued messages
+     *
+     * Blocks until every message logged before
+     * the call has been written to the log file.
+     */
+    static void flush();
+    // NV-DXVK end
     
   private:
+
+    // NV-DXVK start: Asynchronous logging
+    static constexpr uint32_t kRingSize = 4096;
+    static constexpr uint32_t kRepeatFilterSize = 256;
+    static constexpr uint32_t kMaxRepeatsPerSecond = 8;
+
+    struct Entry {
+      std::atomic<uint64_t> sequence;
+      LogLevel level;
+      uint32_t suppressedRepeats;
+      std::string message;
+    };
+    // NV-DXVK end
     
     static Logger s_instance;
     
@@ -73,10 +107,47 @@ namespace dxvk {
     const bool m_doublePrintToStdErr;
     // NV-DXVK end
     
+    // Held by whichever thread is writing out queued messages
     dxvk::mutex   m_mutex;
     std::ofstream m_fileStream;
+
+    // NV-DXVK start: Asynchronous logging
+    std::unique_ptr<Entry[]> m_ring;
+    std::atomic<uint64_t> m_enqueuePos = { 0 };
+    std::atomic<uint64_t> m_dequeuePos = { 0 };
+
+    // Tag, one second window and count of the recently logged messages, packed to be updated with a single CAS
+    std::array<std::atomic<uint64_t>, kRepeatFilterSize> m_repeatFilter = {};
+    const high_resolution_clock::time_point m_startTime;
+
+    std::atomic<uint32_t> m_signal = { 0 };
+    std::atomic<bool> m_sleeping = { false };
+    std::atomic<bool> m_stopped = { false };
+    dxvk::thread m_thread;
+
+    void* m_crashFilter = nullptr;
+    void* m_previousCrashFilter = nullptr;
+    // NV-DXVK end
     
     void emitMsg(LogLevel level, const std::string& message);
+
+    // NV-DXVK start: Asynchronous logging
+    bool filterRepeat(LogLevel level, const std::string& message, uint32_t& suppressedRepeats);
+
+    uint64_t enqueue(LogLevel level, std::string&& message, uint32_t suppressedRepeats);
+
+    // Writes out queued messages up to the given position, expects m_mutex to be held
+    void writeQueued(uint64_t endPos);
+
+    // Writes out the oldest queued message if it's ready, expects m_mutex to be held
+    bool writeNext();
+
+    void writeMsg(LogLevel level, const std::string& message);
+
+    void runWriter();
+
+    static void flushOnCrash();
+    // NV-DXVK end
     
     static LogLevel getMinLogLevel();
     
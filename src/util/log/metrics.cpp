@@ -21,10 +21,465 @@
 */
 #include "METRICS.h"
 
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "log.h"
 #include "../util_env.h"
+#include "../util_time.h"
+#include "../sync/sync_futex.h"
 #include "util_math.h"
 
 namespace dxvk {
+
+  // NV-DXVK start: Metrics timeline
+  namespace {
+    std::string getMetricsPath(const char* fileName) {
+      std::string path = env::getEnvVar("DXVK_METRICS_PATH");
+
+      if (path == "none")
+        return "";
+
+      if (!path.empty() && *path.rbegin() != '/')
+        path += '/';
+
+      path += fileName;
+      return path;
+    }
+
+    struct MetricSlot {
+      std::string name;
+      MetricType type = MetricType::Counter;
+
+      // Counter value, or histogram sample count
+      std::atomic<uint64_t> count = { 0 };
+      // Gauge value, or histogram sample sum
+      std::atomic<double> value = { 0.0 };
+      std::atomic<double> min = { std::numeric_limits<double>::infinity() };
+      std::atomic<double> max = { -std::numeric_limits<double>::infinity() };
+    };
+
+    template<typename Op>
+    void atomicUpdate(std::atomic<double>& target, Op&& op) {
+      double current = target.load(std::memory_order_relaxed);
+      while (!target.compare_exchange_weak(current, op(current), std::memory_order_relaxed)) { }
+    }
+
+    // Rows are collected on the thread ending the frame and handed to a writer thread through a
+    // ring buffer, so the frame never waits on formatting or file IO
+    class MetricsTimeline {
+    public:
+      // Metrics register from static initializers in other translation units, so this
+      // must be constructed on first use
+      static MetricsTimeline& get() {
+        static MetricsTimeline s_timeline;
+        return s_timeline;
+      }
+
+      uint32_t registerMetric(const char* name, MetricType type) {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+        auto it = m_indices.find(name);
+        if (it != m_indices.end()) {
+          assert(m_slots[it->second].type == type && "Metric registered again with a different type.");
+          return it->second;
+        }
+
+        const uint32_t index = m_numMetrics.load(std::memory_order_relaxed);
+        if (index == kMaxMetrics) {
+          Logger::warn(str::format("Metrics: Too many timeline metrics, ", name, " will not be recorded."));
+          return kMaxMetrics;
+        }
+
+        m_slots[index].name = name;
+        m_slots[index].type = type;
+        m_indices.emplace(name, index);
+        m_numMetrics.store(index + 1, std::memory_order_release);
+        return index;
+      }
+
+      // Recording is skipped while no timeline is open, keeping the registered metrics free when unused
+      MetricSlot* getSlotForRecording(uint32_t index) {
+        return m_open.load(std::memory_order_relaxed) ? &m_slots[index] : nullptr;
+      }
+
+      bool begin(const std::string& path, MetricsTimelineFormat format) {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+        close();
+
+        m_stream = std::ofstream(str::tows(path.c_str()).c_str());
+        if (!m_stream)
+          return false;
+
+        m_stream.precision(10);
+        m_format = format;
+        m_numColumns = 0;
+        m_warnedLateMetric = false;
+        m_wroteHeader = false;
+        m_framesSinceFlush = 0;
+        m_startTime = high_resolution_clock::now();
+
+        m_rows = std::make_unique<Row[]>(kRingSize);
+        m_writePos.store(0);
+        m_readPos.store(0);
+        m_droppedFrames.store(0);
+        m_stopping.store(false);
+
+        try {
+          m_writer = dxvk::thread([this] { runWriter(); });
+        } catch (const std::system_error&) {
+          m_stream.close();
+          m_rows.reset();
+          return false;
+        }
+
+        // Drop anything recorded before the timeline opened
+        for (MetricSlot& slot : m_slots)
+          collect(slot);
+
+        m_open.store(true);
+        return true;
+      }
+
+      void end() {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+        close();
+      }
+
+      void flush() {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+        if (m_open.load()) {
+          m_flushRequested.store(true);
+          wakeWriter();
+        }
+      }
+
+      void endFrame(uint64_t frameId) {
+        std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+        // Opening the timeline on startup happens too early to log from
+        if (!m_startupPath.empty()) {
+          if (m_open.load())
+            Logger::info(str::format("Metrics: Writing timeline to ", m_startupPath));
+          else
+            Logger::err(str::format("Metrics: Failed to open timeline file ", m_startupPath));
+          m_startupPath.clear();
+        }
+
+        if (!m_open.load())
+          return;
+
+        uint32_t numMetrics = m_numMetrics.load(std::memory_order_acquire);
+
+        // The CSV header is fixed by the first frame, metrics registered later only make it into JSON timelines
+        if (m_format == MetricsTimelineFormat::Csv) {
+          if (m_numColumns == 0) {
+            m_numColumns = numMetrics;
+          } else if (numMetrics > m_numColumns && !m_warnedLateMetric) {
+            Logger::warn(str::format("Metrics: ", m_slots[m_numColumns].name, " was registered after the timeline started and is left out of it."));
+            m_warnedLateMetric = true;
+          }
+
+          numMetrics = m_numColumns;
+        }
+
+        const double time = std::chrono::duration<double>(high_resolution_clock::now() - m_startTime).count();
+
+        // Writing is behind by the whole ring, drop the frame rather than wait on the writer. Its values
+        // are still collected so they don't end up in the next frame.
+        const uint64_t writePos = m_writePos.load(std::memory_order_relaxed);
+        if (writePos - m_readPos.load(std::memory_order_acquire) == kRingSize) {
+          for (uint32_t i = 0; i < numMetrics; i++)
+            collect(m_slots[i]);
+
+          m_droppedFrames.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+
+        Row& row = m_rows[writePos % kRingSize];
+        row.frameId = frameId;
+        row.time = time;
+        row.samples.resize(numMetrics);
+
+        for (uint32_t i = 0; i < numMetrics; i++)
+          row.samples[i] = collect(m_slots[i]);
+
+        m_writePos.store(writePos + 1);
+
+        if (m_writerSleeping.load())
+          wakeWriter();
+      }
+
+    private:
+      static constexpr uint32_t kMaxMetrics = 256;
+
+      // Frames the writer may fall behind by
+      static constexpr uint32_t kRingSize = 256;
+
+      struct Sample {
+        uint64_t count;
+        double value;
+        double min;
+        double max;
+      };
+
+      struct Row {
+        uint64_t frameId;
+        double time;
+        std::vector<Sample> samples;
+      };
+
+      MetricsTimeline() {
+        const std::string format = env::getEnvVar("DXVK_METRICS_TIMELINE");
+
+        if (format == "csv") {
+          m_startupPath = getMetricsPath("metrics_timeline.csv");
+          if (!m_startupPath.empty())
+            begin(m_startupPath, MetricsTimelineFormat::Csv);
+        } else if (format == "json") {
+          m_startupPath = getMetricsPath("metrics_timeline.jsonl");
+          if (!m_startupPath.empty())
+            begin(m_startupPath, MetricsTimelineFormat::JsonLines);
+        }
+      }
+
+      ~MetricsTimeline() {
+        if (m_open.load() && this_thread::isInModuleDetachment()) {
+          // On process exit the writer has already been terminated, keep what it wrote
+          m_open.store(false);
+          m_writer.detach();
+          m_stream.flush();
+          return;
+        }
+
+        close();
+      }
+
+      void close() {
+        if (m_open.load()) {
+          m_open.store(false);
+
+          // The writer drains the ring before it exits
+          m_stopping.store(true);
+          wakeWriter();
+          m_writer.join();
+
+          m_stream.close();
+          m_rows.reset();
+        }
+      }
+
+      void wakeWriter() {
+        m_writerSignal.fetch_add(1);
+        sync::futexWakeAll(m_writerSignal);
+      }
+
+      void runWriter() {
+        env::setThreadName("dxvk-metrics-writer");
+
+        while (true) {
+          const uint64_t writePos = m_writePos.load(std::memory_order_acquire);
+          uint64_t readPos = m_readPos.load(std::memory_order_relaxed);
+
+          if (readPos == writePos) {
+            if (m_flushRequested.exchange(false))
+              m_stream.flush();
+
+            if (m_stopping.load())
+              break;
+
+            // Frames only wake us while we're flagged as sleeping, so check for work once more after raising the flag
+            const uint32_t signal = m_writerSignal.load();
+            m_writerSleeping.store(true);
+            if (m_writePos.load() == readPos && !m_stopping.load() && !m_flushRequested.load())
+              sync::futexWait(m_writerSignal, signal);
+            m_writerSleeping.store(false);
+            continue;
+          }
+
+          for (; readPos != writePos; readPos++) {
+            writeRow(m_rows[readPos % kRingSize]);
+            m_readPos.store(readPos + 1, std::memory_order_release);
+          }
+
+          const uint64_t droppedFrames = m_droppedFrames.exchange(0, std::memory_order_relaxed);
+          if (droppedFrames > 0)
+            Logger::warn(str::format("Metrics: Writing the timeline fell behind, ", droppedFrames, " frames were dropped from it."));
+        }
+
+        m_stream.flush();
+      }
+
+      void writeRow(const Row& row) {
+        const uint32_t numMetrics = static_cast<uint32_t>(row.samples.size());
+
+        if (m_format == MetricsTimelineFormat::Csv) {
+          if (!m_wroteHeader) {
+            writeCsvHeader(numMetrics);
+            m_wroteHeader = true;
+          }
+
+          m_stream << row.frameId << ',' << row.time;
+        } else {
+          m_stream << "{\"frame\":" << row.frameId << ",\"time\":" << row.time;
+        }
+
+        for (uint32_t i = 0; i < numMetrics; i++) {
+          if (m_format == MetricsTimelineFormat::Csv)
+            writeCsvSample(m_slots[i].type, row.samples[i]);
+          else
+            writeJsonSample(m_slots[i], row.samples[i]);
+        }
+
+        if (m_format == MetricsTimelineFormat::Csv)
+          m_stream << '\n';
+        else
+          m_stream << "}\n";
+
+        // Keep what's written reasonably current on long runs, in case the process doesn't exit cleanly
+        constexpr uint32_t kFlushPeriod = 256;
+        if (++m_framesSinceFlush == kFlushPeriod) {
+          m_stream.flush();
+          m_framesSinceFlush = 0;
+        }
+      }
+
+      // Takes the values recorded since the last collection.  A value recorded concurrently may be
+      // split across two frames, e.g. a histogram sample counted in one and summed in the next.
+      static Sample collect(MetricSlot& slot) {
+        Sample sample = {};
+
+        switch (slot.type) {
+        case MetricType::Counter:
+          sample.count = slot.count.exchange(0, std::memory_order_relaxed);
+          break;
+        case MetricType::Gauge:
+          sample.value = slot.value.load(std::memory_order_relaxed);
+          break;
+        case MetricType::Histogram:
+          sample.count = slot.count.exchange(0, std::memory_order_relaxed);
+          sample.value = slot.value.exchange(0.0, std::memory_order_relaxed);
+          sample.min = slot.min.exchange(std::numeric_limits<double>::infinity(), std::memory_order_relaxed);
+          sample.max = slot.max.exchange(-std::numeric_limits<double>::infinity(), std::memory_order_relaxed);
+          break;
+        }
+
+        return sample;
+      }
+
+      void writeCsvHeader(uint32_t numColumns) {
+        m_stream << "frame,time";
+
+        for (uint32_t i = 0; i < numColumns; i++) {
+          const MetricSlot& slot = m_slots[i];
+
+          if (slot.type == MetricType::Histogram)
+            m_stream << ',' << slot.name << ".count," << slot.name << ".min," << slot.name << ".mean," << slot.name << ".max";
+          else
+            m_stream << ',' << slot.name;
+        }
+
+        m_stream << '\n';
+      }
+
+      void writeCsvSample(MetricType type, const Sample& sample) {
+        switch (type) {
+        case MetricType::Counter:
+          m_stream << ',' << sample.count;
+          break;
+        case MetricType::Gauge:
+          m_stream << ',' << sample.value;
+          break;
+        case MetricType::Histogram:
+          // Left empty for frames without samples
+          m_stream << ',' << sample.count;
+          if (sample.count > 0)
+            m_stream << ',' << sample.min << ',' << sample.value / sample.count << ',' << sample.max;
+          else
+            m_stream << ",,,";
+          break;
+        }
+      }
+
+      void writeJsonSample(const MetricSlot& slot, const Sample& sample) {
+        m_stream << ",\"" << slot.name << "\":";
+
+        switch (slot.type) {
+        case MetricType::Counter:
+          m_stream << sample.count;
+          break;
+        case MetricType::Gauge:
+          m_stream << sample.value;
+          break;
+        case MetricType::Histogram:
+          m_stream << "{\"count\":" << sample.count;
+          if (sample.count > 0)
+            m_stream << ",\"min\":" << sample.min << ",\"mean\":" << sample.value / sample.count << ",\"max\":" << sample.max;
+          m_stream << '}';
+          break;
+        }
+      }
+
+      dxvk::mutex m_mutex;
+
+      // One spare slot takes the values of metrics registered past the limit
+      std::array<MetricSlot, kMaxMetrics + 1> m_slots;
+      std::atomic<uint32_t> m_numMetrics = { 0 };
+      std::unordered_map<std::string, uint32_t> m_indices;
+
+      std::atomic<bool> m_open = { false };
+      MetricsTimelineFormat m_format = MetricsTimelineFormat::Csv;
+      uint32_t m_numColumns = 0;
+      bool m_warnedLateMetric = false;
+      high_resolution_clock::time_point m_startTime;
+      std::string m_startupPath;
+
+      std::unique_ptr<Row[]> m_rows;
+      std::atomic<uint64_t> m_writePos = { 0 };
+      std::atomic<uint64_t> m_readPos = { 0 };
+      std::atomic<uint64_t> m_droppedFrames = { 0 };
+
+      // Only touched by the writer thread while the timeline is open
+      std::ofstream m_stream;
+      bool m_wroteHeader = false;
+      uint32_t m_framesSinceFlush = 0;
+
+      std::atomic<uint32_t> m_writerSignal = { 0 };
+      std::atomic<bool> m_writerSleeping = { false };
+      std::atomic<bool> m_flushRequested = { false };
+      std::atomic<bool> m_stopping = { false };
+      dxvk::thread m_writer;
+    };
+  }
+
+  TimelineMetric::TimelineMetric(const char* name, MetricType type)
+  : m_index(MetricsTimeline::get().registerMetric(name, type)) { }
+
+  void MetricCounter::add(uint64_t value) const {
+    if (MetricSlot* slot = MetricsTimeline::get().getSlotForRecording(m_index))
+      slot->count.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  void MetricGauge::set(double value) const {
+    if (MetricSlot* slot = MetricsTimeline::get().getSlotForRecording(m_index))
+      slot->value.store(value, std::memory_order_relaxed);
+  }
+
+  void MetricHistogram::record(double value) const {
+    if (MetricSlot* slot = MetricsTimeline::get().getSlotForRecording(m_index)) {
+      slot->count.fetch_add(1, std::memory_order_relaxed);
+      atomicUpdate(slot->value, [value](double sum) { return sum + value; });
+      atomicUpdate(slot->min, [value](double min) { return std::min(min, value); });
+      atomicUpdate(slot->max, [value](double max) { return std::max(max, value); });
+    }
+  }
+  // NV-DXVK end
   
   Metrics::Metrics() {
     auto path = getFileName();
@@ -46,8 +501,32 @@ namespace dxvk {
   void Metrics::serialize() {
     for(uint32_t i=0 ; i<Metric::kCount ; i++)
       s_instance.emitMsg((Metric)i, s_instance.m_data[i]);
+
+    // NV-DXVK start: Metrics timeline
+    MetricsTimeline::get().flush();
+    // NV-DXVK end
+  }
+
+  // NV-DXVK start: Metrics timeline
+  bool Metrics::beginTimeline(const std::string& path, MetricsTimelineFormat format) {
+    if (!MetricsTimeline::get().begin(path, format)) {
+      Logger::err(str::format("Metrics: Failed to open timeline file ", path));
+      return false;
+    }
+
+    Logger::info(str::format("Metrics: Writing timeline to ", path));
+    return true;
   }
 
+  void Metrics::endTimeline() {
+    MetricsTimeline::get().end();
+  }
+
+  void Metrics::endFrame(uint64_t frameId) {
+    MetricsTimeline::get().endFrame(frameId);
+  }
+  // NV-DXVK end
+
   template<typename T>
   void Metrics::emitMsg(Metric metric, const T& value) {
     if(m_fileStream)
@@ -55,15 +534,8 @@ namespace dxvk {
   }
   
   std::string Metrics::getFileName() {
-    std::string path = env::getEnvVar("DXVK_METRICS_PATH");
-    
-    if (path == "none")
-      return "";
-
-    if (!path.empty() && *path.rbegin() != '/')
-      path += '/';
-
-    path += "metrics.txt";
-    return path;
+    // NV-DXVK start: Metrics timeline
+    return getMetricsPath("metrics.txt");
+    // NV-DXVK end
   }
 }
@@ -40,12 +40,67 @@ namespace dxvk {
     kCount
   };
 
+  // NV-DXVK start: Metrics timeline
+  enum class MetricType : uint8_t {
+    Counter,    // Summed over the frame
+    Gauge,      // Keeps the last value set
+    Histogram,  // Count, minimum, mean and maximum of the values recorded in the frame
+  };
+
+  enum class MetricsTimelineFormat : uint8_t {
+    Csv,        // One row per frame, one column per metric
+    JsonLines,  // One JSON object per frame and line
+  };
+
+  /**
+   * \brief Timeline metric
+   *
+   * Registers a metric with the metrics timeline by name, meant to be
+   * declared static by the subsystem recording it. Values may be recorded
+   * from any thread without locking, and are collected into a row of the
+   * timeline by Metrics::endFrame.
+   */
+  class TimelineMetric {
+  public:
+    TimelineMetric(const char* name, MetricType type);
+
+  protected:
+    const uint32_t m_index;
+  };
+
+  class MetricCounter : public TimelineMetric {
+  public:
+    explicit MetricCounter(const char* name) : TimelineMetric(name, MetricType::Counter) { }
+
+    void add(uint64_t value = 1) const;
+  };
+
+  class MetricGauge : public TimelineMetric {
+  public:
+    explicit MetricGauge(const char* name) : TimelineMetric(name, MetricType::Gauge) { }
+
+    void set(double value) const;
+  };
+
+  class MetricHistogram : public TimelineMetric {
+  public:
+    explicit MetricHistogram(const char* name) : TimelineMetric(name, MetricType::Histogram) { }
+
+    void record(double value) const;
+  };
+  // NV-DXVK end
+
   /**
    * \brief Metrics
    * 
    * Metrics for one DLL. Creates a text file and
    * writes all metrics messages to that file.
    */
+  // NV-DXVK start: Metrics timeline
+  // Registered metrics are additionally written out frame by frame when a
+  // timeline is open. One opens on startup if DXVK_METRICS_TIMELINE is set
+  // to csv or json, in the directory given by DXVK_METRICS_PATH.
+  // NV-DXVK end
   class Metrics {
   public:
     Metrics();
@@ -54,6 +109,16 @@ namespace dxvk {
     static void log(Metric metric, const float& value);
     static void serialize();
 
+    // NV-DXVK start: Metrics timeline
+    static bool beginTimeline(const std::string& path, MetricsTimelineFormat format);
+    static void endTimeline();
+
+    // Collects the values recorded since the last call and queues them up as
+    // a row of the timeline, which a writer thread formats and writes out.
+    // Expected to be called once per frame from one thread.
+    static void endFrame(uint64_t frameId);
+    // NV-DXVK end
+
   private:
     inline static const std::string m_metricNames[kCount] = {
       "average_frame_time",
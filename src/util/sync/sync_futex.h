@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "../thread.h"
+
+#ifndef _WIN32
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace dxvk::sync {
+
+  /**
+   * \brief Futex wait
+   *
+   * Parks the calling thread for as long as \c word
+   * holds \c expected. May return spuriously, so the
+   * caller must re-check its condition in a loop.
+   * \param [in] word Word to wait on
+   * \param [in] expected Value to sleep on
+   */
+  inline void futexWait(std::atomic<uint32_t>& word, uint32_t expected) {
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+#ifdef _WIN32
+    WaitOnAddress(&word, &expected, sizeof(expected), INFINITE);
+#else
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#endif
+  }
+
+  /**
+   * \brief Futex wake
+   *
+   * Wakes up all threads parked on \c word.
+   * \param [in] word Word to wake waiters of
+   */
+  inline void futexWakeAll(std::atomic<uint32_t>& word) {
+#ifdef _WIN32
+    WakeByAddressAll(&word);
+#else
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+  }
+
+}
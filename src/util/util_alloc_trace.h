@@ -0,0 +1,351 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "util_math.h"
+#include "util_tlsf.h"
+
+namespace dxvk {
+  /**
+    * \brief Allocation trace record
+    *
+    *  One allocation, free or chunk trim seen by DxvkMemoryAllocator.  Allocations are numbered
+    *  in the order they are recorded, and frees refer back to that number, so a trace can be
+    *  replayed without knowing where anything was placed.
+    */
+  struct AllocTraceRecord {
+    enum class Op : uint8_t {
+      Alloc,      // Memory was handed out
+      Free,       // Memory was returned
+      TrimChunks, // Chunks which were entirely free got released
+    };
+
+    static constexpr uint32_t kFlagDedicated = 1u << 0;
+
+    uint64_t size = 0;
+    uint32_t id = 0;
+    uint32_t frameId = 0;
+    Op op = Op::Alloc;
+    uint8_t memoryType = 0;
+    uint8_t category = 0;
+    uint8_t alignmentLog2 = 0;
+    uint32_t flags = 0;
+  };
+
+  static_assert(sizeof(AllocTraceRecord) == 24, "Allocation trace records are written to disk as is");
+
+  /**
+    * \brief Allocation trace file header
+    *
+    *  Carries what the replay needs to know about the allocator which recorded the trace.
+    */
+  struct AllocTraceHeader {
+    static constexpr uint32_t kMagic = 0x52544d44; // "DMTR"
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kMaxMemoryTypes = 32;
+
+    uint32_t magic = kMagic;
+    uint32_t version = kVersion;
+    uint32_t memoryTypeCount = 0;
+    uint32_t reserved = 0;
+    uint64_t chunkSizes[kMaxMemoryTypes] = {};
+  };
+
+  /**
+    * \brief Buffered allocation trace writer
+    *
+    *  Not thread-safe, callers serialize access.
+    */
+  class AllocTraceWriter {
+    static constexpr size_t kBufferedRecords = 4096;
+
+  public:
+    ~AllocTraceWriter() {
+      close();
+    }
+
+    bool open(const std::string& path, const AllocTraceHeader& header) {
+      m_file.open(path, std::ios_base::binary | std::ios_base::trunc);
+
+      if (!m_file) {
+        return false;
+      }
+
+      m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      m_records.reserve(kBufferedRecords);
+      return bool(m_file);
+    }
+
+    void write(const AllocTraceRecord& record) {
+      m_records.push_back(record);
+
+      if (m_records.size() == kBufferedRecords) {
+        flush();
+      }
+    }
+
+    void flush() {
+      if (m_file.is_open() && !m_records.empty()) {
+        m_file.write(reinterpret_cast<const char*>(m_records.data()), m_records.size() * sizeof(AllocTraceRecord));
+        m_file.flush();
+      }
+
+      m_records.clear();
+    }
+
+    void close() {
+      flush();
+
+      if (m_file.is_open()) {
+        m_file.close();
+      }
+    }
+
+  private:
+    std::ofstream m_file;
+    std::vector<AllocTraceRecord> m_records;
+  };
+
+  /**
+    * \brief Reads a whole allocation trace written by \c AllocTraceWriter
+    *
+    * \returns \c false if the file could not be read or is not a trace of this version.
+    *   A trace cut short, e.g. by a crash, is read up to its last complete record.
+    */
+  inline bool readAllocTrace(const std::string& path, AllocTraceHeader& header, std::vector<AllocTraceRecord>& records) {
+    std::ifstream file(path, std::ios_base::binary | std::ios_base::ate);
+
+    if (!file) {
+      return false;
+    }
+
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    if (fileSize < sizeof(header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+      return false;
+    }
+
+    if (header.magic != AllocTraceHeader::kMagic || header.version != AllocTraceHeader::kVersion
+     || header.memoryTypeCount > AllocTraceHeader::kMaxMemoryTypes) {
+      return false;
+    }
+
+    records.resize((fileSize - sizeof(header)) / sizeof(AllocTraceRecord));
+    file.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(AllocTraceRecord));
+    return bool(file);
+  }
+
+  /**
+    * \brief Allocation trace replay results
+    */
+  struct AllocTraceReplayStats {
+    uint32_t numAllocs = 0;
+    uint32_t numFrees = 0;
+    uint32_t numFrames = 0;
+    uint32_t numUnmatchedFrees = 0;
+    uint32_t peakChunkCount = 0;
+    // Peak number of bytes handed out
+    uint64_t peakUsed = 0;
+    // Peak number of bytes of device memory, i.e. chunks plus dedicated allocations
+    uint64_t peakAllocated = 0;
+    // Share of the free bytes in chunks outside of each chunk's largest free block, sampled once per frame
+    double avgFragmentation = 0.0;
+    double maxFragmentation = 0.0;
+    // Time spent in the suballocator and chunk management per alloc/free
+    double nsPerOp = 0.0;
+  };
+
+  /**
+    * \brief Headless allocation trace replay
+    *
+    *  Feeds a trace through the same chunk policy as DxvkMemoryAllocator::tryAllocFromType,
+    *  without a Vulkan device: requests at least a chunk in size, or which asked for a
+    *  dedicated allocation, get their own device memory, everything else is suballocated from
+    *  the first chunk of its memory type that fits, and a new chunk is added when none does.
+    *  Heap budgets are not modeled, so replay never fails an allocation.
+    */
+  class AllocTraceReplayer {
+    struct Chunk {
+      uint32_t memoryType;
+      TlsfAllocator suballocator;
+
+      Chunk(const uint32_t type, const uint64_t size)
+        : memoryType(type), suballocator(size) { }
+    };
+
+    struct LiveAlloc {
+      Chunk* chunk = nullptr;
+      uint64_t offset = TlsfAllocator::kInvalidOffset;
+      uint64_t size = 0;
+    };
+
+  public:
+    explicit AllocTraceReplayer(const AllocTraceHeader& header)
+      : m_header(header) { }
+
+    AllocTraceReplayStats replay(const std::vector<AllocTraceRecord>& records) {
+      using namespace std::chrono;
+
+      AllocTraceReplayStats stats;
+      duration<double, std::nano> elapsed(0);
+
+      // Time the ops of one frame at a time, and sample fragmentation between frames
+      for (size_t begin = 0; begin < records.size(); ) {
+        size_t end = begin + 1;
+
+        while (end < records.size() && records[end].frameId == records[begin].frameId) {
+          end++;
+        }
+
+        const auto start = high_resolution_clock::now();
+
+        for (size_t i = begin; i < end; i++) {
+          execute(records[i], stats);
+        }
+
+        elapsed += high_resolution_clock::now() - start;
+
+        sampleFragmentation(stats);
+        stats.numFrames++;
+        begin = end;
+      }
+
+      stats.avgFragmentation /= std::max(stats.numFrames, 1u);
+      stats.nsPerOp = elapsed.count() / std::max(stats.numAllocs + stats.numFrees, 1u);
+      return stats;
+    }
+
+  private:
+    void execute(const AllocTraceRecord& record, AllocTraceReplayStats& stats) {
+      switch (record.op) {
+      case AllocTraceRecord::Op::Alloc: {
+        if (record.id >= m_live.size()) {
+          m_live.resize(std::max<size_t>(record.id + 1, m_live.size() * 2));
+        }
+
+        m_live[record.id] = alloc(record);
+        m_used += m_live[record.id].size;
+        stats.numAllocs++;
+        stats.peakUsed = std::max(stats.peakUsed, m_used);
+        stats.peakAllocated = std::max(stats.peakAllocated, m_allocated);
+        stats.peakChunkCount = std::max(stats.peakChunkCount, static_cast<uint32_t>(m_chunks.size()));
+        break;
+      }
+
+      case AllocTraceRecord::Op::Free: {
+        if (record.id >= m_live.size() || m_live[record.id].size == 0) {
+          stats.numUnmatchedFrees++;
+          break;
+        }
+
+        LiveAlloc& live = m_live[record.id];
+
+        if (live.chunk != nullptr) {
+          live.chunk->suballocator.free(live.offset);
+        } else {
+          m_allocated -= live.size;
+        }
+
+        m_used -= live.size;
+        live = LiveAlloc();
+        stats.numFrees++;
+        break;
+      }
+
+      case AllocTraceRecord::Op::TrimChunks: {
+        auto newEnd = std::stable_partition(m_chunks.begin(), m_chunks.end(), [](const auto& chunk) {
+          return !chunk->suballocator.empty();
+        });
+
+        for (auto it = newEnd; it != m_chunks.end(); it++) {
+          m_allocated -= (*it)->suballocator.size();
+        }
+
+        m_chunks.erase(newEnd, m_chunks.end());
+        break;
+      }
+      }
+    }
+
+    LiveAlloc alloc(const AllocTraceRecord& record) {
+      const uint64_t chunkSize = record.memoryType < m_header.memoryTypeCount ? m_header.chunkSizes[record.memoryType] : 0;
+      const uint64_t alignment = uint64_t(1) << record.alignmentLog2;
+
+      LiveAlloc live;
+
+      if (record.size >= chunkSize || (record.flags & AllocTraceRecord::kFlagDedicated)) {
+        live.size = std::max<uint64_t>(record.size, 1);
+        m_allocated += live.size;
+        return live;
+      }
+
+      // Chunk slices are padded to the alignment, as in DxvkMemoryChunk::alloc
+      live.size = align(std::max<uint64_t>(record.size, 1), alignment);
+
+      for (const auto& chunk : m_chunks) {
+        if (chunk->memoryType == record.memoryType) {
+          live.offset = chunk->suballocator.alloc(live.size, alignment);
+
+          if (live.offset != TlsfAllocator::kInvalidOffset) {
+            live.chunk = chunk.get();
+            return live;
+          }
+        }
+      }
+
+      m_chunks.push_back(std::make_unique<Chunk>(record.memoryType, chunkSize));
+      m_allocated += chunkSize;
+
+      live.chunk = m_chunks.back().get();
+      live.offset = live.chunk->suballocator.alloc(live.size, alignment);
+      return live;
+    }
+
+    void sampleFragmentation(AllocTraceReplayStats& stats) const {
+      uint64_t freeSize = 0;
+      uint64_t fragmentedSize = 0;
+
+      for (const auto& chunk : m_chunks) {
+        freeSize += chunk->suballocator.freeSize();
+        fragmentedSize += chunk->suballocator.freeSize() - chunk->suballocator.largestFreeBlock();
+      }
+
+      const double fragmentation = freeSize != 0 ? double(fragmentedSize) / double(freeSize) : 0.0;
+      stats.avgFragmentation += fragmentation;
+      stats.maxFragmentation = std::max(stats.maxFragmentation, fragmentation);
+    }
+
+    const AllocTraceHeader m_header;
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    std::vector<LiveAlloc> m_live;
+    uint64_t m_used = 0;
+    uint64_t m_allocated = 0;
+  };
+}
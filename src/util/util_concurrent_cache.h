@@ -0,0 +1,297 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "sync/sync_spinlock.h"
+#include "xxHash/xxhash.h"
+
+namespace dxvk {
+  // A concurrent hash map for read-mostly data keyed by already hashed keys.
+  //
+  // Lookups never lock and never wait: keys are sharded by their top bits, each shard publishes
+  // an open-addressing probe table through an atomic pointer, and a slot becomes visible to
+  // readers only once its key and value are in place.  Writers take a per-shard spinlock, so
+  // writers only contend with each other when they hit the same shard.
+  //
+  // Values live in their own heap nodes and never move, so a pointer returned by find() stays
+  // valid until that value is erased or the cache is cleared.  Probe tables a shard outgrows, or
+  // rebuilds to drop erased slots, are kept until clear() or destruction since a reader may still
+  // be walking them.  That adds up to roughly 64 bytes per insert or erase since the last clear(),
+  // which suits data that is loaded in bulk and then mostly read.
+  //
+  // erase() and clear() destroy values right away, so the caller must ensure no other thread
+  // still uses them.  clear() must not run concurrently with any other access.
+  template<class T>
+  class concurrent_fast_cache {
+    static constexpr uint32_t kShardCountLog2 = 6;
+    static constexpr uint32_t kShardCount = 1u << kShardCountLog2;
+    static constexpr size_t kMinSlots = 16;
+
+    struct Node {
+      template<typename... Args>
+      explicit Node(Args&&... args)
+        : value(std::forward<Args>(args)...) { }
+
+      T value;
+    };
+
+    struct Slot {
+      std::atomic<XXH64_hash_t> key = { 0 };
+      // nullptr marks the end of a probe sequence, tombstone() a value which was erased
+      std::atomic<Node*> node = { nullptr };
+    };
+
+    struct Table {
+      explicit Table(const size_t numSlots)
+        : mask(numSlots - 1)
+        , slots(new Slot[numSlots]) { }
+
+      const size_t mask;
+      std::unique_ptr<Slot[]> slots;
+    };
+
+    struct alignas(64) Shard {
+      std::atomic<Table*> table = { nullptr };
+      sync::Spinlock writeLock;
+      size_t size = 0;
+      size_t tombstones = 0;
+      std::vector<std::unique_ptr<Table>> tables;
+    };
+
+  public:
+    using key_type = XXH64_hash_t;
+    using mapped_type = T;
+
+    concurrent_fast_cache() = default;
+
+    ~concurrent_fast_cache() {
+      clear();
+    }
+
+    concurrent_fast_cache(const concurrent_fast_cache&) = delete;
+    concurrent_fast_cache& operator=(const concurrent_fast_cache&) = delete;
+
+    // Returns a pointer to the value stored for the key, or nullptr.  Wait-free.
+    T* find(const XXH64_hash_t key) const {
+      const Table* table = m_shards[shardIndex(key)].table.load(std::memory_order_acquire);
+
+      if (table == nullptr) {
+        return nullptr;
+      }
+
+      for (size_t i = key & table->mask; ; i = (i + 1) & table->mask) {
+        Node* node = table->slots[i].node.load(std::memory_order_acquire);
+
+        if (node == nullptr) {
+          return nullptr;
+        }
+
+        if (node != tombstone() && table->slots[i].key.load(std::memory_order_relaxed) == key) {
+          return &node->value;
+        }
+      }
+    }
+
+    bool contains(const XXH64_hash_t key) const {
+      return find(key) != nullptr;
+    }
+
+    // Constructs a value for the key if there is none yet.  Returns the stored value, and
+    // whether it was inserted.
+    template<typename... Args>
+    std::pair<T*, bool> try_emplace(const XXH64_hash_t key, Args&&... args) {
+      Shard& shard = m_shards[shardIndex(key)];
+      std::lock_guard<sync::Spinlock> lock(shard.writeLock);
+
+      if (T* value = find(key)) {
+        return { value, false };
+      }
+
+      // Keep the probe sequences short, counting tombstones since they lengthen them just the same
+      const Table* table = shard.table.load(std::memory_order_relaxed);
+
+      if (table == nullptr || (shard.size + shard.tombstones + 1) * 2 > table->mask + 1) {
+        table = rehash(shard);
+      }
+
+      Node* node = new Node(std::forward<Args>(args)...);
+
+      for (size_t i = key & table->mask; ; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        Node* prev = slot.node.load(std::memory_order_relaxed);
+
+        if (prev == nullptr || prev == tombstone()) {
+          // Readers load the node first, so publishing it last makes the key visible with it
+          slot.key.store(key, std::memory_order_relaxed);
+          slot.node.store(node, std::memory_order_release);
+
+          shard.size++;
+          shard.tombstones -= prev == tombstone();
+          return { &node->value, true };
+        }
+      }
+    }
+
+    // Returns true if a value was erased
+    bool erase(const XXH64_hash_t key) {
+      Shard& shard = m_shards[shardIndex(key)];
+      std::lock_guard<sync::Spinlock> lock(shard.writeLock);
+
+      const Table* table = shard.table.load(std::memory_order_relaxed);
+
+      if (table == nullptr) {
+        return false;
+      }
+
+      for (size_t i = key & table->mask; ; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        Node* node = slot.node.load(std::memory_order_relaxed);
+
+        if (node == nullptr) {
+          return false;
+        }
+
+        if (node != tombstone() && slot.key.load(std::memory_order_relaxed) == key) {
+          slot.node.store(tombstone(), std::memory_order_release);
+          delete node;
+
+          shard.size--;
+          shard.tombstones++;
+          return true;
+        }
+      }
+    }
+
+    // Destroys all values and releases all tables
+    void clear() {
+      for (Shard& shard : m_shards) {
+        std::lock_guard<sync::Spinlock> lock(shard.writeLock);
+
+        if (const Table* table = shard.table.load(std::memory_order_relaxed)) {
+          for (size_t i = 0; i <= table->mask; i++) {
+            Node* node = table->slots[i].node.load(std::memory_order_relaxed);
+
+            if (node != nullptr && node != tombstone()) {
+              delete node;
+            }
+          }
+        }
+
+        shard.table.store(nullptr, std::memory_order_release);
+        shard.tables.clear();
+        shard.size = 0;
+        shard.tombstones = 0;
+      }
+    }
+
+    // Calls visitor(key, value) for every value.  Concurrent inserts may or may not be visited.
+    template<typename Visitor>
+    void forEach(Visitor&& visitor) const {
+      for (const Shard& shard : m_shards) {
+        const Table* table = shard.table.load(std::memory_order_acquire);
+
+        if (table == nullptr) {
+          continue;
+        }
+
+        for (size_t i = 0; i <= table->mask; i++) {
+          Node* node = table->slots[i].node.load(std::memory_order_acquire);
+
+          if (node != nullptr && node != tombstone()) {
+            visitor(table->slots[i].key.load(std::memory_order_relaxed), node->value);
+          }
+        }
+      }
+    }
+
+    // Number of values, which may be outdated by the time it returns if there are concurrent writers
+    size_t size() const {
+      size_t total = 0;
+
+      for (Shard& shard : m_shards) {
+        std::lock_guard<sync::Spinlock> lock(shard.writeLock);
+        total += shard.size;
+      }
+
+      return total;
+    }
+
+    bool empty() const {
+      return size() == 0;
+    }
+
+  private:
+    static size_t shardIndex(const XXH64_hash_t key) {
+      // The probe tables index by the low bits
+      return static_cast<size_t>(key >> (64 - kShardCountLog2));
+    }
+
+    static Node* tombstone() {
+      static Node* const s_tombstone = reinterpret_cast<Node*>(alignof(Node));
+      return s_tombstone;
+    }
+
+    // Builds a table with room for twice the live values and publishes it.  The old table is
+    // only retired, so readers walking it still see all values which have not been erased.
+    const Table* rehash(Shard& shard) {
+      size_t numSlots = kMinSlots;
+
+      while (numSlots < (shard.size + 1) * 4) {
+        numSlots *= 2;
+      }
+
+      auto table = std::make_unique<Table>(numSlots);
+
+      if (const Table* oldTable = shard.table.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i <= oldTable->mask; i++) {
+          Node* node = oldTable->slots[i].node.load(std::memory_order_relaxed);
+
+          if (node == nullptr || node == tombstone()) {
+            continue;
+          }
+
+          const XXH64_hash_t key = oldTable->slots[i].key.load(std::memory_order_relaxed);
+
+          size_t j = key & table->mask;
+          while (table->slots[j].node.load(std::memory_order_relaxed) != nullptr) {
+            j = (j + 1) & table->mask;
+          }
+
+          table->slots[j].key.store(key, std::memory_order_relaxed);
+          table->slots[j].node.store(node, std::memory_order_relaxed);
+        }
+      }
+
+      shard.tombstones = 0;
+      shard.table.store(table.get(), std::memory_order_release);
+      shard.tables.push_back(std::move(table));
+      return shard.tables.back().get();
+    }
+
+    mutable Shard m_shards[kShardCount];
+  };
+}
@@ -21,8 +21,14 @@
 */
 
 #pragma once
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
+#include "util_bit.h"
 #include "xxHash/xxhash.h"
 
 
@@ -53,9 +59,255 @@ namespace dxvk {
     }
   };
 
-  // A fast caching structure for use ONLY with already hashed keys.
-  template<class T>
-  struct fast_unordered_cache : public std::unordered_map<XXH64_hash_t, T, XXH64_hash_passthrough> {
+  // An open-addressing hash table for use ONLY with already hashed keys.
+  //
+  // The probe table only holds (key, node index) pairs and is probed linearly, with
+  // backward shift deletion so it never accumulates tombstones.  The values live in a
+  // separate slab of fixed size node chunks, which never move - so pointers, references
+  // and iterators to a value stay valid across inserts and rehashes until that value
+  // itself is erased.  Iteration walks the slab, so erasing while iterating is fine.
+  //
+  // With AllowDuplicates, values sharing a key are chained off a single probe slot,
+  // and equal_range() walks that chain (multimap semantics).
+  template<class T, bool AllowDuplicates = false>
+  class fast_flat_cache {
+    static constexpr uint32_t kInvalidNode = ~0u;
+    static constexpr uint32_t kNodesPerChunk = 64;
+    static constexpr size_t kMinSlots = 16;
+
+  public:
+    using key_type = XXH64_hash_t;
+    using mapped_type = T;
+    using value_type = std::pair<const XXH64_hash_t, T>;
+    using size_type = size_t;
+
+  private:
+    struct Node {
+      value_type value;
+      uint32_t nextDuplicate;
+    };
+
+    struct Chunk {
+      uint64_t occupied = 0;
+      alignas(Node) uint8_t storage[kNodesPerChunk * sizeof(Node)];
+
+      Node* node(const uint32_t i) {
+        return reinterpret_cast<Node*>(storage) + i;
+      }
+    };
+
+    struct Slot {
+      XXH64_hash_t key;
+      uint32_t node;
+    };
+
+    template<bool IsConst, bool DuplicatesOnly>
+    class iterator_base {
+      friend class fast_flat_cache;
+      template<bool, bool> friend class iterator_base;
+      using Owner = std::conditional_t<IsConst, const fast_flat_cache, fast_flat_cache>;
+
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = typename fast_flat_cache::value_type;
+      using difference_type = ptrdiff_t;
+      using pointer = std::conditional_t<IsConst, const value_type*, value_type*>;
+      using reference = std::conditional_t<IsConst, const value_type&, value_type&>;
+
+      iterator_base() = default;
+
+      template<bool OtherConst, typename = std::enable_if_t<IsConst || !OtherConst>>
+      iterator_base(const iterator_base<OtherConst, DuplicatesOnly>& other)
+        : m_owner(other.m_owner), m_index(other.m_index) { }
+
+      reference operator*() const { return m_owner->node(m_index)->value; }
+      pointer operator->() const { return &m_owner->node(m_index)->value; }
+
+      iterator_base& operator++() {
+        if constexpr (DuplicatesOnly) {
+          m_index = m_owner->node(m_index)->nextDuplicate;
+        } else {
+          m_index = m_owner->nextOccupied(m_index + 1);
+        }
+        return *this;
+      }
+
+      iterator_base operator++(int) {
+        iterator_base prev = *this;
+        ++(*this);
+        return prev;
+      }
+
+      template<bool OtherConst>
+      bool operator==(const iterator_base<OtherConst, DuplicatesOnly>& other) const { return m_index == other.m_index; }
+      template<bool OtherConst>
+      bool operator!=(const iterator_base<OtherConst, DuplicatesOnly>& other) const { return m_index != other.m_index; }
+
+    private:
+      iterator_base(Owner* owner, const uint32_t index)
+        : m_owner(owner), m_index(index) { }
+
+      Owner* m_owner = nullptr;
+      uint32_t m_index = kInvalidNode;
+    };
+
+  public:
+    using iterator = iterator_base<false, false>;
+    using const_iterator = iterator_base<true, false>;
+    // Walks the values sharing one key
+    using key_iterator = iterator_base<false, true>;
+    using const_key_iterator = iterator_base<true, true>;
+
+    fast_flat_cache() = default;
+
+    fast_flat_cache(const fast_flat_cache& other) {
+      reserve(other.m_numKeys);
+      for (const value_type& value : other) {
+        emplaceNode(value.first, std::forward_as_tuple(value.second));
+      }
+    }
+
+    fast_flat_cache(fast_flat_cache&& other) noexcept {
+      swap(other);
+    }
+
+    fast_flat_cache& operator=(fast_flat_cache other) noexcept {
+      swap(other);
+      return *this;
+    }
+
+    ~fast_flat_cache() {
+      destroyNodes();
+    }
+
+    void swap(fast_flat_cache& other) noexcept {
+      std::swap(m_slots, other.m_slots);
+      std::swap(m_chunks, other.m_chunks);
+      std::swap(m_freeNodes, other.m_freeNodes);
+      std::swap(m_size, other.m_size);
+      std::swap(m_numKeys, other.m_numKeys);
+      std::swap(m_shift, other.m_shift);
+    }
+
+    iterator begin() { return iterator(this, nextOccupied(0)); }
+    iterator end() { return iterator(this, kInvalidNode); }
+    const_iterator begin() const { return const_iterator(this, nextOccupied(0)); }
+    const_iterator end() const { return const_iterator(this, kInvalidNode); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator find(const XXH64_hash_t key) {
+      return iterator(this, findNode(key));
+    }
+
+    const_iterator find(const XXH64_hash_t key) const {
+      return const_iterator(this, findNode(key));
+    }
+
+    size_t count(const XXH64_hash_t key) const {
+      if constexpr (AllowDuplicates) {
+        size_t n = 0;
+        for (uint32_t index = findNode(key); index != kInvalidNode; index = node(index)->nextDuplicate) {
+          n++;
+        }
+        return n;
+      } else {
+        return findNode(key) != kInvalidNode ? 1 : 0;
+      }
+    }
+
+    bool contains(const XXH64_hash_t key) const {
+      return findNode(key) != kInvalidNode;
+    }
+
+    std::pair<key_iterator, key_iterator> equal_range(const XXH64_hash_t key) {
+      return { key_iterator(this, findNode(key)), key_iterator(this, kInvalidNode) };
+    }
+
+    std::pair<const_key_iterator, const_key_iterator> equal_range(const XXH64_hash_t key) const {
+      return { const_key_iterator(this, findNode(key)), const_key_iterator(this, kInvalidNode) };
+    }
+
+    T& at(const XXH64_hash_t key) {
+      const uint32_t index = findNode(key);
+      if (index == kInvalidNode) {
+        throw std::out_of_range("fast_flat_cache::at");
+      }
+      return node(index)->value.second;
+    }
+
+    const T& at(const XXH64_hash_t key) const {
+      return const_cast<fast_flat_cache*>(this)->at(key);
+    }
+
+    T& operator[](const XXH64_hash_t key) {
+      static_assert(!AllowDuplicates, "operator[] is ambiguous with duplicate keys");
+      return try_emplace(key).first->second;
+    }
+
+    // Constructs the value only when the key is absent
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const XXH64_hash_t key, Args&&... args) {
+      static_assert(!AllowDuplicates, "Use emplace with duplicate keys");
+      const uint32_t existing = findNode(key);
+      if (existing != kInvalidNode) {
+        return { iterator(this, existing), false };
+      }
+      return { iterator(this, emplaceNode(key, std::forward_as_tuple(std::forward<Args>(args)...))), true };
+    }
+
+    template<typename... Args>
+    auto emplace(const XXH64_hash_t key, Args&&... args) {
+      if constexpr (AllowDuplicates) {
+        return iterator(this, emplaceNode(key, std::forward_as_tuple(std::forward<Args>(args)...)));
+      } else {
+        return try_emplace(key, std::forward<Args>(args)...);
+      }
+    }
+
+    template<typename KeyType, typename... Args>
+    auto emplace(std::piecewise_construct_t, std::tuple<KeyType> key, std::tuple<Args...> args) {
+      if constexpr (AllowDuplicates) {
+        return iterator(this, emplaceNode(std::get<0>(key), std::move(args)));
+      } else {
+        const uint32_t existing = findNode(std::get<0>(key));
+        if (existing != kInvalidNode) {
+          return std::make_pair(iterator(this, existing), false);
+        }
+        return std::make_pair(iterator(this, emplaceNode(std::get<0>(key), std::move(args))), true);
+      }
+    }
+
+    auto insert(const value_type& value) {
+      return emplace(value.first, value.second);
+    }
+
+    auto insert(value_type&& value) {
+      return emplace(value.first, std::move(value.second));
+    }
+
+    iterator erase(const_iterator it) {
+      const uint32_t index = it.m_index;
+      eraseNode(index);
+      return iterator(this, nextOccupied(index + 1));
+    }
+
+    iterator erase(iterator it) {
+      return erase(const_iterator(it));
+    }
+
+    size_t erase(const XXH64_hash_t key) {
+      size_t n = 0;
+      for (uint32_t index = findNode(key); index != kInvalidNode; index = findNode(key)) {
+        eraseNode(index);
+        n++;
+      }
+      return n;
+    }
+
     template<typename P>
     void erase_if(P&& p) {
       for (auto it = begin(); it != end();) {
@@ -66,8 +318,180 @@ namespace dxvk {
         }
       }
     }
+
+    void clear() {
+      destroyNodes();
+      m_chunks.clear();
+      m_freeNodes.clear();
+      for (Slot& slot : m_slots) {
+        slot.node = kInvalidNode;
+      }
+      m_size = 0;
+      m_numKeys = 0;
+    }
+
+    // Sizes the probe table for the given number of distinct keys
+    void reserve(const size_t numKeys) {
+      size_t numSlots = kMinSlots;
+      while (numSlots * 3 / 4 < numKeys) {
+        numSlots *= 2;
+      }
+      if (numSlots > m_slots.size()) {
+        rehash(numSlots);
+      }
+    }
+
+  private:
+    Node* node(const uint32_t index) const {
+      return m_chunks[index / kNodesPerChunk]->node(index % kNodesPerChunk);
+    }
+
+    size_t homeSlot(const XXH64_hash_t key) const {
+      // Fibonacci hashing, so keys with poor low bits still spread over the table
+      return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> m_shift);
+    }
+
+    size_t slotMask() const {
+      return m_slots.size() - 1;
+    }
+
+    // Index of the probe slot holding key, or the empty slot it would go into
+    size_t findSlot(const XXH64_hash_t key) const {
+      const size_t mask = slotMask();
+      size_t i = homeSlot(key);
+      while (m_slots[i].node != kInvalidNode && m_slots[i].key != key) {
+        i = (i + 1) & mask;
+      }
+      return i;
+    }
+
+    uint32_t findNode(const XXH64_hash_t key) const {
+      if (m_numKeys == 0) {
+        return kInvalidNode;
+      }
+      return m_slots[findSlot(key)].node;
+    }
+
+    uint32_t nextOccupied(const uint32_t start) const {
+      for (uint32_t chunk = start / kNodesPerChunk; chunk < m_chunks.size(); chunk++) {
+        uint64_t bits = m_chunks[chunk]->occupied;
+        if (chunk == start / kNodesPerChunk) {
+          bits &= ~0ull << (start % kNodesPerChunk);
+        }
+        if (bits != 0) {
+          const uint32_t low = static_cast<uint32_t>(bits);
+          return chunk * kNodesPerChunk + (low != 0 ? bit::tzcnt(low) : 32 + bit::tzcnt(static_cast<uint32_t>(bits >> 32)));
+        }
+      }
+      return kInvalidNode;
+    }
+
+    template<typename ArgsTuple>
+    uint32_t emplaceNode(const XXH64_hash_t key, ArgsTuple&& args) {
+      if (m_slots.empty() || (m_numKeys + 1) > m_slots.size() * 3 / 4) {
+        rehash(std::max(m_slots.size() * 2, kMinSlots));
+      }
+
+      if (m_freeNodes.empty()) {
+        const uint32_t base = static_cast<uint32_t>(m_chunks.size()) * kNodesPerChunk;
+        m_chunks.emplace_back(std::make_unique<Chunk>());
+        for (uint32_t i = kNodesPerChunk; i > 0; i--) {
+          m_freeNodes.push_back(base + i - 1);
+        }
+      }
+
+      const uint32_t index = m_freeNodes.back();
+      Node* pNode = node(index);
+      new (&pNode->value) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward<ArgsTuple>(args));
+      m_freeNodes.pop_back();
+      m_chunks[index / kNodesPerChunk]->occupied |= 1ull << (index % kNodesPerChunk);
+      m_size++;
+
+      Slot& slot = m_slots[findSlot(key)];
+      if (slot.node == kInvalidNode) {
+        slot.key = key;
+        pNode->nextDuplicate = kInvalidNode;
+        m_numKeys++;
+      } else {
+        pNode->nextDuplicate = slot.node;
+      }
+      slot.node = index;
+
+      return index;
+    }
+
+    void eraseNode(const uint32_t index) {
+      Node* pNode = node(index);
+      const size_t slotIndex = findSlot(pNode->value.first);
+      Slot& slot = m_slots[slotIndex];
+
+      if (slot.node == index) {
+        slot.node = pNode->nextDuplicate;
+        if (slot.node == kInvalidNode) {
+          removeSlot(slotIndex);
+          m_numKeys--;
+        }
+      } else {
+        uint32_t prev = slot.node;
+        while (node(prev)->nextDuplicate != index) {
+          prev = node(prev)->nextDuplicate;
+        }
+        node(prev)->nextDuplicate = pNode->nextDuplicate;
+      }
+
+      pNode->value.~value_type();
+      m_chunks[index / kNodesPerChunk]->occupied &= ~(1ull << (index % kNodesPerChunk));
+      m_freeNodes.push_back(index);
+      m_size--;
+    }
+
+    // Backward shift deletion: pull later entries of the probe run into the hole
+    void removeSlot(size_t hole) {
+      const size_t mask = slotMask();
+      for (size_t i = (hole + 1) & mask; m_slots[i].node != kInvalidNode; i = (i + 1) & mask) {
+        const size_t home = homeSlot(m_slots[i].key);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+          m_slots[hole] = m_slots[i];
+          hole = i;
+        }
+      }
+      m_slots[hole].node = kInvalidNode;
+    }
+
+    void rehash(const size_t numSlots) {
+      std::vector<Slot> oldSlots(numSlots, Slot { 0, kInvalidNode });
+      std::swap(m_slots, oldSlots);
+      m_shift = 64 - bit::tzcnt(static_cast<uint32_t>(numSlots));
+
+      for (const Slot& slot : oldSlots) {
+        if (slot.node != kInvalidNode) {
+          m_slots[findSlot(slot.key)] = slot;
+        }
+      }
+    }
+
+    void destroyNodes() {
+      for (uint32_t index = nextOccupied(0); index != kInvalidNode; index = nextOccupied(index + 1)) {
+        node(index)->value.~value_type();
+      }
+    }
+
+    std::vector<Slot> m_slots;
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    std::vector<uint32_t> m_freeNodes;
+    size_t m_size = 0;
+    size_t m_numKeys = 0;
+    uint32_t m_shift = 64;
   };
 
+  // A fast caching structure for use ONLY with already hashed keys.
+  template<class T>
+  using fast_unordered_cache = fast_flat_cache<T, false>;
+
+  // As above, allowing several values per key.
+  template<class T>
+  using fast_unordered_multicache = fast_flat_cache<T, true>;
+
   // A fast set for use ONLY with already hashed keys.
   struct fast_unordered_set : public std::unordered_set<XXH64_hash_t, XXH64_hash_passthrough> { };
 
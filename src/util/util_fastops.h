@@ -90,4 +90,40 @@ namespace fast {
     */
   template<typename T>
   T findNthBit(const T num, const T n);
+
+  /**
+    * \brief Number of elements the vectorized deduplication paths may write past the last unique value
+    */
+  static constexpr uint32_t kDeduplicatePadding = 16;
+
+  /**
+    * \brief Sorts and deduplicates an array of unsigned integers, using a bitset internally
+    *
+    * count: number of integers
+    * data: array of unsigned integers, all values must be <= maxValue
+    * maxValue: maximum value in array (e.g. as determined by findMinMax)
+    * uniqueOut: array of unsigned integers to write the sorted unique values,
+    *            must have room for (maxValue + 1 + kDeduplicatePadding) elements
+    *
+    * Returns the number of unique values written to uniqueOut.
+    * 
+    * Supports unsigned 32-bit and 16-bit integers.  All other uses undefined.
+    */
+  template<typename T>
+  uint32_t deduplicateSortIndices(const uint32_t count, const T* data, const uint32_t maxValue, T* uniqueOut);
+
+  /**
+    * \brief Gathers indexed elements into a strided destination, (D[i * dstStride] = S[indices[i] * srcStride])
+    *
+    * dstData: memory to write to, element i is written at byte offset (i * dstStride)
+    * dstStride: byte distance between consecutive destination elements
+    * srcData: array of source elements
+    * srcStride: byte distance between consecutive source elements
+    * srcCount: number of source elements, all indices must be < srcCount
+    * elementSize: number of bytes to copy per element, must be <= both strides
+    * indices: array of source element indices
+    * count: number of elements to gather
+    */
+  void gatherStrided(void* dstData, const size_t dstStride, const void* srcData, const size_t srcStride, const uint32_t srcCount,
+                     const size_t elementSize, const uint32_t* indices, const uint32_t count);
 }
\ No newline at end of file
@@ -0,0 +1,144 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "util_gdeflate.h"
+
+#include <atomic>
+#include <cstring>
+
+#ifdef WITH_GDEFLATE
+#include <libdeflate.h>
+#endif
+
+namespace dxvk {
+
+  namespace {
+#ifdef WITH_GDEFLATE
+    // Decompressors carry a few KB of table state, keep one per thread rather than one per tile
+    struct ThreadDecompressor {
+      libdeflate_gdeflate_decompressor* decompressor = libdeflate_alloc_gdeflate_decompressor();
+
+      ~ThreadDecompressor() {
+        if (decompressor) {
+          libdeflate_free_gdeflate_decompressor(decompressor);
+        }
+      }
+    };
+
+    bool decompressTile(const uint8_t* in, size_t inSize, uint8_t* out, size_t outSize) {
+      static thread_local ThreadDecompressor t_decompressor;
+
+      if (t_decompressor.decompressor == nullptr) {
+        return false;
+      }
+
+      libdeflate_gdeflate_in_page page { in, inSize };
+      size_t decodedSize = 0;
+
+      return libdeflate_gdeflate_decompress(t_decompressor.decompressor, &page, 1, out, outSize, &decodedSize) == LIBDEFLATE_SUCCESS &&
+             decodedSize == outSize;
+    }
+#else
+    bool decompressTile(const uint8_t*, size_t, uint8_t*, size_t) {
+      return false;
+    }
+#endif
+  }
+
+  GDeflateDecoder::GDeflateDecoder(uint8_t numThreads) {
+    if (numThreads > 0) {
+      m_threadPool = std::make_unique<ThreadPoolType>(numThreads, "rtx-gdeflate-decoder");
+    }
+  }
+
+  GDeflateDecoder& GDeflateDecoder::get() {
+    // Leaked on purpose, joining the workers from static destructors may deadlock on DLL unload
+    static GDeflateDecoder* s_decoder = new GDeflateDecoder(ThreadPoolType::getDefaultThreadCount());
+    return *s_decoder;
+  }
+
+  bool GDeflateDecoder::isSupported() {
+#ifdef WITH_GDEFLATE
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  size_t GDeflateDecoder::getUncompressedSize(const void* in, size_t inSize) {
+    if (inSize < sizeof(TileStream)) {
+      return 0;
+    }
+
+    TileStream header;
+    memcpy(&header, in, sizeof(header));
+
+    if (!header.isValid() || header.numTiles == 0 ||
+        inSize < sizeof(TileStream) + header.numTiles * sizeof(uint32_t)) {
+      return 0;
+    }
+
+    return header.getUncompressedSize();
+  }
+
+  bool GDeflateDecoder::decompress(void* out, size_t outSize, const void* in, size_t inSize) {
+    const size_t uncompressedSize = getUncompressedSize(in, inSize);
+
+    if (uncompressedSize == 0 || outSize < uncompressedSize) {
+      return false;
+    }
+
+    const auto* stream = static_cast<const uint8_t*>(in);
+    const auto* header = reinterpret_cast<const TileStream*>(stream);
+    const uint32_t numTiles = header->numTiles;
+
+    // The offset table is followed by the tile data. Tile 0 always starts at offset 0,
+    // so its slot in the table holds the compressed size of the last tile instead.
+    const uint32_t* tileOffsets = reinterpret_cast<const uint32_t*>(stream + sizeof(TileStream));
+    const uint8_t* tileData = stream + sizeof(TileStream) + numTiles * sizeof(uint32_t);
+    const size_t tileDataSize = inSize - (tileData - stream);
+
+    std::atomic<bool> succeeded = true;
+
+    auto decodeTile = [&](uint32_t tile) {
+      const size_t offset = tile > 0 ? tileOffsets[tile] : 0;
+      const size_t size = tile + 1 < numTiles ? size_t(tileOffsets[tile + 1]) - offset : size_t(tileOffsets[0]);
+      const size_t decodedSize = tile + 1 < numTiles || header->lastTileSize == 0 ? kTileSize : header->lastTileSize;
+
+      if (offset > tileDataSize || size > tileDataSize - offset ||
+          !decompressTile(tileData + offset, size, static_cast<uint8_t*>(out) + tile * kTileSize, decodedSize)) {
+        succeeded.store(false, std::memory_order_relaxed);
+      }
+    };
+
+    if (m_threadPool == nullptr || numTiles == 1) {
+      for (uint32_t tile = 0; tile < numTiles; tile++) {
+        decodeTile(tile);
+      }
+    } else {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      m_threadPool->parallelFor(0, numTiles, 1, decodeTile);
+    }
+
+    return succeeded.load(std::memory_order_relaxed);
+  }
+
+}
@@ -0,0 +1,123 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "thread.h"
+#include "util_threadpool.h"
+
+namespace dxvk {
+
+  /**
+   * \brief CPU GDeflate decoder
+   *
+   * Decodes GDeflate tile streams, the compression format of RTX IO
+   * packages, on the CPU. A stream is a sequence of independently
+   * compressed 64KB tiles, so the tiles of a stream are spread over
+   * the worker threads of the decoder, with the calling thread
+   * participating. Requires the GDeflate library at build time,
+   * see isSupported().
+   */
+  class GDeflateDecoder {
+    static constexpr size_t kTasksPerThread = 64;
+  public:
+    // Uncompressed size of every tile but the last one
+    static constexpr size_t kTileSize = 64 * 1024;
+
+    struct TileStream {
+      static constexpr uint8_t kId = 4;
+
+      uint8_t id;
+      uint8_t magic;
+      uint16_t numTiles;
+      uint32_t tileSizeIdx : 2;
+      uint32_t lastTileSize : 18;
+      uint32_t reserved : 12;
+
+      bool isValid() const {
+        return id == kId && magic == (id ^ 0xff) && tileSizeIdx == 1;
+      }
+
+      size_t getUncompressedSize() const {
+        return numTiles * kTileSize - (lastTileSize == 0 ? 0 : kTileSize - lastTileSize);
+      }
+    };
+
+    static_assert(sizeof(TileStream) == 8, "Tile stream header size overrun!");
+
+    /**
+     * \brief Creates a decoder
+     *
+     * \param [in] numThreads Number of worker threads, 0 decodes on the calling thread only
+     */
+    explicit GDeflateDecoder(uint8_t numThreads);
+
+    /**
+     * \brief Shared decoder
+     *
+     * Process wide decoder using one worker per spare hardware thread,
+     * created on first use.
+     */
+    static GDeflateDecoder& get();
+
+    /**
+     * \brief Checks if the build has a CPU GDeflate implementation
+     */
+    static bool isSupported();
+
+    /**
+     * \brief Uncompressed size of a tile stream
+     *
+     * \param [in] in Compressed stream
+     * \param [in] inSize Compressed stream size
+     * \returns Uncompressed size, 0 if the stream is malformed
+     */
+    static size_t getUncompressedSize(const void* in, size_t inSize);
+
+    /**
+     * \brief Decompresses a tile stream
+     *
+     * Blocks until the whole stream is decoded. Thread-safe, concurrent
+     * calls take turns on the workers.
+     * \param [out] out Output buffer
+     * \param [in] outSize Output buffer size, must hold the uncompressed stream
+     * \param [in] in Compressed stream
+     * \param [in] inSize Compressed stream size
+     * \returns True on success, false if the stream is malformed
+     */
+    bool decompress(void* out, size_t outSize, const void* in, size_t inSize);
+
+    uint8_t getThreadCount() const {
+      return m_threadPool ? m_threadPool->getThreadCount() : 0;
+    }
+
+  private:
+    using ThreadPoolType = WorkerThreadPool<kTasksPerThread, true, false>;
+
+    std::unique_ptr<ThreadPoolType> m_threadPool;
+    // Note: WorkerThreadPool is not thread-safe
+    dxvk::mutex m_mutex;
+  };
+
+}
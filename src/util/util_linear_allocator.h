@@ -0,0 +1,221 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <assert.h>
+#include "util_math.h"
+
+namespace dxvk {
+  /**
+    * \brief Single-threaded linear (bump) allocator for short lived scratch memory.
+    *
+    *  Memory is handed out from large blocks and only ever released in bulk, either
+    *  by rewinding to a previously recorded marker or by resetting the whole arena.
+    *  On reset, all blocks are coalesced into a single block large enough for the
+    *  peak usage seen since the last reset, so steady-state operation does not
+    *  touch the global heap at all.
+    *
+    *  Objects placed in the arena must be trivially destructible, no destructors are run.
+    */
+  class LinearAllocator {
+    struct Block {
+      std::unique_ptr<uint8_t[]> data;
+      size_t size = 0;
+    };
+
+  public:
+    static constexpr size_t kDefaultBlockSize = 256 * 1024;
+
+    struct Marker {
+      size_t block = 0;
+      size_t offset = 0;
+    };
+
+    /**
+      * \brief Rewinds the arena to the state it was in at construction time when going out of scope
+      */
+    class Scope {
+    public:
+      explicit Scope(LinearAllocator& allocator)
+        : m_allocator(allocator)
+        , m_marker(allocator.mark()) { }
+
+      ~Scope() {
+        m_allocator.rewind(m_marker);
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+    private:
+      LinearAllocator& m_allocator;
+      const Marker m_marker;
+    };
+
+    explicit LinearAllocator(size_t blockSize = kDefaultBlockSize)
+      : m_blockSize(blockSize) { }
+
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    void* alloc(size_t size, size_t alignment = 16) {
+      assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+
+      ++m_allocationCount;
+
+      while (true) {
+        if (m_current < m_blocks.size()) {
+          Block& block = m_blocks[m_current];
+          const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+          const size_t offset = align(base + m_offset, alignment) - base;
+
+          if (offset + size <= block.size) {
+            m_offset = offset + size;
+            m_peakUsage = std::max(m_peakUsage, m_usedInPriorBlocks + m_offset);
+            return block.data.get() + offset;
+          }
+
+          // Move on to the next block if we rewound past it and it's large enough
+          if (m_current + 1 < m_blocks.size() && size + alignment <= m_blocks[m_current + 1].size) {
+            nextBlock();
+            continue;
+          }
+        }
+
+        // Need a new block, large allocations get a dedicated block
+        Block block;
+        block.size = std::max(m_blockSize, size + alignment);
+        block.data = std::make_unique<uint8_t[]>(block.size);
+        ++m_blockAllocationCount;
+
+        const size_t insertAt = m_blocks.empty() ? 0 : m_current + 1;
+        m_blocks.insert(m_blocks.begin() + insertAt, std::move(block));
+
+        if (insertAt != m_current) {
+          nextBlock();
+        }
+      }
+    }
+
+    template<typename T>
+    T* alloc(size_t count) {
+      static_assert(std::is_trivially_destructible_v<T>, "Linear allocator does not run destructors");
+      return static_cast<T*>(alloc(sizeof(T) * count, alignof(T) > 16 ? alignof(T) : 16));
+    }
+
+    Marker mark() const {
+      return { m_current, m_offset };
+    }
+
+    void rewind(const Marker& marker) {
+      assert(marker.block < m_current || (marker.block == m_current && marker.offset <= m_offset));
+
+      if (marker.block != m_current) {
+        m_usedInPriorBlocks = 0;
+        for (size_t i = 0; i < marker.block; i++) {
+          m_usedInPriorBlocks += m_blocks[i].size;
+        }
+      }
+
+      m_current = marker.block;
+      m_offset = marker.offset;
+    }
+
+    /**
+      * \brief Releases all allocations, and coalesces the backing memory
+      *        into a single block sized for the peak usage
+      */
+    void reset() {
+      if (m_blocks.size() > 1) {
+        const size_t coalescedSize = align(m_peakUsage, m_blockSize);
+        m_blocks.clear();
+
+        Block block;
+        block.size = coalescedSize;
+        block.data = std::make_unique<uint8_t[]>(block.size);
+        m_blocks.push_back(std::move(block));
+        ++m_blockAllocationCount;
+      }
+
+      m_current = 0;
+      m_offset = 0;
+      m_usedInPriorBlocks = 0;
+      m_peakUsage = 0;
+      m_allocationCount = 0;
+      m_blockAllocationCount = 0;
+    }
+
+    // Number of allocations served since the last reset
+    uint32_t allocationCount() const {
+      return m_allocationCount;
+    }
+
+    // Number of times the arena had to go to the heap since the last reset
+    uint32_t blockAllocationCount() const {
+      return m_blockAllocationCount;
+    }
+
+    // Peak number of bytes in use since the last reset (includes block tail waste)
+    size_t peakUsage() const {
+      return m_peakUsage;
+    }
+
+    size_t capacity() const {
+      size_t total = 0;
+      for (const Block& block : m_blocks) {
+        total += block.size;
+      }
+      return total;
+    }
+
+  private:
+    void nextBlock() {
+      m_usedInPriorBlocks += m_blocks[m_current].size;
+      ++m_current;
+      m_offset = 0;
+    }
+
+    const size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    size_t m_current = 0;
+    size_t m_offset = 0;
+    size_t m_usedInPriorBlocks = 0;
+    size_t m_peakUsage = 0;
+    uint32_t m_allocationCount = 0;
+    uint32_t m_blockAllocationCount = 0;
+  };
+
+  /**
+    * \brief Returns the linear allocator owned by the calling thread, if any.
+    *
+    *  Worker threads which own an arena (e.g. WorkerThreadPool workers) register
+    *  it here so that tasks can get at scratch memory without knowing which worker
+    *  they were scheduled on.  Returns nullptr on threads without an arena.
+    */
+  inline LinearAllocator*& threadLinearAllocator() {
+    static thread_local LinearAllocator* s_allocator = nullptr;
+    return s_allocator;
+  }
+}
@@ -0,0 +1,332 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "util_mesh_optimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace dxvk::meshopt {
+  namespace {
+    // Tuning values from the reference implementation of the algorithm
+    constexpr uint32_t kCacheSize = 32;
+    constexpr uint32_t kMaxValence = 32;
+    constexpr float kCacheDecayPower = 1.5f;
+    constexpr float kLastTriangleScore = 0.75f;
+    constexpr float kValenceBoostScale = 2.0f;
+    constexpr float kValenceBoostPower = 0.5f;
+
+    struct ScoreTables {
+      // Indexed by cache position + 1, i.e. [0] is a vertex outside of the cache
+      float cache[kCacheSize + 1];
+      // Indexed by the number of triangles still to be emitted which use the vertex
+      float valence[kMaxValence + 1];
+
+      ScoreTables() {
+        cache[0] = 0.f;
+        for (uint32_t i = 0; i < kCacheSize; i++) {
+          // The 3 vertices of the last triangle get a fixed score, so the next triangle isn't
+          // biased towards any particular edge of it
+          cache[i + 1] = i < 3 ? kLastTriangleScore : powf(1.f - float(i - 3) / float(kCacheSize - 3), kCacheDecayPower);
+        }
+
+        valence[0] = 0.f;
+        for (uint32_t i = 1; i <= kMaxValence; i++) {
+          // Boost vertices with few triangles left, so lone triangles don't get stranded
+          valence[i] = kValenceBoostScale * powf(float(i), -kValenceBoostPower);
+        }
+      }
+
+      float vertexScore(const int32_t cachePosition, const uint32_t liveTriangles) const {
+        if (liveTriangles == 0) {
+          return -1.f;
+        }
+        return cache[cachePosition + 1] + valence[std::min(liveTriangles, kMaxValence)];
+      }
+    };
+
+    const ScoreTables g_scoreTables;
+  }
+
+  uint32_t removeDegenerateTriangles(uint32_t* indices, const uint32_t numIndices, const void* positions, const size_t positionStride) {
+    assert(numIndices % 3 == 0);
+
+    const uint8_t* positionBytes = static_cast<const uint8_t*>(positions);
+    auto samePosition = [&](const uint32_t a, const uint32_t b) {
+      return memcmp(positionBytes + a * positionStride, positionBytes + b * positionStride, sizeof(float) * 3) == 0;
+    };
+
+    uint32_t numKept = 0;
+    for (uint32_t i = 0; i < numIndices; i += 3) {
+      const uint32_t a = indices[i + 0], b = indices[i + 1], c = indices[i + 2];
+
+      if (a == b || b == c || c == a) {
+        continue;
+      }
+
+      if (positionBytes && (samePosition(a, b) || samePosition(b, c) || samePosition(c, a))) {
+        continue;
+      }
+
+      indices[numKept + 0] = a;
+      indices[numKept + 1] = b;
+      indices[numKept + 2] = c;
+      numKept += 3;
+    }
+
+    // Nothing was written if no triangle was kept, so the list is still as authored
+    return numKept == 0 ? numIndices : numKept;
+  }
+
+  void Scratch::reserveVertices(const uint32_t numVertices) {
+    if (liveTriangles.size() >= numVertices) {
+      return;
+    }
+
+    liveTriangles.resize(numVertices, 0);
+    adjacencyOffsets.resize(numVertices, kUnusedVertex);
+    adjacencyCursor.resize(numVertices, 0);
+    cachePositions.resize(numVertices, -1);
+    vertexScores.resize(numVertices);
+    loadedAt.resize(numVertices, 0);
+  }
+
+  void optimizeVertexCache(uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices, Scratch& scratch) {
+    assert(numIndices % 3 == 0);
+
+    const uint32_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+      return;
+    }
+
+    scratch.reserveVertices(numVertices);
+    uint32_t* liveTriangles = scratch.liveTriangles.data();
+    uint32_t* adjacencyOffsets = scratch.adjacencyOffsets.data();
+    uint32_t* adjacencyCursor = scratch.adjacencyCursor.data();
+    int32_t* cachePositions = scratch.cachePositions.data();
+    float* vertexScores = scratch.vertexScores.data();
+
+    // Vertex to triangle adjacency, each vertex owns a contiguous range of which the first
+    // liveTriangles entries are the triangles not emitted yet.  Ranges are laid out in order
+    // of first use, so only referenced vertices are visited.
+    for (uint32_t i = 0; i < numIndices; i++) {
+      assert(indices[i] < numVertices);
+      liveTriangles[indices[i]]++;
+    }
+
+    uint32_t adjacencySize = 0;
+    for (uint32_t i = 0; i < numIndices; i++) {
+      const uint32_t v = indices[i];
+      if (adjacencyOffsets[v] == kUnusedVertex) {
+        adjacencyOffsets[v] = adjacencySize;
+        adjacencySize += liveTriangles[v];
+        vertexScores[v] = g_scoreTables.vertexScore(-1, liveTriangles[v]);
+      }
+    }
+
+    std::vector<uint32_t>& adjacency = scratch.adjacency;
+    adjacency.resize(numIndices);
+    for (uint32_t i = 0; i < numIndices; i++) {
+      const uint32_t v = indices[i];
+      adjacency[adjacencyOffsets[v] + adjacencyCursor[v]++] = i / 3;
+    }
+
+    // Note: a triangle referencing a vertex twice carries its score twice, in line with its adjacency
+    std::vector<float>& triangleScores = scratch.triangleScores;
+    triangleScores.resize(numTriangles);
+    uint32_t bestTriangle = 0;
+    for (uint32_t t = 0; t < numTriangles; t++) {
+      triangleScores[t] = vertexScores[indices[t * 3 + 0]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+      if (triangleScores[t] > triangleScores[bestTriangle]) {
+        bestTriangle = t;
+      }
+    }
+
+    std::vector<bool>& emitted = scratch.emitted;
+    emitted.assign(numTriangles, false);
+    std::vector<uint32_t>& output = scratch.output;
+    output.resize(numIndices);
+
+    uint32_t cache[kCacheSize + 3];
+    uint32_t cacheCount = 0;
+    uint32_t inputCursor = 0;
+
+    for (uint32_t outputTriangle = 0; outputTriangle < numTriangles; outputTriangle++) {
+      // Nothing in the cache has triangles left, restart from the next triangle in input order
+      if (bestTriangle == ~0u) {
+        while (emitted[inputCursor]) {
+          inputCursor++;
+        }
+        bestTriangle = inputCursor;
+      }
+
+      const uint32_t* triangle = &indices[bestTriangle * 3];
+      memcpy(&output[outputTriangle * 3], triangle, sizeof(uint32_t) * 3);
+      emitted[bestTriangle] = true;
+
+      // Retire the triangle from the adjacency of its vertices
+      for (uint32_t k = 0; k < 3; k++) {
+        const uint32_t v = triangle[k];
+        uint32_t* begin = &adjacency[adjacencyOffsets[v]];
+        uint32_t* end = begin + liveTriangles[v];
+        uint32_t* it = std::find(begin, end, bestTriangle);
+        assert(it != end);
+        *it = *(end - 1);
+        liveTriangles[v]--;
+      }
+
+      // The triangle's vertices move to the front of the LRU cache, the rest shifts back
+      uint32_t newCache[kCacheSize + 3];
+      uint32_t newCacheCount = 0;
+      for (uint32_t k = 0; k < 3; k++) {
+        if (std::find(newCache, newCache + newCacheCount, triangle[k]) == newCache + newCacheCount) {
+          newCache[newCacheCount++] = triangle[k];
+        }
+      }
+      for (uint32_t i = 0; i < cacheCount; i++) {
+        const uint32_t v = cache[i];
+        if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+          newCache[newCacheCount++] = v;
+        }
+      }
+
+      // Rescore everything that was touched, including vertices which just fell out of the cache
+      for (uint32_t i = 0; i < newCacheCount; i++) {
+        const uint32_t v = newCache[i];
+        cachePositions[v] = i < kCacheSize ? int32_t(i) : -1;
+
+        const float score = g_scoreTables.vertexScore(cachePositions[v], liveTriangles[v]);
+        const float delta = score - vertexScores[v];
+        vertexScores[v] = score;
+
+        const uint32_t* adjacent = &adjacency[adjacencyOffsets[v]];
+        for (uint32_t j = 0; j < liveTriangles[v]; j++) {
+          triangleScores[adjacent[j]] += delta;
+        }
+      }
+
+      cacheCount = std::min(newCacheCount, kCacheSize);
+      memcpy(cache, newCache, sizeof(uint32_t) * cacheCount);
+
+      // Only triangles touching the cache changed score, so the next triangle is picked among those
+      bestTriangle = ~0u;
+      float bestScore = -1.f;
+      for (uint32_t i = 0; i < cacheCount; i++) {
+        const uint32_t v = cache[i];
+        const uint32_t* adjacent = &adjacency[adjacencyOffsets[v]];
+        for (uint32_t j = 0; j < liveTriangles[v]; j++) {
+          if (triangleScores[adjacent[j]] > bestScore) {
+            bestScore = triangleScores[adjacent[j]];
+            bestTriangle = adjacent[j];
+          }
+        }
+      }
+    }
+
+    memcpy(indices, output.data(), sizeof(uint32_t) * numIndices);
+
+    // Restore the per vertex state for the next call, every triangle was retired so the live
+    // counts are back to zero already
+    for (uint32_t i = 0; i < cacheCount; i++) {
+      cachePositions[cache[i]] = -1;
+    }
+    for (uint32_t i = 0; i < numIndices; i++) {
+      adjacencyOffsets[indices[i]] = kUnusedVertex;
+      adjacencyCursor[indices[i]] = 0;
+    }
+  }
+
+  void optimizeVertexCache(uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices) {
+    Scratch scratch;
+    optimizeVertexCache(indices, numIndices, numVertices, scratch);
+  }
+
+  float computeAcmr(const uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices, Scratch& scratch, const uint32_t cacheSize) {
+    const uint32_t numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+      return 0.f;
+    }
+
+    scratch.reserveVertices(numVertices);
+    uint32_t* loadedAt = scratch.loadedAt.data();
+
+    // The timestamp advances on every miss, so a vertex is still in the FIFO if fewer than
+    // cacheSize misses happened since it was loaded.  Starting past cacheSize makes every
+    // vertex a miss on first use.
+    uint32_t timestamp = cacheSize + 1;
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < numIndices; i++) {
+      const uint32_t v = indices[i];
+      assert(v < numVertices);
+      if (timestamp - loadedAt[v] > cacheSize) {
+        loadedAt[v] = timestamp++;
+        misses++;
+      }
+    }
+
+    for (uint32_t i = 0; i < numIndices; i++) {
+      loadedAt[indices[i]] = 0;
+    }
+
+    return float(misses) / float(numTriangles);
+  }
+
+  float computeAcmr(const uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices, const uint32_t cacheSize) {
+    Scratch scratch;
+    return computeAcmr(indices, numIndices, numVertices, scratch, cacheSize);
+  }
+
+  uint32_t optimizeVertexFetchRemap(uint32_t* remapOut, const uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices) {
+    std::fill(remapOut, remapOut + numVertices, kUnusedVertex);
+
+    uint32_t numUsed = 0;
+    for (uint32_t i = 0; i < numIndices; i++) {
+      const uint32_t v = indices[i];
+      assert(v < numVertices);
+      if (remapOut[v] == kUnusedVertex) {
+        remapOut[v] = numUsed++;
+      }
+    }
+
+    return numUsed;
+  }
+
+  void remapIndexBuffer(uint32_t* indices, const uint32_t numIndices, const uint32_t* remap) {
+    for (uint32_t i = 0; i < numIndices; i++) {
+      assert(remap[indices[i]] != kUnusedVertex);
+      indices[i] = remap[indices[i]];
+    }
+  }
+
+  void remapVertexBuffer(void* dstVertices, const void* srcVertices, const uint32_t numVertices, const size_t vertexStride, const uint32_t* remap) {
+    uint8_t* dst = static_cast<uint8_t*>(dstVertices);
+    const uint8_t* src = static_cast<const uint8_t*>(srcVertices);
+
+    for (uint32_t v = 0; v < numVertices; v++) {
+      if (remap[v] != kUnusedVertex) {
+        memcpy(dst + remap[v] * vertexStride, src + v * vertexStride, vertexStride);
+      }
+    }
+  }
+}
@@ -0,0 +1,121 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dxvk::meshopt {
+  // Load time optimizations for indexed triangle lists, applied to replacement meshes before
+  // they are uploaded.  All functions work on 32-bit indices into a single vertex stream.
+
+  // Remap table entry of a vertex no triangle references
+  static constexpr uint32_t kUnusedVertex = ~0u;
+
+  /**
+    * \brief Removes triangles which can never produce any coverage
+    *
+    * A triangle is degenerate when two of its corners reference the same vertex, or, when
+    * positions are provided, the same bitwise position.  Triangle order is preserved.  A list
+    * made of degenerate triangles only is left as is, dropping all of them would leave the mesh
+    * without any vertices.
+    *
+    * indices: triangle list indices, compacted in place
+    * numIndices: number of indices, must be a multiple of 3
+    * positions: optional float3 positions, nullptr to only compare indices
+    * positionStride: byte distance between consecutive positions
+    *
+    * Returns the number of indices remaining.
+    */
+  uint32_t removeDegenerateTriangles(uint32_t* indices, const uint32_t numIndices, const void* positions = nullptr, const size_t positionStride = 0);
+
+  /**
+    * \brief Working memory of optimizeVertexCache and computeAcmr
+    *
+    * The per vertex state is sized for the largest vertex count seen and kept in its initial
+    * state between calls, each call only touches and restores the vertices it references.  Sub
+    * meshes sharing one large vertex buffer should share one Scratch, so the buffer is paid
+    * for once rather than per sub mesh.  Not thread-safe.
+    */
+  struct Scratch {
+    std::vector<uint32_t> liveTriangles;    // 0 between calls
+    std::vector<uint32_t> adjacencyOffsets; // kUnusedVertex between calls
+    std::vector<uint32_t> adjacencyCursor;  // 0 between calls
+    std::vector<int32_t> cachePositions;    // -1 between calls
+    std::vector<float> vertexScores;
+    std::vector<uint32_t> loadedAt;         // 0 between calls
+
+    // Per triangle state, only reused for its capacity
+    std::vector<uint32_t> adjacency;
+    std::vector<float> triangleScores;
+    std::vector<bool> emitted;
+    std::vector<uint32_t> output;
+
+    void reserveVertices(const uint32_t numVertices);
+  };
+
+  /**
+    * \brief Reorders triangles for post transform vertex cache reuse
+    *
+    * Greedy triangle ordering driven by a scored LRU cache model (Forsyth, "Linear-Speed Vertex
+    * Cache Optimisation").  Triangles are emitted unmodified, only their order changes.
+    *
+    * indices: triangle list indices, reordered in place
+    * numIndices: number of indices, must be a multiple of 3
+    * numVertices: number of vertices, all indices must be < numVertices
+    */
+  void optimizeVertexCache(uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices, Scratch& scratch);
+  void optimizeVertexCache(uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices);
+
+  /**
+    * \brief Computes the average cache miss ratio of a triangle list
+    *
+    * Simulates a FIFO post transform cache and returns the number of vertex transforms per
+    * triangle, between 0.5 (ideal for large grids) and 3 (no reuse at all).
+    */
+  float computeAcmr(const uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices, Scratch& scratch, const uint32_t cacheSize = 16);
+  float computeAcmr(const uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices, const uint32_t cacheSize = 16);
+
+  /**
+    * \brief Builds a vertex remap table ordering vertices by first use
+    *
+    * remapOut: receives the new index of every vertex, or kUnusedVertex for vertices no
+    *           triangle references, must have room for numVertices entries
+    *
+    * Returns the number of referenced vertices, i.e. the vertex count after remapping.
+    */
+  uint32_t optimizeVertexFetchRemap(uint32_t* remapOut, const uint32_t* indices, const uint32_t numIndices, const uint32_t numVertices);
+
+  /**
+    * \brief Applies a remap table from optimizeVertexFetchRemap to an index buffer
+    */
+  void remapIndexBuffer(uint32_t* indices, const uint32_t numIndices, const uint32_t* remap);
+
+  /**
+    * \brief Applies a remap table from optimizeVertexFetchRemap to a vertex buffer, unused vertices are dropped
+    *
+    * dstVertices: must have room for the number of referenced vertices, may not alias srcVertices
+    */
+  void remapVertexBuffer(void* dstVertices, const void* srcVertices, const uint32_t numVertices, const size_t vertexStride, const uint32_t* remap);
+}
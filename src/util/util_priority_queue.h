@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+  // A queue handing out its items in order of a priority which changes from frame to frame.
+  //
+  // Items which are ready are kept in a binary heap, so picking the next one is O(log n). Their
+  // priorities are re-evaluated and the heap rebuilt once, on the first pick of every frame, rather
+  // than scanning all items on every pick. Items which are not ready yet wait in FIFO order and join
+  // the heap on the first frame they are ready in; they are only handed out when nothing else is.
+  // Equal priorities are handed out in submission order.
+  //
+  // The policy provides:
+  //   uint32_t currentFrame() const;                   - id of the frame currently being recorded
+  //   bool prioritize() const;                         - false hands out all items in FIFO order
+  //   bool isReady(const T& item, uint32_t frame) const;
+  //   float priority(const T& item, uint32_t frame) const;   - higher is handed out first
+  //
+  // Satisfies the Queue requirements of RenderProcessor. Not thread-safe.
+  template<typename T, typename Policy>
+  class FramePriorityQueue {
+  public:
+    template<typename... PolicyArgs>
+    explicit FramePriorityQueue(PolicyArgs&&... policyArgs)
+      : m_policy(std::forward<PolicyArgs>(policyArgs)...) { }
+
+    void emplace(const T& item) {
+      const uint32_t currentFrame = m_policy.currentFrame();
+      Entry entry { item, m_nextSequence++, 0.f };
+
+      // Only join the heap directly while its priorities are current, the first pick of a new frame
+      // moves the waiting items over anyway. Never reorder the heap under a front() not popped yet.
+      if (!m_hasFront && m_policy.prioritize() && m_heapFrame == currentFrame && m_policy.isReady(item, currentFrame)) {
+        entry.priority = m_policy.priority(item, currentFrame);
+        m_heap.push_back(std::move(entry));
+        std::push_heap(m_heap.begin(), m_heap.end(), lessUrgent);
+      } else {
+        m_waiting.push_back(std::move(entry));
+      }
+    }
+
+    bool empty() const {
+      return m_heap.empty() && m_waiting.empty();
+    }
+
+    size_t size() const {
+      return m_heap.size() + m_waiting.size();
+    }
+
+    T& front() {
+      assert(!empty());
+
+      if (m_hasFront) {
+        return m_frontInHeap ? m_heap.front().item : m_waiting.front().item;
+      }
+
+      if (!m_policy.prioritize()) {
+        // Items left over in the heap from before prioritization was turned off are older
+        m_frontInHeap = !m_heap.empty();
+      } else {
+        const uint32_t currentFrame = m_policy.currentFrame();
+        if (m_heapFrame != currentFrame) {
+          refresh(currentFrame);
+        }
+
+        m_frontInHeap = !m_heap.empty();
+      }
+
+      m_hasFront = true;
+
+      return m_frontInHeap ? m_heap.front().item : m_waiting.front().item;
+    }
+
+    void pop() {
+      assert(!empty());
+
+      // Remove the item front() handed out, even if a new frame started in between
+      if (!m_hasFront) {
+        front();
+      }
+
+      m_hasFront = false;
+
+      if (m_frontInHeap) {
+        std::pop_heap(m_heap.begin(), m_heap.end(), lessUrgent);
+        m_heap.pop_back();
+      } else {
+        m_waiting.pop_front();
+      }
+    }
+
+  private:
+    struct Entry {
+      T item;
+      uint64_t sequence;
+      float priority;
+    };
+
+    static bool lessUrgent(const Entry& a, const Entry& b) {
+      return a.priority < b.priority || (a.priority == b.priority && a.sequence > b.sequence);
+    }
+
+    void refresh(uint32_t currentFrame) {
+      // Keep the items which are still not ready in submission order
+      const size_t numWaiting = m_waiting.size();
+      for (size_t i = 0; i < numWaiting; i++) {
+        Entry entry = std::move(m_waiting.front());
+        m_waiting.pop_front();
+
+        if (m_policy.isReady(entry.item, currentFrame)) {
+          m_heap.push_back(std::move(entry));
+        } else {
+          m_waiting.push_back(std::move(entry));
+        }
+      }
+
+      for (Entry& entry : m_heap) {
+        entry.priority = m_policy.priority(entry.item, currentFrame);
+      }
+
+      std::make_heap(m_heap.begin(), m_heap.end(), lessUrgent);
+      m_heapFrame = currentFrame;
+    }
+
+    Policy m_policy;
+    std::vector<Entry> m_heap;
+    std::deque<Entry> m_waiting;
+    uint64_t m_nextSequence = 0;
+    uint32_t m_heapFrame = ~0u;
+    bool m_hasFront = false;
+    bool m_frontInHeap = false;
+  };
+}
@@ -41,15 +41,20 @@ namespace dxvk {
     *        items (T) in a parallel fashion.
     *
     *  typename T: Type of a single work item.
+    *  typename Queue: Container the pending items are kept in, must provide
+    *                  emplace, empty, front and pop with std::queue semantics.
+    *                  Defaults to FIFO order.
     * 
     *  Example usage: See RtxTextureManager
     */
-  template<typename T>
+  template<typename T, typename Queue = std::queue<T>>
   struct RenderProcessor {
     RenderProcessor() = delete;
-    RenderProcessor(DxvkDevice* pDevice, const std::string& threadName)
+    template<typename... QueueArgs>
+    RenderProcessor(DxvkDevice* pDevice, const std::string& threadName, QueueArgs&&... queueArgs)
       : m_threadName (threadName)
-      , m_ctx(pDevice->createContext()) {
+      , m_ctx(pDevice->createContext())
+      , m_itemQueue(std::forward<QueueArgs>(queueArgs)...) {
     }
 
     ~RenderProcessor() {
@@ -155,7 +160,7 @@ namespace dxvk {
 
     Rc<DxvkContext> m_ctx;
 
-    std::queue<T> m_itemQueue;
+    Queue m_itemQueue;
 
     void threadFunc() {
       std::optional<T> optItem;
@@ -0,0 +1,139 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "util_fast_cache.h"
+#include "util_vector.h"
+
+namespace dxvk {
+  // A uniform grid over 3D space for finding the entries near a point without visiting all of them.
+  //
+  // Entries are bucketed by the grid cell their position falls into and by a caller provided key
+  // (e.g. a material hash), so entries which can never match each other do not share buckets.
+  // Buckets are intrusive lists threaded through a single entry array, so building the index does
+  // not allocate once it has warmed up.
+  //
+  // The index is append only.  An entry may go stale when the object it refers to moves or changes
+  // its key, so callers must verify every candidate they are handed, and rebuild the index with
+  // clear() once too much of it is out of date.
+  template<typename T>
+  class SpatialHash {
+    // Keeps cell coordinates well within int32_t, no matter how far out a position is
+    static constexpr float kMaxCellCoord = float(1 << 30);
+
+  public:
+    // Drops all entries and sets the cell size for the entries to come.  Lookups visit every
+    // cell overlapping the search radius, so cells of twice the typical radius keep a lookup
+    // at no more than 2x2x2 cells.
+    void clear(const float cellSize) {
+      m_cells.clear();
+      m_entries.clear();
+      m_cellSize = cellSize;
+      m_invCellSize = 1.f / cellSize;
+    }
+
+    void reserve(const size_t numEntries) {
+      m_cells.reserve(numEntries);
+      m_entries.reserve(numEntries);
+    }
+
+    void insert(const Vector3& position, const XXH64_hash_t key, const T& value) {
+      // Note: a new bucket starts out as 0, i.e. an empty list
+      uint32_t& head = m_cells[cellHash(cellCoord(position.x), cellCoord(position.y), cellCoord(position.z), key)];
+      m_entries.push_back({ value, head });
+      head = static_cast<uint32_t>(m_entries.size());
+    }
+
+    // Calls visitor(value) for every entry with the given key in the cells overlapping the cube of
+    // the given radius around position, until the visitor returns false.  May visit entries which
+    // are farther away than radius.
+    // Returns false if the visitor stopped the lookup.
+    template<typename Visitor>
+    bool forEachNear(const Vector3& position, const float radius, const XXH64_hash_t key, Visitor&& visitor) const {
+      if (m_entries.empty()) {
+        return true;
+      }
+
+      const int32_t minX = cellCoord(position.x - radius), maxX = cellCoord(position.x + radius);
+      const int32_t minY = cellCoord(position.y - radius), maxY = cellCoord(position.y + radius);
+      const int32_t minZ = cellCoord(position.z - radius), maxZ = cellCoord(position.z + radius);
+
+      for (int32_t z = minZ; z <= maxZ; z++) {
+        for (int32_t y = minY; y <= maxY; y++) {
+          for (int32_t x = minX; x <= maxX; x++) {
+            auto it = m_cells.find(cellHash(x, y, z, key));
+            if (it == m_cells.end()) {
+              continue;
+            }
+
+            for (uint32_t entry = it->second; entry != 0; entry = m_entries[entry - 1].next) {
+              if (!visitor(m_entries[entry - 1].value)) {
+                return false;
+              }
+            }
+          }
+        }
+      }
+
+      return true;
+    }
+
+    float cellSize() const {
+      return m_cellSize;
+    }
+
+    size_t size() const {
+      return m_entries.size();
+    }
+
+    bool empty() const {
+      return m_entries.empty();
+    }
+
+  private:
+    struct Entry {
+      T value;
+      // One based index of the next entry in the bucket, 0 terminates the list
+      uint32_t next;
+    };
+
+    int32_t cellCoord(const float v) const {
+      const float c = std::floor(v * m_invCellSize);
+      // Note: also maps NaN to the lower bound
+      return static_cast<int32_t>(c > -kMaxCellCoord ? std::min(c, kMaxCellCoord) : -kMaxCellCoord);
+    }
+
+    static XXH64_hash_t cellHash(const int32_t x, const int32_t y, const int32_t z, const XXH64_hash_t key) {
+      const int32_t cell[3] = { x, y, z };
+      return XXH3_64bits_withSeed(cell, sizeof(cell), key);
+    }
+
+    fast_unordered_cache<uint32_t> m_cells;
+    std::vector<Entry> m_entries;
+    float m_cellSize = 1.f;
+    float m_invCellSize = 1.f;
+  };
+}
@@ -21,10 +21,12 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -36,12 +38,18 @@
 #include "util_math.h"
 #include "util_fastops.h"
 #include "util_bit.h"
+#include "util_linear_allocator.h"
+#include "sync/sync_futex.h"
 #include "sync/sync_spinlock.h"
 
 namespace dxvk {
   const size_t kLambdaStorageCapacity = 256;
   // Note: use up to 64 bytes for state
   const size_t kResultStorageCapacity = 256 - 64;
+  const size_t kContinuationStorageCapacity = 64;
+
+  // Number of pause iterations a waiter spins for before parking on the result
+  const uint32_t kResultSpinCount = 2048;
 
   template<size_t Capacity = kResultStorageCapacity, bool UseWait = false>
   struct Result {
@@ -51,46 +59,75 @@ namespace dxvk {
 
     template<typename T>
     void set(T&& t) {
-      static_assert(sizeof(T) <= Capacity,
-          "Result object storage space overrun!");
+      store(std::forward<T>(t));
+      set();
+    }
 
-      new(storage.data()) T(std::forward<T>(t));
+    template<typename T>
+    void store(T&& t) {
+      static_assert(sizeof(std::decay_t<T>) <= Capacity,
+          "Result object storage space overrun!");
 
-      set();
+      new(storage.data()) std::decay_t<T>(std::forward<T>(t));
     }
 
     void set() {
       if constexpr (UseWait) {
         std::unique_lock<dxvk::mutex> lock(mtx);
-        hasResult = true;
+        state.store(kReady, std::memory_order_release);
         cond.notify_one();
       } else {
-        hasResult = true;
+        // Only pay for the wake syscall if somebody actually went to sleep on us
+        if (state.exchange(kReady, std::memory_order_acq_rel) == kParked) {
+          sync::futexWakeAll(state);
+        }
       }
     }
 
-    void get() {
-#ifdef _DEBUG
-      if (isDisposed) {
-        throw DxvkError("Refusing to get a disposed result!");
+    // Blocks until the result has been set, without consuming it
+    void wait() {
+      if (state.load(std::memory_order_acquire) == kReady) {
+        return;
       }
-#endif
 
       if constexpr (UseWait) {
-        if (!hasResult) {
-          std::unique_lock<dxvk::mutex> lock(mtx);
-          cond.wait(lock, [this] {
-            return hasResult;
-          });
-        }
+        std::unique_lock<dxvk::mutex> lock(mtx);
+        cond.wait(lock, [this] {
+          return state.load(std::memory_order_acquire) == kReady;
+        });
       } else {
-        while (!hasResult) {
-          std::this_thread::yield();
+        // Most results are only microseconds away, so spin briefly before parking
+        for (uint32_t i = 0; i < kResultSpinCount; i++) {
+          _mm_pause();
+          if (state.load(std::memory_order_acquire) == kReady) {
+            return;
+          }
+        }
+
+        uint32_t current = state.load(std::memory_order_acquire);
+        while (current != kReady) {
+          // Flag that a waiter is parked so the setter knows to wake it
+          if (current == kEmpty && !state.compare_exchange_weak(current, kParked, std::memory_order_acq_rel)) {
+            continue;
+          }
+
+          sync::futexWait(state, kParked);
+          current = state.load(std::memory_order_acquire);
         }
       }
+    }
+
+    void get() {
+#ifdef _DEBUG
+      if (disposed()) {
+        throw DxvkError("Refusing to get a disposed result!");
+      }
+#endif
+
+      wait();
 
-      hasResult = false;
-      isDisposed = true;
+      state.store(kEmpty, std::memory_order_relaxed);
+      isDisposed.store(true, std::memory_order_relaxed);
     }
 
     template<typename T>
@@ -99,24 +136,61 @@ namespace dxvk {
       return std::move(*reinterpret_cast<T*>(storage.data()));
     }
 
+    // Replaces the stored T with the result of f(T), in place
+    template<typename T, typename R, typename F>
+    void transform(F& f) {
+      if constexpr (std::is_void_v<T>) {
+        if constexpr (std::is_void_v<R>) {
+          f();
+        } else {
+          store(f());
+        }
+      } else {
+        T* pValue = reinterpret_cast<T*>(storage.data());
+        T value = std::move(*pValue);
+        pValue->~T();
+
+        if constexpr (std::is_void_v<R>) {
+          f(std::move(value));
+        } else {
+          store(f(std::move(value)));
+        }
+      }
+    }
+
+    // Destroys a stored T which is not going to be consumed
+    template<typename T>
+    void destroy() {
+      if constexpr (!std::is_void_v<T>) {
+        reinterpret_cast<T*>(storage.data())->~T();
+      }
+    }
+
     void reset() {
-      hasResult = false;
-      isDisposed = false;
+      state.store(kEmpty, std::memory_order_relaxed);
+      isDisposed.store(false, std::memory_order_relaxed);
     }
 
     void cancel() {
-      hasResult = false;
-      isDisposed = true;
+      state.store(kEmpty, std::memory_order_relaxed);
+      isDisposed.store(true, std::memory_order_relaxed);
     }
 
+    // May be called from a worker while the owner of the future cancels it
     bool disposed() const {
-      return isDisposed;
+      return isDisposed.load(std::memory_order_relaxed);
     }
 
   private:
+    enum : uint32_t {
+      kEmpty = 0,
+      kReady = 1,
+      kParked = 2
+    };
+
     std::array<uint8_t, Capacity> storage;
-    bool hasResult = false;
-    bool isDisposed = false;
+    std::atomic<uint32_t> state = kEmpty;
+    std::atomic<bool> isDisposed = false;
 
     OnSetCondition cond;
     mutable ResultMutex mtx;
@@ -129,6 +203,8 @@ namespace dxvk {
     using LambdaStorage = std::array<uint8_t, kLambdaStorageCapacity>;
     using ThunkType = void(void*);
     using ThunkStorage = std::array<uint8_t, sizeof(uintptr_t)>;
+    using ContinuationStorage = std::array<uint8_t, kContinuationStorageCapacity>;
+    using ContinuationThunkType = bool(Task&, bool);
 
     template<typename LambdaType, typename ResultType>
     Future<ResultType> capture(LambdaType&& lambda) {
@@ -144,23 +220,87 @@ namespace dxvk {
       captureThunk([this]() {
         auto& lambda = *reinterpret_cast<LambdaType*>(lambdaStorage.data());
 
-        if (!result.disposed()) {
+        const bool execute = !result.disposed();
+        if (execute) {
           if constexpr (!std::is_void_v<ResultType>) {
-            result.set(lambda());
+            result.store(lambda());
           } else {
             lambda();
-            result.set();
           }
         }
 
         lambda.~LambdaType();
+
+        // Run a continuation attached before we got here, otherwise close the
+        //  slot so a later then() runs its continuation on the caller instead.
+        bool hasValue = execute;
+        if (continuationState.exchange(kContinuationClosed, std::memory_order_acq_rel) == kContinuationAttached) {
+          hasValue = continuationThunk(*this, hasValue);
+        }
+
+        // Then whatever got chained behind it while we were running
+        runChainedContinuations(hasValue);
+
+        if (execute) {
+          result.set();
+        }
       });
 
+      continuationState.store(kContinuationNone, std::memory_order_relaxed);
+      chainedContinuations.store(nullptr, std::memory_order_relaxed);
       result.reset();
 
       return Future<ResultType>(*this);
     }
 
+    // Chains f onto this task, the returned future yields f(result)
+    template<typename ResultType, typename F, typename R>
+    Future<R> attach(F&& f) {
+      using ContinuationType = std::decay_t<F>;
+      static_assert(sizeof(ContinuationType) <= kContinuationStorageCapacity,
+          "Continuation storage space overrun!");
+
+      // The first continuation goes into the task's own storage.  If that is taken by a
+      //  previous one, this one is chained behind it on the heap instead, unless the worker
+      //  has already run the chain.  Only the worker ever moves the state away from none,
+      //  and only to closed.
+      if (continuationState.load(std::memory_order_acquire) == kContinuationNone) {
+        new (continuationStorage.data()) ContinuationType(std::forward<F>(f));
+        continuationThunk = [](Task& task, bool hasValue) {
+          auto& continuation = *reinterpret_cast<ContinuationType*>(task.continuationStorage.data());
+          hasValue = task.runContinuation<ResultType, R>(continuation, hasValue);
+          continuation.~ContinuationType();
+          return hasValue;
+        };
+
+        uint32_t expected = kContinuationNone;
+        if (!continuationState.compare_exchange_strong(expected, kContinuationAttached, std::memory_order_acq_rel)) {
+          // Task finished in the meantime, finalize the result here
+          result.wait();
+          continuationThunk(*this, true);
+        }
+      } else {
+        auto* pChained = new ChainedContinuationImpl<ResultType, R, ContinuationType>(std::forward<F>(f));
+
+        ChainedContinuation* pHead = chainedContinuations.load(std::memory_order_acquire);
+        do {
+          if (pHead == closedChain()) {
+            break;
+          }
+          pChained->pNext = pHead;
+        } while (!chainedContinuations.compare_exchange_weak(pHead, pChained, std::memory_order_acq_rel, std::memory_order_acquire));
+
+        if (pHead == closedChain()) {
+          // Everything before us has run, and the result is about to be set
+          result.wait();
+          pChained->run(*this, true);
+          delete pChained;
+        }
+      }
+
+      return Future<R>(*this);
+    }
+
     void operator() () {
       dispatchThunk();
     }
@@ -183,6 +323,67 @@ namespace dxvk {
     }
 
   private:
+    struct ChainedContinuation {
+      virtual ~ChainedContinuation() = default;
+      // Returns whether the result still holds a value afterwards
+      virtual bool run(Task& task, bool hasValue) = 0;
+      ChainedContinuation* pNext = nullptr;
+    };
+
+    template<typename ResultType, typename R, typename ContinuationType>
+    struct ChainedContinuationImpl : ChainedContinuation {
+      template<typename F>
+      explicit ChainedContinuationImpl(F&& f)
+        : continuation(std::forward<F>(f)) { }
+
+      bool run(Task& task, bool hasValue) override {
+        return task.runContinuation<ResultType, R>(continuation, hasValue);
+      }
+
+      ContinuationType continuation;
+    };
+
+    static ChainedContinuation* closedChain() {
+      return reinterpret_cast<ChainedContinuation*>(uintptr_t(1));
+    }
+
+    template<typename ResultType, typename R, typename ContinuationType>
+    bool runContinuation(ContinuationType& continuation, const bool hasValue) {
+      if (!hasValue) {
+        return false;
+      }
+
+      // Checked here rather than when the task started, the continuation's future
+      //  may have been cancelled while the antecedent was still running
+      if (result.disposed()) {
+        result.template destroy<ResultType>();
+        return false;
+      }
+
+      result.template transform<ResultType, R>(continuation);
+      return true;
+    }
+
+    void runChainedContinuations(bool hasValue) {
+      ChainedContinuation* pHead = chainedContinuations.exchange(closedChain(), std::memory_order_acq_rel);
+
+      // Pushed in LIFO order, run them in the order they were attached
+      ChainedContinuation* pOrdered = nullptr;
+      while (pHead != nullptr) {
+        ChainedContinuation* pNext = pHead->pNext;
+        pHead->pNext = pOrdered;
+        pOrdered = pHead;
+        pHead = pNext;
+      }
+
+      while (pOrdered != nullptr) {
+        ChainedContinuation* pNext = pOrdered->pNext;
+        hasValue = pOrdered->run(*this, hasValue);
+        delete pOrdered;
+        pOrdered = pNext;
+      }
+    }
+
     template<typename InvocableType>
     static inline void Thunk(void* thunkLambda) {
       (*static_cast<InvocableType*>(thunkLambda))();
@@ -204,10 +405,21 @@ namespace dxvk {
       thunk = nullptr;
     }
 
+    enum : uint32_t {
+      kContinuationNone = 0,
+      kContinuationAttached = 1,
+      kContinuationClosed = 2
+    };
+
     alignas(64) LambdaStorage lambdaStorage;
     alignas(64) Result<kResultStorageCapacity> result;
     alignas(64) ThunkStorage thunkStorage;
     ThunkType* thunk = nullptr;
+    alignas(64) ContinuationStorage continuationStorage;
+    ContinuationThunkType* continuationThunk = nullptr;
+    std::atomic<uint32_t> continuationState = kContinuationNone;
+    // Continuations attached while the one above was still pending
+    std::atomic<ChainedContinuation*> chainedContinuations = nullptr;
   };
 
   template<typename ResultType>
@@ -223,6 +435,21 @@ namespace dxvk {
       return r;
     }
 
+    /**
+      * \brief Chains a continuation, consuming this future.  f(result) runs on the
+      *        worker completing the task, or on the caller if it already completed.
+      *        The continuation must be cheap, it delays publishing the result.
+      */
+    template<typename F, typename R = std::invoke_result_t<std::decay_t<F>, ResultType>>
+    Future<R> then(F&& f) const {
+      if (!valid()) {
+        return Future<R>();
+      }
+      Task* pTask = task;
+      task = nullptr;
+      return pTask->attach<ResultType, F, R>(std::forward<F>(f));
+    }
+
     bool valid() const {
       return task != nullptr && task->valid();
     }
@@ -247,6 +474,16 @@ namespace dxvk {
       task = nullptr;
     }
 
+    template<typename F, typename R = std::invoke_result_t<std::decay_t<F>>>
+    Future<R> then(F&& f) const {
+      if (!valid()) {
+        return Future<R>();
+      }
+      Task* pTask = task;
+      task = nullptr;
+      return pTask->attach<void, F, R>(std::forward<F>(f));
+    }
+
     bool valid() const {
       return task != nullptr && task->valid();
     }
@@ -260,6 +497,72 @@ namespace dxvk {
     mutable Task* task = nullptr;
   };
 
+  /**
+    * \brief Shared state of a parallel for loop.  Participating threads claim
+    *        chunks of the index range from an atomic counter until none remain,
+    *        so uneven per-index costs balance out across threads automatically.
+    *        The thread completing the final chunk runs the continuation.
+    */
+  template<typename F, typename C>
+  struct ParallelForJob {
+    ParallelForJob(const uint32_t begin, const uint32_t end, const uint32_t grainSize, F&& func, C&& onComplete)
+      : m_begin(begin)
+      , m_end(end)
+      , m_grainSize(std::max(grainSize, 1u))
+      , m_numChunks((end - begin + m_grainSize - 1) / m_grainSize)
+      , m_remainingChunks(m_numChunks)
+      , m_func(std::forward<F>(func))
+      , m_onComplete(std::forward<C>(onComplete)) { }
+
+    void run() {
+      while (true) {
+        const uint32_t chunk = m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= m_numChunks)
+          return;
+
+        const uint32_t chunkBegin = m_begin + chunk * m_grainSize;
+        const uint32_t chunkEnd = std::min(chunkBegin + m_grainSize, m_end);
+        for (uint32_t i = chunkBegin; i < chunkEnd; i++) {
+          m_func(i);
+        }
+
+        if (m_remainingChunks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          m_onComplete();
+        }
+      }
+    }
+
+    bool done() const {
+      return m_remainingChunks.load(std::memory_order_acquire) == 0;
+    }
+
+    uint32_t numChunks() const {
+      return m_numChunks;
+    }
+
+  private:
+    const uint32_t m_begin;
+    const uint32_t m_end;
+    const uint32_t m_grainSize;
+    const uint32_t m_numChunks;
+    std::atomic<uint32_t> m_nextChunk = 0;
+    std::atomic<uint32_t> m_remainingChunks;
+    F m_func;
+    C m_onComplete;
+  };
+
+  /**
+    * \brief Waits on all futures in the list (fork-join), returning once every task has completed
+    */
+  template<typename T>
+  void waitAll(std::vector<Future<T>>& futures) {
+    for (Future<T>& future : futures) {
+      if (future.valid()) {
+        future.get();
+      }
+    }
+  }
+
   /**
     * \brief Implements a async task scheduler, optimized
     *        for tasks of varying execution time using a
@@ -272,6 +575,15 @@ namespace dxvk {
     *              waiting for tasks on a conditional variable
     *  (ctor)workerName: Name given to threads with the pattern: workerName(N)
     * 
+    *  Each worker owns a LinearAllocator arena for task scratch memory, reachable
+    *  from inside a task through threadLinearAllocator().  Arenas are reset by the
+    *  workers themselves between tasks, after resetWorkerArenas() is called, and
+    *  their usage is published per epoch after every task.
+    * 
+    *  parallelFor()/parallelForAsync() split an index range into chunks which are
+    *  claimed dynamically by the workers (and the calling thread when blocking).
+    *  Like Schedule(), these must be called from the single scheduling thread.
+    * 
     *  Example usage:
     *   // Creates 1 thread, and uses it to return PI via a future
     *   WorkerThreadPool threadPool(1, "thread-pool-name");
@@ -287,25 +599,50 @@ namespace dxvk {
     using OnAddCondition = std::conditional_t<LowLatency, Nop, dxvk::condition_variable>;
     using TaskMutex = std::conditional_t<LowLatency, Nop, dxvk::mutex>;
 
+    static constexpr uint32_t kInvalidArenaEpoch = ~0u;
+
+    struct WorkerArena {
+      LinearAllocator allocator;
+      // Running stats of the current and previous arena epoch, indexed by epoch parity.
+      //  Published by the owning worker after every task, tagged with the epoch they belong to.
+      struct EpochStats {
+        std::atomic<uint32_t> epoch = kInvalidArenaEpoch;
+        std::atomic<uint32_t> allocationCount = 0;
+        std::atomic<uint32_t> heapAllocationCount = 0;
+        std::atomic<size_t> peakUsage = 0;
+      } epochStats[2];
+    };
+
   public:
+    struct ArenaStats {
+      uint32_t allocationCount = 0;
+      uint32_t heapAllocationCount = 0;
+      size_t peakUsage = 0;
+    };
+
     WorkerThreadPool(uint8_t numThreads, const char* workerName = "Nameless Worker Thread") 
-    : m_numThread(numThreads) {
+    : m_numThread(numThreads)
+    , m_threadMask(numThreads >= 8 ? 0xFF : static_cast<uint8_t>((1u << numThreads) - 1)) {
       // Note: round up to a closest power-of-two so we can use mask as modulo
       m_taskCount = 1 << (32 - bit::lzcnt(static_cast<uint32_t>(NumTasksPerThread*numThreads) - 1));
-      m_tasks.resize(m_taskCount);
+      // Tasks hold atomics and so cannot be relocated, allocate them in place
+      m_tasks = std::make_unique<Task[]>(m_taskCount);
       m_workerTasks.resize(m_numThread);
+      m_workerArenas.resize(m_numThread);
       m_workerThreads.resize(m_numThread);
       // Create the work queues first!  We need to create
       // then all since work stealing may access the other
       // queues.
       for (int i = 0; i < m_numThread; i++) {
         m_workerTasks[i] = std::make_unique<Queue>();
+        m_workerArenas[i] = std::make_unique<WorkerArena>();
       }
 
       // Start the worker threads
       for (int i = 0; i < m_numThread; i++) {
         m_workerThreads[i] = std::thread([this, i, workerName] {
           env::setThreadName(str::format(workerName, "(", i, ")"));
+          threadLinearAllocator() = &m_workerArenas[i]->allocator;
           processWork(i);
         });
       }
@@ -347,11 +684,15 @@ namespace dxvk {
       //  just distribute evenly to all threads for some mask denoted by Affinity.
       static size_t s_idx = 0;
 
-      // Is the affinity mask valid?
-      const uint8_t affinityMask = std::min(popcnt_uint8(Affinity), m_numThread);
+      // Only consider the threads this pool actually has, fall back to all of them if none match
+      uint8_t affinity = Affinity & m_threadMask;
+      if (affinity == 0) {
+        affinity = m_threadMask;
+      }
+      const uint8_t affinityCount = popcnt_uint8(affinity);
 
       // Schedule work on the appropriate thread
-      const uint32_t thread = fast::findNthBit(Affinity, (uint8_t) (s_idx++ % affinityMask));
+      const uint32_t thread = fast::findNthBit(affinity, (uint8_t) (s_idx++ % affinityCount));
       assert(thread < m_numThread);
 
       // Atomic queue is SPSC, so we don't need to take a lock here
@@ -365,6 +706,10 @@ namespace dxvk {
         // Capture task lambda
         future = m_tasks[taskId].capture<F, R>(std::forward<F>(f));
 
+        // Count the task before it becomes visible, so a worker popping it never sees the count
+        //  underflow, and a worker woken below never finds the count at zero and goes back to sleep
+        ++m_numTasks;
+
         // Place task into queue
         m_workerTasks[thread]->push(std::move(taskId));
 
@@ -378,15 +723,151 @@ namespace dxvk {
             m_condOnAdd.notify_all();
           }
         }
-
-        ++m_numTasks;
       }
 
       return future;
     }
 
+    /**
+      * \brief Runs func(i) for every i in [begin, end), split into chunks of grainSize
+      *        indices.  The calling thread participates, and only returns once every
+      *        index has been processed.
+      */
+    template<typename F>
+    void parallelFor(const uint32_t begin, const uint32_t end, const uint32_t grainSize, F&& func) {
+      if (begin >= end)
+        return;
+
+      auto nop = []() { };
+      ParallelForJob<F, decltype(nop)> job(begin, end, grainSize, std::forward<F>(func), std::move(nop));
+
+      // The job lives on our stack, helpers which find no chunks left return immediately, and we
+      // wait for every helper task (not just every chunk) before leaving so none can touch a dead job.
+      std::vector<Future<void>> helpers;
+      const uint32_t numHelpers = std::min<uint32_t>(m_numThread, job.numChunks() - 1);
+      helpers.reserve(numHelpers);
+      for (uint32_t i = 0; i < numHelpers; i++) {
+        helpers.push_back(Schedule([&job]() { job.run(); }));
+      }
+
+      job.run();
+
+      waitAll(helpers);
+      assert(job.done());
+    }
+
+    /**
+      * \brief Non-blocking variant of parallelFor.  onComplete is the continuation, executed
+      *        on whichever worker finishes the last chunk.  The calling thread does not participate.
+      */
+    template<typename F, typename C>
+    void parallelForAsync(const uint32_t begin, const uint32_t end, const uint32_t grainSize, F&& func, C&& onComplete) {
+      if (begin >= end) {
+        onComplete();
+        return;
+      }
+
+      using Job = ParallelForJob<std::decay_t<F>, std::decay_t<C>>;
+      auto job = std::make_shared<Job>(begin, end, grainSize, std::forward<F>(func), std::forward<C>(onComplete));
+
+      const uint32_t numHelpers = std::min<uint32_t>(m_numThread, job->numChunks());
+      uint32_t numScheduled = 0;
+      for (uint32_t i = 0; i < numHelpers; i++) {
+        numScheduled += Schedule([job]() { job->run(); }).valid() ? 1 : 0;
+      }
+
+      // Queues are full, make sure the work still gets done
+      if (numScheduled == 0) {
+        job->run();
+      }
+    }
+
+    /**
+      * \brief Suggested pool size for the current machine, leaving one hardware thread for the caller
+      *
+      * minThreads: lower bound, regardless of the hardware
+      * maxThreads: upper bound, regardless of the hardware
+      */
+    static uint8_t getDefaultThreadCount(const uint32_t minThreads = 1, const uint32_t maxThreads = 255) {
+      const uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 2u);
+      return static_cast<uint8_t>(std::clamp(hardwareThreads - 1, std::max(minThreads, 1u), std::min(maxThreads, 255u)));
+    }
+
+    uint8_t getThreadCount() const {
+      return m_numThread;
+    }
+
+    /**
+      * \brief Requests all worker arenas be reset, typically at the end of a frame.
+      *        Workers apply the reset before their next task.
+      */
+    void resetWorkerArenas() {
+      ++m_arenaEpoch;
+    }
+
+    /**
+      * \brief Arena usage summed over all workers for the last completed arena epoch
+      */
+    ArenaStats getWorkerArenaStats() const {
+      ArenaStats stats;
+      const uint32_t epoch = m_arenaEpoch.load(std::memory_order_acquire);
+      if (epoch == 0) {
+        return stats;
+      }
+
+      // Workers which ran nothing during that epoch never tagged a slot with it, and count as zero
+      const uint32_t completedEpoch = epoch - 1;
+      for (const auto& arena : m_workerArenas) {
+        const auto& epochStats = arena->epochStats[completedEpoch & 1];
+        if (epochStats.epoch.load(std::memory_order_acquire) != completedEpoch) {
+          continue;
+        }
+
+        const uint32_t allocationCount = epochStats.allocationCount.load(std::memory_order_relaxed);
+        const uint32_t heapAllocationCount = epochStats.heapAllocationCount.load(std::memory_order_relaxed);
+        const size_t peakUsage = epochStats.peakUsage.load(std::memory_order_relaxed);
+
+        // The slot is only reused two epochs later, skip it if that happened while we were reading
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (epochStats.epoch.load(std::memory_order_relaxed) != completedEpoch) {
+          continue;
+        }
+
+        stats.allocationCount += allocationCount;
+        stats.heapAllocationCount += heapAllocationCount;
+        stats.peakUsage += peakUsage;
+      }
+      return stats;
+    }
+
   private:
+    void updateWorkerArena(const uint32_t workerId, uint32_t& arenaEpoch) {
+      const uint32_t epoch = m_arenaEpoch.load(std::memory_order_relaxed);
+      if (epoch == arenaEpoch)
+        return;
+
+      // Everything allocated so far was already published under the old epoch
+      m_workerArenas[workerId]->allocator.reset();
+      arenaEpoch = epoch;
+    }
+
+    void publishWorkerArenaStats(const uint32_t workerId, const uint32_t arenaEpoch) {
+      // Stats are published after every task rather than on the next reset, so an epoch is
+      //  complete as soon as its tasks are, even if the worker goes idle for a while after
+      WorkerArena& arena = *m_workerArenas[workerId];
+      auto& epochStats = arena.epochStats[arenaEpoch & 1];
+
+      epochStats.epoch.store(kInvalidArenaEpoch, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      epochStats.allocationCount.store(arena.allocator.allocationCount(), std::memory_order_relaxed);
+      epochStats.heapAllocationCount.store(arena.allocator.blockAllocationCount(), std::memory_order_relaxed);
+      epochStats.peakUsage.store(arena.allocator.peakUsage(), std::memory_order_relaxed);
+      epochStats.epoch.store(arenaEpoch, std::memory_order_release);
+    }
+
     void processWork(const uint32_t workerId) {
+      uint32_t arenaEpoch = 0;
+
       while (true) {
         // Using a conditional wait in high-latency mode
         if constexpr (!LowLatency) {
@@ -402,7 +883,7 @@ namespace dxvk {
         }
 
         // Try executing a task from our queue
-        if (executeTask(workerId))
+        if (executeTask(workerId, workerId, arenaEpoch))
           continue;
 
         if (WorkStealing) {
@@ -411,7 +892,7 @@ namespace dxvk {
           bool workStolen = false;
           for (uint32_t i = 1; i < m_numThread; i++) {
             const uint32_t victim = (workerId + i) % m_numThread;
-            if (executeTask(victim)) {
+            if (executeTask(workerId, victim, arenaEpoch)) {
               workStolen = true;
               break;
             }
@@ -426,7 +907,7 @@ namespace dxvk {
     }
 
     // True if front pop, False if back pop
-    bool executeTask(const uint32_t workerId) {
+    bool executeTask(const uint32_t workerId, const uint32_t queueId, uint32_t& arenaEpoch) {
       TaskId taskId;
       {
         // Since we're using an SPSC queue, we must take a lock when
@@ -434,24 +915,30 @@ namespace dxvk {
         // another thread.
         std::unique_lock<sync::Spinlock> lock(m_threadMutex);
 
-        if (!m_workerTasks[workerId]->pop(taskId)) {
+        if (!m_workerTasks[queueId]->pop(taskId)) {
           return false;
         }
 
         --m_numTasks;
       }
 
+      // No task is running on this thread, so it's safe to recycle our arena.  Checked after the
+      //  pop, so a task scheduled after resetWorkerArenas() is always counted in the new epoch.
+      updateWorkerArena(workerId, arenaEpoch);
+
       // Execute the task
       m_tasks[taskId]();
 
+      publishWorkerArenaStats(workerId, arenaEpoch);
       return true;
     }
 
-    std::vector<Task> m_tasks;
+    std::unique_ptr<Task[]> m_tasks;
     std::atomic<TaskId> m_taskId = 0;
     uint32_t m_taskCount;
 
     uint8_t m_numThread;
+    uint8_t m_threadMask;
 
     std::atomic<bool> m_stopWork = false;
 
@@ -470,6 +957,9 @@ namespace dxvk {
     //  1. Non-circular queue incurs allocation overhead thats unacceptable
     //  2. Use of mutex, and CVs, incur overhead thats unacceptable
     std::vector<QueuePtr> m_workerTasks;
-    std::atomic_uint32_t m_numTasks;
+    std::atomic_uint32_t m_numTasks = 0;
+
+    std::vector<std::unique_ptr<WorkerArena>> m_workerArenas;
+    std::atomic<uint32_t> m_arenaEpoch = 0;
   };
 } //dxvk
\ No newline at end of file
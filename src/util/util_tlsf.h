@@ -0,0 +1,435 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include <assert.h>
+#include "util_bit.h"
+#include "util_fast_cache.h"
+#include "util_math.h"
+
+namespace dxvk {
+  /**
+    * \brief Two-level segregated fit (TLSF) suballocator
+    *
+    *  Carves a range of a fixed size into aligned blocks.  Free blocks are binned by size into
+    *  power-of-two classes (first level), each split linearly into 32 subclasses (second level),
+    *  with a bitmap per level marking the non-empty bins.  Finding a bin whose blocks are all
+    *  large enough for a request takes two bit scans, and every block links to its physical
+    *  neighbors so a freed block is coalesced with them right away.  Both alloc and free are
+    *  O(1), independent of how many blocks the range has been split into.
+    *
+    *  Only offsets are managed, the allocator never touches the memory it describes.  This is
+    *  not thread-safe.
+    */
+  class TlsfAllocator {
+    static constexpr uint32_t kSlCountLog2 = 5;
+    static constexpr uint32_t kSlCount = 1u << kSlCountLog2;
+    static constexpr uint32_t kFlCount = 32;
+    static constexpr uint32_t kInvalidBlock = ~0u;
+
+    // When no bin is guaranteed to fit an aligned request, up to this many blocks which merely
+    // might fit are tried before giving up, so the worst case stays bounded.
+    static constexpr uint32_t kMaxFallbackCandidates = 16;
+
+    struct Block {
+      uint64_t offset;
+      uint64_t size;
+      uint32_t prevPhys;
+      uint32_t nextPhys;
+      uint32_t prevFree;
+      uint32_t nextFree;
+      bool isFree;
+    };
+
+  public:
+    static constexpr uint64_t kInvalidOffset = ~uint64_t(0);
+
+    // Largest range a single allocator can manage
+    static constexpr uint64_t kMaxSize = (uint64_t(1) << (kFlCount + kSlCountLog2 - 1)) - 1;
+
+    explicit TlsfAllocator(const uint64_t size = 0) {
+      reset(size);
+    }
+
+    /**
+      * \brief Drops all allocations and marks the whole range of \c size bytes as free
+      */
+    void reset(const uint64_t size) {
+      assert(size <= kMaxSize);
+
+      m_blocks.clear();
+      m_unusedBlocks.clear();
+      m_allocations.clear();
+      m_flBitmap = 0;
+      std::fill(std::begin(m_slBitmap), std::end(m_slBitmap), 0u);
+      std::fill(std::begin(m_freeHeads), std::end(m_freeHeads), kInvalidBlock);
+
+      m_size = size;
+      m_freeSize = 0;
+      m_numFreeBlocks = 0;
+
+      if (size != 0) {
+        const uint32_t block = newBlock(0, size);
+        insertFree(block);
+      }
+    }
+
+    /**
+      * \brief Allocates a block
+      *
+      * \param [in] size Number of bytes to allocate
+      * \param [in] alignment Required alignment of the offset, must be a power of two
+      * \returns Offset of the block, or \c kInvalidOffset if no free block fits
+      */
+    uint64_t alloc(uint64_t size, const uint64_t alignment = 1) {
+      assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+
+      size = std::max<uint64_t>(size, 1);
+
+      if (size > m_freeSize) {
+        return kInvalidOffset;
+      }
+
+      // Try the first free block at or above the bin the request itself maps to, which is the
+      // smallest candidate and often fits exactly.  Failing that, any block in a bin for at
+      // least size + alignment - 1 bytes fits, wherever it starts.
+      uint32_t block = firstFittingBlock(size, alignment, 1);
+      const uint64_t paddedSize = size + alignment - 1;
+
+      if (block == kInvalidBlock && paddedSize <= m_size) {
+        uint32_t fl, sl;
+        mappingSearch(paddedSize, fl, sl);
+
+        if (findFreeBin(fl, sl)) {
+          block = m_freeHeads[fl * kSlCount + sl];
+        }
+      }
+
+      // Otherwise, look at the blocks which are large enough on their own and check their
+      // alignment.  This covers e.g. an aligned request for the whole range.
+      if (block == kInvalidBlock) {
+        block = firstFittingBlock(size, alignment, kMaxFallbackCandidates);
+
+        if (block == kInvalidBlock) {
+          return kInvalidOffset;
+        }
+      }
+
+      removeFree(block);
+
+      // Return the space before the aligned offset and behind the allocation to the free bins.
+      // Neither can border another free block, since free blocks are always fully coalesced.
+      const uint64_t offset = align(m_blocks[block].offset, alignment);
+
+      if (offset != m_blocks[block].offset) {
+        const uint32_t head = splitBlock(block, offset - m_blocks[block].offset);
+        insertFree(head);
+        block = m_blocks[head].nextPhys;
+      }
+
+      if (m_blocks[block].size != size) {
+        const uint32_t tail = m_blocks[splitBlock(block, size)].nextPhys;
+        insertFree(tail);
+      }
+
+      m_allocations[allocationKey(offset)] = block;
+      return offset;
+    }
+
+    /**
+      * \brief Frees a block returned by \c alloc
+      *
+      * \param [in] offset Offset of the block
+      * \returns Size of the block that has been freed
+      */
+    uint64_t free(const uint64_t offset) {
+      auto it = m_allocations.find(allocationKey(offset));
+      assert(it != m_allocations.end());
+
+      uint32_t block = it->second;
+      m_allocations.erase(it);
+
+      const uint64_t size = m_blocks[block].size;
+
+      const uint32_t prev = m_blocks[block].prevPhys;
+
+      if (prev != kInvalidBlock && m_blocks[prev].isFree) {
+        removeFree(prev);
+        block = mergeBlocks(prev, block);
+      }
+
+      const uint32_t next = m_blocks[block].nextPhys;
+
+      if (next != kInvalidBlock && m_blocks[next].isFree) {
+        removeFree(next);
+        block = mergeBlocks(block, next);
+      }
+
+      insertFree(block);
+      return size;
+    }
+
+    // Size of the managed range
+    uint64_t size() const {
+      return m_size;
+    }
+
+    // Total number of free bytes, which may be split across several blocks
+    uint64_t freeSize() const {
+      return m_freeSize;
+    }
+
+    uint32_t freeBlockCount() const {
+      return m_numFreeBlocks;
+    }
+
+    uint32_t allocationCount() const {
+      return static_cast<uint32_t>(m_allocations.size());
+    }
+
+    bool empty() const {
+      return m_allocations.size() == 0;
+    }
+
+    // Size of the largest free block, i.e. the largest unaligned request that would succeed.
+    // Walks the highest non-empty bin, so this is meant for statistics, not the hot path.
+    uint64_t largestFreeBlock() const {
+      if (m_flBitmap == 0) {
+        return 0;
+      }
+
+      const uint32_t fl = 31 - bit::lzcnt(m_flBitmap);
+      const uint32_t sl = 31 - bit::lzcnt(m_slBitmap[fl]);
+
+      uint64_t largest = 0;
+
+      for (uint32_t block = m_freeHeads[fl * kSlCount + sl]; block != kInvalidBlock; block = m_blocks[block].nextFree) {
+        largest = std::max(largest, m_blocks[block].size);
+      }
+
+      return largest;
+    }
+
+  private:
+    static uint32_t msb(const uint64_t value) {
+      const uint32_t hi = static_cast<uint32_t>(value >> 32);
+      return hi != 0 ? 63 - bit::lzcnt(hi) : 31 - bit::lzcnt(static_cast<uint32_t>(value));
+    }
+
+    // Bin a free block of the given size belongs to
+    static void mappingInsert(const uint64_t size, uint32_t& fl, uint32_t& sl) {
+      if (size < kSlCount) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+      } else {
+        const uint32_t shift = msb(size) - kSlCountLog2;
+        fl = shift + 1;
+        sl = static_cast<uint32_t>(size >> shift) - kSlCount;
+      }
+    }
+
+    // First bin all of whose blocks are at least the given size
+    static void mappingSearch(uint64_t size, uint32_t& fl, uint32_t& sl) {
+      if (size >= kSlCount) {
+        size += (uint64_t(1) << (msb(size) - kSlCountLog2)) - 1;
+      }
+
+      mappingInsert(size, fl, sl);
+    }
+
+    // Offsets are usually aligned, so spread them over the cache's buckets.  Multiplying with
+    // an odd constant is a bijection, so distinct offsets never share a key.
+    static XXH64_hash_t allocationKey(const uint64_t offset) {
+      return offset * 0x9E3779B97F4A7C15ull;
+    }
+
+    // Moves fl/sl to the first non-empty bin at or above them, returns false if there is none
+    bool findFreeBin(uint32_t& fl, uint32_t& sl) const {
+      if (fl >= kFlCount) {
+        return false;
+      }
+
+      uint32_t slMap = sl < kSlCount ? m_slBitmap[fl] & (~0u << sl) : 0;
+
+      if (slMap == 0) {
+        const uint32_t flMap = fl + 1 < kFlCount ? m_flBitmap & (~0u << (fl + 1)) : 0;
+
+        if (flMap == 0) {
+          return false;
+        }
+
+        fl = bit::tzcnt(flMap);
+        slMap = m_slBitmap[fl];
+      }
+
+      sl = bit::tzcnt(slMap);
+      return true;
+    }
+
+    // Walks the free blocks from the bin the given size maps to upwards, and returns the first one
+    // the aligned request fits into, giving up after looking at maxCandidates blocks
+    uint32_t firstFittingBlock(const uint64_t size, const uint64_t alignment, const uint32_t maxCandidates) const {
+      uint32_t fl, sl;
+      mappingInsert(size, fl, sl);
+
+      uint32_t numCandidates = 0;
+
+      while (findFreeBin(fl, sl)) {
+        for (uint32_t block = m_freeHeads[fl * kSlCount + sl]; block != kInvalidBlock; block = m_blocks[block].nextFree) {
+          const Block& candidate = m_blocks[block];
+
+          if (align(candidate.offset, alignment) + size <= candidate.offset + candidate.size) {
+            return block;
+          }
+
+          if (++numCandidates == maxCandidates) {
+            return kInvalidBlock;
+          }
+        }
+
+        sl++;
+      }
+
+      return kInvalidBlock;
+    }
+
+    void insertFree(const uint32_t block) {
+      Block& b = m_blocks[block];
+
+      uint32_t fl, sl;
+      mappingInsert(b.size, fl, sl);
+
+      const uint32_t bin = fl * kSlCount + sl;
+      b.isFree = true;
+      b.prevFree = kInvalidBlock;
+      b.nextFree = m_freeHeads[bin];
+
+      if (b.nextFree != kInvalidBlock) {
+        m_blocks[b.nextFree].prevFree = block;
+      }
+
+      m_freeHeads[bin] = block;
+      m_flBitmap |= 1u << fl;
+      m_slBitmap[fl] |= 1u << sl;
+
+      m_freeSize += b.size;
+      m_numFreeBlocks++;
+    }
+
+    void removeFree(const uint32_t block) {
+      Block& b = m_blocks[block];
+      assert(b.isFree);
+
+      if (b.prevFree != kInvalidBlock) {
+        m_blocks[b.prevFree].nextFree = b.nextFree;
+      } else {
+        uint32_t fl, sl;
+        mappingInsert(b.size, fl, sl);
+
+        m_freeHeads[fl * kSlCount + sl] = b.nextFree;
+
+        if (b.nextFree == kInvalidBlock) {
+          m_slBitmap[fl] &= ~(1u << sl);
+
+          if (m_slBitmap[fl] == 0) {
+            m_flBitmap &= ~(1u << fl);
+          }
+        }
+      }
+
+      if (b.nextFree != kInvalidBlock) {
+        m_blocks[b.nextFree].prevFree = b.prevFree;
+      }
+
+      b.isFree = false;
+      m_freeSize -= b.size;
+      m_numFreeBlocks--;
+    }
+
+    // Cuts a block in two at the given size, the second half is a new block.  Returns the first half.
+    uint32_t splitBlock(const uint32_t block, const uint64_t size) {
+      assert(size < m_blocks[block].size);
+
+      const uint32_t next = newBlock(m_blocks[block].offset + size, m_blocks[block].size - size);
+      Block& b = m_blocks[block];
+      Block& n = m_blocks[next];
+
+      n.prevPhys = block;
+      n.nextPhys = b.nextPhys;
+
+      if (b.nextPhys != kInvalidBlock) {
+        m_blocks[b.nextPhys].prevPhys = next;
+      }
+
+      b.nextPhys = next;
+      b.size = size;
+      return block;
+    }
+
+    // Merges a block into its physical predecessor and returns the merged block
+    uint32_t mergeBlocks(const uint32_t block, const uint32_t next) {
+      Block& b = m_blocks[block];
+      Block& n = m_blocks[next];
+      assert(b.nextPhys == next);
+
+      b.size += n.size;
+      b.nextPhys = n.nextPhys;
+
+      if (n.nextPhys != kInvalidBlock) {
+        m_blocks[n.nextPhys].prevPhys = block;
+      }
+
+      m_unusedBlocks.push_back(next);
+      return block;
+    }
+
+    uint32_t newBlock(const uint64_t offset, const uint64_t size) {
+      uint32_t block;
+
+      if (!m_unusedBlocks.empty()) {
+        block = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+      } else {
+        block = static_cast<uint32_t>(m_blocks.size());
+        m_blocks.emplace_back();
+      }
+
+      m_blocks[block] = Block { offset, size, kInvalidBlock, kInvalidBlock, kInvalidBlock, kInvalidBlock, false };
+      return block;
+    }
+
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unusedBlocks;
+    fast_unordered_cache<uint32_t> m_allocations;
+
+    uint32_t m_flBitmap = 0;
+    uint32_t m_slBitmap[kFlCount] = {};
+    uint32_t m_freeHeads[kFlCount * kSlCount];
+
+    uint64_t m_size = 0;
+    uint64_t m_freeSize = 0;
+    uint32_t m_numFreeBlocks = 0;
+  };
+}
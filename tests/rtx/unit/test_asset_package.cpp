@@ -0,0 +1,239 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_asset_package.h"
+
+using namespace dxvk;
+using namespace std;
+
+class AssetPackageTestApp {
+public:
+  static void run() {
+    const string filename = (filesystem::temp_directory_path() / "dxvk_test_asset_package.pkg").string();
+
+    cout << "Begin round trip test" << endl;
+    writePackage(filename, AssetPackage::kVersion);
+    test_round_trip(filename, true);
+    test_round_trip(filename, false);
+
+    cout << "Begin corruption test" << endl;
+    corruptBlob(filename, 1);
+    test_corruption(filename, true);
+    test_corruption(filename, false);
+
+    cout << "Begin version 1 test" << endl;
+    writePackage(filename, 1);
+    corruptBlob(filename, 1);
+    test_unverified(filename);
+
+    AssetPackage::releasePrefetcher();
+    filesystem::remove(filename);
+
+    cout << "AssetPackage successfully tested" << endl;
+  }
+
+private:
+  static constexpr uint16_t kWidth = 64;
+  static constexpr uint16_t kHeight = 32;
+
+  static vector<uint8_t> blobData(uint32_t idx) {
+    vector<uint8_t> data(kWidth * kHeight * 4 >> idx);
+    for (size_t n = 0; n < data.size(); n++) {
+      data[n] = static_cast<uint8_t>(n * 31 + idx);
+    }
+    return data;
+  }
+
+  static void writePackage(const string& filename, uint32_t version) {
+    AssetPackageWriter writer;
+
+    AssetPackage::AssetDesc image {};
+    image.type = AssetPackage::AssetDesc::Type::IMAGE_2D;
+    image.width = kWidth;
+    image.height = kHeight;
+    image.depth = 1;
+    image.numMips = 2;
+    image.numTailMips = 0;
+    image.arraySize = 1;
+
+    for (uint32_t n = 0; n < 2; n++) {
+      const auto data = blobData(n);
+      const uint32_t blobIdx = writer.addBlob(data.data(), static_cast<uint32_t>(data.size()));
+
+      if (n == 0) {
+        image.baseBlobIdx = static_cast<uint16_t>(blobIdx);
+      }
+    }
+    image.tailBlobIdx = image.baseBlobIdx + 1;
+    writer.addAsset("textures/image.dds", image);
+
+    AssetPackage::AssetDesc buffer {};
+    buffer.type = AssetPackage::AssetDesc::Type::BUFFER;
+    buffer.size = 256;
+    buffer.depth = 1;
+    buffer.numMips = 1;
+    buffer.arraySize = 1;
+    const auto bufferData = blobData(5);
+    buffer.baseBlobIdx = static_cast<uint16_t>(writer.addBlob(bufferData.data(), static_cast<uint32_t>(bufferData.size())));
+    buffer.tailBlobIdx = buffer.baseBlobIdx;
+    writer.addAsset("buffers/buffer.bin", buffer);
+
+    if (!writer.write(filename, version)) {
+      throw DxvkError("Unable to write the test package");
+    }
+  }
+
+  static void corruptBlob(const string& filename, uint32_t blobIdx) {
+    Rc<AssetPackage> package = new AssetPackage(filename, false, false);
+    if (!package->initialize()) {
+      throw DxvkError("Unable to open the test package for corruption");
+    }
+
+    const uint64_t offset = package->getDataBlobDesc(blobIdx)->offset + 7;
+    package = nullptr;
+
+    fstream file(filename, ios::in | ios::out | ios::binary);
+    file.seekg(offset);
+    const char byte = static_cast<char>(file.get() ^ 0x5A);
+    file.seekp(offset);
+    file.put(byte);
+  }
+
+  static void test_round_trip(const string& filename, bool useFileMapping) {
+    Rc<AssetPackage> package = new AssetPackage(filename, useFileMapping, true);
+    if (!package->initialize()) {
+      throw DxvkError("Unable to mount the written package");
+    }
+
+    if (package->getAssetCount() != 2) {
+      throw DxvkError("Unexpected asset count");
+    }
+
+    const uint32_t imageIdx = package->findAsset("textures/image.dds");
+    const uint32_t bufferIdx = package->findAsset("buffers/buffer.bin");
+    if (imageIdx == AssetPackage::kNoAssetIdx || bufferIdx == AssetPackage::kNoAssetIdx ||
+        package->findAsset("textures/missing.dds") != AssetPackage::kNoAssetIdx) {
+      throw DxvkError("Asset names were not round tripped");
+    }
+
+    const AssetPackage::AssetDesc* image = package->getAssetDesc(imageIdx);
+    if (image->type != AssetPackage::AssetDesc::Type::IMAGE_2D ||
+        image->width != kWidth || image->height != kHeight || image->numMips != 2) {
+      throw DxvkError("Image description was not round tripped");
+    }
+
+    const AssetPackage::AssetDesc* buffer = package->getAssetDesc(bufferIdx);
+    if (buffer->type != AssetPackage::AssetDesc::Type::BUFFER || buffer->size != 256) {
+      throw DxvkError("Buffer description was not round tripped");
+    }
+
+    const uint32_t blobIndices[] = { image->baseBlobIdx, image->tailBlobIdx, buffer->baseBlobIdx };
+    const uint32_t dataIndices[] = { 0, 1, 5 };
+    package->prefetchBlobs(blobIndices, 3);
+
+    for (uint32_t n = 0; n < 3; n++) {
+      const auto expected = blobData(dataIndices[n]);
+      const AssetPackage::BlobDesc* blobDesc = package->getDataBlobDesc(blobIndices[n]);
+
+      if (blobDesc->size != expected.size()) {
+        throw DxvkError("Blob size was not round tripped");
+      }
+
+      vector<uint8_t> data(blobDesc->size);
+      if (package->readDataBlob(blobIndices[n], data.data(), data.size()) != data.size() || data != expected) {
+        throw DxvkError("Blob data read back does not match");
+      }
+
+      const uint8_t* mappedData = package->mapDataBlob(blobIndices[n]);
+      if (useFileMapping != (mappedData != nullptr)) {
+        throw DxvkError("Package mapping does not follow the setting");
+      }
+
+      if (mappedData && memcmp(mappedData, expected.data(), expected.size()) != 0) {
+        throw DxvkError("Mapped blob data does not match");
+      }
+
+      if (package->verifyBlobChecksum(blobIndices[n]) != AssetPackage::BlobStatus::Valid) {
+        throw DxvkError("Intact blob failed verification");
+      }
+    }
+  }
+
+  static void test_corruption(const string& filename, bool useFileMapping) {
+    Rc<AssetPackage> package = new AssetPackage(filename, useFileMapping, true);
+    if (!package->initialize()) {
+      throw DxvkError("Unable to mount the corrupted package");
+    }
+
+    // Queue background verification first, the blocking check must not report it in flight
+    const uint32_t blobIndices[] = { 0, 1, 2 };
+    package->prefetchBlobs(blobIndices, 3);
+
+    if (package->verifyBlobChecksum(1) != AssetPackage::BlobStatus::Corrupted) {
+      throw DxvkError("Corrupted blob passed verification");
+    }
+
+    if (package->verifyBlobChecksum(0) != AssetPackage::BlobStatus::Valid ||
+        package->verifyBlobChecksum(2) != AssetPackage::BlobStatus::Valid) {
+      throw DxvkError("Intact blob next to a corrupted one failed verification");
+    }
+
+    if (package->verifyBlobChecksum(3) != AssetPackage::BlobStatus::Corrupted) {
+      throw DxvkError("Out of range blob passed verification");
+    }
+
+    Rc<AssetPackage> unverifiedPackage = new AssetPackage(filename, useFileMapping, false);
+    if (!unverifiedPackage->initialize() ||
+        unverifiedPackage->verifyBlobChecksum(1) != AssetPackage::BlobStatus::Valid) {
+      throw DxvkError("Blob was verified with checksums disabled");
+    }
+  }
+
+  static void test_unverified(const string& filename) {
+    Rc<AssetPackage> package = new AssetPackage(filename, true, true);
+    if (!package->initialize()) {
+      throw DxvkError("Unable to mount a version 1 package");
+    }
+
+    if (package->verifyBlobChecksum(1) != AssetPackage::BlobStatus::Valid) {
+      throw DxvkError("Version 1 package blobs must be trusted as is");
+    }
+  }
+};
+
+int main() {
+  try {
+    AssetPackageTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
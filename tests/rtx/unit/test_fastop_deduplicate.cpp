@@ -0,0 +1,180 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "../../test_utils.h"
+#include "../../../src/util/util_fastops.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+#define TEST(ISA, bitwidth) \
+      {                                                                    \
+        uint32_t uniqueCount2;                                             \
+        {                                                                  \
+          std::cout << "Running: deduplicateSortIndices"#ISA"<uint"#bitwidth"_t> --> "; \
+          Timer time;                                                      \
+          uniqueCount2 = fast::deduplicateSortIndices##ISA((uint32_t) data.size(), data.data(), maxValue, unique2.data()); \
+        }                                                                  \
+        if (uniqueCount2 != uniqueCount || memcmp(unique.data(), unique2.data(), uniqueCount * sizeof(T)) != 0) \
+          throw dxvk::DxvkError("Unique indices not matching deduplicateSortIndices"#ISA"<uint"#bitwidth"_t>"); \
+      }                                                                    \
+
+#define TEST_CHECK(ISA, LEVEL, bitwidth) \
+      if (fast::getSimdSupportLevel() >= SIMD::LEVEL) {                   \
+        TEST(ISA, bitwidth);                                              \
+      } else {                                                            \
+        std::cout << #LEVEL" not supported by this processor" << std::endl; \
+      }                                                                   \
+
+namespace fast {
+
+  template<typename T>
+  extern uint32_t deduplicateSortIndices_slow(const uint32_t count, const T* data, const uint32_t maxValue, T* uniqueOut);
+  template<typename T>
+  extern uint32_t deduplicateSortIndices_SSE(const uint32_t count, const T* data, const uint32_t maxValue, T* uniqueOut);
+  extern uint32_t deduplicateSortIndices32_AVX2(const uint32_t count, const uint32_t* data, const uint32_t maxValue, uint32_t* uniqueOut);
+  template<typename T>
+  extern uint32_t deduplicateSortIndices_AVX512(const uint32_t count, const T* data, const uint32_t maxValue, T* uniqueOut);
+
+class DeduplicateTestApp {
+public:
+  static void run() { 
+    std::cout << std::endl << "Begin test (16-bit)" << std::endl;
+    test_correctness<uint16_t>();
+    test_smoke<uint16_t>(64 * 1024 * 7 + 3, 4096);
+    test_smoke<uint16_t>(64 * 1024 * 7 + 3, std::numeric_limits<uint16_t>::max());
+
+    std::cout << std::endl << "Begin test (32-bit)" << std::endl;
+    test_correctness<uint32_t>();
+    test_smoke<uint32_t>(64 * 1024 * 7 + 3, 4096);
+    test_smoke<uint32_t>(64 * 1024 * 7 + 3, 1024 * 1024);
+  }
+  
+private:
+  // The byte table approach used by the D3D9 geometry hashing before the bitset variant, kept as a baseline
+  template<typename T>
+  static uint32_t deduplicateSortIndices_reference(const std::vector<T>& data, const uint32_t maxValue, std::vector<T>& uniqueOut) {
+    const uint32_t indexRange = maxValue + 1;
+    uniqueOut.resize(indexRange, (T) 0);
+
+    for (uint32_t i = 0; i < data.size(); i++) {
+      uniqueOut[data[i]] = 1;
+    }
+
+    uint32_t uniqueCount = 0;
+    for (uint32_t i = 0; i < indexRange; i++) {
+      if (uniqueOut[i])
+        uniqueOut[uniqueCount++] = i;
+    }
+
+    uniqueOut.resize(uniqueCount);
+    return uniqueCount;
+  }
+
+  template<typename T>
+  static void test_correctness() {
+    const T data1[] = { 29, 1, 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 1, 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 1, 2, 3, 5, 7, 11, 13, 17, 19, 23, 0 };
+    const T expected1[] = { 0, 1, 2, 3, 5, 7, 11, 13, 17, 19, 23, 29 };
+
+    std::vector<T> unique(29 + 1 + fast::kDeduplicatePadding);
+    uint32_t uniqueCount = fast::deduplicateSortIndices<T>(sizeof(data1) / sizeof(data1[0]), data1, 29, unique.data());
+
+    if (uniqueCount != sizeof(expected1) / sizeof(expected1[0]) || memcmp(unique.data(), expected1, sizeof(expected1)) != 0)
+      throw dxvk::DxvkError("Unique indices not matching correctness check 1");
+
+    // Values straddling the bitset word and lane boundaries
+    const T data2[] = { 4095, 63, 64, 4095, 511, 512, 255, 256, 127, 128, 0, 64, 63 };
+    const T expected2[] = { 0, 63, 64, 127, 128, 255, 256, 511, 512, 4095 };
+
+    unique.resize(4095 + 1 + fast::kDeduplicatePadding);
+    uniqueCount = fast::deduplicateSortIndices<T>(sizeof(data2) / sizeof(data2[0]), data2, 4095, unique.data());
+
+    if (uniqueCount != sizeof(expected2) / sizeof(expected2[0]) || memcmp(unique.data(), expected2, sizeof(expected2)) != 0)
+      throw dxvk::DxvkError("Unique indices not matching correctness check 2");
+
+    std::cout << "Deduplicate fast ops successfully tested for correctness" << std::endl;
+  }
+
+  template<typename T>
+  static void test_smoke(const uint32_t count, const uint32_t maxValue) {
+    std::random_device rd;
+    std::mt19937 rng(rd());
+    std::uniform_int_distribution<uint32_t> uni(0, maxValue);
+
+    std::vector<T> data(count);
+    for (uint32_t i = 0; i < count; i++) {
+      data[i] = (T) uni(rng);
+    }
+    data[0] = (T) maxValue;
+
+    std::cout << "Running smoke check, number of indices: " << count << ", max index value: " << maxValue << std::endl;
+
+    std::vector<T> reference;
+    {
+      std::cout << "Running: deduplicateSortIndices_reference --> ";
+      Timer time;
+      deduplicateSortIndices_reference(data, maxValue, reference);
+    }
+
+    std::vector<T> unique(maxValue + 1 + fast::kDeduplicatePadding);
+    std::vector<T> unique2(maxValue + 1 + fast::kDeduplicatePadding);
+
+    uint32_t uniqueCount;
+    {
+      std::cout << "Running: deduplicateSortIndices_slow --> ";
+      Timer time;
+      uniqueCount = fast::deduplicateSortIndices_slow((uint32_t) data.size(), data.data(), maxValue, unique.data());
+    }
+
+    if (uniqueCount != reference.size() || memcmp(unique.data(), reference.data(), uniqueCount * sizeof(T)) != 0)
+      throw dxvk::DxvkError("Unique indices not matching reference");
+
+    if (std::is_same<T, uint16_t>::value) {
+      TEST(_SSE, 16);
+      TEST_CHECK(_AVX512, AVX512, 16);
+    } else {
+      TEST(_SSE, 32);
+      if constexpr (std::is_same<T, uint32_t>::value) {
+        TEST_CHECK(32_AVX2, AVX2, 32);
+      }
+      TEST_CHECK(_AVX512, AVX512, 32);
+    }
+
+    std::cout << "Deduplicate fast ops successfully smoke tested" << std::endl;
+  }
+};
+}
+
+int main() {
+  try {
+    fast::DeduplicateTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,209 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../../test_utils.h"
+#include "../../../src/util/util_fastops.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+namespace fast {
+
+class GatherTestApp {
+public:
+  static void run() {
+    std::cout << std::endl << "Begin correctness test" << std::endl;
+    test_correctness(4, 4, 16);
+    test_correctness(8, 8, 20);
+    test_correctness(12, 12, 32);
+    test_correctness(16, 16, 16);
+    test_correctness(8, 12, 40);   // partial element copy
+    test_correctness(36, 40, 48);  // no fixed size copy
+    test_correctness(6, 6, 10);    // not dword sized
+
+    std::cout << std::endl << "Begin synthetic mesh benchmark" << std::endl;
+    test_synthetic_mesh(512);
+    test_synthetic_mesh(1024);
+  }
+
+private:
+  static void gatherStrided_reference(uint8_t* dst, const size_t dstStride, const uint8_t* src, const size_t srcStride, const size_t elementSize, const uint32_t* indices, const uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+      for (size_t b = 0; b < elementSize; b++) {
+        dst[i * dstStride + b] = src[indices[i] * srcStride + b];
+      }
+    }
+  }
+
+  static void test_correctness(const size_t elementSize, const size_t srcStride, const size_t dstStride) {
+    std::mt19937 rng(1234);
+
+    // Odd counts to exercise the remainder loops
+    const uint32_t srcCount = 1021;
+    const uint32_t count = 8 * 97 + 5;
+
+    std::vector<uint8_t> src(srcCount * srcStride);
+    for (uint8_t& b : src) {
+      b = (uint8_t) rng();
+    }
+
+    std::uniform_int_distribution<uint32_t> uni(0, srcCount - 1);
+    std::vector<uint32_t> indices(count);
+    for (uint32_t& i : indices) {
+      i = uni(rng);
+    }
+    indices[0] = srcCount - 1;
+
+    // Pre-fill so bytes between elements must be left untouched
+    std::vector<uint8_t> reference(count * dstStride, 0xCD);
+    gatherStrided_reference(reference.data(), dstStride, src.data(), srcStride, elementSize, indices.data(), count);
+
+    std::vector<uint8_t> dst(count * dstStride, 0xCD);
+    gatherStrided(dst.data(), dstStride, src.data(), srcStride, srcCount, elementSize, indices.data(), count);
+    if (dst != reference) {
+      throw dxvk::DxvkError("gatherStrided not matching reference");
+    }
+
+    std::cout << "Gather fast ops successfully tested, element size: " << elementSize << ", src stride: " << srcStride << ", dst stride: " << dstStride << std::endl;
+  }
+
+  // Mimics the per corner virtual sampling the USD mesh importer did before bulk expansion
+  class CornerSampler {
+  public:
+    virtual ~CornerSampler() = default;
+    virtual bool SampleBuffer(int index, void* value) const = 0;
+  };
+
+  class IndexedCornerSampler : public CornerSampler {
+  public:
+    IndexedCornerSampler(const std::vector<uint8_t>& data, const std::vector<uint32_t>& indices, size_t elementSize)
+      : m_data(data), m_indices(indices), m_elementSize(elementSize) { }
+
+    bool SampleBuffer(int index, void* value) const override {
+      const size_t element = m_indices[index];
+      if (element * m_elementSize >= m_data.size())
+        return false;
+      memcpy(value, &m_data[element * m_elementSize], m_elementSize);
+      return true;
+    }
+
+  private:
+    const std::vector<uint8_t>& m_data;
+    const std::vector<uint32_t>& m_indices;
+    size_t m_elementSize;
+  };
+
+  // Triangulated N x N quad grid: positions and normals are per point, texcoords are face-varying
+  static void test_synthetic_mesh(const uint32_t gridSize) {
+    const uint32_t numPoints = (gridSize + 1) * (gridSize + 1);
+    const uint32_t numCorners = gridSize * gridSize * 6;
+
+    std::vector<uint32_t> pointIndices;
+    pointIndices.reserve(numCorners);
+    for (uint32_t y = 0; y < gridSize; y++) {
+      for (uint32_t x = 0; x < gridSize; x++) {
+        const uint32_t p = y * (gridSize + 1) + x;
+        const uint32_t quad[6] = { p, p + 1, p + gridSize + 2, p, p + gridSize + 2, p + gridSize + 1 };
+        pointIndices.insert(pointIndices.end(), quad, quad + 6);
+      }
+    }
+
+    std::vector<uint32_t> cornerIndices(numCorners);
+    for (uint32_t i = 0; i < numCorners; i++) {
+      cornerIndices[i] = i;
+    }
+
+    std::mt19937 rng(5678);
+    auto randomBuffer = [&](size_t size) {
+      std::vector<uint8_t> buffer(size);
+      for (uint8_t& b : buffer) {
+        b = (uint8_t) rng();
+      }
+      return buffer;
+    };
+    const std::vector<uint8_t> positions = randomBuffer(numPoints * 12);
+    const std::vector<uint8_t> normals = randomBuffer(numPoints * 12);
+    const std::vector<uint8_t> texcoords = randomBuffer(numCorners * 8);
+
+    struct Stream {
+      const std::vector<uint8_t>& data;
+      const std::vector<uint32_t>& indices;
+      uint32_t srcCount;
+      size_t elementSize;
+      size_t offset;
+    };
+    const Stream streams[] = {
+      { positions, pointIndices, numPoints, 12, 0 },
+      { normals, pointIndices, numPoints, 12, 12 },
+      { texcoords, cornerIndices, numCorners, 8, 24 },
+    };
+    const size_t vertexStride = 32;
+
+    std::cout << "Running synthetic mesh, triangles: " << numCorners / 3 << ", corners: " << numCorners << std::endl;
+
+    std::vector<uint8_t> reference(numCorners * vertexStride);
+    {
+      std::vector<std::unique_ptr<CornerSampler>> samplers;
+      for (const Stream& s : streams) {
+        samplers.emplace_back(new IndexedCornerSampler(s.data, s.indices, s.elementSize));
+      }
+
+      std::cout << "Running: per corner virtual sampling --> ";
+      Timer time;
+      for (uint32_t i = 0; i < numCorners; i++) {
+        for (uint32_t s = 0; s < samplers.size(); s++) {
+          samplers[s]->SampleBuffer(i, &reference[i * vertexStride + streams[s].offset]);
+        }
+      }
+    }
+
+    std::vector<uint8_t> vertices(numCorners * vertexStride);
+    {
+      std::cout << "Running: gatherStrided --> ";
+      Timer time;
+      for (const Stream& s : streams) {
+        gatherStrided(&vertices[s.offset], vertexStride, s.data.data(), s.elementSize, s.srcCount, s.elementSize, s.indices.data(), numCorners);
+      }
+    }
+    if (vertices != reference) {
+      throw dxvk::DxvkError("gatherStrided not matching per corner sampling");
+    }
+
+    std::cout << "Gather fast ops successfully benchmarked" << std::endl;
+  }
+};
+}
+
+int main() {
+  try {
+    fast::GatherTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
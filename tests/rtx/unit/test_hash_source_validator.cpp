@@ -0,0 +1,256 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_hash_source_validator.h"
+
+using namespace dxvk;
+using namespace std;
+
+using Writer = HashSourceDataValidator::SourceDataWriter;
+
+// All hashes below share the top bits and so land in the same shard
+static XXH64_hash_t makeHash(uint32_t i) {
+  return 0x0000100000000000ull + i;
+}
+
+static bool submit(HashSourceDataValidator& validator, XXH64_hash_t hash, const vector<uint8_t>& data) {
+  return validator.submit(hash, data.size(), HashSourceDataCategory::GeometryIndices, [&data](Writer& writer) {
+    writer.write(data.data(), data.size());
+  });
+}
+
+static vector<uint8_t> makeData(size_t size, uint8_t seed) {
+  vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<uint8_t>(seed + i * 7);
+  }
+  return data;
+}
+
+class HashSourceValidatorTestApp {
+public:
+  static void run() {
+    cout << "Begin concurrent submission test" << endl;
+    test_concurrent_submission();
+    cout << "Begin fingerprint test" << endl;
+    test_fingerprint();
+    cout << "Begin LRU eviction test" << endl;
+    test_lru_eviction();
+    cout << "Begin budget test" << endl;
+    test_budget();
+    cout << "Begin background thread test" << endl;
+    test_background_thread();
+    cout << "HashSourceDataValidator successfully tested" << endl;
+  }
+
+private:
+  static void test_concurrent_submission() {
+    HashSourceDataValidator validator(64 << 20);
+
+    constexpr uint32_t kThreads = 4;
+    constexpr uint32_t kPerThread = 1000;
+
+    // Threads submit disjoint hashes, except for hash 0 which all of them submit with different data
+    vector<std::thread> threads;
+    for (uint32_t t = 0; t < kThreads; t++) {
+      threads.emplace_back([&validator, t] {
+        for (uint32_t i = 1; i <= kPerThread; i++) {
+          submit(validator, makeHash(t * kPerThread + i), makeData(32, static_cast<uint8_t>(i)));
+        }
+        submit(validator, makeHash(0), makeData(32, static_cast<uint8_t>(100 + t)));
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    validator.processSubmissions();
+
+    HashSourceDataValidator::Stats stats = validator.getStats();
+    if (stats.submitted != kThreads * (kPerThread + 1) || stats.validated != stats.submitted || stats.dropped != 0) {
+      throw DxvkError("Submissions were lost in the submission list");
+    }
+    if (stats.collisions != kThreads - 1) {
+      throw DxvkError("Mismatching source data for one hash was not detected");
+    }
+    if (stats.pendingBytes != 0) {
+      throw DxvkError("Validated submissions were still accounted as pending");
+    }
+
+    // Matching source data for known hashes is no collision
+    for (uint32_t i = 1; i <= kPerThread; i++) {
+      submit(validator, makeHash(i), makeData(32, static_cast<uint8_t>(i)));
+    }
+    validator.processSubmissions();
+
+    if (validator.getStats().collisions != kThreads - 1) {
+      throw DxvkError("Matching source data was reported as a collision");
+    }
+  }
+
+  static void test_fingerprint() {
+    HashSourceDataValidator validator(64 << 20);
+
+    const vector<uint8_t> data = makeData(HashSourceDataValidator::kMaxStoredSourceDataSize * 4, 1);
+    submit(validator, makeHash(1), data);
+
+    // Only the fingerprint is queued for large sources
+    if (validator.getStats().pendingBytes >= HashSourceDataValidator::kMaxStoredSourceDataSize) {
+      throw DxvkError("Large source data was queued in full");
+    }
+
+    // The same data written in pieces matches
+    validator.submit(makeHash(1), data.size(), HashSourceDataCategory::GeometryIndices, [&data](Writer& writer) {
+      for (size_t offset = 0; offset < data.size(); offset += 12) {
+        writer.write(data.data() + offset, std::min<size_t>(12, data.size() - offset));
+      }
+    });
+    validator.processSubmissions();
+
+    if (validator.getStats().collisions != 0) {
+      throw DxvkError("Fingerprint of source data written in pieces did not match");
+    }
+
+    vector<uint8_t> changed = data;
+    changed[changed.size() / 2] ^= 1;
+    submit(validator, makeHash(1), changed);
+    validator.processSubmissions();
+
+    if (validator.getStats().collisions != 1) {
+      throw DxvkError("Fingerprint did not catch a single changed byte");
+    }
+  }
+
+  static void test_lru_eviction() {
+    // Sized so each shard caches exactly two 64 byte sources
+    constexpr size_t kSourceSize = 64;
+    constexpr size_t kEntryCost = kSourceSize + HashSourceDataValidator::kEntryOverhead;
+    constexpr size_t kBudget = (kEntryCost * 2 * HashSourceDataValidator::kNumShards + 2) / 3 * 4;
+    HashSourceDataValidator validator(kBudget);
+
+    submit(validator, makeHash(1), makeData(kSourceSize, 1));
+    submit(validator, makeHash(2), makeData(kSourceSize, 2));
+    // Seeing hash 1 again makes hash 2 the least recently seen
+    submit(validator, makeHash(1), makeData(kSourceSize, 1));
+    submit(validator, makeHash(3), makeData(kSourceSize, 3));
+    validator.processSubmissions();
+
+    HashSourceDataValidator::Stats stats = validator.getStats();
+    if (stats.evicted != 1 || stats.cachedBytes != kEntryCost * 2) {
+      throw DxvkError("Cache was not bounded by its share of the budget");
+    }
+
+    // Hash 2 was evicted, so it is cached anew rather than compared
+    submit(validator, makeHash(2), makeData(kSourceSize, 4));
+    validator.processSubmissions();
+
+    if (validator.getStats().collisions != 0) {
+      throw DxvkError("Least recently seen hash was not the one evicted");
+    }
+
+    // That evicted hash 1, leaving hash 3 to be compared
+    submit(validator, makeHash(3), makeData(kSourceSize, 5));
+    validator.processSubmissions();
+
+    if (validator.getStats().collisions != 1) {
+      throw DxvkError("Recently seen hash was evicted");
+    }
+  }
+
+  static uint32_t fillPending(HashSourceDataValidator& validator, uint32_t firstHash) {
+    uint32_t count = 0;
+    while (submit(validator, makeHash(firstHash + count), makeData(64, 0))) {
+      count++;
+    }
+    return count;
+  }
+
+  static void test_budget() {
+    constexpr size_t kBudget = 64 << 10;
+    HashSourceDataValidator validator(kBudget);
+
+    // Submissions which do not fit in the budget are dropped
+    const uint32_t queued = fillPending(validator, 0);
+
+    HashSourceDataValidator::Stats stats = validator.getStats();
+    if (queued == 0 || stats.dropped != 1 || stats.pendingBytes > kBudget) {
+      throw DxvkError("Pending submissions were not bounded by the budget");
+    }
+
+    validator.processSubmissions();
+    stats = validator.getStats();
+    if (stats.validated != queued || stats.pendingBytes != 0 || stats.cachedBytes == 0) {
+      throw DxvkError("Queued submissions were not validated");
+    }
+
+    // Cached source data takes from the same budget
+    const uint32_t queuedWithCache = fillPending(validator, queued);
+    if (queuedWithCache >= queued || validator.getStats().pendingBytes + validator.getStats().cachedBytes > kBudget) {
+      throw DxvkError("Pending and cached source data did not share the budget");
+    }
+
+    // The cache leaves room for submissions even when full
+    validator.processSubmissions();
+    fillPending(validator, queued + queuedWithCache);
+    validator.processSubmissions();
+    if (fillPending(validator, 2 * (queued + queuedWithCache)) == 0) {
+      throw DxvkError("The cache took the entire budget");
+    }
+  }
+
+  static void test_background_thread() {
+    HashSourceDataValidator validator(64 << 20);
+    validator.start();
+
+    for (uint32_t i = 0; i < 1000; i++) {
+      submit(validator, makeHash(i), makeData(32, static_cast<uint8_t>(i)));
+    }
+
+    // Stopping joins the thread and discards whatever is still pending
+    validator.stop();
+
+    HashSourceDataValidator::Stats stats = validator.getStats();
+    if (stats.pendingBytes != 0 || stats.validated > stats.submitted) {
+      throw DxvkError("Pending submissions were leaked on stop");
+    }
+
+    // A stopped validator can be restarted
+    validator.start();
+    validator.stop();
+  }
+};
+
+int main() {
+  try {
+    HashSourceValidatorTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
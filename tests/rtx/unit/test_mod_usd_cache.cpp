@@ -0,0 +1,379 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_mod_usd_cache_file.h"
+
+using namespace dxvk;
+using namespace dxvk::CompiledModCache;
+using namespace std;
+
+class ModUsdCacheTestApp {
+public:
+  static void run() {
+    const filesystem::path dir = filesystem::temp_directory_path() / "dxvk_test_mod_usd_cache";
+    filesystem::remove_all(dir);
+    filesystem::create_directories(dir);
+
+    cout << "Begin round trip test" << endl;
+    test_round_trip(dir);
+    cout << "Begin version test" << endl;
+    test_version(dir);
+    cout << "Begin dependency test" << endl;
+    test_dependencies(dir);
+    cout << "Begin corruption test" << endl;
+    test_corruption(dir);
+    cout << "Begin geometry validation test" << endl;
+    test_geometry_validation();
+
+    filesystem::remove_all(dir);
+
+    cout << "Compiled mod cache successfully tested" << endl;
+  }
+
+private:
+  static constexpr uint32_t kVersion = 3;
+  static constexpr XXH64_hash_t kLayoutHash = 0x1234567890abcdefull;
+
+  // Each section holds as many strings as its count says
+  static const vector<vector<string>>& sectionContents() {
+    static const vector<vector<string>> contents = {
+      { "vertices", string(1000, 'v') },
+      { },
+      { "material", "", "textures/albedo.dds" },
+    };
+    return contents;
+  }
+
+  static void writeText(const filesystem::path& path, const string& text) {
+    ofstream file(path, ios::binary | ios::trunc);
+    file << text;
+  }
+
+  static vector<uint8_t> readFile(const filesystem::path& path) {
+    ifstream file(path, ios::binary);
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  }
+
+  static void writeFileBytes(const filesystem::path& path, const uint8_t* data, size_t size) {
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char*>(data), size);
+  }
+
+  static Manifest makeManifest(const filesystem::path& dir) {
+    writeText(dir / "mod.usda", "#usda 1.0\n");
+    writeText(dir / "sublayer.usda", "#usda 1.0\n(\n)\n");
+
+    Manifest manifest;
+    for (const char* layer : { "mod.usda", "sublayer.usda", "missing.usda" }) {
+      Dependency& dependency = manifest.dependencies.emplace_back();
+      if (!captureDependency(dir / layer, dependency)) {
+        throw DxvkError("Unable to capture a layer");
+      }
+    }
+
+    if (!manifest.dependencies[0].exists || manifest.dependencies[2].exists) {
+      throw DxvkError("Layer existence was not captured");
+    }
+
+    manifest.status = "Processed";
+    manifest.searchPaths = { { 0, "textures" }, { 2, "../shared" } };
+    manifest.variantCounts = { { 0xabcull, 3 }, { 0xdefull, 1 } };
+    return manifest;
+  }
+
+  static bool writeCache(const filesystem::path& path, uint32_t version, const Manifest& manifest) {
+    vector<vector<uint8_t>> data;
+    for (const vector<string>& strings : sectionContents()) {
+      vector<uint8_t>& bytes = data.emplace_back();
+      for (const string& str : strings) {
+        writeString(bytes, str);
+      }
+    }
+
+    vector<Section> sections;
+    for (size_t i = 0; i < data.size(); i++) {
+      sections.push_back({ static_cast<uint32_t>(sectionContents()[i].size()), &data[i] });
+    }
+
+    return writeFile(path, version, kLayoutHash, manifest, sections);
+  }
+
+  // Reads the sections the same way the cache reader does, returns false on any inconsistency
+  static bool readSections(const MappedFile& file, vector<vector<string>>& contents) {
+    BlobReader reader = file.getPayload();
+
+    contents.clear();
+    for (size_t i = 0; i < sectionContents().size() && !reader.failed(); i++) {
+      vector<string>& strings = contents.emplace_back();
+      const uint32_t count = reader.read<uint32_t>();
+      for (uint32_t n = 0; n < count && !reader.failed(); n++) {
+        strings.push_back(reader.readString());
+      }
+    }
+
+    return !reader.failed() && reader.read<uint32_t>() == kEndMagic;
+  }
+
+  static void test_round_trip(const filesystem::path& dir) {
+    const Manifest manifest = makeManifest(dir);
+    const filesystem::path path = dir / "mod.usda.rtxmodcache";
+
+    if (!writeCache(path, kVersion, manifest)) {
+      throw DxvkError("Unable to write the cache");
+    }
+
+    if (filesystem::exists(dir / "mod.usda.rtxmodcache.tmp")) {
+      throw DxvkError("Temporary file was left behind");
+    }
+
+    MappedFile file;
+    if (!file.open(path, kVersion, kLayoutHash)) {
+      throw DxvkError("Unable to open the written cache");
+    }
+
+    const Manifest& read = file.getManifest();
+    if (read.dependencies.size() != manifest.dependencies.size()) {
+      throw DxvkError("Dependencies were not round tripped");
+    }
+
+    for (size_t i = 0; i < manifest.dependencies.size(); i++) {
+      const Dependency& a = manifest.dependencies[i];
+      const Dependency& b = read.dependencies[i];
+      if (a.path != b.path || a.exists != b.exists || a.size != b.size ||
+          a.modificationTime != b.modificationTime || a.contentHash != b.contentHash) {
+        throw DxvkError("Dependency was not round tripped");
+      }
+    }
+
+    if (read.status != manifest.status || read.searchPaths != manifest.searchPaths ||
+        read.variantCounts != manifest.variantCounts) {
+      throw DxvkError("Manifest was not round tripped");
+    }
+
+    vector<vector<string>> contents;
+    if (!readSections(file, contents) || contents != sectionContents()) {
+      throw DxvkError("Sections were not round tripped");
+    }
+
+    file.close();
+    if (file.isOpen() || file.getPayload().read<uint32_t>() != 0) {
+      throw DxvkError("Closed cache still hands out data");
+    }
+  }
+
+  static void test_version(const filesystem::path& dir) {
+    const filesystem::path path = dir / "mod.usda.rtxmodcache";
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+
+    MappedFile file;
+    if (file.open(path, kVersion + 1, kLayoutHash) || file.isOpen()) {
+      throw DxvkError("Cache of a different version was accepted");
+    }
+
+    if (file.open(path, kVersion, kLayoutHash + 1)) {
+      throw DxvkError("Cache of a different layout was accepted");
+    }
+
+    if (file.open(dir / "nonexistent.rtxmodcache", kVersion, kLayoutHash)) {
+      throw DxvkError("Missing cache was accepted");
+    }
+  }
+
+  static void test_dependencies(const filesystem::path& dir) {
+    const filesystem::path path = dir / "mod.usda.rtxmodcache";
+    MappedFile file;
+
+    // Touched but unchanged layers match by content
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+    filesystem::last_write_time(dir / "sublayer.usda", filesystem::last_write_time(dir / "sublayer.usda") + chrono::hours(1));
+    if (!file.open(path, kVersion, kLayoutHash)) {
+      throw DxvkError("Touched layer invalidated the cache");
+    }
+
+    // Same size, different content
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+    writeText(dir / "sublayer.usda", "#usda 1.0\n[\n]\n");
+    filesystem::last_write_time(dir / "sublayer.usda", filesystem::last_write_time(dir / "sublayer.usda") + chrono::hours(1));
+    if (file.open(path, kVersion, kLayoutHash)) {
+      throw DxvkError("Changed layer did not invalidate the cache");
+    }
+
+    // Different size
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+    writeText(dir / "mod.usda", "#usda 1.0\ndef Xform \"World\" {}\n");
+    if (file.open(path, kVersion, kLayoutHash)) {
+      throw DxvkError("Resized layer did not invalidate the cache");
+    }
+
+    // A layer which was missing showing up
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+    writeText(dir / "missing.usda", "#usda 1.0\n");
+    if (file.open(path, kVersion, kLayoutHash)) {
+      throw DxvkError("Added layer did not invalidate the cache");
+    }
+    filesystem::remove(dir / "missing.usda");
+
+    // A layer going missing
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+    filesystem::remove(dir / "sublayer.usda");
+    if (file.open(path, kVersion, kLayoutHash)) {
+      throw DxvkError("Removed layer did not invalidate the cache");
+    }
+  }
+
+  static void test_corruption(const filesystem::path& dir) {
+    const filesystem::path path = dir / "mod.usda.rtxmodcache";
+    const filesystem::path corruptPath = dir / "corrupt.rtxmodcache";
+
+    if (!writeCache(path, kVersion, makeManifest(dir))) {
+      throw DxvkError("Unable to write the cache");
+    }
+    const vector<uint8_t> bytes = readFile(path);
+
+    // Every truncation must be caught, either by open() or while reading the sections
+    for (size_t size = 0; size < bytes.size(); size++) {
+      writeFileBytes(corruptPath, bytes.data(), size);
+
+      MappedFile file;
+      vector<vector<string>> contents;
+      if (file.open(corruptPath, kVersion, kLayoutHash) && readSections(file, contents)) {
+        throw DxvkError("Truncated cache was accepted");
+      }
+    }
+
+    // Flipping any byte must never read out of bounds, and must be caught unless it only
+    // changed the contents of a string or a recorded value which is not checked
+    vector<uint8_t> corrupted = bytes;
+    for (size_t offset = 0; offset < bytes.size(); offset++) {
+      corrupted[offset] ^= 0xA5;
+      writeFileBytes(corruptPath, corrupted.data(), corrupted.size());
+      corrupted[offset] = bytes[offset];
+
+      MappedFile file;
+      vector<vector<string>> contents;
+      if (offset < sizeof(FileHeader) && file.open(corruptPath, kVersion, kLayoutHash)) {
+        throw DxvkError("Cache with a corrupted header was accepted");
+      }
+
+      if (file.open(corruptPath, kVersion, kLayoutHash)) {
+        readSections(file, contents);
+      }
+    }
+
+    // Garbage in place of the counts
+    const size_t payloadOffset = bytes.size() - sizeof(kEndMagic) - [] {
+      size_t size = 0;
+      for (const vector<string>& strings : sectionContents()) {
+        size += sizeof(uint32_t);
+        for (const string& str : strings) {
+          size += sizeof(uint32_t) + str.size();
+        }
+      }
+      return size;
+    }();
+
+    corrupted = bytes;
+    const uint32_t hugeCount = 0xfffffff0u;
+    memcpy(corrupted.data() + payloadOffset, &hugeCount, sizeof(hugeCount));
+    writeFileBytes(corruptPath, corrupted.data(), corrupted.size());
+
+    MappedFile file;
+    vector<vector<string>> contents;
+    if (!file.open(corruptPath, kVersion, kLayoutHash) || readSections(file, contents)) {
+      throw DxvkError("Cache with a corrupted section count was accepted");
+    }
+  }
+
+  static void test_geometry_validation() {
+    CachedGeometry geometry {};
+    geometry.vertexCount = 4;
+    geometry.indexCount = 6;
+    geometry.attributes[0] = { 0, 32, 0 };
+    geometry.attributes[2] = { 12, 32, 0 };
+
+    const uint32_t indices[] = { 0, 1, 2, 2, 1, 3 };
+    const uint64_t vertexDataSize = 4 * 32;
+
+    if (!isValidGeometry(geometry, indices, vertexDataSize)) {
+      throw DxvkError("Valid geometry was rejected");
+    }
+
+    if (isValidGeometry(geometry, indices, vertexDataSize - 1)) {
+      throw DxvkError("Geometry exceeding its vertex data was accepted");
+    }
+
+    const uint32_t outOfRange[] = { 0, 1, 2, 2, 1, 4 };
+    if (isValidGeometry(geometry, outOfRange, vertexDataSize)) {
+      throw DxvkError("Geometry with an out of range index was accepted");
+    }
+
+    CachedGeometry badOffset = geometry;
+    badOffset.attributes[2].offset = 32;
+    if (isValidGeometry(badOffset, indices, vertexDataSize)) {
+      throw DxvkError("Attribute outside of its vertex was accepted");
+    }
+
+    CachedGeometry noPositions = geometry;
+    noPositions.attributes[0].stride = 0;
+    if (isValidGeometry(noPositions, indices, vertexDataSize)) {
+      throw DxvkError("Geometry without positions was accepted");
+    }
+
+    CachedGeometry hugeVertexCount = geometry;
+    hugeVertexCount.vertexCount = 0xffffffffu;
+    if (isValidGeometry(hugeVertexCount, indices, vertexDataSize)) {
+      throw DxvkError("Geometry with a corrupted vertex count was accepted");
+    }
+  }
+};
+
+int main() {
+  try {
+    ModUsdCacheTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
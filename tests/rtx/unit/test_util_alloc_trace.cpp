@@ -0,0 +1,252 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_alloc_trace.h"
+#include "../../../src/util/util_string.h"
+
+using namespace dxvk;
+using namespace std;
+
+// Replays allocation traces recorded with dxvk.memoryTracePath (or DXVK_MEMORY_TRACE_PATH).
+// Without arguments, this tests recording and replay with a synthetic trace.  Pass trace files
+// on the command line to replay them instead:
+//
+//   util_alloc_trace.exe capture1.dmtr capture2.dmtr
+class AllocTraceTestApp {
+public:
+  static void run() {
+    cout << "Begin allocation trace round trip test" << endl;
+    test_round_trip();
+    cout << "Begin allocation trace replay benchmark" << endl;
+    const AllocTraceHeader header = makeHeader();
+    report("synthetic", AllocTraceReplayer(header).replay(generateTrace(300, 7)));
+    cout << "Allocation trace successfully tested" << endl;
+  }
+
+  static void replayFile(const char* path) {
+    AllocTraceHeader header;
+    vector<AllocTraceRecord> records;
+
+    if (!readAllocTrace(path, header, records)) {
+      throw DxvkError(str::format("Failed to read allocation trace ", path));
+    }
+
+    report(path, AllocTraceReplayer(header).replay(records));
+  }
+
+private:
+  // Device local and host visible memory types with the default chunk sizes
+  static AllocTraceHeader makeHeader() {
+    AllocTraceHeader header;
+    header.memoryTypeCount = 2;
+    header.chunkSizes[0] = 320ull << 20;
+    header.chunkSizes[1] = 128ull << 20;
+    return header;
+  }
+
+  // A level load followed by gameplay: long lived textures and buffers come in early, while every
+  // frame allocates and frees staging and per-frame buffers.  Every 100 frames, the chunks which
+  // emptied out get trimmed.
+  static vector<AllocTraceRecord> generateTrace(const uint32_t numFrames, const uint32_t seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> log2SizeDist(8.0, 22.0);
+    uniform_real_distribution<float> unitDist(0.f, 1.f);
+
+    vector<AllocTraceRecord> records;
+    vector<AllocTraceRecord> live;
+    uint32_t nextId = 0;
+
+    auto alloc = [&](const uint32_t frame, const bool transient) {
+      AllocTraceRecord record;
+      record.op = AllocTraceRecord::Op::Alloc;
+      record.id = nextId++;
+      record.frameId = frame;
+      record.size = static_cast<uint64_t>(exp2(log2SizeDist(rng)));
+      record.memoryType = transient ? 1 : 0;
+      record.category = transient ? 3 : 2;
+      record.alignmentLog2 = unitDist(rng) < 0.5f ? 8 : unitDist(rng) < 0.6f ? 12 : 16;
+      record.flags = unitDist(rng) < 0.02f ? AllocTraceRecord::kFlagDedicated : 0;
+      records.push_back(record);
+
+      if (transient) {
+        live.push_back(record);
+      } else {
+        live.insert(live.begin(), record);
+      }
+    };
+
+    auto free = [&](const uint32_t frame, const size_t i) {
+      AllocTraceRecord record = live[i];
+      record.op = AllocTraceRecord::Op::Free;
+      record.frameId = frame;
+      record.alignmentLog2 = 0;
+      record.flags = 0;
+      records.push_back(record);
+
+      live[i] = live.back();
+      live.pop_back();
+    };
+
+    for (uint32_t frame = 0; frame < numFrames; frame++) {
+      const uint32_t numPersistent = frame < 10 ? 200 : rng() % 4;
+
+      for (uint32_t i = 0; i < numPersistent; i++) {
+        alloc(frame, false);
+      }
+
+      for (uint32_t i = 0; i < 50; i++) {
+        alloc(frame, true);
+      }
+
+      // Free the transient allocations at the back, along with a persistent one now and then
+      while (live.size() > 2000 + frame) {
+        free(frame, live.size() - 1 - min<size_t>(rng() % 64, live.size() - 1));
+      }
+
+      if (frame % 100 == 99) {
+        AllocTraceRecord record;
+        record.op = AllocTraceRecord::Op::TrimChunks;
+        record.frameId = frame;
+        records.push_back(record);
+      }
+    }
+
+    return records;
+  }
+
+  static void test_round_trip() {
+    const AllocTraceHeader header = makeHeader();
+    const vector<AllocTraceRecord> records = generateTrace(50, 3);
+    const string path = (filesystem::temp_directory_path() / "dxvk_test_alloc_trace.dmtr").string();
+
+    {
+      AllocTraceWriter writer;
+      if (!writer.open(path, header)) {
+        throw DxvkError("Failed to open the trace for writing");
+      }
+
+      for (const auto& record : records) {
+        writer.write(record);
+      }
+    }
+
+    AllocTraceHeader readHeader;
+    vector<AllocTraceRecord> readRecords;
+    if (!readAllocTrace(path, readHeader, readRecords)) {
+      throw DxvkError("Failed to read the trace back");
+    }
+    if (memcmp(&header, &readHeader, sizeof(header)) != 0) {
+      throw DxvkError("Header mismatch");
+    }
+    if (!(readRecords.size() == records.size() && memcmp(records.data(), readRecords.data(), records.size() * sizeof(AllocTraceRecord)) == 0)) {
+      throw DxvkError("Record mismatch");
+    }
+
+    // A trace cut off mid record, e.g. by a crash, is read up to its last complete record
+    filesystem::resize_file(path, sizeof(AllocTraceHeader) + 10 * sizeof(AllocTraceRecord) + 5);
+    if (!(readAllocTrace(path, readHeader, readRecords) && readRecords.size() == 10)) {
+      throw DxvkError("Truncated trace was not read");
+    }
+
+    // Anything else is rejected
+    filesystem::resize_file(path, 8);
+    if (readAllocTrace(path, readHeader, readRecords)) {
+      throw DxvkError("Accepted a trace without a header");
+    }
+    filesystem::remove(path);
+    if (readAllocTrace(path, readHeader, readRecords)) {
+      throw DxvkError("Accepted a missing trace");
+    }
+
+    // Replay sees every alloc and free, and ends up with nothing but the chunks still allocated
+    uint32_t numAllocs = 0;
+    uint32_t numFrees = 0;
+    for (const auto& record : records) {
+      numAllocs += record.op == AllocTraceRecord::Op::Alloc;
+      numFrees += record.op == AllocTraceRecord::Op::Free;
+    }
+
+    const AllocTraceReplayStats stats = AllocTraceReplayer(header).replay(records);
+    if (!(stats.numAllocs == numAllocs && stats.numFrees == numFrees)) {
+      throw DxvkError("Replay op count mismatch");
+    }
+    if (stats.numUnmatchedFrees != 0) {
+      throw DxvkError("Replay failed to match frees to allocations");
+    }
+    if (stats.numFrames != 50) {
+      throw DxvkError("Replay frame count mismatch");
+    }
+    if (!(stats.peakUsed != 0 && stats.peakUsed <= stats.peakAllocated)) {
+      throw DxvkError("Replay usage out of range");
+    }
+    if (stats.peakChunkCount == 0) {
+      throw DxvkError("Replay did not create any chunks");
+    }
+
+    // A free without its allocation, e.g. from a trace started mid session, is counted and skipped
+    vector<AllocTraceRecord> orphan(1);
+    orphan[0].op = AllocTraceRecord::Op::Free;
+    orphan[0].id = 1234;
+    orphan[0].size = 256;
+    if (AllocTraceReplayer(header).replay(orphan).numUnmatchedFrees != 1) {
+      throw DxvkError("Orphaned free was not detected");
+    }
+  }
+
+  static void report(const string& name, const AllocTraceReplayStats& stats) {
+    cout << name << ": " << stats.numAllocs << " allocs, " << stats.numFrees << " frees over "
+         << stats.numFrames << " frames, " << stats.nsPerOp << " ns per op" << endl
+         << "  peak used " << (stats.peakUsed >> 20) << " MB, peak allocated " << (stats.peakAllocated >> 20)
+         << " MB in up to " << stats.peakChunkCount << " chunks" << endl
+         << "  fragmentation " << 100.0 * stats.avgFragmentation << "% average, "
+         << 100.0 * stats.maxFragmentation << "% peak" << endl;
+
+    if (stats.numUnmatchedFrees != 0) {
+      cout << "  " << stats.numUnmatchedFrees << " frees without a recorded allocation" << endl;
+    }
+  }
+};
+
+int main(int argc, char** argv) {
+  try {
+    if (argc > 1) {
+      for (int i = 1; i < argc; i++) {
+        AllocTraceTestApp::replayFile(argv[i]);
+      }
+    } else {
+      AllocTraceTestApp::run();
+    }
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,304 @@
+/*
+* Copyright (c) 2021-2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_concurrent_cache.h"
+#include "../../../src/util/util_fast_cache.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+namespace {
+  // Stand-in for a replacement, large enough that a torn read would show
+  struct Value {
+    XXH64_hash_t key;
+    uint64_t payload[7];
+
+    explicit Value(const XXH64_hash_t k) : key(k) {
+      for (uint64_t& p : payload) {
+        p = k * 3;
+      }
+    }
+
+    bool isConsistent(const XXH64_hash_t k) const {
+      return key == k && std::all_of(std::begin(payload), std::end(payload), [k](uint64_t p) { return p == k * 3; });
+    }
+  };
+
+  XXH64_hash_t makeKey(const uint64_t i) {
+    return XXH3_64bits(&i, sizeof(i));
+  }
+
+  // What AssetReplacements used before: one spinlock around a fast_unordered_cache
+  class LockedCache {
+  public:
+    Value* find(const XXH64_hash_t key) {
+      std::lock_guard<sync::Spinlock> lock(m_spinlock);
+      auto it = m_cache.find(key);
+      return it != m_cache.end() ? &it->second : nullptr;
+    }
+
+    void try_emplace(const XXH64_hash_t key) {
+      std::lock_guard<sync::Spinlock> lock(m_spinlock);
+      m_cache.try_emplace(key, key);
+    }
+
+  private:
+    sync::Spinlock m_spinlock;
+    fast_unordered_cache<Value> m_cache;
+  };
+
+  class ConcurrentCache {
+  public:
+    Value* find(const XXH64_hash_t key) {
+      return m_cache.find(key);
+    }
+
+    void try_emplace(const XXH64_hash_t key) {
+      m_cache.try_emplace(key, key);
+    }
+
+  private:
+    concurrent_fast_cache<Value> m_cache;
+  };
+}
+
+class ConcurrentCacheTestApp {
+public:
+  static void run() {
+    cout << "Begin concurrent cache single threaded test" << endl;
+    test_against_reference();
+    cout << "Begin concurrent cache multi threaded test" << endl;
+    test_concurrent_readers();
+    cout << "Begin concurrent cache contention benchmark" << endl;
+    benchmark<LockedCache>("spinlock");
+    benchmark<ConcurrentCache>("concurrent");
+    cout << "Concurrent cache successfully tested" << endl;
+  }
+
+private:
+  static void test_against_reference() {
+    mt19937_64 rng(5678);
+    concurrent_fast_cache<Value> cache;
+    unordered_map<XXH64_hash_t, bool> reference;
+
+    for (uint32_t i = 0; i < 200000; i++) {
+      // Few enough keys to hit the same ones again, and to erase and insert them repeatedly
+      const XXH64_hash_t key = makeKey(rng() % 5000);
+
+      switch (rng() % 4) {
+      case 0:
+      case 1: {
+        auto [value, inserted] = cache.try_emplace(key, key);
+        if (inserted != (reference.count(key) == 0)) {
+          throw DxvkError("Insert mismatch");
+        }
+        if (!(value != nullptr && value->isConsistent(key))) {
+          throw DxvkError("Inserted value mismatch");
+        }
+        reference[key] = true;
+        break;
+      }
+      case 2:
+        if (cache.erase(key) != (reference.erase(key) != 0)) {
+          throw DxvkError("Erase mismatch");
+        }
+        break;
+      case 3: {
+        Value* value = cache.find(key);
+        if ((value != nullptr) != (reference.count(key) != 0)) {
+          throw DxvkError("Find mismatch");
+        }
+        if (!(value == nullptr || value->isConsistent(key))) {
+          throw DxvkError("Found value mismatch");
+        }
+        break;
+      }
+      }
+    }
+
+    if (cache.size() != reference.size()) {
+      throw DxvkError("Size mismatch");
+    }
+
+    size_t numVisited = 0;
+    cache.forEach([&](XXH64_hash_t key, const Value& value) {
+      if (!(reference.count(key) != 0 && value.isConsistent(key))) {
+        throw DxvkError("Visited value mismatch");
+      }
+      numVisited++;
+    });
+    if (numVisited != reference.size()) {
+      throw DxvkError("Visited count mismatch");
+    }
+
+    // Pointers stay put while other values come and go
+    Value* pinned = cache.try_emplace(makeKey(~0ull), makeKey(~0ull)).first;
+    for (uint64_t i = 0; i < 50000; i++) {
+      cache.try_emplace(makeKey(1000000 + i), makeKey(1000000 + i));
+    }
+    if (!(cache.find(makeKey(~0ull)) == pinned && pinned->isConsistent(makeKey(~0ull)))) {
+      throw DxvkError("Value moved");
+    }
+
+    cache.clear();
+    if (!(cache.empty() && cache.find(makeKey(~0ull)) == nullptr)) {
+      throw DxvkError("Clear left values behind");
+    }
+  }
+
+  // Readers look up keys while writers insert them, and must find every key that was published
+  // before the lookup, fully constructed
+  static void test_concurrent_readers() {
+    const uint32_t numKeys = 200000;
+    const uint32_t numWriters = 2;
+    const uint32_t numReaders = 3;
+
+    concurrent_fast_cache<Value> cache;
+    atomic<uint32_t> published[numWriters] = {};
+    atomic<bool> failed = { false };
+    atomic<uint32_t> numDone = { 0 };
+
+    vector<thread> threads;
+
+    for (uint32_t w = 0; w < numWriters; w++) {
+      threads.emplace_back([&, w] {
+        for (uint32_t i = w; i < numKeys; i += numWriters) {
+          cache.try_emplace(makeKey(i), makeKey(i));
+          published[w].store(i / numWriters + 1, memory_order_release);
+        }
+        numDone++;
+      });
+    }
+
+    for (uint32_t r = 0; r < numReaders; r++) {
+      threads.emplace_back([&, r] {
+        mt19937 rng(r);
+        while (numDone.load() < numWriters && !failed.load()) {
+          const uint32_t w = rng() % numWriters;
+          const uint32_t count = published[w].load(memory_order_acquire);
+
+          // A published key must be found
+          if (count != 0) {
+            const uint32_t i = (rng() % count) * numWriters + w;
+            const Value* value = cache.find(makeKey(i));
+            if (value == nullptr || !value->isConsistent(makeKey(i))) {
+              failed = true;
+            }
+          }
+
+          // A key that may be in flight is either missing or complete
+          const uint32_t i = rng() % numKeys;
+          const Value* value = cache.find(makeKey(i));
+          if (value != nullptr && !value->isConsistent(makeKey(i))) {
+            failed = true;
+          }
+        }
+      });
+    }
+
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    if (failed) {
+      throw DxvkError("Reader saw a missing or torn value");
+    }
+    if (cache.size() != numKeys) {
+      throw DxvkError("Concurrent inserts lost values");
+    }
+  }
+
+  // The render thread looking up replacements for each draw while a mod is being loaded:
+  // one reader looks up keys of a loaded mod while a writer keeps adding new ones.  Reports
+  // the reader's average and worst lookup time.
+  template<typename Cache>
+  static void benchmark(const char* name) {
+    const uint32_t numLoaded = 50000;
+    const uint32_t numLoading = 500000;
+    const uint32_t numLookupsPerBatch = 1000;
+
+    Cache cache;
+    for (uint32_t i = 0; i < numLoaded; i++) {
+      cache.try_emplace(makeKey(i));
+    }
+
+    atomic<bool> loading = { true };
+
+    thread writer([&] {
+      for (uint32_t i = 0; i < numLoading; i++) {
+        cache.try_emplace(makeKey(numLoaded + i));
+      }
+      loading = false;
+    });
+
+    mt19937 rng(1);
+    uint64_t numLookups = 0;
+    uint64_t numFound = 0;
+    duration<double, micro> total(0);
+    duration<double, micro> worstBatch(0);
+
+    while (loading.load()) {
+      const auto start = high_resolution_clock::now();
+
+      for (uint32_t i = 0; i < numLookupsPerBatch; i++) {
+        numFound += cache.find(makeKey(rng() % numLoaded)) != nullptr;
+      }
+
+      const duration<double, micro> elapsed = high_resolution_clock::now() - start;
+      total += elapsed;
+      worstBatch = std::max(worstBatch, elapsed);
+      numLookups += numLookupsPerBatch;
+    }
+
+    writer.join();
+
+    if (numFound != numLookups) {
+      throw DxvkError("Lookup missed a loaded key");
+    }
+
+    cout << name << ": " << numLookups << " lookups during load, "
+         << total.count() * 1000.0 / std::max<uint64_t>(numLookups, 1) << " ns per lookup, worst "
+         << numLookupsPerBatch << " lookups took " << worstBatch.count() << " us" << endl;
+  }
+};
+
+int main() {
+  try {
+    ConcurrentCacheTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,232 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_fast_cache.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+namespace {
+  // Roughly the footprint of a BLAS cache entry, so the benchmark pays realistic node costs
+  struct FakeBlasEntry {
+    uint64_t frameLastTouched;
+    uint8_t payload[504];
+
+    explicit FakeBlasEntry(uint64_t frame) : frameLastTouched(frame) { }
+  };
+
+  using StdMultimap = std::unordered_multimap<XXH64_hash_t, FakeBlasEntry, XXH64_hash_passthrough>;
+  using FlatMultimap = fast_unordered_multicache<FakeBlasEntry>;
+}
+
+class FastCacheTestApp {
+public:
+  static void run() {
+    cout << "Begin fast cache correctness test" << endl;
+    test_against_std();
+    cout << "Begin fast multicache correctness test" << endl;
+    test_multi();
+    cout << "Begin fast cache benchmark" << endl;
+    benchmark<StdMultimap>("std::unordered_multimap");
+    benchmark<FlatMultimap>("fast_unordered_multicache");
+    cout << "Fast cache successfully tested" << endl;
+  }
+
+private:
+  static void test_against_std() {
+    mt19937_64 rng(1234);
+    fast_unordered_cache<uint64_t> cache;
+    unordered_map<XXH64_hash_t, uint64_t> reference;
+
+    // Small key range forces plenty of collisions, probe runs and backward shifts
+    uniform_int_distribution<uint64_t> keyDist(0, 4096);
+    for (uint32_t i = 0; i < 200000; i++) {
+      const XXH64_hash_t key = keyDist(rng) * 0x100000001ull;
+      switch (rng() % 4) {
+      case 0:
+      case 1:
+        cache[key] = i;
+        reference[key] = i;
+        break;
+      case 2:
+        if (cache.erase(key) != reference.erase(key)) {
+          throw DxvkError("Erase count mismatch");
+        }
+        break;
+      case 3: {
+        auto it = cache.find(key);
+        auto refIt = reference.find(key);
+        if ((it == cache.end()) != (refIt == reference.end()) || (it != cache.end() && it->second != refIt->second)) {
+          throw DxvkError("Lookup mismatch");
+        }
+        break;
+      }
+      }
+    }
+
+    if (cache.size() != reference.size()) {
+      throw DxvkError("Size mismatch");
+    }
+
+    // Values must not move as the table grows
+    const uint64_t* pValue = &cache.begin()->second;
+    const XXH64_hash_t pinnedKey = cache.begin()->first;
+    for (uint64_t i = 0; i < 100000; i++) {
+      cache.try_emplace(XXH3_64bits(&i, sizeof(i)), i);
+    }
+    if (&cache.find(pinnedKey)->second != pValue) {
+      throw DxvkError("Value moved during rehash");
+    }
+
+    // Erase while iterating visits each entry exactly once
+    size_t visited = 0;
+    const size_t total = cache.size();
+    cache.erase_if([&visited](const auto& it) {
+      visited++;
+      return (it->first & 1) == 0;
+    });
+    if (visited != total) {
+      throw DxvkError("erase_if did not visit every entry once");
+    }
+    for (const auto& [key, value] : cache) {
+      if ((key & 1) == 0) {
+        throw DxvkError("erase_if left an entry behind");
+      }
+    }
+
+    fast_unordered_cache<uint64_t> copy = cache;
+    if (copy.size() != cache.size() || copy.at(cache.begin()->first) != cache.begin()->second) {
+      throw DxvkError("Copy mismatch");
+    }
+
+    cache.clear();
+    if (!cache.empty() || cache.find(pinnedKey) != cache.end()) {
+      throw DxvkError("Clear left entries behind");
+    }
+  }
+
+  static void test_multi() {
+    fast_unordered_multicache<uint32_t> cache;
+    for (uint32_t i = 0; i < 64; i++) {
+      cache.emplace(i % 4, i);
+    }
+
+    if (cache.size() != 64 || cache.count(2) != 16) {
+      throw DxvkError("Duplicate count mismatch");
+    }
+
+    // Remove the middle of a duplicate chain, as well as its head
+    cache.erase_if([](const auto& it) { return it->first == 3 && it->second % 8 == 7; });
+    uint32_t n = 0;
+    for (auto it = cache.equal_range(3).first; it != cache.equal_range(3).second; ++it) {
+      if (it->second % 8 == 7) {
+        throw DxvkError("Erased duplicate still reachable");
+      }
+      n++;
+    }
+    if (n != 8) {
+      throw DxvkError("Duplicate chain broken by erase");
+    }
+
+    cache.erase(3);
+    if (cache.count(3) != 0 || cache.size() != 48) {
+      throw DxvkError("Erase by key left duplicates");
+    }
+  }
+
+  template<typename Map>
+  static void benchmark(const char* name) {
+    const uint32_t numEntries = 65536;
+    const uint32_t numFrames = 16;
+
+    // Mostly unique keys with a few shared ones, like topological hashes of a scene
+    vector<XXH64_hash_t> keys(numEntries);
+    for (uint32_t i = 0; i < numEntries; i++) {
+      const uint32_t k = (i % 16) == 0 ? i / 2 : i;
+      keys[i] = XXH3_64bits(&k, sizeof(k));
+    }
+
+    Map map;
+    double insertMs, lookupMs, sweepMs;
+    {
+      const auto start = high_resolution_clock::now();
+      for (uint32_t i = 0; i < numEntries; i++) {
+        map.emplace(keys[i], FakeBlasEntry(i % numFrames));
+      }
+      insertMs = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+    }
+
+    uint64_t checksum = 0;
+    {
+      const auto start = high_resolution_clock::now();
+      for (uint32_t frame = 0; frame < numFrames; frame++) {
+        for (uint32_t i = 0; i < numEntries; i++) {
+          auto range = map.equal_range(keys[(i * 7919) % numEntries]);
+          for (auto it = range.first; it != range.second; ++it) {
+            checksum += it->second.frameLastTouched;
+          }
+        }
+      }
+      lookupMs = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+    }
+
+    {
+      // Same shape as SceneManager::garbageCollection, evicting a frame's worth of entries each pass
+      const auto start = high_resolution_clock::now();
+      for (uint32_t frame = 0; frame < numFrames; frame++) {
+        for (auto iter = map.begin(); iter != map.end(); ) {
+          if (iter->second.frameLastTouched == frame && (iter->first & 3) == 0) {
+            iter = map.erase(iter);
+          } else {
+            ++iter;
+          }
+        }
+      }
+      sweepMs = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+    }
+
+    cout << name << ": " << numEntries << " entries, insert " << insertMs << " ms, "
+         << numFrames << "x lookups " << lookupMs << " ms, "
+         << numFrames << "x GC sweeps " << sweepMs << " ms (" << map.size() << " left, checksum " << checksum << ")" << endl;
+  }
+};
+
+int main() {
+  try {
+    FastCacheTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
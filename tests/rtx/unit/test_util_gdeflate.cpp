@@ -0,0 +1,229 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <libdeflate.h>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_gdeflate.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+namespace {
+  // A synthetic package blob: runs of repeated 16 byte blocks, like flat BCn regions,
+  // mixed with noise, so it compresses at a ratio similar to real textures
+  vector<uint8_t> makeSyntheticBlob(const size_t size, const uint32_t seed) {
+    mt19937 rng(seed);
+    vector<uint8_t> data(size);
+
+    size_t offset = 0;
+    while (offset < size) {
+      uint8_t block[16];
+      for (auto& b : block) {
+        b = static_cast<uint8_t>(rng());
+      }
+
+      const size_t repeats = (rng() % 4 == 0) ? 1 : 1 + rng() % 64;
+      for (size_t n = 0; n < repeats && offset < size; n++) {
+        const size_t bytes = std::min(sizeof(block), size - offset);
+        memcpy(data.data() + offset, block, bytes);
+        offset += bytes;
+      }
+    }
+
+    return data;
+  }
+
+  // Packs the data into a GDeflate tile stream, the layout RTX IO packages store compressed blobs in
+  vector<uint8_t> compressTileStream(const vector<uint8_t>& data) {
+    const size_t tileSize = GDeflateDecoder::kTileSize;
+    const uint32_t numTiles = static_cast<uint32_t>((data.size() + tileSize - 1) / tileSize);
+
+    libdeflate_gdeflate_compressor* compressor = libdeflate_alloc_gdeflate_compressor(8);
+    if (compressor == nullptr) {
+      throw DxvkError("Unable to create a GDeflate compressor");
+    }
+
+    vector<vector<uint8_t>> tiles(numTiles);
+    for (uint32_t tile = 0; tile < numTiles; tile++) {
+      const size_t offset = tile * tileSize;
+      const size_t size = std::min(tileSize, data.size() - offset);
+
+      size_t numPages = 0;
+      tiles[tile].resize(libdeflate_gdeflate_compress_bound(compressor, size, &numPages));
+      if (numPages != 1) {
+        throw DxvkError("Unexpected GDeflate page count for a single tile");
+      }
+
+      libdeflate_gdeflate_out_page page { tiles[tile].data(), tiles[tile].size() };
+      const size_t compressedSize = libdeflate_gdeflate_compress(compressor, data.data() + offset, size, &page, 1);
+      if (compressedSize == 0) {
+        throw DxvkError("GDeflate compression failed");
+      }
+
+      tiles[tile].resize(compressedSize);
+    }
+
+    libdeflate_free_gdeflate_compressor(compressor);
+
+    GDeflateDecoder::TileStream header {};
+    header.id = GDeflateDecoder::TileStream::kId;
+    header.magic = header.id ^ 0xff;
+    header.numTiles = static_cast<uint16_t>(numTiles);
+    header.tileSizeIdx = 1;
+    header.lastTileSize = static_cast<uint32_t>(data.size() % tileSize);
+
+    vector<uint32_t> tileOffsets(numTiles);
+    uint32_t offset = 0;
+    for (uint32_t tile = 0; tile < numTiles; tile++) {
+      tileOffsets[tile] = offset;
+      offset += static_cast<uint32_t>(tiles[tile].size());
+    }
+    tileOffsets[0] = static_cast<uint32_t>(tiles.back().size());
+
+    vector<uint8_t> stream(sizeof(header) + numTiles * sizeof(uint32_t));
+    memcpy(stream.data(), &header, sizeof(header));
+    memcpy(stream.data() + sizeof(header), tileOffsets.data(), numTiles * sizeof(uint32_t));
+    for (const auto& tile : tiles) {
+      stream.insert(stream.end(), tile.begin(), tile.end());
+    }
+
+    return stream;
+  }
+}
+
+class GDeflateTestApp {
+public:
+  static void run() {
+    cout << "Begin GDeflate round trip test" << endl;
+    test_round_trip();
+    cout << "Begin GDeflate malformed stream test" << endl;
+    test_malformed();
+    cout << "Begin GDeflate throughput benchmark" << endl;
+    benchmark();
+    cout << "GDeflate decoder successfully tested" << endl;
+  }
+
+private:
+  static void test_round_trip() {
+    GDeflateDecoder decoder(4);
+
+    // Partial last tile, exact multiple of the tile size, and a single small tile
+    const size_t sizes[] = { 5 * GDeflateDecoder::kTileSize + 1234, 8 * GDeflateDecoder::kTileSize, 300 };
+
+    for (const size_t size : sizes) {
+      const auto data = makeSyntheticBlob(size, static_cast<uint32_t>(size));
+      const auto stream = compressTileStream(data);
+
+      if (GDeflateDecoder::getUncompressedSize(stream.data(), stream.size()) != size) {
+        throw DxvkError("Tile stream reports a wrong uncompressed size");
+      }
+
+      vector<uint8_t> decoded(size);
+      if (!decoder.decompress(decoded.data(), decoded.size(), stream.data(), stream.size())) {
+        throw DxvkError("Tile stream failed to decompress");
+      }
+
+      if (decoded != data) {
+        throw DxvkError("Decompressed tile stream does not match the source data");
+      }
+    }
+  }
+
+  static void test_malformed() {
+    GDeflateDecoder decoder(2);
+
+    const auto data = makeSyntheticBlob(3 * GDeflateDecoder::kTileSize, 42);
+    auto stream = compressTileStream(data);
+    vector<uint8_t> decoded(data.size());
+
+    // Truncated tile data
+    if (decoder.decompress(decoded.data(), decoded.size(), stream.data(), stream.size() - 64)) {
+      throw DxvkError("Truncated tile stream was decompressed");
+    }
+
+    // Output buffer too small
+    if (decoder.decompress(decoded.data(), decoded.size() - 1, stream.data(), stream.size())) {
+      throw DxvkError("Tile stream was decompressed into a short buffer");
+    }
+
+    // Broken header
+    stream[1] ^= 0x1;
+    if (GDeflateDecoder::getUncompressedSize(stream.data(), stream.size()) != 0) {
+      throw DxvkError("Tile stream with a broken header was accepted");
+    }
+  }
+
+  static void benchmark() {
+    // A 4K BC7 texture with its mip chain is about 21MB
+    const size_t blobSize = 21 * 1024 * 1024;
+    const uint32_t numIterations = 8;
+
+    const auto data = makeSyntheticBlob(blobSize, 7);
+    const auto stream = compressTileStream(data);
+    cout << "Synthetic blob: " << (blobSize >> 20) << " MB, compression ratio "
+         << (double) blobSize / stream.size() << endl;
+
+    vector<uint8_t> decoded(blobSize);
+
+    const uint32_t maxThreads = GDeflateDecoder::get().getThreadCount();
+    for (uint32_t numThreads = 0; ; numThreads = std::min(std::max(numThreads * 2, 1u), maxThreads)) {
+      GDeflateDecoder decoder(static_cast<uint8_t>(numThreads));
+
+      const auto start = high_resolution_clock::now();
+      for (uint32_t n = 0; n < numIterations; n++) {
+        if (!decoder.decompress(decoded.data(), decoded.size(), stream.data(), stream.size())) {
+          throw DxvkError("Benchmark tile stream failed to decompress");
+        }
+      }
+      const double seconds = duration<double>(high_resolution_clock::now() - start).count();
+
+      // The calling thread decodes tiles as well
+      const uint32_t numCores = numThreads + 1;
+      const double mbPerSecond = (double) blobSize * numIterations / (1024.0 * 1024.0) / seconds;
+      cout << numCores << " core(s): " << mbPerSecond << " MB/s, " << mbPerSecond / numCores << " MB/s per core" << endl;
+
+      if (numThreads == maxThreads) {
+        break;
+      }
+    }
+  }
+};
+
+int main() {
+  try {
+    GDeflateTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
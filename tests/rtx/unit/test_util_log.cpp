@@ -0,0 +1,251 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_env.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+namespace dxvk {
+  Logger Logger::s_instance("util_log.log");
+}
+
+namespace {
+  // Where Logger::s_instance writes to
+  string getLogPath() {
+    string path = env::getEnvVar("DXVK_LOG_PATH");
+
+    if (!path.empty() && *path.rbegin() != '/')
+      path += '/';
+
+    return path + env::getExeBaseName() + "_util_log.log";
+  }
+
+  vector<string> readLogLines(const string& needle) {
+    ifstream file(getLogPath());
+    vector<string> lines;
+    string line;
+    while (getline(file, line)) {
+      if (line.find(needle) != string::npos) {
+        lines.push_back(line);
+      }
+    }
+    return lines;
+  }
+
+  // What Logger::emitMsg did before it went asynchronous: format and write out under one lock.
+  // Writes to a scratch file which is removed again once done.
+  class SynchronousLogger {
+  public:
+    SynchronousLogger()
+      : m_path(filesystem::temp_directory_path() / "util_log_synchronous.log")
+      , m_fileStream(m_path) { }
+
+    ~SynchronousLogger() {
+      m_fileStream.close();
+
+      error_code ec;
+      filesystem::remove(m_path, ec);
+    }
+
+    void info(const string& message) {
+      lock_guard<std::mutex> lock(m_mutex);
+
+      stringstream stream(message);
+      string line;
+
+      while (getline(stream, line, '\n')) {
+        m_fileStream << "info:  " << line << endl;
+      }
+    }
+
+  private:
+    std::mutex m_mutex;
+    filesystem::path m_path;
+    ofstream m_fileStream;
+  };
+}
+
+class LogTestApp {
+public:
+  static void run() {
+    if (Logger::logLevel() > LogLevel::Info || env::getEnvVar("DXVK_LOG_PATH") == "none") {
+      cout << "Logging to a file is disabled, skipping log tests" << endl;
+      return;
+    }
+
+    cout << "Begin log ordering test" << endl;
+    test_ordering();
+    cout << "Begin log error flush test" << endl;
+    test_error_flush();
+    cout << "Begin log repeat suppression test" << endl;
+    test_repeat_suppression();
+    cout << "Begin log contention benchmark" << endl;
+    benchmark();
+    cout << "Log successfully tested" << endl;
+  }
+
+private:
+  static constexpr uint32_t kNumThreads = 8;
+
+  // Every message makes it to the file, in the order each thread logged them
+  static void test_ordering() {
+    const uint32_t numMessages = 5000;
+
+    vector<std::thread> threads;
+    for (uint32_t t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([t] {
+        for (uint32_t i = 0; i < numMessages; i++) {
+          Logger::info(str::format("ordering ", t, " ", i));
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    Logger::flush();
+
+    vector<int64_t> lastSeen(kNumThreads, -1);
+    for (const string& line : readLogLines("ordering ")) {
+      uint32_t t, i;
+      if (!(sscanf(line.c_str(), "info:  ordering %u %u", &t, &i) == 2 && t < kNumThreads)) {
+        throw DxvkError("Garbled message");
+      }
+      if (int64_t(i) != lastSeen[t] + 1) {
+        throw DxvkError("Message lost or out of order");
+      }
+      lastSeen[t] = i;
+    }
+
+    if (!all_of(lastSeen.begin(), lastSeen.end(), [](int64_t i) { return i == numMessages - 1; })) {
+      throw DxvkError("Message lost");
+    }
+  }
+
+  // Errors are written out before the call returns
+  static void test_error_flush() {
+    Logger::info("before error");
+    Logger::err("error marker");
+
+    if (readLogLines("before error").size() != 1) {
+      throw DxvkError("Message before an error not written out");
+    }
+    if (readLogLines("error marker").size() != 1) {
+      throw DxvkError("Error not written out");
+    }
+  }
+
+  static void test_repeat_suppression() {
+    for (uint32_t i = 0; i < 1000; i++) {
+      Logger::info("repeated message");
+    }
+
+    Logger::flush();
+
+    // The burst may straddle the start of a new second
+    const size_t numLogged = readLogLines("repeated message").size();
+    if (!(numLogged > 0 && numLogged <= 16)) {
+      throw DxvkError("Repeated message not suppressed");
+    }
+
+    // Next time the message comes up the suppressed repeats are reported
+    std::this_thread::sleep_for(milliseconds(1100));
+    Logger::info("repeated message");
+    Logger::flush();
+
+    if (readLogLines("repeats of the next message").size() < 1) {
+      throw DxvkError("Suppressed repeats not reported");
+    }
+  }
+
+  // Render and worker threads logging at the same time, reports the log calls per second
+  // while the calls are made, and including writing everything out
+  static void benchmark() {
+    const uint32_t numMessages = 20000;
+
+    auto runThreads = [](auto&& logMessage) {
+      vector<std::thread> threads;
+      for (uint32_t t = 0; t < kNumThreads; t++) {
+        threads.emplace_back([t, &logMessage] {
+          for (uint32_t i = 0; i < numMessages; i++) {
+            logMessage(str::format("benchmark thread ", t, " message ", i, " with a typical amount of detail following it"));
+          }
+        });
+      }
+
+      for (auto& thread : threads) {
+        thread.join();
+      }
+    };
+
+    const double numCalls = double(kNumThreads) * numMessages;
+
+    duration<double> synchronous;
+    {
+      SynchronousLogger synchronousLogger;
+      const auto start = high_resolution_clock::now();
+      runThreads([&](const string& message) { synchronousLogger.info(message); });
+      synchronous = high_resolution_clock::now() - start;
+    }
+
+    const auto start = high_resolution_clock::now();
+    runThreads([](const string& message) { Logger::info(message); });
+    const duration<double> calls = high_resolution_clock::now() - start;
+    Logger::flush();
+    const duration<double> written = high_resolution_clock::now() - start;
+
+    if (readLogLines("benchmark thread ").size() != kNumThreads * numMessages) {
+      throw DxvkError("Benchmark message lost");
+    }
+
+    cout << "synchronous: " << numCalls / synchronous.count() << " calls per second" << endl;
+    cout << "asynchronous: " << numCalls / calls.count() << " calls per second, "
+         << numCalls / written.count() << " calls per second including writing out" << endl;
+  }
+};
+
+int main() {
+  try {
+    LogTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,274 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_mesh_optimizer.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+class MeshOptimizerTestApp {
+public:
+  static void run() {
+    cout << "Begin degenerate triangle test" << endl;
+    test_degenerates();
+    cout << "Begin degenerate only mesh test" << endl;
+    test_degenerates_only();
+    cout << "Begin vertex fetch remap test" << endl;
+    test_fetch_remap();
+    cout << "Begin vertex cache test" << endl;
+    test_vertex_cache(64, 1);
+    test_vertex_cache(512, 2);
+    cout << "Begin shared scratch test" << endl;
+    test_shared_scratch();
+    cout << "Mesh optimizer successfully tested" << endl;
+  }
+
+private:
+  using Triangle = array<uint32_t, 3>;
+
+  static void test_degenerates() {
+    const float positions[] = {
+      0.f, 0.f, 0.f,
+      1.f, 0.f, 0.f,
+      0.f, 1.f, 0.f,
+      1.f, 0.f, 0.f, // same position as vertex 1
+    };
+
+    vector<uint32_t> indices = {
+      0, 1, 2,
+      0, 0, 2, // repeated index
+      2, 1, 1, // repeated index, last edge
+      0, 1, 3, // repeated position
+      2, 3, 0,
+    };
+
+    // Index only: the repeated position survives
+    vector<uint32_t> indexOnly = indices;
+    uint32_t numIndices = meshopt::removeDegenerateTriangles(indexOnly.data(), (uint32_t) indexOnly.size());
+    if (numIndices != 9) {
+      throw DxvkError("Wrong number of triangles kept comparing indices");
+    }
+    if (vector<uint32_t>(indexOnly.begin(), indexOnly.begin() + numIndices) != vector<uint32_t>({ 0, 1, 2, 0, 1, 3, 2, 3, 0 })) {
+      throw DxvkError("Wrong triangles kept comparing indices");
+    }
+
+    numIndices = meshopt::removeDegenerateTriangles(indices.data(), (uint32_t) indices.size(), positions, sizeof(float) * 3);
+    if (numIndices != 6) {
+      throw DxvkError("Wrong number of triangles kept comparing positions");
+    }
+    if (vector<uint32_t>(indices.begin(), indices.begin() + numIndices) != vector<uint32_t>({ 0, 1, 2, 2, 3, 0 })) {
+      throw DxvkError("Wrong triangles kept comparing positions");
+    }
+  }
+
+  static void test_degenerates_only() {
+    const float positions[] = {
+      0.f, 0.f, 0.f,
+      1.f, 0.f, 0.f,
+      1.f, 0.f, 0.f, // same position as vertex 1
+      0.f, 1.f, 0.f,
+    };
+
+    const vector<uint32_t> authored = {
+      0, 0, 1, // repeated index
+      0, 1, 2, // repeated position
+      3, 3, 3, // repeated index
+    };
+
+    // Dropping every triangle would leave the mesh without vertices, so the list is kept as authored
+    vector<uint32_t> indices = authored;
+    uint32_t numIndices = meshopt::removeDegenerateTriangles(indices.data(), (uint32_t) indices.size(), positions, sizeof(float) * 3);
+    if (numIndices != authored.size() || indices != authored) {
+      throw DxvkError("Mesh of degenerate triangles only was not kept as authored");
+    }
+
+    const vector<uint32_t> authoredIndexOnly = { 0, 0, 1, 2, 1, 2, 3, 3, 3 };
+    vector<uint32_t> indexOnly = authoredIndexOnly;
+    if (meshopt::removeDegenerateTriangles(indexOnly.data(), (uint32_t) indexOnly.size()) != authoredIndexOnly.size() || indexOnly != authoredIndexOnly) {
+      throw DxvkError("Mesh of degenerate triangles only was not kept as authored comparing indices");
+    }
+
+    // The rest of the pipeline still leaves vertices to upload
+    meshopt::optimizeVertexCache(indices.data(), numIndices, 4);
+    vector<uint32_t> remap(4);
+    const uint32_t numUsedVertices = meshopt::optimizeVertexFetchRemap(remap.data(), indices.data(), numIndices, 4);
+    if (numUsedVertices != 4) {
+      throw DxvkError("Vertices of a mesh of degenerate triangles only were dropped");
+    }
+
+    // An empty list stays empty
+    if (meshopt::removeDegenerateTriangles(indices.data(), 0, positions, sizeof(float) * 3) != 0) {
+      throw DxvkError("Empty triangle list gained triangles");
+    }
+  }
+
+  static void test_fetch_remap() {
+    // Vertex 1 and 5 are unused
+    const uint32_t numVertices = 6;
+    vector<uint32_t> indices = { 4, 2, 0, 0, 2, 3 };
+    const uint32_t vertices[numVertices] = { 100, 101, 102, 103, 104, 105 };
+
+    vector<uint32_t> remap(numVertices);
+    const uint32_t numUsed = meshopt::optimizeVertexFetchRemap(remap.data(), indices.data(), (uint32_t) indices.size(), numVertices);
+    if (numUsed != 4) {
+      throw DxvkError("Wrong number of referenced vertices");
+    }
+    if (remap != vector<uint32_t>({ 2, meshopt::kUnusedVertex, 1, 3, 0, meshopt::kUnusedVertex })) {
+      throw DxvkError("Wrong remap table");
+    }
+
+    vector<uint32_t> remappedVertices(numUsed);
+    meshopt::remapVertexBuffer(remappedVertices.data(), vertices, numVertices, sizeof(uint32_t), remap.data());
+    meshopt::remapIndexBuffer(indices.data(), (uint32_t) indices.size(), remap.data());
+
+    if (indices != vector<uint32_t>({ 0, 1, 2, 2, 1, 3 })) {
+      throw DxvkError("Wrong remapped indices");
+    }
+    if (remappedVertices != vector<uint32_t>({ 104, 102, 100, 103 })) {
+      throw DxvkError("Wrong remapped vertices");
+    }
+  }
+
+  static vector<Triangle> sortedTriangles(const vector<uint32_t>& indices) {
+    vector<Triangle> triangles(indices.size() / 3);
+    for (size_t t = 0; t < triangles.size(); t++) {
+      triangles[t] = { indices[t * 3 + 0], indices[t * 3 + 1], indices[t * 3 + 2] };
+    }
+    sort(triangles.begin(), triangles.end());
+    return triangles;
+  }
+
+  // Triangulated N x N quad grid with its triangles shuffled, the way an unoptimized export might look
+  static vector<uint32_t> shuffledGrid(const uint32_t gridSize, const uint32_t seed) {
+    vector<Triangle> triangles;
+    for (uint32_t y = 0; y < gridSize; y++) {
+      for (uint32_t x = 0; x < gridSize; x++) {
+        const uint32_t p = y * (gridSize + 1) + x;
+        triangles.push_back({ p, p + 1, p + gridSize + 2 });
+        triangles.push_back({ p, p + gridSize + 2, p + gridSize + 1 });
+      }
+    }
+    // A few degenerate triangles must survive the reordering untouched
+    triangles.push_back({ 0, 0, 1 });
+    triangles.push_back({ 5, 5, 5 });
+
+    mt19937 rng(seed);
+    shuffle(triangles.begin(), triangles.end(), rng);
+
+    vector<uint32_t> indices;
+    for (const Triangle& t : triangles) {
+      indices.insert(indices.end(), t.begin(), t.end());
+    }
+    return indices;
+  }
+
+  static void test_vertex_cache(const uint32_t gridSize, const uint32_t seed) {
+    const uint32_t numVertices = (gridSize + 1) * (gridSize + 1);
+    const vector<uint32_t> indices = shuffledGrid(gridSize, seed);
+    const size_t numTriangles = indices.size() / 3;
+
+    const float acmrBefore = meshopt::computeAcmr(indices.data(), (uint32_t) indices.size(), numVertices);
+
+    vector<uint32_t> optimized = indices;
+    const auto start = high_resolution_clock::now();
+    meshopt::optimizeVertexCache(optimized.data(), (uint32_t) optimized.size(), numVertices);
+    const auto elapsed = duration_cast<microseconds>(high_resolution_clock::now() - start);
+
+    const float acmrAfter = meshopt::computeAcmr(optimized.data(), (uint32_t) optimized.size(), numVertices);
+
+    cout << "Grid " << gridSize << "x" << gridSize << ", " << numTriangles << " triangles: ACMR " << acmrBefore << " -> " << acmrAfter
+         << " in " << elapsed.count() / 1000.0 << " ms" << endl;
+
+    if (sortedTriangles(optimized) != sortedTriangles(indices)) {
+      throw DxvkError("Vertex cache optimization changed the set of triangles");
+    }
+    if (acmrBefore <= 2.5f) {
+      throw DxvkError("Shuffled grid unexpectedly cache friendly");
+    }
+    if (acmrAfter >= 0.8f) {
+      throw DxvkError("Vertex cache optimization did not reach the expected ACMR");
+    }
+
+    // An already optimized order doesn't regress
+    const float ideal = meshopt::computeAcmr(optimized.data(), (uint32_t) optimized.size(), numVertices);
+    meshopt::optimizeVertexCache(optimized.data(), (uint32_t) optimized.size(), numVertices);
+    if (meshopt::computeAcmr(optimized.data(), (uint32_t) optimized.size(), numVertices) > ideal + 0.01f) {
+      throw DxvkError("Vertex cache optimization regressed an optimized mesh");
+    }
+  }
+
+  // Sub meshes of one vertex buffer share a scratch, each must come out as if optimized on its own
+  static void test_shared_scratch() {
+    const uint32_t numVertices = 65 * 65;
+    const vector<uint32_t> grid = shuffledGrid(64, 3);
+
+    // Sub meshes touching different, partly overlapping ranges of the vertex buffer
+    vector<vector<uint32_t>> submeshes = {
+      vector<uint32_t>(grid.begin(), grid.begin() + grid.size() / 3 / 2 * 3),
+      vector<uint32_t>(grid.begin() + grid.size() / 3 / 4 * 3, grid.end()),
+      shuffledGrid(16, 4),
+      grid,
+    };
+
+    meshopt::Scratch scratch;
+    for (vector<uint32_t>& submesh : submeshes) {
+      vector<uint32_t> expected = submesh;
+      meshopt::optimizeVertexCache(expected.data(), (uint32_t) expected.size(), numVertices);
+      const float expectedAcmr = meshopt::computeAcmr(expected.data(), (uint32_t) expected.size(), numVertices);
+
+      meshopt::optimizeVertexCache(submesh.data(), (uint32_t) submesh.size(), numVertices, scratch);
+      if (submesh != expected) {
+        throw DxvkError("Shared scratch changed the optimized order");
+      }
+      if (meshopt::computeAcmr(submesh.data(), (uint32_t) submesh.size(), numVertices, scratch) != expectedAcmr) {
+        throw DxvkError("Shared scratch changed the ACMR");
+      }
+    }
+
+    for (uint32_t v = 0; v < numVertices; v++) {
+      if (scratch.liveTriangles[v] != 0 || scratch.adjacencyOffsets[v] != meshopt::kUnusedVertex ||
+          scratch.adjacencyCursor[v] != 0 || scratch.cachePositions[v] != -1 || scratch.loadedAt[v] != 0) {
+        throw DxvkError("Scratch was not restored to its initial state");
+      }
+    }
+  }
+};
+
+int main() {
+  try {
+    MeshOptimizerTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,208 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/log/metrics.h"
+
+using namespace dxvk;
+using namespace std;
+
+namespace dxvk {
+  Logger Logger::s_instance("util_metrics.log");
+  Metrics Metrics::s_instance;
+}
+
+namespace {
+  MetricCounter s_counter("test.counter");
+  MetricGauge s_gauge("test.gauge");
+  MetricHistogram s_histogram("test.histogram");
+
+  vector<string> readLines(const char* path) {
+    ifstream file(path);
+    vector<string> lines;
+    string line;
+    while (getline(file, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  vector<string> split(const string& line) {
+    vector<string> fields;
+    stringstream stream(line);
+    string field;
+    while (getline(stream, field, ',')) {
+      fields.push_back(field);
+    }
+    // getline drops a trailing empty field
+    if (!line.empty() && line.back() == ',') {
+      fields.push_back("");
+    }
+    return fields;
+  }
+}
+
+class MetricsTestApp {
+public:
+  static void run() {
+    cout << "Begin metrics CSV timeline test" << endl;
+    test_csv_timeline();
+    cout << "Begin metrics JSON timeline test" << endl;
+    test_json_timeline();
+    cout << "Metrics successfully tested" << endl;
+  }
+
+private:
+  static constexpr uint32_t kNumThreads = 4;
+  static constexpr uint32_t kNumRecords = 10000;
+
+  // Records the same values into the test metrics from several threads
+  static void recordConcurrently() {
+    vector<std::thread> threads;
+    for (uint32_t t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([t] {
+        for (uint32_t i = 0; i < kNumRecords; i++) {
+          s_counter.add();
+          s_histogram.record(double(t * kNumRecords + i));
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    s_gauge.set(42.0);
+  }
+
+  static void test_csv_timeline() {
+    // Nothing is recorded before a timeline opens
+    s_counter.add(1000);
+
+    if (!Metrics::beginTimeline("util_metrics_timeline.csv", MetricsTimelineFormat::Csv)) {
+      throw DxvkError("Failed to open CSV timeline");
+    }
+
+    // Registering an existing name shares the metric
+    MetricCounter sameCounter("test.counter");
+    sameCounter.add(5);
+
+    recordConcurrently();
+    Metrics::endFrame(0);
+
+    // Metrics registered once the timeline started don't change its columns
+    MetricCounter lateCounter("test.late_counter");
+    lateCounter.add();
+
+    Metrics::endFrame(1);
+    Metrics::endTimeline();
+
+    const vector<string> lines = readLines("util_metrics_timeline.csv");
+    if (lines.size() != 3) {
+      throw DxvkError("Unexpected number of CSV rows");
+    }
+    if (lines[0] != "frame,time,test.counter,test.gauge,test.histogram.count,test.histogram.min,test.histogram.mean,test.histogram.max") {
+      throw DxvkError("Unexpected CSV header");
+    }
+
+    const vector<string> frame0 = split(lines[1]);
+    if (!(frame0.size() == 8 && frame0[0] == "0")) {
+      throw DxvkError("Unexpected CSV row");
+    }
+    if (stoull(frame0[2]) != kNumThreads * kNumRecords + 5) {
+      throw DxvkError("Counter lost values");
+    }
+    if (stod(frame0[3]) != 42.0) {
+      throw DxvkError("Gauge not set");
+    }
+    if (stoull(frame0[4]) != kNumThreads * kNumRecords) {
+      throw DxvkError("Histogram lost values");
+    }
+    if (!(stod(frame0[5]) == 0.0 && stod(frame0[7]) == double(kNumThreads * kNumRecords - 1))) {
+      throw DxvkError("Histogram range mismatch");
+    }
+    if (abs(stod(frame0[6]) - (kNumThreads * kNumRecords - 1) / 2.0) >= 1.0) {
+      throw DxvkError("Histogram mean mismatch");
+    }
+
+    // Counters and histograms start over every frame, gauges keep their value
+    const vector<string> frame1 = split(lines[2]);
+    if (!(frame1.size() == 8 && frame1[0] == "1")) {
+      throw DxvkError("Unexpected CSV row");
+    }
+    if (!(frame1[2] == "0" && stod(frame1[3]) == 42.0 && frame1[4] == "0" && frame1[5].empty())) {
+      throw DxvkError("Values carried over to the next frame");
+    }
+  }
+
+  static void test_json_timeline() {
+    if (!Metrics::beginTimeline("util_metrics_timeline.jsonl", MetricsTimelineFormat::JsonLines)) {
+      throw DxvkError("Failed to open JSON timeline");
+    }
+
+    recordConcurrently();
+    Metrics::endFrame(7);
+    Metrics::endFrame(8);
+    Metrics::endTimeline();
+
+    const vector<string> lines = readLines("util_metrics_timeline.jsonl");
+    if (lines.size() != 2) {
+      throw DxvkError("Unexpected number of JSON lines");
+    }
+
+    // Unlike the CSV header, JSON timelines include metrics registered at any point
+    if (lines[0].find("{\"frame\":7,") != 0) {
+      throw DxvkError("Unexpected JSON frame");
+    }
+    if (lines[0].find("\"test.counter\":" + to_string(kNumThreads * kNumRecords)) == string::npos) {
+      throw DxvkError("Counter missing from JSON");
+    }
+    if (lines[0].find("\"test.histogram\":{\"count\":" + to_string(kNumThreads * kNumRecords) + ",\"min\":0,") == string::npos) {
+      throw DxvkError("Histogram missing from JSON");
+    }
+    if (lines[0].find("\"test.late_counter\":0") == string::npos) {
+      throw DxvkError("Late metric missing from JSON");
+    }
+    if (lines[1].find("\"test.histogram\":{\"count\":0}") == string::npos) {
+      throw DxvkError("Empty histogram mismatch");
+    }
+  }
+};
+
+int main() {
+  try {
+    MetricsTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,216 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <iostream>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_priority_queue.h"
+
+using namespace dxvk;
+using namespace std;
+
+// Items are indices into the world state, mirroring how the texture manager reads
+// priorities from the textures themselves
+struct TestWorld {
+  uint32_t frame = 1;
+  bool prioritize = true;
+  vector<float> priorities;
+  vector<uint32_t> frameQueued;
+};
+
+struct TestPolicy {
+  explicit TestPolicy(const TestWorld* world)
+    : m_world(world) { }
+
+  uint32_t currentFrame() const {
+    return m_world->frame;
+  }
+
+  bool prioritize() const {
+    return m_world->prioritize;
+  }
+
+  bool isReady(const uint32_t& item, uint32_t frame) const {
+    return m_world->frameQueued[item] < frame;
+  }
+
+  float priority(const uint32_t& item, uint32_t frame) const {
+    return m_world->priorities[item];
+  }
+
+private:
+  const TestWorld* m_world;
+};
+
+using TestQueue = FramePriorityQueue<uint32_t, TestPolicy>;
+
+class PriorityQueueTestApp {
+public:
+  static void run() {
+    cout << "Begin priority order test" << endl;
+    test_order();
+    cout << "Begin readiness test" << endl;
+    test_readiness();
+    cout << "Begin frame refresh test" << endl;
+    test_refresh();
+    cout << "Begin FIFO test" << endl;
+    test_fifo();
+    cout << "FramePriorityQueue successfully tested" << endl;
+  }
+
+private:
+  static uint32_t add(TestWorld& world, TestQueue& queue, float priority, bool ready = false) {
+    const uint32_t item = static_cast<uint32_t>(world.priorities.size());
+    world.priorities.push_back(priority);
+    world.frameQueued.push_back(ready ? 0 : world.frame);
+    queue.emplace(item);
+    return item;
+  }
+
+  static vector<uint32_t> drain(TestQueue& queue) {
+    vector<uint32_t> order;
+    while (!queue.empty()) {
+      order.push_back(queue.front());
+      queue.pop();
+    }
+    return order;
+  }
+
+  static void test_order() {
+    TestWorld world;
+    TestQueue queue(&world);
+
+    add(world, queue, 0.5f);
+    add(world, queue, 2.f);
+    add(world, queue, 1.f);
+    add(world, queue, 2.f);
+    add(world, queue, 0.25f);
+
+    // Everything was queued in this frame, the next one may upload them
+    world.frame++;
+
+    // Ties are handed out in submission order
+    if (drain(queue) != vector<uint32_t> { 1, 3, 2, 0, 4 }) {
+      throw DxvkError("Items were not handed out by priority");
+    }
+
+    // Items which are ready when added while the heap is current join it right away,
+    // the others wait for the next frame
+    add(world, queue, 1.f, true);
+    add(world, queue, 3.f, true);
+    add(world, queue, 2.f, false);
+    add(world, queue, 4.f, true);
+
+    if (drain(queue) != vector<uint32_t> { 8, 6, 5, 7 }) {
+      throw DxvkError("Items added mid frame were not ordered");
+    }
+  }
+
+  static void test_readiness() {
+    TestWorld world;
+    TestQueue queue(&world);
+
+    add(world, queue, 1.f);
+    world.frame++;
+    add(world, queue, 8.f);
+    add(world, queue, 4.f);
+
+    // Items cooling down from this frame only go when nothing else is ready, in FIFO order
+    vector<uint32_t> order;
+    order.push_back(queue.front());
+    queue.pop();
+    order.push_back(queue.front());
+    queue.pop();
+
+    if (order != vector<uint32_t> { 0, 1 }) {
+      throw DxvkError("Items which are not ready were handed out first");
+    }
+
+    // Once ready they are ordered by priority against the others
+    add(world, queue, 2.f);
+    world.frame++;
+
+    if (drain(queue) != vector<uint32_t> { 2, 3 }) {
+      throw DxvkError("Items did not join the heap once ready");
+    }
+  }
+
+  static void test_refresh() {
+    TestWorld world;
+    TestQueue queue(&world);
+
+    for (float priority : { 1.f, 2.f, 3.f, 4.f }) {
+      add(world, queue, priority);
+    }
+    world.frame++;
+
+    if (queue.front() != 3) {
+      throw DxvkError("Highest priority item was not picked");
+    }
+    queue.pop();
+
+    // Priorities change within the frame, the heap keeps the ones of the first pick
+    world.priorities[0] = 10.f;
+    if (queue.front() != 2) {
+      throw DxvkError("Priorities were re-evaluated within a frame");
+    }
+
+    // A new frame starting between front() and pop() must not pop a different item
+    world.frame++;
+    queue.pop();
+
+    if (queue.front() != 0) {
+      throw DxvkError("Priorities were not re-evaluated on a new frame");
+    }
+
+    if (drain(queue) != vector<uint32_t> { 0, 1 }) {
+      throw DxvkError("Item picked before the frame change was popped twice or lost");
+    }
+  }
+
+  static void test_fifo() {
+    TestWorld world;
+    world.prioritize = false;
+    TestQueue queue(&world);
+
+    for (float priority : { 1.f, 4.f, 2.f, 3.f }) {
+      add(world, queue, priority);
+    }
+    world.frame++;
+
+    if (drain(queue) != vector<uint32_t> { 0, 1, 2, 3 }) {
+      throw DxvkError("Items were not handed out in FIFO order");
+    }
+  }
+};
+
+int main() {
+  try {
+    PriorityQueueTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
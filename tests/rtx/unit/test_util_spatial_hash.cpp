@@ -0,0 +1,348 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cfloat>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_spatial_hash.h"
+#include "../../../src/dxvk/rtx_render/rtx_instance_matching.h"
+#include "../../../src/dxvk/rtx_render/rtx_light_matching.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+namespace {
+  // Provides what the instance matching reads from an RtInstance
+  struct TestInstance {
+    Matrix4 transform;
+    Vector3 prevWorldPosition;
+    XXH64_hash_t materialHash;
+    uint32_t frameLastUpdated;
+
+    uint32_t getFrameLastUpdated() const { return frameLastUpdated; }
+    const XXH64_hash_t& getMaterialHash() const { return materialHash; }
+    Matrix4 getTransform() const { return transform; }
+    Vector3 getWorldPosition() const { return transform[3].xyz(); }
+    const Vector3& getPrevWorldPosition() const { return prevWorldPosition; }
+  };
+
+  // Provides what the light matching reads from an RtLight
+  struct TestLight {
+    Vector3 position;
+    uint32_t type;
+
+    const Vector3& getPosition() const { return position; }
+    uint32_t getType() const { return type; }
+  };
+
+  using TestLightTable = unordered_map<XXH64_hash_t, TestLight>;
+
+  constexpr float kUniqueObjectDistance = 300.f;
+
+  // Positional part of LightManager::isSimilar
+  float isSimilar(const TestLight& a, const TestLight& b, const float distanceThreshold) {
+    if (a.type != b.type) {
+      return -1.f;
+    }
+    const float distNormalized = length(a.position - b.position) / distanceThreshold;
+    return distNormalized <= 1.f ? 1.f - distNormalized : -1.f;
+  }
+}
+
+class SpatialHashTestApp {
+public:
+  static void run() {
+    cout << "Begin spatial hash correctness test" << endl;
+    test_against_brute_force();
+    cout << "Begin instance matching benchmark" << endl;
+    if (benchmark_instances(false) != benchmark_instances(true)) {
+      throw DxvkError("Instance matching through the index differed from the linear scan");
+    }
+    cout << "Begin light matching benchmark" << endl;
+    for (uint32_t numLights : { 1000u, 5000u, 10000u, 20000u }) {
+      benchmark_light_matching(numLights);
+    }
+    cout << "Begin light merging benchmark" << endl;
+    for (uint32_t numLights : { 1000u, 10000u }) {
+      benchmark_light_merging(numLights);
+    }
+    cout << "Spatial hash successfully tested" << endl;
+  }
+
+private:
+  static void test_against_brute_force() {
+    mt19937 rng(1234);
+    uniform_real_distribution<float> coordDist(-5000.f, 5000.f);
+    uniform_real_distribution<float> radiusDist(0.f, 400.f);
+
+    vector<Vector3> points(20000);
+    for (auto& p : points) {
+      p = Vector3(coordDist(rng), coordDist(rng), coordDist(rng));
+    }
+
+    SpatialHash<uint32_t> index;
+    index.clear(2.f * kUniqueObjectDistance);
+    for (uint32_t i = 0; i < points.size(); i++) {
+      index.insert(points[i], i % 3, i);
+    }
+
+    if (index.size() != points.size()) {
+      throw DxvkError("Entry count mismatch");
+    }
+
+    for (uint32_t q = 0; q < 2000; q++) {
+      const Vector3 center(coordDist(rng), coordDist(rng), coordDist(rng));
+      const float radius = radiusDist(rng);
+      const XXH64_hash_t key = q % 3;
+
+      // Every entry within radius must be visited, entries of other keys never
+      vector<bool> visited(points.size(), false);
+      index.forEachNear(center, radius, key, [&](uint32_t i) {
+        if (i % 3 != key) {
+          throw DxvkError("Visited an entry with a different key");
+        }
+        visited[i] = true;
+        return true;
+      });
+
+      for (uint32_t i = 0; i < points.size(); i++) {
+        if (i % 3 == key && lengthSqr(points[i] - center) <= radius * radius && !visited[i]) {
+          throw DxvkError("Missed an entry within the search radius");
+        }
+      }
+    }
+
+    // Stopping a lookup is reported back
+    uint32_t numVisited = 0;
+    const bool completed = index.forEachNear(points[0], 5000.f, 0, [&](uint32_t) { return ++numVisited < 4; });
+    if (completed || numVisited != 4) {
+      throw DxvkError("Lookup was not stopped by the visitor");
+    }
+
+    // Far out and non finite positions must not break the cell math
+    index.insert(Vector3(FLT_MAX, -FLT_MAX, 1e30f), 7, 0);
+    index.insert(Vector3(NAN, 0.f, 0.f), 7, 1);
+    index.forEachNear(Vector3(FLT_MAX, -FLT_MAX, 1e30f), 1.f, 7, [](uint32_t) { return true; });
+
+    index.clear(1.f);
+    if (!index.empty() || !index.forEachNear(points[0], 1.f, 0, [](uint32_t) { return false; })) {
+      throw DxvkError("Clear left entries behind");
+    }
+  }
+
+  // Matches 10k draws of the same mesh against the previous frame's instances through matchSimilarInstance,
+  // maintaining the index the way InstanceManager does, and moving every instance a little each frame.
+  // Returns the number of draws matched, which must not depend on whether the index is used.
+  static uint32_t benchmark_instances(const bool useIndex) {
+    const uint32_t numInstances = 10000;
+    const uint32_t numFrames = 4;
+    const XXH64_hash_t materialHash = 0x1234;
+
+    mt19937 rng(4321);
+    uniform_real_distribution<float> coordDist(-50000.f, 50000.f);
+    uniform_real_distribution<float> jitterDist(-10.f, 10.f);
+
+    vector<TestInstance> instances(numInstances);
+    vector<const TestInstance*> linkedInstances;
+    for (auto& instance : instances) {
+      instance.transform = Matrix4(Vector3(coordDist(rng), coordDist(rng), 0.f));
+      instance.prevWorldPosition = instance.getWorldPosition();
+      instance.materialHash = materialHash;
+      instance.frameLastUpdated = 0;
+      linkedInstances.push_back(&instance);
+    }
+
+    vector<Matrix4> draws(numInstances);
+    SpatialHash<const TestInstance*> index;
+    uint32_t numMatched = 0;
+
+    const auto start = high_resolution_clock::now();
+
+    for (uint32_t frame = 1; frame <= numFrames; frame++) {
+      for (uint32_t i = 0; i < numInstances; i++) {
+        draws[i] = Matrix4(instances[i].getWorldPosition() + Vector3(jitterDist(rng), jitterDist(rng), 0.f));
+      }
+
+      if (useIndex) {
+        buildInstanceIndex(index, linkedInstances, 2.f * kUniqueObjectDistance, frame);
+      }
+
+      for (const Matrix4& draw : draws) {
+        const SimilarInstanceMatch<TestInstance> match =
+          matchSimilarInstance<TestInstance>(useIndex ? &index : nullptr, linkedInstances, draw, materialHash, frame, kUniqueObjectDistance);
+
+        TestInstance* matched = match.exactMatch ? match.exactMatch : match.nearest;
+        if (matched) {
+          matched->prevWorldPosition = matched->getWorldPosition();
+          matched->transform = draw;
+          matched->frameLastUpdated = frame;
+          numMatched++;
+
+          if (useIndex) {
+            index.insert(matched->getWorldPosition(), kTouchedInstanceIndexKey, matched);
+          }
+        }
+      }
+    }
+
+    const double ms = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    if (numMatched < numInstances * numFrames * 9 / 10) {
+      throw DxvkError("Too few instances matched across frames");
+    }
+
+    cout << (useIndex ? "spatial hash" : "linear scan") << ": " << numInstances << " instances, "
+         << ms / numFrames << " ms per frame (" << numMatched << " matches)" << endl;
+
+    return numMatched;
+  }
+
+  static TestLightTable makeLights(mt19937& rng, const uint32_t numLights, const XXH64_hash_t firstHash) {
+    uniform_real_distribution<float> coordDist(-100000.f, 100000.f);
+
+    TestLightTable lights;
+    for (uint32_t i = 0; i < numLights; i++) {
+      lights[firstHash + i] = TestLight { Vector3(coordDist(rng), coordDist(rng), coordDist(rng) * 0.01f), i % 4 };
+    }
+    return lights;
+  }
+
+  // Matches every light of the previous frame against the lights added this frame, as LightManager::dynamicLightMatching
+  // does, with lights of 4 types scattered over a level.  Every light must find the same match as a linear scan over the
+  // new lights, the time per light should stay flat with the index and grow linearly with the light count without it.
+  static void benchmark_light_matching(const uint32_t numLights) {
+    mt19937 rng(numLights);
+    uniform_real_distribution<float> jitterDist(-50.f, 50.f);
+
+    const TestLightTable prevLights = makeLights(rng, numLights, 0);
+    TestLightTable newLights;
+    for (auto&& [lightHash, light] : prevLights) {
+      newLights[numLights + lightHash] = TestLight { light.position + Vector3(jitterDist(rng), jitterDist(rng), jitterDist(rng)), light.type };
+    }
+
+    auto similarity = [](const TestLight& newLight, const TestLight& prevLight) { return isSimilar(prevLight, newLight, kUniqueObjectDistance); };
+
+    unordered_map<XXH64_hash_t, XXH64_hash_t> linearMatches;
+    auto start = high_resolution_clock::now();
+    for (auto&& [prevHash, prevLight] : prevLights) {
+      float currentSimilarity = -1.f;
+      for (auto&& [newHash, newLight] : newLights) {
+        const float newSimilarity = similarity(newLight, prevLight);
+        if (newSimilarity > currentSimilarity) {
+          currentSimilarity = newSimilarity;
+          linearMatches[prevHash] = newHash;
+        }
+      }
+    }
+    const double linearUs = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+
+    uint32_t numMatchedIndex = 0;
+    start = high_resolution_clock::now();
+    LightIndex index;
+    index.clear(kUniqueObjectDistance);
+    for (auto&& [newHash, newLight] : newLights) {
+      index.insert(newHash, newLight);
+    }
+    for (auto&& [prevHash, prevLight] : prevLights) {
+      const std::optional<XXH64_hash_t> match = index.findMostSimilar(newLights, prevLight, kUniqueObjectDistance, similarity);
+      if (match.has_value()) {
+        if (match.value() != linearMatches[prevHash]) {
+          throw DxvkError("Light matching through the index differed from the linear scan");
+        }
+        numMatchedIndex++;
+      }
+    }
+    const double indexUs = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+
+    if (linearMatches.size() != numLights || numMatchedIndex != numLights) {
+      throw DxvkError("Light failed to match its moved self");
+    }
+
+    cout << numLights << " lights: linear scan " << linearUs / 1000.0 << " ms (" << linearUs * 1000.0 / numLights << " ns per light), "
+         << "spatial hash " << indexUs / 1000.0 << " ms (" << indexUs * 1000.0 / numLights << " ns per light)" << endl;
+  }
+
+  // Resubmits every light each frame under a new hash and slightly perturbed, as LightManager::addLight sees static lights
+  // suffering from precision loss.  Every light must merge with its previous self, and the stale entries this leaves behind
+  // must not grow the index without bound.
+  static void benchmark_light_merging(const uint32_t numLights) {
+    const uint32_t numFrames = 8;
+    const float mergeDistance = 1.f;
+
+    mt19937 rng(numLights);
+    uniform_real_distribution<float> jitterDist(-0.1f, 0.1f);
+
+    TestLightTable lights = makeLights(rng, numLights, 0);
+    LightIndex index;
+    index.rebuild(lights, mergeDistance);
+
+    auto similarity = [mergeDistance](const TestLight& candidate, const TestLight& newLight) { return isSimilar(candidate, newLight, mergeDistance); };
+
+    uint32_t numMerged = 0;
+    const auto start = high_resolution_clock::now();
+
+    for (uint32_t frame = 1; frame <= numFrames; frame++) {
+      for (uint32_t i = 0; i < numLights; i++) {
+        const TestLight& prevLight = lights.at((frame - 1) * numLights + i);
+        const TestLight newLight { prevLight.position + Vector3(jitterDist(rng), jitterDist(rng), jitterDist(rng)), prevLight.type };
+        const XXH64_hash_t newHash = frame * numLights + i;
+
+        const std::optional<XXH64_hash_t> similarLight = index.findSimilar(lights, newLight, mergeDistance, similarity);
+        if (similarLight.has_value()) {
+          lights.erase(similarLight.value());
+          numMerged++;
+        }
+
+        lights[newHash] = newLight;
+        index.update(newHash, lights.at(newHash), lights, mergeDistance);
+      }
+    }
+
+    const double us = duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+
+    if (numMerged != numLights * numFrames || lights.size() != numLights) {
+      throw DxvkError("Resubmitted light failed to merge with its previous self");
+    }
+    if (index.size() > 3 * numLights + 256) {
+      throw DxvkError("Stale light index entries were never dropped");
+    }
+
+    cout << numLights << " lights: " << us / 1000.0 / numFrames << " ms per frame (" << us * 1000.0 / (numLights * numFrames) << " ns per light)" << endl;
+  }
+};
+
+int main() {
+  try {
+    SpatialHashTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}
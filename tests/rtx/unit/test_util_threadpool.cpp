@@ -42,6 +42,14 @@ public:
     test_smoke<4>();
     cout << "Begin misc tests" << endl;
     test_misc();
+    cout << "Begin worker arena test" << endl;
+    test_arena();
+    cout << "Begin parallel for test" << endl;
+    test_parallel_for();
+    cout << "Begin continuation test" << endl;
+    test_continuations();
+    cout << "Begin skewed workload benchmark" << endl;
+    benchmark_skewed();
     cout << "WorkerThreadPool successfully smoke tested" << endl;
   }
   
@@ -181,6 +189,291 @@ private:
       throw DxvkError("Result didnt match");
     }
   }
+
+  static void test_arena() {
+    const uint32_t numThreads = 4;
+    const uint32_t numTasks = 256;
+    const uint32_t numFrames = 4;
+
+    WorkerThreadPool<numTasks> threadPool(numThreads);
+
+    if (threadLinearAllocator() != nullptr) {
+      throw DxvkError("Non-worker thread should not own an arena");
+    }
+
+    for (uint32_t frame = 0; frame < numFrames; frame++) {
+      vector<Future<bool>> results(numTasks);
+      for (uint32_t i = 0; i < numTasks; i++) {
+        results[i] = threadPool.Schedule([i]() -> bool {
+          LinearAllocator* pArena = threadLinearAllocator();
+          if (pArena == nullptr) {
+            return false;
+          }
+
+          LinearAllocator::Scope scope(*pArena);
+          const uint32_t count = 1024 + i * 64;
+          uint32_t* pScratch = pArena->alloc<uint32_t>(count);
+          if (reinterpret_cast<uintptr_t>(pScratch) % 16 != 0) {
+            return false;
+          }
+
+          for (uint32_t n = 0; n < count; n++) {
+            pScratch[n] = n;
+          }
+          return pScratch[count - 1] == count - 1;
+        });
+      }
+
+      for (Future<bool>& result : results) {
+        if (!result.get()) {
+          throw DxvkError("Arena allocation from worker failed");
+        }
+      }
+
+      threadPool.resetWorkerArenas();
+    }
+
+    // Wait for the workers to pick up the last reset and publish their stats
+    const auto start = high_resolution_clock::now();
+    WorkerThreadPool<numTasks>::ArenaStats stats;
+    do {
+      std::this_thread::yield();
+      stats = threadPool.getWorkerArenaStats();
+    } while (stats.allocationCount != numTasks && duration_cast<seconds>(high_resolution_clock::now() - start).count() < 5);
+
+    cout << "Arena allocations in last frame: " << stats.allocationCount << ", heap allocations: " << stats.heapAllocationCount << ", peak bytes: " << stats.peakUsage << endl;
+
+    if (stats.allocationCount != numTasks) {
+      throw DxvkError("Arena allocation count didnt match");
+    }
+
+    // A frame in which no worker ran anything must not report the previous frame's usage
+    threadPool.resetWorkerArenas();
+    stats = threadPool.getWorkerArenaStats();
+    if (stats.allocationCount != 0 || stats.peakUsage != 0) {
+      throw DxvkError("Idle workers reported stale arena stats");
+    }
+  }
+
+  static void spinFor(const uint32_t microsecondsToSpin) {
+    const auto start = high_resolution_clock::now();
+    while (duration_cast<microseconds>(high_resolution_clock::now() - start).count() < microsecondsToSpin);
+  }
+
+  static void test_parallel_for() {
+    const uint32_t numThreads = 4;
+    const uint32_t numTasks = 64;
+    const uint32_t numItems = 10000;
+
+    WorkerThreadPool<numTasks> threadPool(numThreads);
+
+    // Every index must be visited exactly once, across a variety of grain sizes
+    for (uint32_t grainSize : { 1u, 7u, 64u, numItems, numItems * 2 }) {
+      vector<atomic<uint32_t>> visits(numItems);
+      threadPool.parallelFor(0, numItems, grainSize, [&visits](uint32_t i) {
+        visits[i].fetch_add(1, memory_order_relaxed);
+      });
+
+      for (uint32_t i = 0; i < numItems; i++) {
+        if (visits[i].load() != 1) {
+          throw DxvkError(str::format("parallelFor visited index ", i, " ", visits[i].load(), " times with grain size ", grainSize));
+        }
+      }
+    }
+
+    // Empty ranges are a no-op
+    threadPool.parallelFor(5, 5, 1, [](uint32_t) { throw DxvkError("parallelFor ran an empty range"); });
+
+    // Continuation must run exactly once, after all indices completed
+    atomic<uint64_t> sum = 0;
+    atomic<uint32_t> continuationCount = 0;
+    atomic<uint64_t> sumAtContinuation = 0;
+    threadPool.parallelForAsync(0, numItems, 16, [&sum](uint32_t i) {
+      sum.fetch_add(i, memory_order_relaxed);
+    }, [&]() {
+      sumAtContinuation = sum.load();
+      continuationCount.fetch_add(1);
+    });
+
+    const auto start = high_resolution_clock::now();
+    while (continuationCount.load() == 0 && duration_cast<seconds>(high_resolution_clock::now() - start).count() < 5) {
+      std::this_thread::yield();
+    }
+
+    const uint64_t expectedSum = (uint64_t) numItems * (numItems - 1) / 2;
+    if (continuationCount.load() != 1 || sumAtContinuation.load() != expectedSum) {
+      throw DxvkError("parallelForAsync continuation did not observe the completed range");
+    }
+
+    // Fork-join over a set of futures
+    vector<Future<void>> futures;
+    atomic<uint32_t> joined = 0;
+    for (uint32_t i = 0; i < numThreads * 4; i++) {
+      futures.push_back(threadPool.Schedule([&joined]() { spinFor(100); joined++; }));
+    }
+    waitAll(futures);
+
+    if (joined.load() != numThreads * 4) {
+      throw DxvkError("waitAll returned before all tasks completed");
+    }
+  }
+
+  static void test_continuations() {
+    const uint32_t numThreads = 4;
+    const uint32_t numTasks = 64;
+
+    WorkerThreadPool<numTasks> threadPool(numThreads);
+
+    // Continuation attached while the task is still running
+    atomic<bool> release = false;
+    Future<uint32_t> pending = threadPool.Schedule([&release]() -> uint32_t {
+      while (!release.load()) {
+        std::this_thread::yield();
+      }
+      return 20;
+    });
+    Future<uint64_t> chained = pending.then([](uint32_t v) -> uint64_t { return (uint64_t) v * 2 + 2; });
+    if (pending.valid() || !chained.valid()) {
+      throw DxvkError("then() should consume the antecedent future");
+    }
+    release = true;
+    if (chained.get() != 42) {
+      throw DxvkError("Continuation result didnt match");
+    }
+
+    // Continuation attached after the task completed runs on the caller
+    atomic<bool> done = false;
+    Future<uint32_t> finished = threadPool.Schedule([&done]() -> uint32_t { done = true; return 7; });
+    while (!done.load()) {
+      std::this_thread::yield();
+    }
+    spinFor(1000);
+    const std::thread::id callerId = std::this_thread::get_id();
+    std::thread::id continuationThreadId;
+    Future<void> tail = finished.then([&continuationThreadId](uint32_t v) {
+      continuationThreadId = std::this_thread::get_id();
+      if (v != 7) {
+        throw DxvkError("Continuation received the wrong value");
+      }
+    });
+    tail.get();
+    if (continuationThreadId != callerId) {
+      throw DxvkError("Continuation of a completed task should run on the caller");
+    }
+
+    // Chains of void tasks
+    uint32_t counter = 0;
+    threadPool.Schedule([&counter]() { counter++; })
+      .then([&counter]() { counter *= 10; })
+      .then([&counter]() -> uint32_t { return counter + 1; })
+      .get();
+    if (counter != 10) {
+      throw DxvkError("Void continuation chain didnt match");
+    }
+
+    // Cancelled continuations are destroyed without running, even when cancelled while the antecedent runs
+    std::atomic<bool> started = false;
+    std::atomic<bool> ran = false;
+    std::atomic<uint32_t> destroyed = 0;
+    release = false;
+    struct DestroyCounter {
+      std::atomic<uint32_t>* pCount;
+      explicit DestroyCounter(std::atomic<uint32_t>& count) : pCount(&count) { }
+      DestroyCounter(DestroyCounter&& other) : pCount(other.pCount) { other.pCount = nullptr; }
+      ~DestroyCounter() { if (pCount) (*pCount)++; }
+    };
+    Future<void> blocker = threadPool.Schedule([&started, &release]() {
+      started = true;
+      while (!release.load()) {
+        std::this_thread::yield();
+      }
+    });
+    while (!started.load()) {
+      std::this_thread::yield();
+    }
+    Future<uint32_t> cancelled = blocker.then([&ran, counter = DestroyCounter(destroyed)]() -> uint32_t {
+      ran = true;
+      return 0;
+    });
+    cancelled.cancel();
+    release = true;
+    auto start = high_resolution_clock::now();
+    while (destroyed.load() == 0 && duration_cast<seconds>(high_resolution_clock::now() - start).count() < 5) {
+      std::this_thread::yield();
+    }
+    if (destroyed.load() != 1) {
+      throw DxvkError("Cancelled continuation was not destroyed");
+    }
+    if (ran.load()) {
+      throw DxvkError("Cancelled continuation was executed");
+    }
+
+    // Chaining onto a task which is still running must not block the caller
+    release = false;
+    std::thread releaser([&release]() {
+      std::this_thread::sleep_for(milliseconds(500));
+      release = true;
+    });
+    start = high_resolution_clock::now();
+    Future<uint32_t> runningChain = threadPool.Schedule([&release]() -> uint32_t {
+        while (!release.load()) {
+          std::this_thread::yield();
+        }
+        return 1;
+      })
+      .then([](uint32_t value) { return value + 1; })
+      .then([](uint32_t value) { return value * 10; })
+      .then([](uint32_t value) { return value + 3; });
+    const auto chainTime = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+    const uint32_t chainedResult = runningChain.get();
+    releaser.join();
+    if (chainTime >= 250) {
+      throw DxvkError(str::format("Chaining continuations blocked the caller for ", chainTime, "ms"));
+    }
+    if (chainedResult != 23) {
+      throw DxvkError("Chained continuations ran out of order");
+    }
+
+    // Parked waiters must wake up, make sure a long task does not leave get() spinning forever
+    Future<uint32_t> slow = threadPool.Schedule([]() -> uint32_t { spinFor(50000); return 1; });
+    if (slow.get() != 1) {
+      throw DxvkError("Parked result didnt match");
+    }
+  }
+
+  static void benchmark_skewed() {
+    const uint32_t numThreads = WorkerThreadPool<1>::getDefaultThreadCount(4, 8);
+    const uint32_t numItems = 1024;
+
+    // Every 16th item is 40x as expensive, and they land on the same worker under round-robin scheduling
+    auto costOf = [numThreads](uint32_t i) -> uint32_t {
+      return (i % (numThreads * 16)) < numThreads ? 400 : 10;
+    };
+
+    WorkerThreadPool<numItems> threadPool(numThreads);
+    cout << "Created thread pool with " << (uint32_t) threadPool.getThreadCount() << " threads" << endl;
+
+    double roundRobinMs, parallelForMs;
+    {
+      Timer t;
+      const auto start = high_resolution_clock::now();
+      vector<Future<void>> futures(numItems);
+      for (uint32_t i = 0; i < numItems; i++) {
+        futures[i] = threadPool.Schedule([cost = costOf(i)]() { spinFor(cost); });
+      }
+      waitAll(futures);
+      roundRobinMs = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+    }
+
+    {
+      Timer t;
+      const auto start = high_resolution_clock::now();
+      threadPool.parallelFor(0, numItems, 4, [&costOf](uint32_t i) { spinFor(costOf(i)); });
+      parallelForMs = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+    }
+
+    cout << "Skewed workload of " << numItems << " items: round-robin Schedule " << roundRobinMs << " ms, parallelFor " << parallelForMs << " ms" << endl;
+  }
 };
 
 int main() {
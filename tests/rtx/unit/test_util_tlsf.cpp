@@ -0,0 +1,394 @@
+/*
+* Copyright (c) 2023, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_tlsf.h"
+
+using namespace dxvk;
+using namespace std;
+using namespace chrono;
+
+namespace {
+  // The suballocator DxvkMemoryChunk used before, kept as the baseline for the benchmark:
+  // a worst-fit linear scan of the free list, and a linear pass to coalesce on free.
+  class LegacyChunk {
+    struct FreeSlice {
+      uint64_t offset;
+      uint64_t length;
+    };
+
+  public:
+    explicit LegacyChunk(const uint64_t size) {
+      m_freeList.push_back({ 0, size });
+    }
+
+    uint64_t alloc(const uint64_t size, const uint64_t alignment) {
+      if (m_freeList.size() == 0)
+        return TlsfAllocator::kInvalidOffset;
+
+      auto bestSlice = m_freeList.begin();
+
+      for (auto slice = m_freeList.begin(); slice != m_freeList.end(); slice++) {
+        if (slice->length == size) {
+          bestSlice = slice;
+          break;
+        } else if (slice->length > bestSlice->length) {
+          bestSlice = slice;
+        }
+      }
+
+      const uint64_t sliceStart = bestSlice->offset;
+      const uint64_t sliceEnd   = bestSlice->offset + bestSlice->length;
+      const uint64_t allocStart = align(sliceStart, alignment);
+      const uint64_t allocEnd   = allocStart + size;
+
+      if (allocEnd > sliceEnd)
+        return TlsfAllocator::kInvalidOffset;
+
+      m_freeList.erase(bestSlice);
+
+      if (allocStart != sliceStart)
+        m_freeList.push_back({ sliceStart, allocStart - sliceStart });
+
+      if (allocEnd != sliceEnd)
+        m_freeList.push_back({ allocEnd, sliceEnd - allocEnd });
+
+      return allocStart;
+    }
+
+    void free(uint64_t offset, uint64_t length) {
+      auto curr = m_freeList.begin();
+
+      while (curr != m_freeList.end()) {
+        if (curr->offset == offset + length) {
+          length += curr->length;
+          curr = m_freeList.erase(curr);
+        } else if (curr->offset + curr->length == offset) {
+          offset -= curr->length;
+          length += curr->length;
+          curr = m_freeList.erase(curr);
+        } else {
+          curr++;
+        }
+      }
+
+      m_freeList.push_back({ offset, length });
+    }
+
+    uint64_t freeSize() const {
+      uint64_t total = 0;
+      for (const auto& slice : m_freeList) {
+        total += slice.length;
+      }
+      return total;
+    }
+
+    uint64_t largestFreeBlock() const {
+      uint64_t largest = 0;
+      for (const auto& slice : m_freeList) {
+        largest = std::max(largest, slice.length);
+      }
+      return largest;
+    }
+
+  private:
+    std::vector<FreeSlice> m_freeList;
+  };
+
+  // DxvkMemoryChunk passes the slice length back on free, the TLSF allocator looks it up itself
+  class TlsfChunk : public TlsfAllocator {
+  public:
+    using TlsfAllocator::TlsfAllocator;
+
+    void free(const uint64_t offset, const uint64_t) {
+      TlsfAllocator::free(offset);
+    }
+  };
+
+  // One step of an allocation trace.  Frees refer to the allocation made by step allocStep.
+  struct TraceOp {
+    bool isAlloc;
+    uint32_t allocStep;
+    uint64_t size;
+    uint64_t alignment;
+  };
+
+  constexpr uint64_t kChunkSize = 256ull << 20;
+
+  // Mimics what a device local memory chunk sees over a session: a mix of small buffers and large
+  // textures with the alignments Vulkan typically asks for, where most allocations are short lived
+  // (staging and per-frame resources) and the rest persist, keeping the chunk around 70% full.
+  vector<TraceOp> generateTrace(const uint32_t numOps, const uint32_t seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> log2SizeDist(8.0, 22.0);
+    uniform_real_distribution<float> unitDist(0.f, 1.f);
+
+    vector<TraceOp> trace;
+    trace.reserve(numOps);
+
+    vector<uint32_t> transient, persistent;
+    uint64_t liveSize = 0;
+
+    auto freeOne = [&](vector<uint32_t>& live) {
+      const uint32_t i = rng() % live.size();
+      const uint32_t step = live[i];
+      live[i] = live.back();
+      live.pop_back();
+
+      trace.push_back({ false, step, trace[step].size, trace[step].alignment });
+      liveSize -= trace[step].size;
+    };
+
+    while (trace.size() < numOps) {
+      if (liveSize < kChunkSize * 7 / 10 && unitDist(rng) < 0.6f) {
+        const float kind = unitDist(rng);
+        const uint64_t alignment = kind < 0.5f ? 256 : kind < 0.8f ? 4096 : 65536;
+        const uint64_t size = align<uint64_t>(static_cast<uint64_t>(exp2(log2SizeDist(rng))), 16);
+
+        (unitDist(rng) < 0.8f ? transient : persistent).push_back(static_cast<uint32_t>(trace.size()));
+        trace.push_back({ true, static_cast<uint32_t>(trace.size()), size, alignment });
+        liveSize += size;
+      } else if (!transient.empty() && (persistent.empty() || unitDist(rng) < 0.9f)) {
+        freeOne(transient);
+      } else if (!persistent.empty()) {
+        freeOne(persistent);
+      }
+    }
+
+    return trace;
+  }
+}
+
+class TlsfTestApp {
+public:
+  static void run() {
+    cout << "Begin TLSF edge case test" << endl;
+    test_edge_cases();
+    cout << "Begin TLSF randomized test" << endl;
+    test_against_reference(1);
+    test_against_reference(2);
+    test_against_reference(3);
+    cout << "Begin suballocator trace replay benchmark" << endl;
+    const vector<TraceOp> trace = generateTrace(200000, 42);
+    benchmark<LegacyChunk>("legacy free list", trace);
+    benchmark<TlsfChunk>("tlsf", trace);
+    cout << "TLSF allocator successfully tested" << endl;
+  }
+
+private:
+  static void test_edge_cases() {
+    // An empty range never hands out anything
+    TlsfAllocator empty;
+    if (empty.alloc(1) != TlsfAllocator::kInvalidOffset) {
+      throw DxvkError("Allocated from an empty range");
+    }
+
+    // The whole range can be allocated at once, aligned or not
+    TlsfAllocator tlsf(1 << 20);
+    if (tlsf.alloc(1 << 20, 65536) != 0) {
+      throw DxvkError("Failed to allocate the whole range with alignment");
+    }
+    if (tlsf.alloc(1) != TlsfAllocator::kInvalidOffset) {
+      throw DxvkError("Allocated from a full range");
+    }
+    if (tlsf.free(0) != 1 << 20) {
+      throw DxvkError("Freed size mismatch");
+    }
+
+    if (tlsf.alloc((1 << 20) + 1) != TlsfAllocator::kInvalidOffset) {
+      throw DxvkError("Allocated more than the range");
+    }
+
+    // Misaligned free space in front of an aligned allocation is returned to the free bins
+    const uint64_t a = tlsf.alloc(100);
+    const uint64_t b = tlsf.alloc(4096, 4096);
+    if (!(a == 0 && b == 4096)) {
+      throw DxvkError("Unexpected placement");
+    }
+    if (tlsf.freeBlockCount() != 2) {
+      throw DxvkError("Alignment padding was not kept free");
+    }
+    if (tlsf.alloc(3996) != 100) {
+      throw DxvkError("Alignment padding was not reused");
+    }
+
+    // Freeing the middle block of three coalesces with both neighbors
+    tlsf.free(0);
+    tlsf.free(100);
+    if (tlsf.freeBlockCount() != 2) {
+      throw DxvkError("Freed neighbors were not coalesced");
+    }
+    tlsf.free(4096);
+    if (!(tlsf.empty() && tlsf.freeBlockCount() == 1 && tlsf.largestFreeBlock() == 1 << 20)) {
+      throw DxvkError("Range was not restored after freeing everything");
+    }
+
+    // Many tiny allocations, then a large one which only fits once they are gone
+    vector<uint64_t> offsets;
+    for (uint64_t offset; (offset = tlsf.alloc(17)) != TlsfAllocator::kInvalidOffset; ) {
+      offsets.push_back(offset);
+    }
+    if (offsets.size() != (1 << 20) / 17) {
+      throw DxvkError("Tiny allocations did not fill the range");
+    }
+    if (tlsf.alloc(1 << 19) != TlsfAllocator::kInvalidOffset) {
+      throw DxvkError("Allocated from a full range");
+    }
+    for (uint64_t offset : offsets) {
+      tlsf.free(offset);
+    }
+    if (tlsf.alloc(1 << 19, 1 << 19) != 0) {
+      throw DxvkError("Range was fragmented after freeing everything");
+    }
+  }
+
+  // Random allocations and frees, checked against a map of the live allocations
+  static void test_against_reference(const uint32_t seed) {
+    mt19937 rng(seed);
+    uniform_real_distribution<double> log2SizeDist(0.0, 18.0);
+
+    const uint64_t size = (32ull << 20) + seed * 12345;
+    TlsfAllocator tlsf(size);
+    map<uint64_t, uint64_t> live;
+    uint64_t liveSize = 0;
+
+    for (uint32_t i = 0; i < 100000; i++) {
+      if (live.empty() || rng() % 100 < 55) {
+        const uint64_t allocSize = static_cast<uint64_t>(exp2(log2SizeDist(rng)));
+        const uint64_t alignment = uint64_t(1) << (rng() % 17);
+        const uint64_t offset = tlsf.alloc(allocSize, alignment);
+
+        if (offset == TlsfAllocator::kInvalidOffset) {
+          // A failure is only acceptable if the request, padded for alignment and rounded up to
+          // the next size class (at most 1/32 larger), does not fit the largest free block
+          const uint64_t paddedSize = allocSize + alignment - 1;
+          if (paddedSize + paddedSize / 32 < tlsf.largestFreeBlock()) {
+            throw DxvkError("Allocation failed despite enough space");
+          }
+          continue;
+        }
+
+        if (offset % alignment != 0) {
+          throw DxvkError("Misaligned allocation");
+        }
+        if (offset + allocSize > size) {
+          throw DxvkError("Allocation out of range");
+        }
+
+        auto next = live.lower_bound(offset);
+        if (!(next == live.end() || offset + allocSize <= next->first)) {
+          throw DxvkError("Allocation overlaps its successor");
+        }
+        if (!(next == live.begin() || prev(next)->first + prev(next)->second <= offset)) {
+          throw DxvkError("Allocation overlaps its predecessor");
+        }
+
+        live.emplace(offset, allocSize);
+        liveSize += allocSize;
+      } else {
+        auto it = live.begin();
+        advance(it, rng() % live.size());
+
+        if (tlsf.free(it->first) != it->second) {
+          throw DxvkError("Freed size mismatch");
+        }
+        liveSize -= it->second;
+        live.erase(it);
+      }
+
+      if (tlsf.freeSize() != size - liveSize) {
+        throw DxvkError("Free size mismatch");
+      }
+      if (tlsf.allocationCount() != live.size()) {
+        throw DxvkError("Allocation count mismatch");
+      }
+    }
+
+    for (const auto& allocation : live) {
+      tlsf.free(allocation.first);
+    }
+
+    if (!(tlsf.empty() && tlsf.freeBlockCount() == 1 && tlsf.largestFreeBlock() == size)) {
+      throw DxvkError("Range was not restored after freeing everything");
+    }
+  }
+
+  template<typename Allocator>
+  static void benchmark(const char* name, const vector<TraceOp>& trace) {
+    Allocator allocator(kChunkSize);
+    vector<uint64_t> offsets(trace.size(), TlsfAllocator::kInvalidOffset);
+
+    uint32_t numFailed = 0;
+    uint32_t numSamples = 0;
+    double fragmentation = 0.0;
+    duration<double, micro> elapsed(0);
+
+    // Time the trace in batches, sampling the fragmentation in between: 1 - largest free block / free bytes
+    const size_t kBatchSize = 1000;
+
+    for (size_t batch = 0; batch < trace.size(); batch += kBatchSize) {
+      const auto start = high_resolution_clock::now();
+
+      for (size_t i = batch; i < std::min(batch + kBatchSize, trace.size()); i++) {
+        const TraceOp& op = trace[i];
+
+        if (op.isAlloc) {
+          offsets[i] = allocator.alloc(op.size, op.alignment);
+          numFailed += offsets[i] == TlsfAllocator::kInvalidOffset;
+        } else if (offsets[op.allocStep] != TlsfAllocator::kInvalidOffset) {
+          allocator.free(offsets[op.allocStep], op.size);
+        }
+      }
+
+      elapsed += high_resolution_clock::now() - start;
+
+      const uint64_t freeSize = allocator.freeSize();
+      if (freeSize != 0) {
+        fragmentation += 1.0 - double(allocator.largestFreeBlock()) / double(freeSize);
+        numSamples++;
+      }
+    }
+
+    cout << name << ": " << trace.size() << " ops in " << elapsed.count() / 1000.0 << " ms ("
+         << elapsed.count() * 1000.0 / trace.size() << " ns per op), "
+         << numFailed << " failed allocations, "
+         << 100.0 * fragmentation / std::max(numSamples, 1u) << "% average fragmentation" << endl;
+  }
+};
+
+int main() {
+  try {
+    TlsfTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    cerr << e.message() << endl;
+    return -1;
+  }
+
+  return 0;
+}